@@ -33,13 +33,22 @@ namespace
     const char kDesc[] = "Implementation of \"Edge-Avoiding A-Trous Wavelet Transform for Fast Global Illumination Filtering\"";
 
     const char kATrousFile[] = "RenderPasses/Hime/ATrousWaveletFilter/ATrous.ps.slang";
+    const char kPackGBufferFile[] = "RenderPasses/Hime/ATrousWaveletFilter/PackGBuffer.ps.slang";
+    const char kTemporalFile[] = "RenderPasses/Hime/ATrousWaveletFilter/TemporalAccumulation.ps.slang";
 
     const char kColorInput[] = "color";
     const char kColorTexName[] = "gColorMap";
+    const char kNormalInput[] = "normal";
+    const char kPositionInput[] = "position";
     const ChannelList kInputChannels = {
-        { kColorInput, kColorTexName , "Ray tracing output."     , false, ResourceFormat::RGBA32Float },
-        { "normal"   , "gNormalMap"  , "Normal in world space."  , false, ResourceFormat::RGBA32Float },
-        { "position" , "gPosMap"     , "Position in world space.", false, ResourceFormat::RGBA32Float },
+        { kColorInput   , kColorTexName , "Ray tracing output."     , false, ResourceFormat::RGBA32Float },
+        { kNormalInput  , "gNormalMap"  , "Normal in world space."  , false, ResourceFormat::RGBA32Float },
+        { kPositionInput, "gPosMap"     , "Position in world space.", false, ResourceFormat::RGBA32Float },
+    };
+
+    const char kMotionVectorInput[] = "mvec";
+    const ChannelList kTemporalInputChannels = {
+        { kMotionVectorInput, "gMotionVector", "Motion vectors, used by variance guidance.", true /* optional */, ResourceFormat::RG32Float },
     };
 
     const ChannelDesc kOutput = {"filtered color", "gFilteredColor", "Filtered image.", false, ResourceFormat::RGBA16Float };
@@ -48,6 +57,14 @@ namespace
     const char kColorPhi[] = "color phi";
     const char kNormalPhi[] = "normal phi";
     const char kPositionPhi[] = "position phi";
+    const char kCompactGBuffer[] = "compact gbuffer";
+    const char kVarianceGuidance[] = "variance guidance";
+    const char kLuminancePhi[] = "luminance phi";
+    const char kColorAlpha[] = "color alpha";
+    const char kMomentsAlpha[] = "moments alpha";
+    const char kMaxHistoryLength[] = "max history length";
+    const char kDisocclusionNormalThreshold[] = "disocclusion normal threshold";
+    const char kDisocclusionDepthThreshold[] = "disocclusion depth threshold";
 }
 
 // Don't remove this. it's required for hot-reload to function properly
@@ -77,6 +94,14 @@ Dictionary ATrousWaveletFilter::getScriptingDictionary()
     d[kColorPhi] = mParams.cPhi;
     d[kNormalPhi] = mParams.nPhi;
     d[kPositionPhi] = mParams.pPhi;
+    d[kCompactGBuffer] = mParams.useCompactGBuffer;
+    d[kVarianceGuidance] = mParams.useVarianceGuidance;
+    d[kLuminancePhi] = mParams.lPhi;
+    d[kColorAlpha] = mParams.colorAlpha;
+    d[kMomentsAlpha] = mParams.momentsAlpha;
+    d[kMaxHistoryLength] = mParams.maxHistoryLength;
+    d[kDisocclusionNormalThreshold] = mParams.disocclusionNormalThreshold;
+    d[kDisocclusionDepthThreshold] = mParams.disocclusionDepthThreshold;
     return d;
 }
 
@@ -87,6 +112,14 @@ void ATrousWaveletFilter::registerBindings(pybind11::module& m)
     pass.def_property(kColorPhi, &ATrousWaveletFilter::getCPhi, &ATrousWaveletFilter::setCPhi);
     pass.def_property(kNormalPhi, &ATrousWaveletFilter::getNPhi, &ATrousWaveletFilter::setNPhi);
     pass.def_property(kPositionPhi, &ATrousWaveletFilter::getPPhi, &ATrousWaveletFilter::setPPhi);
+    pass.def_property(kCompactGBuffer, &ATrousWaveletFilter::getCompactGBuffer, &ATrousWaveletFilter::setCompactGBuffer);
+    pass.def_property(kVarianceGuidance, &ATrousWaveletFilter::getVarianceGuidance, &ATrousWaveletFilter::setVarianceGuidance);
+    pass.def_property(kLuminancePhi, &ATrousWaveletFilter::getLPhi, &ATrousWaveletFilter::setLPhi);
+    pass.def_property(kColorAlpha, &ATrousWaveletFilter::getColorAlpha, &ATrousWaveletFilter::setColorAlpha);
+    pass.def_property(kMomentsAlpha, &ATrousWaveletFilter::getMomentsAlpha, &ATrousWaveletFilter::setMomentsAlpha);
+    pass.def_property(kMaxHistoryLength, &ATrousWaveletFilter::getMaxHistoryLength, &ATrousWaveletFilter::setMaxHistoryLength);
+    pass.def_property(kDisocclusionNormalThreshold, &ATrousWaveletFilter::getDisocclusionNormalThreshold, &ATrousWaveletFilter::setDisocclusionNormalThreshold);
+    pass.def_property(kDisocclusionDepthThreshold, &ATrousWaveletFilter::getDisocclusionDepthThreshold, &ATrousWaveletFilter::setDisocclusionDepthThreshold);
 }
 
 ATrousWaveletFilter::ATrousWaveletFilter(const Dictionary& dict)
@@ -97,9 +130,18 @@ ATrousWaveletFilter::ATrousWaveletFilter(const Dictionary& dict)
         else if (key == kColorPhi) mParams.cPhi = value;
         else if (key == kNormalPhi) mParams.nPhi = value;
         else if (key == kPositionPhi) mParams.pPhi = value;
+        else if (key == kCompactGBuffer) mParams.useCompactGBuffer = value;
+        else if (key == kVarianceGuidance) mParams.useVarianceGuidance = value;
+        else if (key == kLuminancePhi) mParams.lPhi = value;
+        else if (key == kColorAlpha) mParams.colorAlpha = value;
+        else if (key == kMomentsAlpha) mParams.momentsAlpha = value;
+        else if (key == kMaxHistoryLength) mParams.maxHistoryLength = value;
+        else if (key == kDisocclusionNormalThreshold) mParams.disocclusionNormalThreshold = value;
+        else if (key == kDisocclusionDepthThreshold) mParams.disocclusionDepthThreshold = value;
     }
 
-    mpATrousPass = FullScreenPass::create(kATrousFile);
+    mpPackGBufferPass = FullScreenPass::create(kPackGBufferFile);
+    mpTemporalPass = FullScreenPass::create(kTemporalFile);
 }
 
 RenderPassReflection ATrousWaveletFilter::reflect(const CompileData& compileData)
@@ -107,6 +149,7 @@ RenderPassReflection ATrousWaveletFilter::reflect(const CompileData& compileData
     RenderPassReflection reflector;
 
     addRenderPassInputs(reflector, kInputChannels);
+    addRenderPassInputs(reflector, kTemporalInputChannels);
 
     reflector.addOutput(kOutput.name, kOutput.desc)
         .format(kOutput.format)
@@ -125,6 +168,89 @@ void ATrousWaveletFilter::compile(RenderContext* context, const CompileData& com
     desc.setColorTarget(0, ResourceFormat::RGBA32Float);
     mpPingPongFbo[0] = Fbo::create2D(dims.x, dims.y, desc);
     mpPingPongFbo[1] = Fbo::create2D(dims.x, dims.y, desc);
+
+    Fbo::Desc packedDesc;
+    packedDesc.setColorTarget(0, ResourceFormat::R32Uint);
+    mpPackedGBufferFbo = Fbo::create2D(dims.x, dims.y, packedDesc);
+
+    // Filter input, then history: color and length, moments, normal and position.
+    Fbo::Desc temporalDesc;
+    temporalDesc.setColorTarget(0, ResourceFormat::RGBA32Float);
+    temporalDesc.setColorTarget(1, ResourceFormat::RGBA32Float);
+    temporalDesc.setColorTarget(2, ResourceFormat::RG32Float);
+    temporalDesc.setColorTarget(3, ResourceFormat::RGBA32Float);
+    temporalDesc.setColorTarget(4, ResourceFormat::RGBA32Float);
+    mpTemporalFbo[0] = Fbo::create2D(dims.x, dims.y, temporalDesc);
+    mpTemporalFbo[1] = Fbo::create2D(dims.x, dims.y, temporalDesc);
+    mClearHistory = true;
+}
+
+void ATrousWaveletFilter::setScene(RenderContext* pRenderContext, const Scene::SharedPtr& pScene)
+{
+    mpScene = pScene;
+    mpATrousPass = nullptr;
+    mClearHistory = true;
+}
+
+void ATrousWaveletFilter::packGBuffer(RenderContext* pRenderContext, const RenderData& renderData)
+{
+    PROFILE("Pack G-buffer");
+
+    const CameraData& camera = mpScene->getCamera()->getData();
+    const float3 cameraForward = normalize(camera.cameraW);
+
+    mpPackGBufferPass.getRootVar()["PerFrameCB"]["gCameraPosW"] = camera.posW;
+    mpPackGBufferPass.getRootVar()["PerFrameCB"]["gCameraForward"] = cameraForward;
+    mpPackGBufferPass.getRootVar()["gNormalMap"] = renderData[kNormalInput]->asTexture();
+    mpPackGBufferPass.getRootVar()["gPosMap"] = renderData[kPositionInput]->asTexture();
+    mpPackGBufferPass->execute(pRenderContext, mpPackedGBufferFbo);
+
+    // Filter reconstructs position along the same pixel rays.
+    mpATrousPass.getRootVar()["PerFrameCB"]["gCameraPosW"] = camera.posW;
+    mpATrousPass.getRootVar()["PerFrameCB"]["gCameraForward"] = cameraForward;
+    mpATrousPass.getRootVar()["PerFrameCB"]["gCameraU"] = camera.cameraU;
+    mpATrousPass.getRootVar()["PerFrameCB"]["gCameraV"] = camera.cameraV;
+    mpATrousPass.getRootVar()["PerFrameCB"]["gCameraW"] = camera.cameraW;
+    mpATrousPass.getRootVar()["gPackedGBuffer"] = mpPackedGBufferFbo->getColorTexture(0);
+}
+
+void ATrousWaveletFilter::accumulate(RenderContext* pRenderContext, const RenderData& renderData)
+{
+    PROFILE("Temporal Accumulation");
+
+    if (mClearHistory)
+    {
+        pRenderContext->clearFbo(mpTemporalFbo[0].get(), float4(0), 1.0f, 0, FboAttachmentType::All);
+        pRenderContext->clearFbo(mpTemporalFbo[1].get(), float4(0), 1.0f, 0, FboAttachmentType::All);
+        mClearHistory = false;
+    }
+
+    mpTemporalPass.getRootVar()["PerFrameCB"]["gColorAlpha"] = mParams.colorAlpha;
+    mpTemporalPass.getRootVar()["PerFrameCB"]["gMomentsAlpha"] = mParams.momentsAlpha;
+    mpTemporalPass.getRootVar()["PerFrameCB"]["gMaxHistoryLength"] = (float)mParams.maxHistoryLength;
+    mpTemporalPass.getRootVar()["PerFrameCB"]["gNPhi"] = mParams.nPhi;
+    mpTemporalPass.getRootVar()["PerFrameCB"]["gPPhi"] = mParams.pPhi;
+    mpTemporalPass.getRootVar()["PerFrameCB"]["gDisocclusionNormalThreshold"] = mParams.disocclusionNormalThreshold;
+    mpTemporalPass.getRootVar()["PerFrameCB"]["gDisocclusionDepthThreshold"] = mParams.disocclusionDepthThreshold;
+    mpTemporalPass.getRootVar()["PerFrameCB"]["gResolution"] = mParams.resolution;
+    mpTemporalPass.getRootVar()["PerFrameCB"]["gCameraPosW"] = mpScene ? mpScene->getCamera()->getPosition() : float3(0);
+    for (const auto& input : kInputChannels)
+    {
+        mpTemporalPass.getRootVar()[input.texname] = renderData[input.name]->asTexture();
+    }
+    const auto& pMotionVector = renderData[kMotionVectorInput];
+    mpTemporalPass.getRootVar()["gMotionVector"] = pMotionVector ? pMotionVector->asTexture() : nullptr;
+
+    // History of previous frame is in temporal fbo 1.
+    mpTemporalPass.getRootVar()["gPrevColor"] = mpTemporalFbo[1]->getColorTexture(1);
+    mpTemporalPass.getRootVar()["gPrevMoments"] = mpTemporalFbo[1]->getColorTexture(2);
+    mpTemporalPass.getRootVar()["gPrevNormal"] = mpTemporalFbo[1]->getColorTexture(3);
+    mpTemporalPass.getRootVar()["gPrevPos"] = mpTemporalFbo[1]->getColorTexture(4);
+    mpTemporalPass->execute(pRenderContext, mpTemporalFbo[0]);
+
+    // Accumulated color and variance are input of filter iterations.
+    pRenderContext->blit(mpTemporalFbo[0]->getColorTexture(0)->getSRV(), mpPingPongFbo[0]->getColorTexture(0)->getRTV());
+    std::swap(mpTemporalFbo[0], mpTemporalFbo[1]);
 }
 
 void ATrousWaveletFilter::execute(RenderContext* pRenderContext, const RenderData& renderData)
@@ -141,23 +267,49 @@ void ATrousWaveletFilter::execute(RenderContext* pRenderContext, const RenderDat
     {
         PROFILE("A-Trous Filtering");
 
+        const bool useCompactGBuffer = mParams.useCompactGBuffer && mpScene;
+        if (mpATrousPass == nullptr)
+        {
+            Program::DefineList defines;
+            defines.add("USE_COMPACT_GBUFFER", useCompactGBuffer ? "1" : "0");
+            defines.add("USE_VARIANCE_GUIDANCE", mParams.useVarianceGuidance ? "1" : "0");
+            mpATrousPass = FullScreenPass::create(kATrousFile, defines);
+        }
+
         mpATrousPass.getRootVar()["PerFrameCB"]["gCPhi"] = mParams.cPhi;
         mpATrousPass.getRootVar()["PerFrameCB"]["gNPhi"] = mParams.nPhi;
         mpATrousPass.getRootVar()["PerFrameCB"]["gPPhi"] = mParams.pPhi;
+        mpATrousPass.getRootVar()["PerFrameCB"]["gLPhi"] = mParams.lPhi;
         mpATrousPass.getRootVar()["PerFrameCB"]["gResolution"] = mParams.resolution;
 
-        // Bind color, normal and position.
-        for (const auto& input : kInputChannels)
+        // Bind color, normal and position, or packed normal and depth.
+        if (useCompactGBuffer)
         {
-            mpATrousPass.getRootVar()[input.texname] = renderData[input.name]->asTexture();
+            packGBuffer(pRenderContext, renderData);
+        }
+        else
+        {
+            for (const auto& input : kInputChannels)
+            {
+                mpATrousPass.getRootVar()[input.texname] = renderData[input.name]->asTexture();
+            }
         }
 
-        pRenderContext->blit(pColorTexture->getSRV(), mpPingPongFbo[0]->getColorTexture(0)->getRTV());
+        if (mParams.useVarianceGuidance)
+        {
+            accumulate(pRenderContext, renderData);
+            mpATrousPass.getRootVar()["gInputColor"] = pColorTexture;
+        }
+        else
+        {
+            pRenderContext->blit(pColorTexture->getSRV(), mpPingPongFbo[0]->getColorTexture(0)->getRTV());
+        }
 
         for (int i = 0; i < mParams.iterations; i++)
         {
             mpATrousPass.getRootVar()[kColorTexName] = mpPingPongFbo[0]->getColorTexture(0);
             mpATrousPass.getRootVar()["PerFrameCB"]["gStepSize"] = 1 << i;
+            mpATrousPass.getRootVar()["PerFrameCB"]["gIsLastIteration"] = i == mParams.iterations - 1 ? 1 : 0;
 
             mpATrousPass->execute(pRenderContext, mpPingPongFbo[1]);
 
@@ -181,4 +333,23 @@ void ATrousWaveletFilter::renderUI(Gui::Widgets& widget)
     widget.var("Color Phi", mParams.cPhi, 0.0f, 10000.0f, 0.01f);
     widget.var("Normal Phi", mParams.nPhi, 0.0f, 10000.0f, 0.01f);
     widget.var("Position Phi", mParams.pPhi, 0.0f, 10000.0f, 0.01f);
+
+    if (widget.checkbox("Compact G-buffer", mParams.useCompactGBuffer)) mpATrousPass = nullptr;
+    if (mParams.useCompactGBuffer && !mpScene) widget.text("Compact G-buffer requires scene camera, full G-buffer is used.");
+
+    if (widget.checkbox("Variance guidance", mParams.useVarianceGuidance))
+    {
+        mpATrousPass = nullptr;
+        mClearHistory = true;
+    }
+    if (mParams.useVarianceGuidance)
+    {
+        widget.var("Luminance Phi", mParams.lPhi, 0.0f, 100.0f, 0.01f);
+        widget.var("Color alpha", mParams.colorAlpha, 0.0f, 1.0f, 0.001f);
+        widget.var("Moments alpha", mParams.momentsAlpha, 0.0f, 1.0f, 0.001f);
+        widget.var("Disocclusion normal threshold", mParams.disocclusionNormalThreshold, -1.0f, 1.0f, 0.01f);
+        widget.var("Disocclusion depth threshold", mParams.disocclusionDepthThreshold, 0.0f, 1.0f, 0.001f);
+        if (widget.button("Clear history")) mClearHistory = true;
+    }
 }
+
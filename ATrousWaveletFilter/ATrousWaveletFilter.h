@@ -50,16 +50,33 @@ public:
     virtual void compile(RenderContext* pContext, const CompileData& compileData) override;
     virtual void execute(RenderContext* pRenderContext, const RenderData& renderData) override;
     virtual void renderUI(Gui::Widgets& widget) override;
+    virtual void setScene(RenderContext* pRenderContext, const Scene::SharedPtr& pScene) override;
 
     // Scripting functions
     void setIterations(int iterations) { mParams.iterations = iterations; }
     void setCPhi(float cPhi) { mParams.cPhi = cPhi; }
     void setNPhi(float nPhi) { mParams.nPhi = nPhi; }
     void setPPhi(float pPhi) { mParams.pPhi = pPhi; }
+    void setCompactGBuffer(bool useCompactGBuffer) { mParams.useCompactGBuffer = useCompactGBuffer; mpATrousPass = nullptr; }
+    void setVarianceGuidance(bool useVarianceGuidance) { mParams.useVarianceGuidance = useVarianceGuidance; mpATrousPass = nullptr; mClearHistory = true; }
+    void setLPhi(float lPhi) { mParams.lPhi = lPhi; }
+    void setColorAlpha(float colorAlpha) { mParams.colorAlpha = colorAlpha; }
+    void setMomentsAlpha(float momentsAlpha) { mParams.momentsAlpha = momentsAlpha; }
+    void setMaxHistoryLength(uint maxHistoryLength) { mParams.maxHistoryLength = maxHistoryLength; }
+    void setDisocclusionNormalThreshold(float threshold) { mParams.disocclusionNormalThreshold = threshold; }
+    void setDisocclusionDepthThreshold(float threshold) { mParams.disocclusionDepthThreshold = threshold; }
     int getIterations() const { return mParams.iterations; }
     float getCPhi() const { return mParams.cPhi; }
     float getNPhi() const { return mParams.nPhi; }
     float getPPhi() const { return mParams.pPhi; }    
+    bool getCompactGBuffer() const { return mParams.useCompactGBuffer; }
+    bool getVarianceGuidance() const { return mParams.useVarianceGuidance; }
+    float getLPhi() const { return mParams.lPhi; }
+    float getColorAlpha() const { return mParams.colorAlpha; }
+    float getMomentsAlpha() const { return mParams.momentsAlpha; }
+    uint getMaxHistoryLength() const { return mParams.maxHistoryLength; }
+    float getDisocclusionNormalThreshold() const { return mParams.disocclusionNormalThreshold; }
+    float getDisocclusionDepthThreshold() const { return mParams.disocclusionDepthThreshold; }
 
 protected:
     static void registerBindings(pybind11::module& m);
@@ -68,6 +85,9 @@ protected:
 private:
     ATrousWaveletFilter(const Dictionary& dict);
 
+    void packGBuffer(RenderContext* pRenderContext, const RenderData& renderData);
+    void accumulate(RenderContext* pRenderContext, const RenderData& renderData);
+
     struct
     {
         bool useFiltering = true;
@@ -78,9 +98,26 @@ private:
         float cPhi = 10.0f;  ///< Color Phi.
         float nPhi = 128.0f; ///< Normal Phi.
         float pPhi = 10.0f;  ///< Position Phi.
+
+        bool useCompactGBuffer = false; ///< Filter reads normal and depth packed in 4 bytes (HimeGBufferCodec) instead of 32 bytes of normal and position, requires a scene camera.
+
+        bool useVarianceGuidance = false; ///< Accumulate color and luminance moments over frames, color weight is scaled by luminance variance.
+        float lPhi = 4.0f;                ///< Luminance Phi, in units of standard deviation.
+        float colorAlpha = 0.05f;         ///< Blend weight of current color.
+        float momentsAlpha = 0.2f;        ///< Blend weight of current luminance moments.
+        uint maxHistoryLength = 32;
+        float disocclusionNormalThreshold = 0.9f; ///< History is dropped below this cosine between current and previous normal.
+        float disocclusionDepthThreshold = 0.05f; ///< History is dropped if previous position is farther from the current surface plane, relative to distance to camera.
     } mParams;
 
     Fbo::SharedPtr mpPingPongFbo[2];
+    Fbo::SharedPtr mpPackedGBufferFbo;
+    Fbo::SharedPtr mpTemporalFbo[2]; ///< Filter input and history of current and previous frame, see TemporalAccumulation.ps.slang.
+    bool mClearHistory = true;
 
     FullScreenPass::SharedPtr mpATrousPass;
+    FullScreenPass::SharedPtr mpPackGBufferPass;
+    FullScreenPass::SharedPtr mpTemporalPass;
+
+    Scene::SharedPtr mpScene;
 };
@@ -0,0 +1,410 @@
+#include "CPUATrousFilter.h"
+#include <atomic>
+#include <chrono>
+#include "../HimeUtils/HimeParallel.h"
+#include "../HimeUtils/HimeSimd.h"
+
+namespace Falcor
+{
+    namespace
+    {
+        const uint kLaneCount = 8; ///< Lanes of SimdFloat<8> and SimdFloatAVX2.
+
+        const float kKernel[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+        const float kGaussian[2] = { 1.0f / 2.0f, 1.0f / 4.0f }; ///< Variance prefilter.
+
+        /** SoA planes of a tile. Color is double buffered, valid is 1 inside the frame and 0 outside.
+        */
+        enum TilePlane : uint
+        {
+            Color = 0,        // 2 x 4 planes.
+            Normal = 8,       // 4 planes.
+            Position = 12,    // 4 planes.
+            Valid = 16,
+            TilePlaneCount,
+        };
+
+        /** Same as computeEdgeStoppingWeight() in ATrous.ps.slang.
+        */
+        float computeEdgeStoppingWeight(const float4& pVal, const float4& qVal, float phi)
+        {
+            float4 t = pVal - qVal;
+            float dist2 = dot(t, t);
+            float w = std::exp(-(dist2) / phi);
+            return w;
+        }
+
+        float luminance(const float4& color) { return color.x * 0.2126f + color.y * 0.7152f + color.z * 0.0722f; }
+
+        template<typename SimdType>
+        SimdType computeLuminance(const SimdType color[4])
+        {
+            return color[0] * SimdType::set1(0.2126f) + color[1] * SimdType::set1(0.7152f) + color[2] * SimdType::set1(0.0722f);
+        }
+
+        /** Variance guidance replaces w of the last iteration's output with alpha of the color before temporal accumulation.
+        */
+        float getRestoredAlpha(const CPUATrousFilter::Frame& frame, size_t pixelIdx) { return frame.inputColor ? frame.inputColor[pixelIdx].w : 1.0f; }
+
+        /** Same as computeVarianceCenter() in ATrous.ps.slang, 3x3 Gaussian of variance (color.w), normalized inside the frame.
+        */
+        float computeVarianceCenter(const std::vector<float4>& colorAndVariance, int2 ipos, uint2 dim)
+        {
+            float sum = 0.0f;
+            float cumW = 0.0f;
+            for (int yy = -1; yy <= 1; yy++)
+            {
+                for (int xx = -1; xx <= 1; xx++)
+                {
+                    const int2 uv = ipos + int2(xx, yy);
+                    if (uv.x < 0 || uv.y < 0 || uv.x >= (int)dim.x || uv.y >= (int)dim.y) continue;
+                    float w = kGaussian[std::abs(xx)] * kGaussian[std::abs(yy)];
+                    sum += colorAndVariance[(size_t)uv.y * dim.x + uv.x].w * w;
+                    cumW += w;
+                }
+            }
+            return sum / cumW;
+        }
+
+        /** Planes of a tile loaded with halo, see TilePlane.
+        */
+        struct Tile
+        {
+            float* pScratch;
+            size_t planeSize;
+            uint stride;    ///< Floats per row, padded by a SIMD vector.
+            uint halo;
+            uint2 coreDim;  ///< Pixels of the tile inside the frame, without halo.
+
+            float* plane(uint idx) const { return pScratch + idx * planeSize; }
+        };
+
+        /** Fused iterations [first, last) of a tile, 8 pixels of a row at a time on SimdType (SimdFloat<8> or SimdFloatAVX2).
+            Returns the color buffer (0 or 1) holding the result, and adds filtered pixels including halo to filteredPixelCount.
+
+            With UseVarianceGuidance, color exponent is -|l(p) - l(q)| / (lPhi * sqrt(g(var(p)))) * log2(e), same as runReference().
+            Variance prefilter reads neighbors at distance 1, which are always inside the area computed by the previous iteration.
+        */
+        template<typename SimdType, bool UseVarianceGuidance>
+        uint filterTile(const Tile& tile, uint first, uint last, const CPUATrousFilter::Params& params, size_t& filteredPixelCount)
+        {
+            // Edge-stopping weights are merged into 2^(sum of exponents), exponent of each is -|p - q|^2 / phi * log2(e).
+            const SimdType colorScale = SimdType::set1(-1.44269504f / params.cPhi);
+            const SimdType luminanceScale = SimdType::set1(-1.44269504f);
+            const SimdType lPhi = SimdType::set1(params.lPhi);
+            const SimdType normalScale = SimdType::set1(-1.44269504f / params.nPhi);
+            const SimdType positionScale = SimdType::set1(-1.44269504f / params.pPhi);
+            const SimdType centerKernel = SimdType::set1(kKernel[0] * kKernel[0]);
+
+            // Each iteration filters the area still needed by following iterations of this group.
+            uint src = 0;
+            uint remaining = tile.halo;
+            for (uint i = first; i < last; i++)
+            {
+                const ptrdiff_t stepSize = (ptrdiff_t)1 << i;
+                remaining -= 2u << i;
+                const uint2 areaOrigin = uint2(tile.halo - remaining);
+                const uint2 areaDim = tile.coreDim + 2 * remaining;
+                filteredPixelCount += (size_t)areaDim.x * areaDim.y;
+
+                const float* srcColor[4] = { tile.plane(Color + src * 4), tile.plane(Color + src * 4 + 1), tile.plane(Color + src * 4 + 2), tile.plane(Color + src * 4 + 3) };
+                float* dstColor[4] = { tile.plane(Color + (1 - src) * 4), tile.plane(Color + (1 - src) * 4 + 1), tile.plane(Color + (1 - src) * 4 + 2), tile.plane(Color + (1 - src) * 4 + 3) };
+                const float* normal[4] = { tile.plane(Normal), tile.plane(Normal + 1), tile.plane(Normal + 2), tile.plane(Normal + 3) };
+                const float* position[4] = { tile.plane(Position), tile.plane(Position + 1), tile.plane(Position + 2), tile.plane(Position + 3) };
+                const float* valid = tile.plane(Valid);
+
+                for (uint y = areaOrigin.y; y < areaOrigin.y + areaDim.y; y++)
+                {
+                    for (uint x = areaOrigin.x; x < areaOrigin.x + areaDim.x; x += kLaneCount)
+                    {
+                        const ptrdiff_t center = (ptrdiff_t)y * tile.stride + x;
+                        SimdType cVal[4], nVal[4], pVal[4], sum[4];
+                        for (uint ch = 0; ch < 4; ch++)
+                        {
+                            cVal[ch] = SimdType::loadUnaligned(srcColor[ch] + center);
+                            nVal[ch] = SimdType::loadUnaligned(normal[ch] + center);
+                            pVal[ch] = SimdType::loadUnaligned(position[ch] + center);
+                            sum[ch] = cVal[ch] * centerKernel;
+                        }
+
+                        // Variance guidance: w of sum is variance filtered with squared weights, lScale includes -log2(e).
+                        SimdType lVal = SimdType::set1(0.f), lScale = SimdType::set1(0.f);
+                        if (UseVarianceGuidance)
+                        {
+                            lVal = computeLuminance(cVal);
+                            sum[3] = cVal[3] * centerKernel * centerKernel;
+
+                            // Center of the 3x3 Gaussian isn't masked either, it's always valid for pixels inside the frame.
+                            SimdType varianceSum = cVal[3] * SimdType::set1(kGaussian[0] * kGaussian[0]);
+                            SimdType gaussianSum = SimdType::set1(kGaussian[0] * kGaussian[0]);
+                            for (int yy = -1; yy <= 1; yy++)
+                            {
+                                for (int xx = -1; xx <= 1; xx++)
+                                {
+                                    if (xx == 0 && yy == 0) continue;
+                                    const ptrdiff_t offset = center + yy * (ptrdiff_t)tile.stride + xx;
+                                    SimdType w = SimdType::loadUnaligned(valid + offset) * SimdType::set1(kGaussian[std::abs(xx)] * kGaussian[std::abs(yy)]);
+                                    varianceSum = varianceSum + SimdType::loadUnaligned(srcColor[3] + offset) * w;
+                                    gaussianSum = gaussianSum + w;
+                                }
+                            }
+                            SimdType stdDev = sqrt(max(varianceSum / gaussianSum, SimdType::set1(0.f)));
+                            lScale = luminanceScale / (lPhi * stdDev + SimdType::set1(1e-10f));
+                        }
+
+                        // Weight of center is exactly 1. It's not masked by valid, so lanes outside the frame don't divide by 0.
+                        SimdType cumW = centerKernel;
+                        for (int yy = -2; yy <= 2; yy++)
+                        {
+                            for (int xx = -2; xx <= 2; xx++)
+                            {
+                                if (xx == 0 && yy == 0) continue;
+
+                                const ptrdiff_t offset = center + (yy * (ptrdiff_t)tile.stride + xx) * stepSize;
+                                SimdType cTmp[4];
+                                SimdType cDist2 = SimdType::set1(0.f), nDist2 = SimdType::set1(0.f), pDist2 = SimdType::set1(0.f);
+                                for (uint ch = 0; ch < 4; ch++)
+                                {
+                                    cTmp[ch] = SimdType::loadUnaligned(srcColor[ch] + offset);
+                                    SimdType c = cVal[ch] - cTmp[ch];
+                                    SimdType n = nVal[ch] - SimdType::loadUnaligned(normal[ch] + offset);
+                                    SimdType p = pVal[ch] - SimdType::loadUnaligned(position[ch] + offset);
+                                    cDist2 = cDist2 + c * c;
+                                    nDist2 = nDist2 + n * n;
+                                    pDist2 = pDist2 + p * p;
+                                }
+
+                                SimdType kernelVal = SimdType::loadUnaligned(valid + offset) * SimdType::set1(kKernel[std::abs(xx)] * kKernel[std::abs(yy)]);
+                                SimdType exponent = nDist2 * normalScale + pDist2 * positionScale;
+                                exponent = exponent + (UseVarianceGuidance ? abs(lVal - computeLuminance(cTmp)) * lScale : cDist2 * colorScale);
+                                SimdType weight = fastExp2(exponent) * kernelVal;
+                                for (uint ch = 0; ch < 3; ch++) sum[ch] = sum[ch] + cTmp[ch] * weight;
+                                sum[3] = sum[3] + cTmp[3] * (UseVarianceGuidance ? weight * weight : weight);
+                                cumW = cumW + weight;
+                            }
+                        }
+
+                        for (uint ch = 0; ch < 3; ch++) (sum[ch] / cumW).storeUnaligned(dstColor[ch] + center);
+                        (UseVarianceGuidance ? sum[3] / (cumW * cumW) : sum[3] / cumW).storeUnaligned(dstColor[3] + center);
+                    }
+                }
+                src = 1 - src;
+            }
+            return src;
+        }
+
+        template<bool UseVarianceGuidance>
+        uint filterTileSSE(const Tile& tile, uint first, uint last, const CPUATrousFilter::Params& params, size_t& filteredPixelCount)
+        {
+            return filterTile<SimdFloat<8>, UseVarianceGuidance>(tile, first, last, params, filteredPixelCount);
+        }
+
+#if HIME_CPU_X64
+        /** Only called if HimeCpuHelpers::hasAVX2() is true.
+        */
+        template<bool UseVarianceGuidance>
+        HIME_TARGET_AVX2_KERNEL uint filterTileAVX2(const Tile& tile, uint first, uint last, const CPUATrousFilter::Params& params, size_t& filteredPixelCount)
+        {
+            return filterTile<SimdFloatAVX2, UseVarianceGuidance>(tile, first, last, params, filteredPixelCount);
+        }
+#endif
+    }
+
+    void CPUATrousFilter::runReference(const Frame& frame, const Params& params, std::vector<float4>& output)
+    {
+        const uint2 dim = frame.dim;
+        const size_t pixelCount = (size_t)dim.x * dim.y;
+        output.assign(frame.color, frame.color + pixelCount);
+
+        std::vector<float4> filtered(pixelCount);
+        for (uint i = 0; i < params.iterations; i++)
+        {
+            const int stepSize = 1 << i;
+            HimeParallelHelpers::parallelFor(0, dim.y, [&](size_t begin, size_t end, unsigned int)
+            {
+                for (size_t y = begin; y < end; y++)
+                {
+                    for (uint x = 0; x < dim.x; x++)
+                    {
+                        const int2 ipos = int2((int)x, (int)y);
+                        const size_t pixelIdx = y * dim.x + x;
+
+                        float4 sum = float4(0.0f);
+                        float4 cVal = output[pixelIdx];
+                        float4 nVal = frame.normal[pixelIdx];
+                        float4 pVal = frame.position[pixelIdx];
+                        float cumW = 0.0f;
+
+                        // Variance guidance: luminance distance in units of filtered standard deviation, variance is filtered with squared weights.
+                        float lVal = luminance(cVal);
+                        float lScale = 0.0f;
+                        float sumVariance = 0.0f;
+                        if (params.useVarianceGuidance)
+                        {
+                            lScale = 1.0f / (params.lPhi * std::sqrt(std::max(computeVarianceCenter(output, ipos, dim), 0.0f)) + 1e-10f);
+                        }
+
+                        for (int yy = -2; yy <= 2; yy++)
+                        {
+                            for (int xx = -2; xx <= 2; xx++)
+                            {
+                                const int2 uv = ipos + int2(xx, yy) * stepSize;
+                                const bool inside = uv.x >= 0 && uv.y >= 0 && uv.x < (int)dim.x && uv.y < (int)dim.y;
+
+                                if (inside)
+                                {
+                                    const size_t q = (size_t)uv.y * dim.x + uv.x;
+                                    float4 cTmp = output[q];
+                                    float cW = params.useVarianceGuidance ? std::exp(-std::abs(lVal - luminance(cTmp)) * lScale) : computeEdgeStoppingWeight(cVal, cTmp, params.cPhi);
+                                    float nW = computeEdgeStoppingWeight(nVal, frame.normal[q], params.nPhi);
+                                    float pW = computeEdgeStoppingWeight(pVal, frame.position[q], params.pPhi);
+
+                                    float kernelVal = kKernel[std::abs(xx)] * kKernel[std::abs(yy)];
+
+                                    float weight = cW * nW * pW;
+                                    sum += cTmp * weight * kernelVal;
+                                    cumW += weight * kernelVal;
+                                    sumVariance += cTmp.w * (weight * kernelVal) * (weight * kernelVal);
+                                }
+                            }
+                        }
+
+                        filtered[pixelIdx] = sum / cumW;
+                        if (params.useVarianceGuidance) filtered[pixelIdx].w = sumVariance / (cumW * cumW);
+                    }
+                }
+            }, 1);
+            output.swap(filtered);
+        }
+
+        if (params.useVarianceGuidance && params.iterations > 0)
+        {
+            for (size_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++) output[pixelIdx].w = getRestoredAlpha(frame, pixelIdx);
+        }
+    }
+
+    void CPUATrousFilter::run(const Frame& frame, const Params& params, std::vector<float4>& output)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        mStats = {};
+
+        const uint2 dim = frame.dim;
+        const size_t pixelCount = (size_t)dim.x * dim.y;
+        output.resize(pixelCount);
+        if (pixelCount == 0) return;
+        if (params.iterations == 0)
+        {
+            std::copy(frame.color, frame.color + pixelCount, output.begin());
+            return;
+        }
+
+        const uint tileSize = std::max(params.tileSize, 1u);
+        const uint fusedIterationCount = std::max(params.fusedIterationCount, 1u);
+        const uint2 tileDim = uint2((dim.x + tileSize - 1) / tileSize, (dim.y + tileSize - 1) / tileSize);
+        const size_t tileCount = (size_t)tileDim.x * tileDim.y;
+        mScratch.resize(std::max<size_t>(mScratch.size(), HimeParallelHelpers::getChunkCount(tileCount, 1)));
+
+        auto filterTileIterations = params.useVarianceGuidance ? filterTileSSE<true> : filterTileSSE<false>;
+#if HIME_CPU_X64
+        if (params.useAVX2 && HimeCpuHelpers::hasAVX2()) filterTileIterations = params.useVarianceGuidance ? filterTileAVX2<true> : filterTileAVX2<false>;
+#endif
+
+        std::atomic<size_t> filteredPixelCount{ 0 };
+        const float4* pInput = frame.color;
+        for (uint first = 0, group = 0; first < params.iterations; first += fusedIterationCount, group++)
+        {
+            const uint last = std::min(first + fusedIterationCount, params.iterations);
+            const bool restoreAlpha = params.useVarianceGuidance && last == params.iterations;
+            float4* pOutput = output.data();
+            if (last < params.iterations)
+            {
+                mIntermediate[group & 1].resize(pixelCount);
+                pOutput = mIntermediate[group & 1].data();
+            }
+
+            // Filter radius of iteration i is 2 * 2^i, halo covers all fused iterations. Rows are padded by a SIMD vector,
+            // so the last vector of a row can be computed and stored without bound checks.
+            uint halo = 0;
+            for (uint i = first; i < last; i++) halo += 2u << i;
+            const uint bufferWidth = tileSize + 2 * halo;
+            const uint stride = (bufferWidth + 2 * kLaneCount - 1) / kLaneCount * kLaneCount;
+            const size_t planeSize = (size_t)stride * bufferWidth;
+
+            HimeParallelHelpers::parallelFor(0, tileCount, [&](size_t begin, size_t end, unsigned int chunkIdx)
+            {
+                std::vector<float>& scratch = mScratch[chunkIdx];
+                if (scratch.size() < planeSize * TilePlaneCount) scratch.resize(planeSize * TilePlaneCount);
+                size_t chunkFilteredPixelCount = 0;
+
+                for (size_t tileIdx = begin; tileIdx < end; tileIdx++)
+                {
+                    const uint2 tileOrigin = uint2((uint)(tileIdx % tileDim.x) * tileSize, (uint)(tileIdx / tileDim.x) * tileSize);
+                    const uint2 coreDim = min(tileOrigin + tileSize, dim) - tileOrigin;
+                    const uint2 loadDim = coreDim + 2 * halo;
+                    const Tile tile = { scratch.data(), planeSize, stride, halo, coreDim };
+
+                    // Load tile and halo, pixels outside the frame are 0. Both color buffers are filled, so lanes outside
+                    // computed area read finite values.
+                    const int2 loadOrigin = int2(tileOrigin) - int2(halo);
+                    for (uint r = 0; r < loadDim.y; r++)
+                    {
+                        const int y = loadOrigin.y + (int)r;
+                        const bool rowInside = y >= 0 && y < (int)dim.y;
+                        const uint xBegin = rowInside ? (uint)std::min(std::max(-loadOrigin.x, 0), (int)loadDim.x) : 0;
+                        const uint xEnd = rowInside ? std::max((uint)std::min((int)dim.x - loadOrigin.x, (int)loadDim.x), xBegin) : 0;
+                        const size_t rowOffset = (size_t)r * stride;
+
+                        for (uint idx = 0; idx < TilePlaneCount; idx++)
+                        {
+                            float* pRow = tile.plane(idx) + rowOffset;
+                            std::fill(pRow, pRow + xBegin, 0.f);
+                            std::fill(pRow + xEnd, pRow + stride, 0.f);
+                        }
+                        if (xBegin == xEnd) continue;
+
+                        const size_t pixelOffset = (size_t)y * dim.x + loadOrigin.x;
+                        float* pColor[4] = { tile.plane(Color) + rowOffset, tile.plane(Color + 1) + rowOffset, tile.plane(Color + 2) + rowOffset, tile.plane(Color + 3) + rowOffset };
+                        float* pNormal[4] = { tile.plane(Normal) + rowOffset, tile.plane(Normal + 1) + rowOffset, tile.plane(Normal + 2) + rowOffset, tile.plane(Normal + 3) + rowOffset };
+                        float* pPosition[4] = { tile.plane(Position) + rowOffset, tile.plane(Position + 1) + rowOffset, tile.plane(Position + 2) + rowOffset, tile.plane(Position + 3) + rowOffset };
+                        for (uint c = xBegin; c < xEnd; c++)
+                        {
+                            const float* color = &pInput[pixelOffset + c].x;
+                            const float* normal = &frame.normal[pixelOffset + c].x;
+                            const float* position = &frame.position[pixelOffset + c].x;
+                            for (uint ch = 0; ch < 4; ch++)
+                            {
+                                pColor[ch][c] = color[ch];
+                                pNormal[ch][c] = normal[ch];
+                                pPosition[ch][c] = position[ch];
+                            }
+                        }
+                        std::fill(tile.plane(Valid) + rowOffset + xBegin, tile.plane(Valid) + rowOffset + xEnd, 1.f);
+                        for (uint ch = 0; ch < 4; ch++) std::copy(pColor[ch] + xBegin, pColor[ch] + xEnd, tile.plane(Color + 4 + ch) + rowOffset + xBegin);
+                    }
+
+                    const uint src = filterTileIterations(tile, first, last, params, chunkFilteredPixelCount);
+
+                    // Store tile without halo.
+                    for (uint r = 0; r < coreDim.y; r++)
+                    {
+                        const size_t rowOffset = (size_t)(halo + r) * stride + halo;
+                        const float* pColor[4] = { tile.plane(Color + src * 4) + rowOffset, tile.plane(Color + src * 4 + 1) + rowOffset, tile.plane(Color + src * 4 + 2) + rowOffset, tile.plane(Color + src * 4 + 3) + rowOffset };
+                        const size_t pixelOffset = (size_t)(tileOrigin.y + r) * dim.x + tileOrigin.x;
+                        float* pRow = &pOutput[pixelOffset].x;
+                        for (uint c = 0; c < coreDim.x; c++)
+                        {
+                            for (uint ch = 0; ch < 4; ch++) pRow[c * 4 + ch] = pColor[ch][c];
+                            if (restoreAlpha) pRow[c * 4 + 3] = getRestoredAlpha(frame, pixelOffset + c);
+                        }
+                    }
+                }
+                filteredPixelCount += chunkFilteredPixelCount;
+            }, 1);
+
+            pInput = pOutput;
+        }
+
+        mStats.filteredPixelRatio = (double)filteredPixelCount / ((double)pixelCount * params.iterations);
+        mStats.time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "Falcor.h"
+
+namespace Falcor
+{
+    /** Host version of ATrousWaveletFilter, for render nodes without GPU.
+
+        Same filter as ATrous.ps.slang: 5x5 B3 kernel dilated by gStepSize = 2^i in iteration i, and edge-stopping weights
+        exp(-|p - q|^2 / phi) of color, normal and position (all 4 channels). Neighbors outside the frame are skipped.
+
+        The frame is split into tiles of tileSize x tileSize pixels, processed on all cores. fusedIterationCount iterations
+        run on a tile before the next tile is loaded: the tile is loaded with a halo of the sum of their filter radii, and
+        each iteration shrinks the computed area by its radius, so tiles stay in cache instead of ping-ponging whole frames.
+        Pixels of a tile row are filtered 8 at a time on SIMD lanes (AVX2 if the CPU supports it, checked at runtime,
+        otherwise SSE), and the three edge-stopping weights are merged into one fastExp2() of the sum of their exponents,
+        with or without variance guidance.
+
+        runReference() is a scalar version of the shader with std::exp, used to validate run().
+    */
+    class CPUATrousFilter
+    {
+    public:
+        using SharedPtr = std::shared_ptr<CPUATrousFilter>;
+
+        struct Params
+        {
+            uint iterations = 4;
+            float cPhi = 10.0f;  ///< Color Phi.
+            float nPhi = 128.0f; ///< Normal Phi.
+            float pPhi = 10.0f;  ///< Position Phi.
+
+            bool useVarianceGuidance = false; ///< color.w is luminance variance from CPUTemporalAccumulation, cPhi is replaced by lPhi.
+            float lPhi = 4.0f;                ///< Luminance Phi, in units of standard deviation.
+
+            uint tileSize = 128;            ///< Pixels of a tile, without halo.
+            uint fusedIterationCount = 2;   ///< Iterations run on a tile at a time, halo grows with 2^fusedIterationCount.
+            bool useAVX2 = true;            ///< Filter tiles with AVX2 if the CPU supports it, otherwise with SSE.
+        };
+
+        /** Inputs, width * height each, same as color, normal and position channels.
+        */
+        struct Frame
+        {
+            uint2 dim = uint2(0);
+            const float4* color = nullptr;
+            const float4* normal = nullptr;
+            const float4* position = nullptr;
+            const float4* inputColor = nullptr; ///< Color before CPUTemporalAccumulation. With variance guidance, alpha of the output is restored from it, 1 if null.
+        };
+
+        /** Last run().
+        */
+        struct Stats
+        {
+            double time = 0.0;               ///< ms
+            double filteredPixelRatio = 0.0; ///< Filtered pixels including halos, over width * height * iterations.
+        };
+
+        static SharedPtr create() { return SharedPtr(new CPUATrousFilter()); }
+
+        /** Filter a frame.
+            \param[in] frame Inputs.
+            \param[in] params Filter parameters.
+            \param[out] output Filtered color, width * height.
+        */
+        void run(const Frame& frame, const Params& params, std::vector<float4>& output);
+
+        /** Same as ATrousWaveletFilter::execute(), one full frame pass per iteration, rows are processed on all cores.
+            Tile parameters are ignored.
+
+            With variance guidance, color weight is exp(-|l(p) - l(q)| / (lPhi * sqrt(g(var(p))))) of luminance l, with variance
+            var prefiltered by 3x3 Gaussian g. Variance in color.w is filtered with squared weights, same as SVGF, and the last
+            iteration replaces it by alpha of frame.inputColor.
+        */
+        static void runReference(const Frame& frame, const Params& params, std::vector<float4>& output);
+
+        const Stats& getStats() const { return mStats; }
+
+    private:
+        CPUATrousFilter() = default;
+
+        std::vector<float4> mIntermediate[2]; ///< Output of fused iterations, except the last ones.
+        std::vector<std::vector<float>> mScratch; ///< Tile planes of each worker.
+        Stats mStats;
+    };
+}
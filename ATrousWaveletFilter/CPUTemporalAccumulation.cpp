@@ -0,0 +1,127 @@
+#include "CPUTemporalAccumulation.h"
+#include <atomic>
+#include <chrono>
+#include "../HimeUtils/HimeParallel.h"
+
+namespace Falcor
+{
+    namespace
+    {
+        /** Same as computeEdgeStoppingWeight() in ATrous.ps.slang.
+        */
+        float computeEdgeStoppingWeight(const float4& pVal, const float4& qVal, float phi)
+        {
+            float4 t = pVal - qVal;
+            float dist2 = dot(t, t);
+            return std::exp(-(dist2) / phi);
+        }
+
+        float luminance(const float4& color) { return color.x * 0.2126f + color.y * 0.7152f + color.z * 0.0722f; }
+
+        /** Same as isSameSurface() in TemporalAccumulation.ps.slang.
+        */
+        bool isSameSurface(const float3& normal, const float3& posW, const float3& prevNormal, const float3& prevPosW, const CPUTemporalAccumulation::Params& params)
+        {
+            float planeDistance = std::abs(dot(prevPosW - posW, normal));
+            return dot(normal, prevNormal) >= params.disocclusionNormalThreshold
+                && planeDistance <= params.disocclusionDepthThreshold * length(posW - params.cameraPosW);
+        }
+    }
+
+    void CPUTemporalAccumulation::run(const CPUATrousFilter::Frame& frame, const float2* motionVectors, const Params& params, std::vector<float4>& colorAndVariance)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        const uint2 dim = frame.dim;
+        const size_t pixelCount = (size_t)dim.x * dim.y;
+        const bool hasHistory = mHistoryDim == dim;
+        for (History& history : mHistory)
+        {
+            history.color.resize(pixelCount);
+            history.moments.resize(pixelCount);
+            history.normal.resize(pixelCount);
+            history.position.resize(pixelCount);
+        }
+        colorAndVariance.resize(pixelCount);
+
+        const History& prev = mHistory[0];
+        History& curr = mHistory[1];
+        std::atomic<size_t> reprojectedCount{ 0 };
+        HimeParallelHelpers::parallelFor(0, dim.y, [&](size_t begin, size_t end, unsigned int)
+        {
+            size_t chunkReprojectedCount = 0;
+            for (size_t y = begin; y < end; y++)
+            {
+                for (uint x = 0; x < dim.x; x++)
+                {
+                    const size_t pixelIdx = y * dim.x + x;
+                    const float4 color = frame.color[pixelIdx];
+                    const float4 normal = frame.normal[pixelIdx];
+                    const float4 position = frame.position[pixelIdx];
+                    const float l = luminance(color);
+
+                    // Reproject, history is kept if it's the same surface (disocclusion test).
+                    const float2 motionVector = motionVectors ? motionVectors[pixelIdx] : float2(0.0f);
+                    const int2 prevPos = int2(glm::floor(float2((float)x, (float)y) + motionVector * float2(dim) + float2(0.5f)));
+                    bool isValid = hasHistory && prevPos.x >= 0 && prevPos.y >= 0 && prevPos.x < (int)dim.x && prevPos.y < (int)dim.y;
+                    size_t prevIdx = 0;
+                    if (isValid)
+                    {
+                        prevIdx = (size_t)prevPos.y * dim.x + prevPos.x;
+                        isValid = prev.color[prevIdx].w > 0.0f
+                            && isSameSurface(float3(normal), float3(position), float3(prev.normal[prevIdx]), float3(prev.position[prevIdx]), params);
+                    }
+
+                    float historyLength = 1.0f;
+                    float3 accumulated = float3(color);
+                    float2 moments = float2(l, l * l);
+                    if (isValid)
+                    {
+                        historyLength = std::min(prev.color[prevIdx].w + 1.0f, (float)params.maxHistoryLength);
+                        const float colorAlpha = std::max(params.colorAlpha, 1.0f / historyLength);
+                        const float momentsAlpha = std::max(params.momentsAlpha, 1.0f / historyLength);
+                        accumulated = float3(prev.color[prevIdx]) + (accumulated - float3(prev.color[prevIdx])) * colorAlpha;
+                        moments = prev.moments[prevIdx] + (moments - prev.moments[prevIdx]) * momentsAlpha;
+                        chunkReprojectedCount++;
+                    }
+
+                    float variance = std::max(moments.y - moments.x * moments.x, 0.0f);
+                    if (historyLength < 4.0f)
+                    {
+                        // Short history, spatial moments of 3x3 neighbors on the same surface.
+                        float2 spatialMoments = float2(0.0f);
+                        float cumW = 0.0f;
+                        for (int yy = -1; yy <= 1; yy++)
+                        {
+                            for (int xx = -1; xx <= 1; xx++)
+                            {
+                                const int2 uv = int2((int)x + xx, (int)y + yy);
+                                if (uv.x < 0 || uv.y < 0 || uv.x >= (int)dim.x || uv.y >= (int)dim.y) continue;
+                                const size_t q = (size_t)uv.y * dim.x + uv.x;
+                                float w = computeEdgeStoppingWeight(normal, frame.normal[q], params.nPhi) * computeEdgeStoppingWeight(position, frame.position[q], params.pPhi);
+                                float lq = luminance(frame.color[q]);
+                                spatialMoments += float2(lq, lq * lq) * w;
+                                cumW += w;
+                            }
+                        }
+                        spatialMoments /= cumW;
+                        variance = std::max(spatialMoments.y - spatialMoments.x * spatialMoments.x, 0.0f) * (4.0f / historyLength);
+                    }
+
+                    colorAndVariance[pixelIdx] = float4(accumulated, variance);
+                    curr.color[pixelIdx] = float4(accumulated, historyLength);
+                    curr.moments[pixelIdx] = moments;
+                    curr.normal[pixelIdx] = normal;
+                    curr.position[pixelIdx] = position;
+                }
+            }
+            reprojectedCount += chunkReprojectedCount;
+        }, 1);
+
+        std::swap(mHistory[0], mHistory[1]);
+        mHistoryDim = dim;
+
+        mStats.reprojectedRatio = pixelCount > 0 ? (double)reprojectedCount / pixelCount : 0.0;
+        mStats.time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "Falcor.h"
+#include "CPUATrousFilter.h"
+
+namespace Falcor
+{
+    /** Host version of TemporalAccumulation.ps.slang, variance guidance stage of ATrousWaveletFilter.
+
+        Each pixel is reprojected to previous frame with its motion vector. History is kept if it's the same surface: the cosine
+        between current and previous normal is at least disocclusionNormalThreshold, and the previous position is closer to the
+        plane of the current surface than disocclusionDepthThreshold times the distance to camera. Color and luminance moments (l, l^2) are blended
+        with history by exponential moving averages, alpha is at least 1 / history length so new history starts as a plain
+        average. Variance is l^2 - l * l of the moments. Below 4 frames of history, it is estimated from 3x3 spatial moments
+        weighted by normal and position, and scaled by 4 / history length.
+
+        Output is accumulated color with variance in w, input of CPUATrousFilter with useVarianceGuidance.
+    */
+    class CPUTemporalAccumulation
+    {
+    public:
+        using SharedPtr = std::shared_ptr<CPUTemporalAccumulation>;
+
+        struct Params
+        {
+            float colorAlpha = 0.05f;   ///< Blend weight of current color.
+            float momentsAlpha = 0.2f;  ///< Blend weight of current moments.
+            uint maxHistoryLength = 32;
+            float nPhi = 128.0f;        ///< Same as filter, weights of spatial moments.
+            float pPhi = 10.0f;
+            float disocclusionNormalThreshold = 0.9f;  ///< Min cosine between current and previous normal.
+            float disocclusionDepthThreshold = 0.05f;  ///< Max distance of previous position to current surface plane, relative to distance to camera.
+            float3 cameraPosW = float3(0.0f);          ///< Camera of the current frame.
+        };
+
+        /** Last run().
+        */
+        struct Stats
+        {
+            double time = 0.0;            ///< ms
+            double reprojectedRatio = 0.0; ///< Pixels that kept their history.
+        };
+
+        static SharedPtr create() { return SharedPtr(new CPUTemporalAccumulation()); }
+
+        /** Accumulate a frame.
+            \param[in] frame Current color, normal and position.
+            \param[in] motionVectors Screen space, previous uv minus current uv, same as Falcor's motion vectors. Static if null.
+            \param[in] params Accumulation parameters.
+            \param[out] colorAndVariance Accumulated color and luminance variance (w), width * height.
+        */
+        void run(const CPUATrousFilter::Frame& frame, const float2* motionVectors, const Params& params, std::vector<float4>& colorAndVariance);
+
+        /** Drop history, next frame starts from scratch.
+        */
+        void reset() { mHistoryDim = uint2(0); }
+
+        const Stats& getStats() const { return mStats; }
+
+    private:
+        CPUTemporalAccumulation() = default;
+
+        /** Same as render targets of TemporalAccumulation.ps.slang.
+        */
+        struct History
+        {
+            std::vector<float4> color;   ///< Accumulated color, history length in w.
+            std::vector<float2> moments; ///< Luminance moments.
+            std::vector<float4> normal;
+            std::vector<float4> position;
+        };
+
+        History mHistory[2]; ///< Previous and current frame.
+        uint2 mHistoryDim = uint2(0);
+        Stats mStats;
+    };
+}
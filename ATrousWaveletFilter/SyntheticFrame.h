@@ -0,0 +1,64 @@
+#pragma once
+#include <random>
+#include "CPUATrousFilter.h"
+
+namespace Falcor
+{
+    /** Synthetic inputs for CPU filter: a floor and walls at different depths and orientations, noisy shading and a few fireflies.
+        Surfaces move left by shift pixels, reference is the noise-free color.
+    */
+    struct SyntheticFrame
+    {
+        const float3 cameraPosW = float3(5.f, 3.f, -10.f); ///< In front of floor and walls, for distances relative to camera.
+
+        std::vector<float4> color;
+        std::vector<float4> normal;
+        std::vector<float4> position;
+        std::vector<float4> reference;
+        CPUATrousFilter::Frame frame;
+
+        SyntheticFrame(uint2 dim, uint seed, uint shift = 0)
+        {
+            const size_t pixelCount = (size_t)dim.x * dim.y;
+            color.resize(pixelCount);
+            normal.resize(pixelCount);
+            position.resize(pixelCount);
+            reference.resize(pixelCount);
+
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> noise(-0.3f, 0.3f);
+            for (size_t i = 0; i < pixelCount; i++)
+            {
+                float u = ((float)(i % dim.x + shift) + 0.5f) / dim.x;
+                float v = ((float)(i / dim.x) + 0.5f) / dim.y;
+                float3 n, p, albedo;
+                if (v > 0.6f)
+                {
+                    n = float3(0.f, 1.f, 0.f);
+                    p = float3(u * 10.f, 0.f, (v - 0.6f) * 20.f);
+                    albedo = float3(0.6f);
+                }
+                else
+                {
+                    uint segment = (uint)(u * 8.f);
+                    n = normalize(float3(segment % 2 == 0 ? -0.3f : 0.3f, 0.f, 1.f));
+                    p = float3(u * 10.f, (0.6f - v) * 10.f, 5.f + (float)(segment % 3));
+                    albedo = float3(0.2f + 0.1f * (segment % 5), 0.5f, 0.8f - 0.1f * (segment % 4));
+                }
+                float shading = 0.3f + 0.7f * std::max(dot(n, normalize(float3(0.3f, 1.f, 0.5f))), 0.f);
+                float3 c = albedo * (shading * (1.f + noise(rng)));
+                if (rng() % 500 == 0) c *= 20.f;
+
+                color[i] = float4(c, 1.f);
+                reference[i] = float4(albedo * shading, 1.f);
+                normal[i] = float4(n, 0.f);
+                position[i] = float4(p, 1.f);
+            }
+
+            frame.dim = dim;
+            frame.color = color.data();
+            frame.normal = normal.data();
+            frame.position = position.data();
+        }
+    };
+}
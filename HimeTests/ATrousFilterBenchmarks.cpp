@@ -0,0 +1,43 @@
+#include "HimeTest.h"
+#include "ATrousWaveletFilter/CPUATrousFilter.h"
+#include "ATrousWaveletFilter/SyntheticFrame.h"
+#include "HimeUtils/HimeParallel.h"
+
+using namespace Falcor;
+
+HIME_BENCHMARK(ATrousTiledFilter)
+{
+    // Tiled filter against the scalar reference, default parameters of the pass without variance guidance (synthetic color carries no variance).
+    const std::vector<uint2> dims = HimeTest::isQuickRun() ? std::vector<uint2>{ uint2(320, 180) } : std::vector<uint2>{ uint2(1920, 1080), uint2(3840, 2160) };
+    CPUATrousFilter::SharedPtr pFilter = CPUATrousFilter::create();
+    for (uint2 dim : dims)
+    {
+        SyntheticFrame syntheticFrame(dim, 0);
+        CPUATrousFilter::Params params;
+        std::vector<float4> output;
+
+        HimeTest::Timer referenceTimer;
+        CPUATrousFilter::runReference(syntheticFrame.frame, params, output);
+        const double referenceTime = referenceTimer.elapsed() * 1e3;
+        std::printf("    %ux%u, %u iterations: scalar reference %.1f ms\n", dim.x, dim.y, params.iterations, referenceTime);
+
+        for (uint fusedIterationCount : { 1u, 2u, params.iterations })
+        {
+            for (uint tileSize : { 32u, 64u, 128u })
+            {
+                params.fusedIterationCount = fusedIterationCount;
+                params.tileSize = tileSize;
+
+                // First run allocates scratch and intermediate frames.
+                double time = 0.0;
+                for (uint run = 0; run < 2; run++)
+                {
+                    pFilter->run(syntheticFrame.frame, params, output);
+                    time = pFilter->getStats().time;
+                }
+                std::printf("    %u fused, tile size %3u: %.1f ms (%.1fx), %.2f filtered pixels per output pixel and iteration (%u threads)\n", fusedIterationCount, tileSize,
+                    time, referenceTime / time, pFilter->getStats().filteredPixelRatio, HimeParallelHelpers::getWorkerCount());
+            }
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#include "HimeTest.h"
+#include "ATrousWaveletFilter/CPUATrousFilter.h"
+#include "ATrousWaveletFilter/SyntheticFrame.h"
+#include "HimeUtils/HimeSimd.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Falcor;
+
+namespace
+{
+    /** fastExp2() of 8 values.
+    */
+    template<typename Simd>
+    void computeFastExp2(const float* x, float* y)
+    {
+        const uint laneCount = sizeof(Simd) / sizeof(float);
+        for (uint i = 0; i < 8; i += laneCount) fastExp2(Simd::load(x + i)).store(y + i);
+    }
+
+#if HIME_CPU_X64
+    HIME_TARGET_AVX2_KERNEL void computeFastExp2AVX2(const float* x, float* y)
+    {
+        computeFastExp2<SimdFloatAVX2>(x, y);
+    }
+#endif
+
+    /** Max relative error of fastExp2() against exp2 over [-125, 0], and values at 0 and below -125.
+    */
+    void checkFastExp2(void (*computeFunc)(const float*, float*), const char* name)
+    {
+        const uint kSampleCount = 1 << 20;
+        alignas(32) float x[8], y[8];
+        double maxError = 0.0;
+        for (uint i = 0; i < kSampleCount; i += 8)
+        {
+            for (uint lane = 0; lane < 8; lane++) x[lane] = -125.f * (float)(i + lane) / (kSampleCount - 1);
+            computeFunc(x, y);
+            for (uint lane = 0; lane < 8; lane++) maxError = std::max(maxError, std::abs(y[lane] / std::exp2((double)x[lane]) - 1.0));
+        }
+        HIME_EXPECT_MSG(maxError < 2.5e-7, std::string(name) + ": max relative error " + std::to_string(maxError * 1e6) + " ppm");
+
+        // Exactly 1 at 0 and above, flushed to 0 below -125.
+        alignas(32) const float edges[8] = { 0.f, 1.f, -125.f, -125.001f, -126.f, -150.f, -1e30f, -INFINITY };
+        computeFunc(edges, y);
+        HIME_EXPECT(y[0] == 1.f && y[1] == 1.f);
+        HIME_EXPECT(y[2] > 0.f && std::abs(y[2] / std::exp2(-125.0) - 1.0) < 2.5e-7);
+        for (uint lane = 3; lane < 8; lane++) HIME_EXPECT_MSG(y[lane] == 0.f, std::string(name) + ": 2^" + std::to_string(edges[lane]));
+    }
+
+    float computeMaxError(const std::vector<float4>& a, const std::vector<float4>& b)
+    {
+        float maxError = 0.f;
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            float4 d = a[i] - b[i];
+            float error = std::max({ std::abs(d.x), std::abs(d.y), std::abs(d.z), std::abs(d.w) });
+            maxError = std::isfinite(error) ? std::max(maxError, error) : INFINITY;
+        }
+        return maxError;
+    }
+}
+
+HIME_TEST(FastExp2MatchesExp2)
+{
+    checkFastExp2(computeFastExp2<SimdFloat<4>>, "SimdFloat<4>");
+    checkFastExp2(computeFastExp2<SimdFloat<8>>, "SimdFloat<8>");
+#if HIME_CPU_X64
+    if (HimeCpuHelpers::hasAVX2()) checkFastExp2(computeFastExp2AVX2, "SimdFloatAVX2");
+#endif
+}
+
+HIME_TEST(CPUATrousFilterMatchesReference)
+{
+    // Frame sizes are not multiples of tile size or SIMD width.
+    auto pFilter = CPUATrousFilter::create();
+    for (uint2 dim : { uint2(333, 197), uint2(640, 360) })
+    {
+        SyntheticFrame syntheticFrame(dim, dim.x);
+        CPUATrousFilter::Params params;
+        std::vector<float4> reference, filtered;
+        CPUATrousFilter::runReference(syntheticFrame.frame, params, reference);
+
+        float maxValue = 0.f;
+        for (const float4& color : reference) maxValue = std::max({ maxValue, std::abs(color.x), std::abs(color.y), std::abs(color.z), std::abs(color.w) });
+
+        for (uint fusedIterationCount : { 1u, 2u, params.iterations })
+        {
+            for (uint tileSize : { 16u, 64u })
+            {
+                params.fusedIterationCount = fusedIterationCount;
+                params.tileSize = tileSize;
+                pFilter->run(syntheticFrame.frame, params, filtered);
+
+                // fastExp2() and merged exponents change weights by about 1e-6 relative, 1e-4 leaves room for 10 iterations.
+                float relativeError = computeMaxError(filtered, reference) / std::max(maxValue, 1e-30f);
+                HIME_EXPECT_MSG(relativeError < 1e-4f, std::to_string(dim.x) + "x" + std::to_string(dim.y) + ", " + std::to_string(fusedIterationCount)
+                    + " fused, tile size " + std::to_string(tileSize) + ": max error " + std::to_string(relativeError * 1e6f) + " ppm");
+            }
+        }
+    }
+}
+
+HIME_TEST(CPUATrousFilterAVX2MatchesSSE)
+{
+#if HIME_CPU_X64
+    if (!HimeCpuHelpers::hasAVX2())
+    {
+        std::printf("    AVX2 is not supported, only SSE path tested\n");
+        return;
+    }
+
+    // Both paths run the same operations in the same order, without FMA.
+    SyntheticFrame syntheticFrame(uint2(333, 197), 1);
+    auto pFilter = CPUATrousFilter::create();
+    CPUATrousFilter::Params params;
+    params.tileSize = 64;
+    std::vector<float4> sse, avx2;
+    params.useAVX2 = false;
+    pFilter->run(syntheticFrame.frame, params, sse);
+    params.useAVX2 = true;
+    pFilter->run(syntheticFrame.frame, params, avx2);
+    HIME_EXPECT_MSG(computeMaxError(sse, avx2) == 0.f, "max difference " + std::to_string(computeMaxError(sse, avx2)));
+#endif
+}
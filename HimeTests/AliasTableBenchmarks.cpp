@@ -0,0 +1,60 @@
+#include "HimeTest.h"
+#include "HimeUtils/HimeAliasTable.h"
+#include <cmath>
+#include <random>
+
+using namespace Falcor;
+
+HIME_BENCHMARK(AliasTableBuild)
+{
+    const std::vector<size_t> lightCounts = HimeTest::isQuickRun() ? std::vector<size_t>{ 100000 } : std::vector<size_t>{ 1000000, 4000000, 10000000 };
+    const int repeatCount = HimeTest::isQuickRun() ? 1 : 3;
+    HimeAliasTableBuilder::SharedPtr pBuilder = HimeAliasTableBuilder::create();
+    for (size_t lightCount : lightCounts)
+    {
+        // Synthetic lognormal fluxes, a tenth of lights are not emissive.
+        std::vector<float> weights(lightCount);
+        std::mt19937 rng((uint32_t)lightCount);
+        std::lognormal_distribution<float> dist(0.f, 2.f);
+        for (auto& weight : weights) weight = rng() % 10 == 0 ? 0.f : dist(rng);
+
+        std::vector<HimeAliasTableEntry> entries(lightCount);
+        double times[2] = { 1e30, 1e30 };
+        for (int r = 0; r < repeatCount; r++)
+        {
+            HimeTest::Timer parallelTimer;
+            pBuilder->build(weights.data(), lightCount, entries.data());
+            times[0] = std::min(times[0], parallelTimer.elapsed());
+
+            HimeTest::Timer sortingTimer;
+            HimeAliasTableBuilder::buildBySorting(weights.data(), lightCount, entries.data());
+            times[1] = std::min(times[1], sortingTimer.elapsed());
+        }
+        std::printf("    %zu lights: parallel %.2f ms (%u threads), sorting %.2f ms, speedup %.2fx\n", lightCount, times[0] * 1e3, HimeParallelHelpers::getWorkerCount(),
+            times[1] * 1e3, times[1] / times[0]);
+    }
+}
+
+HIME_BENCHMARK(IncrementalAliasTableUpdate)
+{
+    const size_t lightCount = HimeTest::isQuickRun() ? 100000 : 4000000;
+    std::vector<float> weights(lightCount);
+    std::mt19937 rng(0);
+    std::lognormal_distribution<float> dist(0.f, 2.f);
+    for (auto& weight : weights) weight = dist(rng);
+
+    HimeIncrementalAliasTable::SharedPtr pTable = HimeIncrementalAliasTable::create();
+    HimeTest::Timer fullTimer;
+    pTable->update(weights.data(), lightCount);
+    const double fullTime = fullTimer.elapsed();
+
+    // Flux of a few lights changes per update, like blinking lights in a large scene.
+    for (size_t changedCount : { 16u, 1024u, 65536u })
+    {
+        for (size_t k = 0; k < changedCount; k++) weights[rng() % lightCount] = dist(rng);
+        HimeTest::Timer timer;
+        uint32_t rebuiltBucketCount = pTable->update(weights.data(), lightCount);
+        std::printf("    %zu of %zu lights changed: %u of %u buckets rebuilt in %.3f ms (full build %.2f ms)\n", changedCount, lightCount, rebuiltBucketCount, pTable->getBucketCount(),
+            timer.elapsed() * 1e3, fullTime * 1e3);
+    }
+}
@@ -0,0 +1,203 @@
+#include "HimeTest.h"
+#include "HimeUtils/HimeAliasTable.h"
+#include "ReSTIR/LightIndexRemap.h"
+#include <cmath>
+#include <random>
+
+using namespace Falcor;
+
+namespace
+{
+    /** Synthetic lognormal fluxes, a tenth of lights are not emissive.
+    */
+    std::vector<float> createWeights(size_t count, uint32_t seed)
+    {
+        std::vector<float> weights(count);
+        std::mt19937 rng(seed);
+        std::lognormal_distribution<float> dist(0.f, 2.f);
+        for (auto& weight : weights) weight = rng() % 10 == 0 ? 0.f : dist(rng);
+        return weights;
+    }
+
+    /** Probability of selecting each item implied by table.
+    */
+    std::vector<double> computeProbabilities(const std::vector<HimeAliasTableEntry>& entries)
+    {
+        std::vector<double> probabilities(entries.size(), 0.0);
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            probabilities[i] += entries[i].threshold;
+            probabilities[entries[i].alias] += 1.0 - entries[i].threshold;
+        }
+        for (auto& probability : probabilities) probability /= (double)entries.size();
+        return probabilities;
+    }
+
+    /** Max error of implied probabilities against weight / sum, relative to the larger of expected and uniform probability.
+    */
+    double computeMaxRelativeError(const std::vector<float>& weights, const std::vector<double>& probabilities)
+    {
+        double weightSum = 0.0;
+        for (float weight : weights) weightSum += weight;
+        double maxError = 0.0;
+        for (size_t i = 0; i < weights.size(); i++)
+        {
+            double expected = weights[i] / weightSum;
+            maxError = std::max(maxError, std::abs(probabilities[i] - expected) / std::max(expected, 1.0 / weights.size()));
+        }
+        return maxError;
+    }
+}
+
+HIME_TEST(AliasTableMatchesWeights)
+{
+    // Single chunk and several chunks of the parallel builder.
+    HimeAliasTableBuilder::SharedPtr pBuilder = HimeAliasTableBuilder::create();
+    for (size_t count : { (size_t)1, (size_t)7, (size_t)1000, HimeAliasTableBuilder::kMinChunkSize * 5 + 123 })
+    {
+        std::vector<float> weights = createWeights(count, (uint32_t)count);
+        if (count == 1) weights[0] = 2.f;
+        for (int method = 0; method < 2; method++)
+        {
+            std::vector<HimeAliasTableEntry> entries(count);
+            double weightSum = method == 0 ? pBuilder->build(weights.data(), count, entries.data()) : HimeAliasTableBuilder::buildBySorting(weights.data(), count, entries.data());
+            const std::string name = std::string(method == 0 ? "parallel" : "sorting") + ", " + std::to_string(count) + " weights";
+
+            double expectedSum = 0.0;
+            for (float weight : weights) expectedSum += weight;
+            HIME_EXPECT_MSG(std::abs(weightSum - expectedSum) <= 1e-9 * expectedSum, name);
+
+            std::vector<double> probabilities = computeProbabilities(entries);
+            size_t zeroWeightMismatchCount = 0;
+            for (size_t i = 0; i < count; i++) zeroWeightMismatchCount += weights[i] == 0.f && probabilities[i] != 0.0 ? 1 : 0;
+            double maxError = computeMaxRelativeError(weights, probabilities);
+            HIME_EXPECT_MSG(zeroWeightMismatchCount == 0, name + ": " + std::to_string(zeroWeightMismatchCount) + " non-emissive lights can be selected");
+            HIME_EXPECT_MSG(maxError < 1e-5, name + ": max relative pdf error " + std::to_string(maxError * 1e6) + " ppm");
+        }
+    }
+
+    // All zero weights select themselves.
+    std::vector<float> zeroWeights(100, 0.f);
+    std::vector<HimeAliasTableEntry> entries(zeroWeights.size());
+    HIME_EXPECT(pBuilder->build(zeroWeights.data(), zeroWeights.size(), entries.data()) == 0.0);
+    for (size_t i = 0; i < entries.size(); i++) HIME_EXPECT(entries[i].threshold == 1.f && entries[i].alias == i);
+}
+
+HIME_TEST(AliasTableSamplingPassesChiSquare)
+{
+    // Sampling same as sampleAliasTable() in HimeAliasTable.slang.
+    const size_t kLightCount = 1000;
+    const size_t kSampleCount = 4000000;
+    std::vector<float> weights = createWeights(kLightCount, 0);
+    std::vector<HimeAliasTableEntry> entries(kLightCount);
+    double weightSum = HimeAliasTableBuilder::create()->build(weights.data(), kLightCount, entries.data());
+
+    std::vector<size_t> histogram(kLightCount, 0);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(0.f, 1.f);
+    for (size_t s = 0; s < kSampleCount; s++)
+    {
+        uint32_t idx = std::min((uint32_t)(dist(rng) * kLightCount), (uint32_t)kLightCount - 1);
+        histogram[dist(rng) < entries[idx].threshold ? idx : entries[idx].alias]++;
+    }
+
+    double chiSquare = 0.0;
+    size_t degreesOfFreedom = 0;
+    size_t zeroWeightSampleCount = 0;
+    for (size_t i = 0; i < kLightCount; i++)
+    {
+        double expected = kSampleCount * (weights[i] / weightSum);
+        if (expected > 0.0)
+        {
+            chiSquare += (histogram[i] - expected) * (histogram[i] - expected) / expected;
+            degreesOfFreedom++;
+        }
+        else
+        {
+            zeroWeightSampleCount += histogram[i];
+        }
+    }
+    degreesOfFreedom--;
+
+    // Chi-square with k degrees of freedom has mean k and variance 2k, |z| > 4 means sampling is broken.
+    double z = (chiSquare - degreesOfFreedom) / std::sqrt(2.0 * degreesOfFreedom);
+    std::printf("    chi-square %.1f with %zu degrees of freedom (z = %.2f)\n", chiSquare, degreesOfFreedom, z);
+    HIME_EXPECT_MSG(std::abs(z) < 4.0, "z = " + std::to_string(z));
+    HIME_EXPECT(zeroWeightSampleCount == 0);
+}
+
+HIME_TEST(IncrementalAliasTableMatchesFullBuild)
+{
+    // Flux of a few lights changes per update, like blinking lights in a large scene.
+    const size_t kLightCount = 100 * HimeIncrementalAliasTable::kBucketSize + 17;
+    std::vector<float> weights = createWeights(kLightCount, 2);
+    std::mt19937 rng(3);
+    std::lognormal_distribution<float> dist(0.f, 2.f);
+
+    HimeIncrementalAliasTable::SharedPtr pTable = HimeIncrementalAliasTable::create();
+    HIME_EXPECT(pTable->update(weights.data(), kLightCount) == pTable->getBucketCount());
+    HIME_EXPECT(pTable->update(weights.data(), kLightCount) == 0);
+
+    for (size_t changedCount : { 1u, 16u, 1024u })
+    {
+        std::vector<uint8_t> isChangedBucket(pTable->getBucketCount(), 0);
+        for (size_t k = 0; k < changedCount; k++)
+        {
+            size_t i = rng() % kLightCount;
+            weights[i] = dist(rng);
+            isChangedBucket[i / HimeIncrementalAliasTable::kBucketSize] = 1;
+        }
+        std::vector<uint32_t> changedBuckets;
+        for (uint32_t b = 0; b < isChangedBucket.size(); b++) if (isChangedBucket[b]) changedBuckets.push_back(b);
+
+        // Only buckets of changed lights are rebuilt, and the table is the same as a full build.
+        const std::string name = std::to_string(changedCount) + " changed lights";
+        HIME_EXPECT_MSG(pTable->update(weights.data(), kLightCount) == changedBuckets.size(), name);
+        HIME_EXPECT_MSG(pTable->getDirtyBuckets() == changedBuckets, name);
+
+        HimeIncrementalAliasTable::SharedPtr pFullTable = HimeIncrementalAliasTable::create();
+        pFullTable->update(weights.data(), kLightCount);
+        HIME_EXPECT_MSG(memcmp(pTable->getEntries().data(), pFullTable->getEntries().data(), kLightCount * sizeof(HimeAliasTableEntry)) == 0, name);
+        HIME_EXPECT_MSG(memcmp(pTable->getBucketEntries().data(), pFullTable->getBucketEntries().data(), pTable->getBucketCount() * sizeof(HimeAliasTableEntry)) == 0, name);
+
+        double maxError = computeMaxRelativeError(weights, pTable->computeProbabilities());
+        HIME_EXPECT_MSG(maxError < 1e-5, name + ": max relative pdf error " + std::to_string(maxError * 1e6) + " ppm");
+    }
+
+    // Light count changed, all buckets are rebuilt.
+    weights.resize(kLightCount - 100);
+    HIME_EXPECT(pTable->update(weights.data(), weights.size()) == pTable->getBucketCount());
+    HIME_EXPECT(computeMaxRelativeError(weights, pTable->computeProbabilities()) < 1e-5);
+}
+
+HIME_TEST(LightIndexRemapFollowsReorderedLights)
+{
+    // Light collection rebuilt with one mesh light removed and the rest in reversed order.
+    const uint32_t kMeshLightCount = 1000;
+    const uint32_t kRemovedInstanceID = 3;
+    std::mt19937 rng(4);
+    std::vector<uint32_t> triangleCounts(kMeshLightCount);
+    for (auto& triangleCount : triangleCounts) triangleCount = 1 + rng() % 64;
+
+    std::vector<uint32_t> prevInstanceIDs, currInstanceIDs;
+    for (uint32_t m = 0; m < kMeshLightCount; m++) prevInstanceIDs.insert(prevInstanceIDs.end(), triangleCounts[m], m);
+    for (uint32_t m = kMeshLightCount; m-- > 0;) if (m != kRemovedInstanceID) currInstanceIDs.insert(currInstanceIDs.end(), triangleCounts[m], m);
+
+    std::vector<uint64_t> prevKeys = LightIndexRemap::computeKeys(prevInstanceIDs);
+    std::vector<uint64_t> currKeys = LightIndexRemap::computeKeys(currInstanceIDs);
+    std::vector<uint32_t> remap = LightIndexRemap::compute(prevKeys, currKeys);
+    HIME_EXPECT(remap.size() == prevKeys.size());
+
+    size_t droppedCount = 0, mismatchCount = 0;
+    for (size_t i = 0; i < remap.size(); i++)
+    {
+        bool isRemoved = prevInstanceIDs[i] == kRemovedInstanceID;
+        if (remap[i] == LightIndexRemap::kInvalidIndex) droppedCount++;
+        if (isRemoved != (remap[i] == LightIndexRemap::kInvalidIndex) || (!isRemoved && currKeys[remap[i]] != prevKeys[i])) mismatchCount++;
+    }
+    HIME_EXPECT(droppedCount == triangleCounts[kRemovedInstanceID]);
+    HIME_EXPECT_MSG(mismatchCount == 0, std::to_string(mismatchCount) + " mismatches");
+
+    // Identity remap is skipped.
+    HIME_EXPECT(LightIndexRemap::compute(prevKeys, prevKeys).empty());
+}
@@ -0,0 +1,93 @@
+#include "HimeTest.h"
+#include "LightTreeTestScenes.h"
+#include "RealtimeStochasticLightcuts/CPULightcuts.h"
+#include "HimeUtils/HimeParallel.h"
+#include <algorithm>
+
+using namespace Falcor;
+using namespace LightTreeTestScenes;
+
+namespace
+{
+    /** Relative RMSE of unshadowed irradiance estimated by one frame of samples (every pixelStep-th pixel), against all lights as point lights.
+    */
+    double computeRelativeError(const std::vector<LightTreeNode>& leaves, const GBuffer& gBuffer, const CPULightcuts::Params& params, const std::vector<CPULightcuts::LightSample>& samples, size_t pixelStep)
+    {
+        std::vector<const LightTreeNode*> lights(leaves.size(), nullptr);
+        for (const LightTreeNode& leaf : leaves) lights[leaf.lightIdx] = &leaf;
+
+        float SR2 = params.errorLimit * params.sceneLightBoundRadius;
+        SR2 *= SR2;
+        auto evalLight = [&](const LightTreeNode& light, const float3& posW, const float3& normal)
+        {
+            float3 d = (light.aabbMinPoint + light.aabbMaxPoint) * 0.5f - posW;
+            float dlen2 = dot(d, d);
+            float cosTheta = dlen2 > 0.f ? dot(normal, d) / std::sqrt(dlen2) : 0.f;
+            return cosTheta > 0.f ? length(light.intensity) * cosTheta / std::max(dlen2, SR2) : 0.f;
+        };
+
+        const size_t pixelCount = (size_t)gBuffer.dim.x * gBuffer.dim.y;
+        double squaredErrorSum = 0.0, squaredReferenceSum = 0.0;
+        for (size_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx += pixelStep)
+        {
+            const float3& posW = gBuffer.positions[pixelIdx];
+            const float3& normal = gBuffer.normals[pixelIdx];
+            if (normal == float3(0)) continue;
+
+            double reference = 0.0;
+            for (const LightTreeNode* pLight : lights) reference += evalLight(*pLight, posW, normal);
+
+            double estimate = 0.0;
+            for (uint i = 0; i < params.lightSampleCount; i++)
+            {
+                const CPULightcuts::LightSample& sample = samples[i * pixelCount + pixelIdx];
+                if (sample.pdf == 1e27f || sample.lightIdx >= lights.size()) continue; // dead branch
+                estimate += evalLight(*lights[sample.lightIdx], posW, normal) / sample.pdf;
+            }
+
+            squaredErrorSum += (estimate - reference) * (estimate - reference);
+            squaredReferenceSum += reference * reference;
+        }
+        return squaredReferenceSum > 0.0 ? std::sqrt(squaredErrorSum / squaredReferenceSum) : 0.0;
+    }
+}
+
+HIME_BENCHMARK(CPULightcutsFrame)
+{
+    const uint lightCount = HimeTest::isQuickRun() ? 1 << 12 : 1 << 16;
+    const uint2 dim = HimeTest::isQuickRun() ? uint2(64, 64) : uint2(512, 512);
+    const int repeatCount = HimeTest::isQuickRun() ? 1 : 3;
+
+    auto leaves = createLeaves(Layout::Clustered, lightCount, 1);
+    AABB sceneBound = computeCubicBound(leaves);
+    LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+    std::vector<LightTreeNode> lightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+    LightTreeHelpers::LightTreeView view = LightTreeHelpers::LightTreeView::create(lightTree);
+    auto pLightcuts = CPULightcuts::create();
+
+    std::vector<CPULightcuts::LightSample> samples;
+    for (GBufferLayout gBufferLayout : { GBufferLayout::Random, GBufferLayout::Surface })
+    {
+        GBuffer gBuffer = createGBuffer(gBufferLayout, sceneBound, dim, 2);
+        for (uint2 cutConfig : { uint2(8, 1), uint2(32, 1), uint2(32, 4), uint2(32, 8) })
+        {
+            CPULightcuts::Params params;
+            params.cutSize = cutConfig.x;
+            params.cutTileSize = cutConfig.y;
+            params.lightSampleCount = 4;
+            params.sceneLightBoundRadius = sceneBound.radius();
+
+            double time = 1e30;
+            for (int r = 0; r < repeatCount; r++)
+            {
+                HimeTest::Timer timer;
+                pLightcuts->run(view, gBuffer.positions.data(), gBuffer.normals.data(), dim, params, samples);
+                time = std::min(time, timer.elapsed());
+            }
+            double relativeError = computeRelativeError(leaves, gBuffer, params, samples, HimeTest::isQuickRun() ? 61 : 1021);
+            const std::string cutMode = params.cutTileSize > 1 ? "one cut per " + std::to_string(params.cutTileSize) + "x" + std::to_string(params.cutTileSize) + " tile" : "one cut per pixel";
+            std::printf("    %s %ux%u, %u lights, cut size %u, %u light samples, %s: %.2f ms (%u threads), relative RMSE %.4f\n", getGBufferLayoutName(gBufferLayout), dim.x, dim.y,
+                lightCount, params.cutSize, params.lightSampleCount, cutMode.c_str(), time * 1e3, HimeParallelHelpers::getWorkerCount(), relativeError);
+        }
+    }
+}
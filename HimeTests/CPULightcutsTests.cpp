@@ -0,0 +1,235 @@
+#include "HimeTest.h"
+#include "LightTreeTestScenes.h"
+#include "RealtimeStochasticLightcuts/CPULightcuts.h"
+
+using namespace Falcor;
+using namespace LightTreeTestScenes;
+
+namespace
+{
+    /** Light tree of both layouts FindLightcuts.cs.slang traverses, complete binary tree and LBVH.
+    */
+    struct TestLightTrees
+    {
+        AABB sceneBound;
+        std::vector<LightTreeNode> lightTree;
+        LightTreeHelpers::LBVH lbvh;
+    };
+
+    TestLightTrees createLightTrees(uint lightCount, uint seed)
+    {
+        TestLightTrees lightTrees;
+        auto leaves = createLeaves(Layout::Clustered, lightCount, seed);
+        lightTrees.sceneBound = computeCubicBound(leaves);
+        LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, lightTrees.sceneBound);
+        lightTrees.lightTree = LightTreeHelpers::buildLightTree(leaves, lightTrees.sceneBound);
+        lightTrees.lbvh = LightTreeHelpers::buildLBVH(leaves, LightTreeHelpers::LeafOrder::Morton, lightTrees.sceneBound);
+        return lightTrees;
+    }
+
+    /** Samples of pixels (every pixelStep-th) that differ from findCut() and traverseLightTree() of LightTreeHelpers.
+    */
+    uint countMismatches(const LightTreeHelpers::LightTreeView& view, const GBuffer& gBuffer, const CPULightcuts::Params& params, const std::vector<CPULightcuts::LightSample>& samples, size_t pixelStep)
+    {
+        const uint2 dim = gBuffer.dim;
+        const size_t pixelCount = (size_t)dim.x * dim.y;
+        const std::vector<float3>& positions = gBuffer.positions;
+        const std::vector<float3>& normals = gBuffer.normals;
+
+        uint mismatchCount = 0;
+        for (size_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx += pixelStep)
+        {
+            if (normals[pixelIdx] == float3(0))
+            {
+                for (uint i = 0; i < params.lightSampleCount; i++) mismatchCount += samples[i * pixelCount + pixelIdx].cutNode == kInvalidLightTreeNode ? 0 : 1;
+                continue;
+            }
+
+            const uint2 pixel = uint2((uint)(pixelIdx % dim.x), (uint)(pixelIdx / dim.x));
+            LightcutHeap heap;
+            if (params.cutTileSize > 1)
+            {
+                // Shading points of cut tile in row major order, same as CPULightcuts.
+                std::vector<float3> tilePositions, tileNormals;
+                const uint2 tileOrigin = uint2(pixel.x / params.cutTileSize * params.cutTileSize, pixel.y / params.cutTileSize * params.cutTileSize);
+                for (uint y = tileOrigin.y; y < std::min(tileOrigin.y + params.cutTileSize, dim.y); y++)
+                {
+                    for (uint x = tileOrigin.x; x < std::min(tileOrigin.x + params.cutTileSize, dim.x); x++)
+                    {
+                        size_t tilePixelIdx = (size_t)y * dim.x + x;
+                        if (normals[tilePixelIdx] == float3(0)) continue;
+                        tilePositions.push_back(positions[tilePixelIdx]);
+                        tileNormals.push_back(normals[tilePixelIdx]);
+                    }
+                }
+                auto bound = LightTreeHelpers::ShadingPointBound::create(tilePositions.data(), tileNormals.data(), tilePositions.size());
+                LightTreeHelpers::findCut(view, bound, params.cutSize, params.errorLimit, params.sceneLightBoundRadius, heap);
+            }
+            else
+            {
+                LightTreeHelpers::findCut(view, positions[pixelIdx], normals[pixelIdx], params.cutSize, params.errorLimit, params.sceneLightBoundRadius, heap);
+            }
+
+            CPULightcuts::RandomState rng = CPULightcuts::RandomState::create(pixel, params.frameCount);
+            for (uint i = 0; i < params.lightSampleCount; i++)
+            {
+                const CPULightcuts::LightSample& sample = samples[i * pixelCount + pixelIdx];
+                float r = rng.next(), nodeProb = 1.f;
+                uint cutNode = 0; // unused cut nodes are root in shader
+                if (params.cutSize == params.lightSampleCount)
+                {
+                    if (i < heap.size) cutNode = heap.nodes[i].nodeId;
+                }
+                else
+                {
+                    LightcutSelection selection = heap.selectNode(r);
+                    if (selection.heapIdx == heap.size)
+                    {
+                        if (sample.pdf != 1e27f) mismatchCount++;
+                        continue;
+                    }
+                    cutNode = heap.nodes[selection.heapIdx].nodeId;
+                    r = selection.r;
+                    nodeProb = selection.prob * params.lightSampleCount;
+                }
+                uint nodeId = cutNode;
+                if (LightTreeHelpers::traverseLightTree(view, positions[pixelIdx], normals[pixelIdx], nodeId, r, nodeProb))
+                {
+                    if (sample.cutNode != cutNode || sample.pdf != 1e27f) mismatchCount++;
+                    continue;
+                }
+                if (sample.cutNode != cutNode || sample.lightIdx != view.pNodes[nodeId].lightIdx || sample.pdf != nodeProb) mismatchCount++;
+            }
+        }
+        return mismatchCount;
+    }
+}
+
+HIME_TEST(CPULightcutsMatchScalarHelpers)
+{
+    TestLightTrees lightTrees = createLightTrees(20000, 1);
+    const LightTreeHelpers::LightTreeView views[2] = { LightTreeHelpers::LightTreeView::create(lightTrees.lightTree), LightTreeHelpers::LightTreeView::create(lightTrees.lbvh) };
+    const char* viewNames[2] = { "binary tree", "LBVH" };
+    auto pLightcuts = CPULightcuts::create();
+
+    // Cut sizes equal to light samples sample every cut node, larger cuts select cut nodes by error.
+    const uint2 cutConfigs[] = { { 1, 1 }, { 4, 4 }, { 16, 4 }, { 64, 8 } };
+    std::vector<CPULightcuts::LightSample> samples;
+    for (GBufferLayout gBufferLayout : { GBufferLayout::Random, GBufferLayout::Surface })
+    {
+        GBuffer gBuffer = createGBuffer(gBufferLayout, lightTrees.sceneBound, uint2(100, 76), 2);
+        for (uint v = 0; v < 2; v++)
+        {
+            for (uint2 cutConfig : cutConfigs)
+            {
+                for (uint cutTileSize : { 1u, 4u, 8u })
+                {
+                    CPULightcuts::Params params;
+                    params.cutSize = cutConfig.x;
+                    params.lightSampleCount = cutConfig.y;
+                    params.cutTileSize = cutTileSize;
+                    params.sceneLightBoundRadius = lightTrees.sceneBound.radius();
+                    params.frameCount = 3;
+                    pLightcuts->run(views[v], gBuffer.positions.data(), gBuffer.normals.data(), gBuffer.dim, params, samples);
+                    HIME_EXPECT(samples.size() == (size_t)params.lightSampleCount * gBuffer.dim.x * gBuffer.dim.y);
+
+                    // SIMD bound evaluation is bit identical with the scalar helpers, per pixel and per tile (partial tiles at the border).
+                    uint mismatchCount = countMismatches(views[v], gBuffer, params, samples, 1);
+                    HIME_EXPECT_MSG(mismatchCount == 0, std::string(getGBufferLayoutName(gBufferLayout)) + ", " + viewNames[v] + ", cut size " + std::to_string(params.cutSize)
+                        + ", cut tile " + std::to_string(cutTileSize) + ": " + std::to_string(mismatchCount) + " samples differ from scalar helpers");
+                }
+            }
+        }
+    }
+}
+
+HIME_TEST(CPULightcutsAreDeterministic)
+{
+    TestLightTrees lightTrees = createLightTrees(5000, 4);
+    const LightTreeHelpers::LightTreeView view = LightTreeHelpers::LightTreeView::create(lightTrees.lightTree);
+    GBuffer gBuffer = createGBuffer(GBufferLayout::Surface, lightTrees.sceneBound, uint2(64, 64), 5);
+    auto pLightcuts = CPULightcuts::create();
+
+    CPULightcuts::Params params;
+    params.cutSize = 16;
+    params.lightSampleCount = 4;
+    params.sceneLightBoundRadius = lightTrees.sceneBound.radius();
+
+    // Same frame gives same samples (tiles are independent of scheduling), another frame gives other samples.
+    std::vector<CPULightcuts::LightSample> samples[3];
+    for (uint i = 0; i < 3; i++)
+    {
+        params.frameCount = i < 2 ? 7 : 8;
+        pLightcuts->run(view, gBuffer.positions.data(), gBuffer.normals.data(), gBuffer.dim, params, samples[i]);
+    }
+    HIME_EXPECT(memcmp(samples[0].data(), samples[1].data(), samples[0].size() * sizeof(CPULightcuts::LightSample)) == 0);
+    HIME_EXPECT(memcmp(samples[0].data(), samples[2].data(), samples[0].size() * sizeof(CPULightcuts::LightSample)) != 0);
+}
+
+HIME_TEST(TileCutBoundsAreConservative)
+{
+    TestLightTrees lightTrees = createLightTrees(1024, 6);
+    const LightTreeHelpers::LightTreeView view = LightTreeHelpers::LightTreeView::create(lightTrees.lightTree);
+    const float errorLimit = 0.001f;
+    const float sceneLightBoundRadius = lightTrees.sceneBound.radius();
+    float SR2 = errorLimit * sceneLightBoundRadius;
+    SR2 *= SR2;
+
+    uint badBoundCount = 0, underestimateCount = 0;
+    for (GBufferLayout gBufferLayout : { GBufferLayout::Random, GBufferLayout::Surface })
+    {
+        GBuffer gBuffer = createGBuffer(gBufferLayout, lightTrees.sceneBound, uint2(64, 64), 7);
+        for (uint cutTileSize : { 4u, 8u })
+        {
+            const uint tilesPerRow = gBuffer.dim.x / cutTileSize;
+            for (uint tileIdx = 0; tileIdx < tilesPerRow * (gBuffer.dim.y / cutTileSize); tileIdx += 5)
+            {
+                std::vector<float3> positions, normals;
+                const uint2 tileOrigin = uint2(tileIdx % tilesPerRow, tileIdx / tilesPerRow) * cutTileSize;
+                for (uint y = tileOrigin.y; y < tileOrigin.y + cutTileSize; y++)
+                {
+                    for (uint x = tileOrigin.x; x < tileOrigin.x + cutTileSize; x++)
+                    {
+                        size_t pixelIdx = (size_t)y * gBuffer.dim.x + x;
+                        if (gBuffer.normals[pixelIdx] == float3(0)) continue;
+                        positions.push_back(gBuffer.positions[pixelIdx]);
+                        normals.push_back(gBuffer.normals[pixelIdx]);
+                    }
+                }
+
+                // Bound holds every position and normal of tile.
+                auto bound = LightTreeHelpers::ShadingPointBound::create(positions.data(), normals.data(), positions.size());
+                for (size_t i = 0; i < positions.size(); i++)
+                {
+                    if (min(positions[i], bound.boundMin) != bound.boundMin || max(positions[i], bound.boundMax) != bound.boundMax) badBoundCount++;
+                    if (dot(normals[i], bound.normalAxis) < bound.normalCosAngle - 1e-6f) badBoundCount++;
+                }
+
+                std::vector<float> tileErrors(view.nodeCount);
+                for (uint nodeId = 0; nodeId < view.nodeCount; nodeId++) tileErrors[nodeId] = LightTreeHelpers::computeNodeError(view.pNodes[nodeId], bound, errorLimit, sceneLightBoundRadius);
+
+                // Error of a node bounds the unshadowed contribution of every light under it at every shading point of tile.
+                // It's not compared with per-point errors, the normal cone can bound the geometry term tighter than a single point's box bound.
+                for (size_t i = 0; i < positions.size(); i++)
+                {
+                    for (uint leafId = view.leafStartIdx; leafId < view.nodeCount; leafId++)
+                    {
+                        const LightTreeNode& leaf = view.pNodes[leafId];
+                        if (leaf.isBogus()) continue;
+                        float3 d = leaf.aabbMinPoint - positions[i];
+                        float dlen2 = dot(d, d);
+                        float cosTheta = dlen2 > 0.f ? dot(normals[i], d) / std::sqrt(dlen2) : 1.f;
+                        float contribution = cosTheta > 0.f ? length(leaf.intensity) * cosTheta / std::max(dlen2, SR2) : 0.f;
+                        for (uint nodeId = leafId; ; nodeId = (nodeId - 1) / 2)
+                        {
+                            if (tileErrors[nodeId] < contribution * (1.f - 1e-5f)) underestimateCount++;
+                            if (nodeId == 0) break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    HIME_EXPECT_MSG(badBoundCount == 0, std::to_string(badBoundCount) + " positions or normals outside tile bound");
+    HIME_EXPECT_MSG(underestimateCount == 0, std::to_string(underestimateCount) + " node errors below a light of the tile");
+}
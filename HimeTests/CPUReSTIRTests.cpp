@@ -0,0 +1,206 @@
+#include "HimeTest.h"
+#include "ReSTIR/CPUReSTIR.h"
+#include "ReSTIR/SyntheticScene.h"
+#include "ReSTIR/ReservoirData.slang"
+#include <algorithm>
+#include <cmath>
+
+using namespace Falcor;
+
+namespace
+{
+    const AABB kSceneBound(float3(0.f), float3(10.f, 2.f, 10.f));
+    const uint2 kDim = uint2(128, 72);
+    const size_t kPixelCount = (size_t)kDim.x * kDim.y;
+    const size_t kLightCount = 2000;
+    const uint kFrameCount = 4;
+
+    const std::vector<CPUReSTIR::Light>& getLights()
+    {
+        static const std::vector<CPUReSTIR::Light> lights = createSyntheticLights(kSceneBound, kLightCount, 7);
+        return lights;
+    }
+
+    /** Runs frames firstFrame to firstFrame + frameCount - 1 while the camera pans one pixel per frame.
+        Motion vectors are scaled by motionScale, 1 follows the pan.
+    */
+    CPUReSTIR::SharedPtr runFrames(const CPUReSTIR::Params& params, uint firstFrame, uint frameCount, float motionScale, std::vector<float4>& lightTexture)
+    {
+        auto pCPUReSTIR = CPUReSTIR::create();
+        pCPUReSTIR->setLights(getLights());
+
+        SyntheticGBuffer syntheticGBuffer(kDim);
+        std::fill(syntheticGBuffer.motionVectors.begin(), syntheticGBuffer.motionVectors.end(), float2(motionScale / kDim.x, 0.f));
+        for (uint frame = firstFrame; frame < firstFrame + frameCount; frame++)
+        {
+            syntheticGBuffer.update(kSceneBound, frame);
+            CPUReSTIR::Params frameParams = params;
+            frameParams.frameCount = frame;
+            pCPUReSTIR->run(syntheticGBuffer.gBuffer, frameParams, lightTexture);
+        }
+        return pCPUReSTIR;
+    }
+
+    CPUReSTIR::SharedPtr runFrames(const CPUReSTIR::Params& params, uint frameCount, float motionScale = 1.f)
+    {
+        std::vector<float4> lightTexture;
+        return runFrames(params, 0, frameCount, motionScale, lightTexture);
+    }
+
+    bool isBackground(size_t pixelIdx) { return pixelIdx % 16 == 0; }
+
+    size_t getSurfacePixelCount() { return kPixelCount - (kPixelCount + 15) / 16; }
+
+    /** Luminance estimate of a pixel without visibility, target pdf of the selected sample times its unbiased contribution weight.
+    */
+    double getEstimate(const CPUReSTIR::ReservoirBuffer& reservoirs, size_t pixelIdx)
+    {
+        ReservoirData reservoir = reservoirs.load(pixelIdx);
+        return (double)reservoir.targetPdf * reservoir.getInvPdf();
+    }
+
+    /** RMSE of surface pixel estimates relative to the mean of the reference.
+    */
+    double computeRelativeError(const CPUReSTIR::ReservoirBuffer& reservoirs, const CPUReSTIR::ReservoirBuffer& reference)
+    {
+        double squaredErrorSum = 0.0, referenceSum = 0.0;
+        for (size_t i = 0; i < kPixelCount; i++)
+        {
+            if (isBackground(i)) continue;
+            double d = getEstimate(reservoirs, i) - getEstimate(reference, i);
+            squaredErrorSum += d * d;
+            referenceSum += getEstimate(reference, i);
+        }
+        const double n = (double)getSurfacePixelCount();
+        return std::sqrt(squaredErrorSum / n) / (referenceSum / n);
+    }
+
+    /** Reference of the last frame of runFrames(), resampled from many candidates without reuse.
+    */
+    CPUReSTIR::SharedPtr computeReference(uint frameCount)
+    {
+        CPUReSTIR::Params params;
+        params.initialCandidateCount = 2048;
+        params.enableTemporalResampling = false;
+        params.enableSpatialResampling = false;
+        std::vector<float4> lightTexture;
+        return runFrames(params, frameCount - 1, 1, 1.f, lightTexture);
+    }
+
+    CPUReSTIR::Params getNoReuseParams()
+    {
+        CPUReSTIR::Params params;
+        params.enableTemporalResampling = false;
+        params.enableSpatialResampling = false;
+        return params;
+    }
+}
+
+HIME_TEST(CPUReSTIRReusesHistoryAcrossPan)
+{
+    CPUReSTIR::Params params;
+    params.enableSpatialResampling = false;
+    params.enableBoilingFilter = false;
+
+    // Motion vectors follow the pan: only pixels whose previous pixel was background, and part of the column entering the frame, have no temporal neighbor.
+    auto pPanned = runFrames(params, kFrameCount);
+    const CPUReSTIR::Stats& stats = pPanned->getStats();
+    const size_t maxDisocclusionCount = kPixelCount / 16 + kDim.y;
+    HIME_EXPECT_MSG(stats.disocclusionCount <= maxDisocclusionCount, std::to_string(stats.disocclusionCount) + " disoccluded pixels, expected at most " + std::to_string(maxDisocclusionCount));
+
+    // M counts candidates of all frames in history.
+    size_t fullHistoryCount = 0;
+    for (size_t i = 0; i < kPixelCount; i++) fullHistoryCount += !isBackground(i) && pPanned->getReservoirs().load(i).M == kFrameCount ? 1 : 0;
+    HIME_EXPECT_MSG(fullHistoryCount >= getSurfacePixelCount() * 3 / 4, std::to_string(fullHistoryCount) + " of " + std::to_string(getSurfacePixelCount()) + " pixels have " + std::to_string(kFrameCount) + " frames of history");
+
+    // Temporal reuse reduces error of the same frame.
+    auto pReference = computeReference(kFrameCount);
+    const double temporalError = computeRelativeError(pPanned->getReservoirs(), pReference->getReservoirs());
+    const double noReuseError = computeRelativeError(runFrames(getNoReuseParams(), kFrameCount)->getReservoirs(), pReference->getReservoirs());
+    HIME_EXPECT_MSG(temporalError < noReuseError * 0.8, "relative RMSE " + std::to_string(temporalError) + " with temporal reuse, " + std::to_string(noReuseError) + " without");
+
+    // History is capped by maxHistoryLength times M of current candidates.
+    auto pLongHistory = runFrames(params, 12);
+    uint maxM = 0;
+    for (size_t i = 0; i < kPixelCount; i++) maxM = std::max(maxM, (uint)pLongHistory->getReservoirs().load(i).M);
+    HIME_EXPECT_MSG(maxM <= params.maxHistoryLength + 1, "max M " + std::to_string(maxM));
+
+    // Motion vectors pointing out of frame find no temporal neighbor.
+    auto pOutOfFrame = runFrames(params, kFrameCount, 2.f * kDim.x);
+    HIME_EXPECT(pOutOfFrame->getStats().disocclusionCount == getSurfacePixelCount());
+    bool isFirstFrameOnly = true;
+    for (size_t i = 0; i < kPixelCount; i++) isFirstFrameOnly &= isBackground(i) || pOutOfFrame->getReservoirs().load(i).M == 1;
+    HIME_EXPECT(isFirstFrameOnly);
+}
+
+HIME_TEST(CPUReSTIRReusesSpatialNeighbors)
+{
+    // Default radius of 32 pixels is scaled down to the small frame, neighbors should see about the same lights.
+    CPUReSTIR::Params params;
+    params.enableTemporalResampling = false;
+    params.spatialSampleRadius = 8.f;
+
+    // Without history, every pixel takes disocclusionBoostSampleCount neighbors.
+    auto pSpatial = runFrames(params, 1);
+    size_t reusedCount = 0;
+    for (size_t i = 0; i < kPixelCount; i++) reusedCount += !isBackground(i) && pSpatial->getReservoirs().load(i).M > 1 ? 1 : 0;
+    HIME_EXPECT_MSG(reusedCount >= getSurfacePixelCount() * 99 / 100, std::to_string(reusedCount) + " of " + std::to_string(getSurfacePixelCount()) + " pixels reused neighbors");
+
+    // Spatial reuse reduces error.
+    auto pReference = computeReference(1);
+    const double spatialError = computeRelativeError(pSpatial->getReservoirs(), pReference->getReservoirs());
+    const double noReuseError = computeRelativeError(runFrames(getNoReuseParams(), 1)->getReservoirs(), pReference->getReservoirs());
+    HIME_EXPECT_MSG(spatialError < noReuseError * 0.6, "relative RMSE " + std::to_string(spatialError) + " with spatial reuse, " + std::to_string(noReuseError) + " without");
+
+    // No neighbor, no reuse.
+    params.spatialSampleCount = 0;
+    params.disocclusionBoostSampleCount = 0;
+    auto pNoNeighbor = runFrames(params, 1);
+    bool isCandidateOnly = true;
+    for (size_t i = 0; i < kPixelCount; i++) isCandidateOnly &= isBackground(i) || pNoNeighbor->getReservoirs().load(i).M == 1;
+    HIME_EXPECT(isCandidateOnly);
+}
+
+HIME_TEST(CPUReSTIRLightTextureIsValid)
+{
+    // Light texture is (light index, pdf, uv) of final reservoirs, read by the path tracer.
+    for (bool useVariants : { false, true })
+    {
+        CPUReSTIR::Params params;
+        params.useCompactReservoir = useVariants;
+        params.useCompactGBuffer = useVariants;
+        params.useLightTiles = useVariants;
+        params.useHashGrid = useVariants;
+        std::vector<float4> lightTexture;
+        auto pCPUReSTIR = runFrames(params, 0, kFrameCount, 1.f, lightTexture);
+        HIME_EXPECT(lightTexture.size() == kPixelCount);
+
+        size_t validCount = 0;
+        bool isConsistent = true, isBackgroundEmpty = true;
+        for (size_t i = 0; i < kPixelCount; i++)
+        {
+            const float4& texel = lightTexture[i];
+            if (isBackground(i))
+            {
+                isBackgroundEmpty &= texel.x == 0.f && texel.z == 0.f && texel.w == 0.f;
+                continue;
+            }
+
+            ReservoirData reservoir = pCPUReSTIR->getReservoirs().load(i);
+            if (!reservoir.isValid()) continue;
+            validCount++;
+
+            // Selected lights are emissive, their pdf is positive and finite, and uv is a sample on the triangle.
+            const uint lightIdx = (uint)texel.x;
+            isConsistent &= texel.x == (float)reservoir.getLightIndex() && lightIdx < kLightCount && getLights()[lightIdx].flux > 0.f;
+            isConsistent &= texel.y > 0.f && std::isfinite(texel.y);
+            isConsistent &= texel.z >= 0.f && texel.z <= 1.f && texel.w >= 0.f && texel.w <= 1.f && float2(texel.z, texel.w) == reservoir.getSampleUV();
+        }
+        const std::string config = useVariants ? "compact reservoir, compact G-buffer, light tiles and hash grid" : "default";
+        HIME_EXPECT_MSG(isConsistent, config);
+        HIME_EXPECT_MSG(isBackgroundEmpty, config);
+
+        // Boiling filter may drop a few reservoirs.
+        HIME_EXPECT_MSG(validCount >= getSurfacePixelCount() * 99 / 100, config + ": " + std::to_string(validCount) + " of " + std::to_string(getSurfacePixelCount()) + " valid");
+    }
+}
@@ -0,0 +1,97 @@
+#include "HimeTest.h"
+#include "ReSTIR/CompactReservoir.h"
+#include <random>
+
+using namespace Falcor;
+
+namespace
+{
+    /** Random reservoir with every field inside encodable range, pdf and weight over 2^-34..2^36 to cover clamping and flushing.
+    */
+    ReservoirData createRandomReservoir(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> exponentDist(-34.f, 36.f);
+        const uint distanceRange = 2 * CompactReservoirData::c_MaxDistance + 1;
+        ReservoirData r;
+        r.lightData = (rng() & ReservoirData::c_LightIndexMask) | ReservoirData::c_LightValidBit;
+        r.uvData = rng();
+        r.targetPdf = std::exp2(exponentDist(rng));
+        r.weightSum = std::exp2(exponentDist(rng));
+        r.M = rng() % (CompactReservoirData::c_MMask + 1);
+        r.spatialDistance = int2(int(rng() % distanceRange) - CompactReservoirData::c_MaxDistance, int(rng() % distanceRange) - CompactReservoirData::c_MaxDistance);
+        r.age = rng() % (CompactReservoirData::c_MaxAge + 1);
+        return r;
+    }
+}
+
+HIME_TEST(CompactReservoirRoundTripWithinBounds)
+{
+    const size_t kRandomCount = HimeTest::isQuickRun() ? 100000 : 1000000;
+    std::mt19937 rng(0);
+    int maxUVError = 0; // 16-bit fixed point steps.
+    float maxHalfError = 0.f; // Relative error of targetPdf and weight.
+    size_t clampedCount = 0;
+    size_t flushedCount = 0;
+    for (size_t i = 0; i < kRandomCount; i++)
+    {
+        const ReservoirData r = createRandomReservoir(rng);
+        const ReservoirData d = CompactReservoir::unpack(CompactReservoir::pack(r));
+
+        int uError = std::abs(int(d.uvData & 0xffff) - int(r.uvData & 0xffff));
+        int vError = std::abs(int(d.uvData >> 16) - int(r.uvData >> 16));
+        maxUVError = std::max(maxUVError, std::max(uError, vError));
+
+        for (float2 values : { float2(r.targetPdf, d.targetPdf), float2(r.weightSum, d.weightSum) })
+        {
+            if (values.x > CompactReservoir::kMaxHalf)
+            {
+                clampedCount++;
+                HIME_EXPECT(values.y == CompactReservoir::kMaxHalf);
+            }
+            else if (values.x < CompactReservoir::kMinHalf)
+            {
+                flushedCount++;
+                HIME_EXPECT(values.y <= CompactReservoir::kMinHalf);
+            }
+            else maxHalfError = std::max(maxHalfError, std::abs(values.y - values.x) / values.x);
+        }
+        HIME_EXPECT(d.lightData == r.lightData && d.M == r.M && d.age == r.age && d.spatialDistance == r.spatialDistance);
+    }
+    HIME_EXPECT_MSG(maxUVError <= CompactReservoir::kMaxUVError, "max uv error " + std::to_string(maxUVError) + " steps");
+    HIME_EXPECT_MSG(maxHalfError <= CompactReservoir::kMaxRelativeHalfError, "max relative pdf/weight error " + std::to_string(maxHalfError * 2048.f) + " x 2^-11");
+    // The exponent range must have exercised both ends.
+    HIME_EXPECT(clampedCount > 0 && flushedCount > 0);
+}
+
+HIME_TEST(CompactReservoirClampsOutOfRange)
+{
+    ReservoirData r;
+    r.lightData = 42 | ReservoirData::c_LightValidBit;
+    r.uvData = 0xffffffff;
+    r.targetPdf = 1e20f;
+    r.weightSum = 0.f;
+    r.M = ReservoirData::c_MaxM + 1000;
+    r.spatialDistance = int2(1000, -1000);
+    r.age = ReservoirData::c_MaxAge;
+
+    ReservoirData d = CompactReservoir::unpack(CompactReservoir::pack(r));
+    HIME_EXPECT(d.lightData == r.lightData);
+    HIME_EXPECT(d.uvData == 0xffffffff); // UV 1 stays exact.
+    HIME_EXPECT(d.targetPdf == CompactReservoir::kMaxHalf);
+    HIME_EXPECT(d.weightSum == 0.f);
+    HIME_EXPECT(d.M == CompactReservoirData::c_MMask);
+    HIME_EXPECT(d.age == CompactReservoirData::c_MaxAge);
+    HIME_EXPECT(d.spatialDistance == int2(CompactReservoirData::c_MaxDistance, -CompactReservoirData::c_MaxDistance));
+
+    // Reservoirs with non-finite weight are dropped.
+    for (float weight : { INFINITY, NAN })
+    {
+        r.weightSum = weight;
+        ReservoirData dropped = CompactReservoir::unpack(CompactReservoir::pack(r));
+        HIME_EXPECT(!dropped.isValid() && dropped.M == 0 && dropped.weightSum == 0.f);
+    }
+
+    // Empty reservoir round trips exactly.
+    ReservoirData empty = CompactReservoir::unpack(CompactReservoir::pack(ReservoirData()));
+    HIME_EXPECT(!empty.isValid() && empty.uvData == 0 && empty.targetPdf == 0.f && empty.weightSum == 0.f && empty.M == 0 && empty.age == 0 && empty.spatialDistance == int2(0));
+}
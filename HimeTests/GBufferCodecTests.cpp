@@ -0,0 +1,182 @@
+#include "HimeTest.h"
+#include "HimeUtils/HimeGBufferCodec.h"
+#include "ATrousWaveletFilter/CPUATrousFilter.h"
+#include "ATrousWaveletFilter/SyntheticFrame.h"
+#include "ReSTIR/CompactReservoir.h"
+#include "ReSTIR/ReservoirResampling.slangh"
+#include <algorithm>
+#include <random>
+
+using namespace Falcor;
+using namespace GBufferCodecHelpers;
+
+namespace
+{
+    /** Camera looking down at SyntheticFrame, 60 degree vertical field of view. Surfaces are moved onto pixel rays at
+        linear depth 1 + z of their synthetic position, like a G-buffer rendered by the camera.
+    */
+    struct SyntheticCamera
+    {
+        uint2 dim;
+        float3 posW = float3(5.f, 4.f, -6.f);
+        float3 forward = normalize(float3(0.f, -0.3f, 1.f));
+        float3 cameraU, cameraV, cameraW;
+
+        SyntheticCamera(uint2 dim_) : dim(dim_)
+        {
+            float3 right = normalize(cross(float3(0.f, 1.f, 0.f), forward));
+            float3 up = cross(forward, right);
+            float tanHalfFovY = std::tan(glm::radians(30.f));
+            cameraU = right * (tanHalfFovY * dim.x / dim.y);
+            cameraV = up * tanHalfFovY;
+            cameraW = forward;
+        }
+
+        float3 getRayDir(uint x, uint y) const { return computePixelRayDir(uint2(x, y), dim, cameraU, cameraV, cameraW); }
+
+        void placeSurfaces(SyntheticFrame& syntheticFrame) const
+        {
+            for (uint y = 0; y < dim.y; y++)
+            {
+                for (uint x = 0; x < dim.x; x++)
+                {
+                    float4& position = syntheticFrame.position[(size_t)y * dim.x + x];
+                    position = float4(reconstructPosition(posW, getRayDir(x, y), forward, 1.f + position.z), 1.f);
+                }
+            }
+        }
+    };
+}
+
+HIME_TEST(GBufferCodecRoundTripWithinBounds)
+{
+    // Random unit normals and linear z across encodable range.
+    const size_t kRandomCount = HimeTest::isQuickRun() ? 100000 : 1000000;
+    std::mt19937 rng(0);
+    std::normal_distribution<float> normalDist;
+    std::uniform_real_distribution<float> exponentDist(-14.f, 16.f);
+    float maxNormalError = 0.f;  // Radians.
+    float maxLinearZError = 0.f; // Relative.
+    for (size_t i = 0; i < kRandomCount; i++)
+    {
+        float3 normal = normalize(float3(normalDist(rng), normalDist(rng), normalDist(rng)));
+        float linearZ = std::min(std::exp2(exponentDist(rng)), kMaxLinearZ);
+        uint packed = packNormalAndLinearZ(normal, linearZ);
+        float4 decoded = unpackNormalAndLinearZ(packed);
+        HIME_EXPECT(packed != 0);
+        maxNormalError = std::max(maxNormalError, std::acos(std::min(dot(normal, float3(decoded)), 1.f)));
+        maxLinearZError = std::max(maxLinearZError, std::abs(decoded.w - linearZ) / linearZ);
+    }
+    HIME_EXPECT_MSG(maxNormalError <= kMaxNormalError, "max normal error " + std::to_string(glm::degrees(maxNormalError)) + " degrees");
+    HIME_EXPECT_MSG(maxLinearZError <= kMaxRelativeLinearZError, "max relative linear z error " + std::to_string(maxLinearZError * 2048.f) + " x 2^-11");
+
+    // Background, clamped depth and axis normals are exact.
+    HIME_EXPECT(packNormalAndLinearZ(float3(0.f), 0.f) == 0 && unpackNormalAndLinearZ(0) == float4(0.f));
+    HIME_EXPECT(unpackLinearZ(packLinearZ(1e9f)) == kMaxLinearZ && unpackLinearZ(packLinearZ(1e-9f)) == kMinLinearZ);
+    for (float3 axis : { float3(1.f, 0.f, 0.f), float3(0.f, -1.f, 0.f), float3(0.f, 0.f, 1.f), float3(0.f, 0.f, -1.f) })
+    {
+        HIME_EXPECT(decodeNormalOct16(encodeNormalOct16(axis)) == axis);
+    }
+}
+
+HIME_TEST(CompactGBufferReconstructsPosition)
+{
+    // Round trip of PackGBuffer.ps.slang and loadSurface() of ATrous.ps.slang.
+    const uint2 dim = uint2(640, 360);
+    const SyntheticCamera camera(dim);
+    SyntheticFrame syntheticFrame(dim, 0);
+    camera.placeSurfaces(syntheticFrame);
+
+    std::vector<float4> decodedNormal(syntheticFrame.normal.size());
+    std::vector<float4> decodedPosition(syntheticFrame.position.size());
+    float maxNormalError = 0.f;   // Radians.
+    float maxPositionError = 0.f; // Relative to distance to camera.
+    for (uint y = 0; y < dim.y; y++)
+    {
+        for (uint x = 0; x < dim.x; x++)
+        {
+            const size_t i = (size_t)y * dim.x + x;
+            const float3 normal = float3(syntheticFrame.normal[i]);
+            const float3 position = float3(syntheticFrame.position[i]);
+
+            float4 normalAndLinearZ = unpackNormalAndLinearZ(packNormalAndLinearZ(normal, computeLinearZ(position, camera.posW, camera.forward)));
+            decodedNormal[i] = float4(float3(normalAndLinearZ), 0.f);
+            decodedPosition[i] = float4(reconstructPosition(camera.posW, camera.getRayDir(x, y), camera.forward, normalAndLinearZ.w), 1.f);
+
+            maxNormalError = std::max(maxNormalError, std::acos(std::min(dot(normal, float3(normalAndLinearZ)), 1.f)));
+            maxPositionError = std::max(maxPositionError, length(float3(decodedPosition[i]) - position) / length(position - camera.posW));
+        }
+    }
+    // Position moves along the ray by linear depth error, 1e-6 is left for rounding of reconstruction.
+    HIME_EXPECT_MSG(maxNormalError <= kMaxNormalError, "max normal error " + std::to_string(glm::degrees(maxNormalError)) + " degrees");
+    HIME_EXPECT_MSG(maxPositionError <= kMaxRelativeLinearZError + 1e-6f, "max position error " + std::to_string(maxPositionError * 2048.f) + " x 2^-11 of distance to camera");
+
+    // Filter output with decoded inputs stays close to output with full inputs.
+    CPUATrousFilter::Params params;
+    CPUATrousFilter::Frame compactFrame = syntheticFrame.frame;
+    compactFrame.normal = decodedNormal.data();
+    compactFrame.position = decodedPosition.data();
+    std::vector<float4> reference, filtered;
+    CPUATrousFilter::runReference(syntheticFrame.frame, params, reference);
+    CPUATrousFilter::runReference(compactFrame, params, filtered);
+
+    double sumError = 0.0;
+    double sumValue = 0.0;
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        float4 d = filtered[i] - reference[i];
+        sumError += std::abs(d.x) + std::abs(d.y) + std::abs(d.z);
+        sumValue += std::abs(reference[i].x) + std::abs(reference[i].y) + std::abs(reference[i].z);
+    }
+    HIME_EXPECT_MSG(sumError <= 1e-4 * sumValue, "mean relative difference " + std::to_string(sumError / sumValue * 1e6) + " ppm");
+}
+
+HIME_TEST(CompactGBufferKeepsNeighborTests)
+{
+    // Temporal and spatial neighbor tests of ReSTIR (isValidNeighbor() with default thresholds) on decoded surfaces
+    // should accept the same neighbors as on full surfaces.
+    const uint2 dim = uint2(640, 360);
+    const SyntheticCamera camera(dim);
+    SyntheticFrame syntheticFrame(dim, 0);
+    camera.placeSurfaces(syntheticFrame);
+
+    const size_t pixelCount = (size_t)dim.x * dim.y;
+    std::vector<float4> full(pixelCount), compact(pixelCount);
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        float3 normal = float3(syntheticFrame.normal[i]);
+        float linearZ = computeLinearZ(float3(syntheticFrame.position[i]), camera.posW, camera.forward);
+        full[i] = float4(normal, linearZ);
+        compact[i] = unpackNormalAndLinearZ(packNormalAndLinearZ(normal, linearZ));
+    }
+
+    const float kNormalThreshold = 0.5f;
+    const float kDepthThreshold = 0.1f;
+    auto isValid = [&](const float4& ours, const float4& theirs)
+    {
+        return isValidNeighbor(float3(ours), float3(theirs), ours.w, theirs.w, kNormalThreshold, kDepthThreshold);
+    };
+    size_t testCount = 0;
+    size_t rejectCount = 0;
+    size_t flipCount = 0;
+    for (uint y = 0; y < dim.y; y++)
+    {
+        for (uint x = 0; x < dim.x; x++)
+        {
+            for (int2 offset : { int2(1, 0), int2(0, 1), int2(8, 0), int2(0, 8), int2(32, 0), int2(0, 32) })
+            {
+                int2 neighbor = int2(x, y) + offset;
+                if (neighbor.x >= (int)dim.x || neighbor.y >= (int)dim.y) continue;
+                size_t center = (size_t)y * dim.x + x;
+                size_t other = (size_t)neighbor.y * dim.x + neighbor.x;
+                bool fullResult = isValid(full[center], full[other]);
+                testCount++;
+                rejectCount += fullResult ? 0 : 1;
+                flipCount += fullResult != isValid(compact[center], compact[other]) ? 1 : 0;
+            }
+        }
+    }
+    // Only pairs right at a threshold can flip.
+    HIME_EXPECT(rejectCount > 0);
+    HIME_EXPECT_MSG(flipCount * 1000 <= testCount, std::to_string(flipCount) + " of " + std::to_string(testCount) + " neighbor tests changed");
+}
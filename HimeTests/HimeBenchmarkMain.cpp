@@ -0,0 +1,15 @@
+#include "HimeTest.h"
+
+/** Usage: HimeBenchmarks [--quick] [name filter]
+    --quick shrinks workloads, so benchmarks can run as a smoke test under ctest.
+*/
+int main(int argc, char** argv)
+{
+    const char* filter = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--quick") == 0) HimeTest::isQuickRun() = true;
+        else filter = argv[i];
+    }
+    return HimeTest::runEntries(HimeTest::getBenchmarks(), filter);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/** Minimal headless test and benchmark registry.
+
+    Tests are registered with HIME_TEST and checked with HIME_EXPECT, a failed check marks the test as failed
+    and HimeTests returns non-zero. Benchmarks are registered with HIME_BENCHMARK and run by HimeBenchmarks,
+    isQuickRun() asks them to shrink their workloads (used by ctest).
+*/
+namespace HimeTest
+{
+    using Func = void (*)();
+
+    struct Entry
+    {
+        const char* name;
+        Func func;
+    };
+
+    inline std::vector<Entry>& getTests() { static std::vector<Entry> sTests; return sTests; }
+    inline std::vector<Entry>& getBenchmarks() { static std::vector<Entry> sBenchmarks; return sBenchmarks; }
+    inline int& getFailureCount() { static int sFailureCount = 0; return sFailureCount; }
+    inline bool& isQuickRun() { static bool sIsQuickRun = false; return sIsQuickRun; }
+
+    struct Registrar
+    {
+        Registrar(std::vector<Entry>& entries, const char* name, Func func) { entries.push_back({ name, func }); }
+    };
+
+    inline void reportFailure(const char* file, int line, const std::string& msg)
+    {
+        std::printf("    %s:%d: check failed: %s\n", file, line, msg.c_str());
+        getFailureCount()++;
+    }
+
+    /** Seconds elapsed since construction.
+    */
+    struct Timer
+    {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        double elapsed() const { return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count(); }
+    };
+
+    /** Run entries whose name contains filter, return number of failed entries.
+    */
+    inline int runEntries(const std::vector<Entry>& entries, const char* filter)
+    {
+        int failedCount = 0;
+        int runCount = 0;
+        for (const auto& entry : entries)
+        {
+            if (filter && !std::strstr(entry.name, filter)) continue;
+            std::printf("[ RUN  ] %s\n", entry.name);
+            int failureCount = getFailureCount();
+            Timer timer;
+            entry.func();
+            bool isPassed = getFailureCount() == failureCount;
+            std::printf("[ %s ] %s (%.1f ms)\n", isPassed ? " OK " : "FAIL", entry.name, timer.elapsed() * 1e3);
+            failedCount += isPassed ? 0 : 1;
+            runCount++;
+        }
+        std::printf("%d run, %d failed\n", runCount, failedCount);
+        return failedCount;
+    }
+}
+
+#define HIME_TEST_CONCAT_IMPL(a, b) a##b
+#define HIME_TEST_CONCAT(a, b) HIME_TEST_CONCAT_IMPL(a, b)
+
+#define HIME_TEST(name) \
+    static void name(); \
+    static HimeTest::Registrar HIME_TEST_CONCAT(s##name, Registrar)(HimeTest::getTests(), #name, name); \
+    static void name()
+
+#define HIME_BENCHMARK(name) \
+    static void name(); \
+    static HimeTest::Registrar HIME_TEST_CONCAT(s##name, Registrar)(HimeTest::getBenchmarks(), #name, name); \
+    static void name()
+
+#define HIME_EXPECT(cond) \
+    do { if (!(cond)) HimeTest::reportFailure(__FILE__, __LINE__, #cond); } while (0)
+
+#define HIME_EXPECT_MSG(cond, msg) \
+    do { if (!(cond)) HimeTest::reportFailure(__FILE__, __LINE__, std::string(#cond) + " (" + (msg) + ")"); } while (0)
@@ -0,0 +1,10 @@
+#include "HimeTest.h"
+
+/** Usage: HimeTests [name filter]
+    Returns the number of failed tests.
+*/
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    return HimeTest::runEntries(HimeTest::getTests(), filter);
+}
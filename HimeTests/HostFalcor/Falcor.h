@@ -0,0 +1,58 @@
+#pragma once
+
+/** Headless stand-in for Falcor.h, see Utils/HostDeviceShared.slangh. Only used by HimeTests.
+*/
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Utils/HostDeviceShared.slangh"
+
+namespace Falcor
+{
+    struct AABB
+    {
+        float3 minPoint = float3(INFINITY);
+        float3 maxPoint = float3(-INFINITY);
+
+        AABB() = default;
+        AABB(const float3& minPoint_, const float3& maxPoint_) : minPoint(minPoint_), maxPoint(maxPoint_) {}
+
+        bool valid() const { return maxPoint.x >= minPoint.x && maxPoint.y >= minPoint.y && maxPoint.z >= minPoint.z; }
+        float3 center() const { return (minPoint + maxPoint) * 0.5f; }
+        float3 extent() const { return maxPoint - minPoint; }
+        float radius() const { return 0.5f * length(extent()); }
+        float area() const
+        {
+            float3 e = extent();
+            return 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+
+        AABB& include(const float3& p)
+        {
+            minPoint = min(minPoint, p);
+            maxPoint = max(maxPoint, p);
+            return *this;
+        }
+
+        AABB& include(const AABB& b)
+        {
+            minPoint = min(minPoint, b.minPoint);
+            maxPoint = max(maxPoint, b.maxPoint);
+            return *this;
+        }
+    };
+
+    inline void logInfo(const std::string& msg) { std::printf("(Info) %s\n", msg.c_str()); }
+    inline void logWarning(const std::string& msg) { std::printf("(Warning) %s\n", msg.c_str()); }
+    inline void logError(const std::string& msg) { std::printf("(Error) %s\n", msg.c_str()); }
+}
+
+namespace glm
+{
+    template<typename T> constexpr T pi() { return T(3.14159265358979323846); }
+    inline float degrees(float radians) { return radians * (180.f / pi<float>()); }
+    inline float radians(float degrees) { return degrees * (pi<float>() / 180.f); }
+    template<typename T> T floor(const T& v) { return Falcor::floor(v); }
+    template<typename T> T abs(const T& v) { return Falcor::abs(v); }
+}
@@ -0,0 +1,44 @@
+#include "HimeTest.h"
+#include "ReSTIR/CPUReSTIR.h"
+#include "ReSTIR/SyntheticScene.h"
+#include "HimeUtils/HimeParallel.h"
+
+using namespace Falcor;
+
+HIME_BENCHMARK(LightTiles)
+{
+    // Candidates per second of initial sampling, lights are too many to stay in cache when they are drawn directly.
+    const AABB bound(float3(0.f), float3(10.f, 2.f, 10.f));
+    const uint2 dim = HimeTest::isQuickRun() ? uint2(320, 180) : uint2(1920, 1080);
+    SyntheticGBuffer syntheticGBuffer(dim);
+    syntheticGBuffer.update(bound, 0);
+
+    // Only initial candidates are compared, temporal and spatial resample don't depend on how lights are drawn.
+    CPUReSTIR::Params params;
+    params.enableTemporalResampling = false;
+    params.enableSpatialResampling = false;
+    const double candidateCount = (double)dim.x * dim.y * params.initialCandidateCount;
+
+    const std::vector<size_t> lightCounts = HimeTest::isQuickRun() ? std::vector<size_t>{ 100000 } : std::vector<size_t>{ 1000000, 4000000 };
+    for (size_t lightCount : lightCounts)
+    {
+        auto pCPUReSTIR = CPUReSTIR::create();
+        pCPUReSTIR->setLights(createSyntheticLights(bound, lightCount, (uint)lightCount));
+
+        double initialTimes[2] = {}, presampleTime = 0.0;
+        std::vector<float4> lightTexture;
+        for (uint useLightTiles = 0; useLightTiles < 2; useLightTiles++)
+        {
+            params.useLightTiles = useLightTiles != 0;
+            pCPUReSTIR->run(syntheticGBuffer.gBuffer, params, lightTexture);
+            initialTimes[useLightTiles] = pCPUReSTIR->getStats().initialSampleTime;
+            if (useLightTiles) presampleTime = pCPUReSTIR->getStats().presampleTime;
+        }
+
+        const double directRate = candidateCount / (initialTimes[0] * 1e-3);
+        const double tiledRate = candidateCount / ((initialTimes[1] + presampleTime) * 1e-3);
+        std::printf("    %zu lights, %ux%u, %u candidates: direct %.2f ms (%.0f M candidates/s), tiles %.2f ms + presample %.2f ms (%.0f M candidates/s), speedup %.2fx (%u threads)\n",
+            lightCount, dim.x, dim.y, params.initialCandidateCount, initialTimes[0], directRate * 1e-6, initialTimes[1], presampleTime, tiledRate * 1e-6,
+            tiledRate / directRate, HimeParallelHelpers::getWorkerCount());
+    }
+}
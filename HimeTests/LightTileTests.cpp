@@ -0,0 +1,127 @@
+#include "HimeTest.h"
+#include "ReSTIR/CPUReSTIR.h"
+#include "ReSTIR/SyntheticScene.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Falcor;
+
+namespace
+{
+    const AABB kLightTileSceneBound(float3(0.f), float3(10.f, 2.f, 10.f));
+}
+
+HIME_TEST(PresampledLightsFollowFlux)
+{
+    // Presampled lights over frames against flux / flux sum. A tenth of synthetic lights are not emissive.
+    const size_t kLightCount = 1000;
+    const uint kFrameCount = 16;
+    CPUReSTIR::Params params;
+    const uint sampleCount = params.lightTileCount * params.lightTileSize;
+    const std::vector<CPUReSTIR::Light> lights = createSyntheticLights(kLightTileSceneBound, kLightCount, 0);
+    auto pCPUReSTIR = CPUReSTIR::create();
+    pCPUReSTIR->setLights(lights);
+
+    double fluxSum = 0.0;
+    for (const auto& light : lights) fluxSum += light.flux;
+
+    std::vector<size_t> histogram(kLightCount, 0);
+    std::vector<PresampledLight> lightTiles;
+    size_t totalSampleCount = 0;
+    double maxPdfError = 0.0;
+    for (uint frame = 0; frame < kFrameCount; frame++)
+    {
+        pCPUReSTIR->presampleLights(frame, sampleCount, lightTiles);
+        for (const PresampledLight& presampled : lightTiles)
+        {
+            histogram[presampled.lightIndex]++;
+            double expectedPdf = lights[presampled.lightIndex].flux / fluxSum;
+            double pdf = presampled.invPdf > 0.f ? 1.0 / presampled.invPdf : 0.0;
+            maxPdfError = std::max(maxPdfError, std::abs(pdf - expectedPdf) / std::max(expectedPdf, 1e-30));
+        }
+        totalSampleCount += lightTiles.size();
+    }
+    HIME_EXPECT(totalSampleCount == (size_t)kFrameCount * sampleCount);
+
+    // Pdf of each sample is its light's flux share, up to float precision.
+    HIME_EXPECT_MSG(maxPdfError < 1e-5, "max relative pdf error " + std::to_string(maxPdfError * 1e6) + " ppm");
+
+    // Chi-square over lights, lights expecting fewer than 5 samples are pooled into one bin.
+    double chiSquare = 0.0;
+    size_t binCount = 0, zeroFluxSampleCount = 0, pooledCount = 0;
+    double pooledExpected = 0.0;
+    for (size_t i = 0; i < kLightCount; i++)
+    {
+        double expected = totalSampleCount * (lights[i].flux / fluxSum);
+        if (lights[i].flux == 0.f)
+        {
+            zeroFluxSampleCount += histogram[i];
+        }
+        else if (expected < 5.0)
+        {
+            pooledExpected += expected;
+            pooledCount += histogram[i];
+        }
+        else
+        {
+            chiSquare += (histogram[i] - expected) * (histogram[i] - expected) / expected;
+            binCount++;
+        }
+    }
+    if (pooledExpected > 0.0)
+    {
+        chiSquare += (pooledCount - pooledExpected) * (pooledCount - pooledExpected) / pooledExpected;
+        binCount++;
+    }
+    const size_t degreesOfFreedom = binCount - 1;
+    const double z = (chiSquare - degreesOfFreedom) / std::sqrt(2.0 * degreesOfFreedom);
+    HIME_EXPECT_MSG(zeroFluxSampleCount == 0, std::to_string(zeroFluxSampleCount) + " samples of non-emissive lights");
+    HIME_EXPECT_MSG(std::abs(z) < 4.0, "chi-square " + std::to_string(chiSquare) + " with " + std::to_string(degreesOfFreedom) + " degrees of freedom, z = " + std::to_string(z));
+}
+
+HIME_TEST(LightTilesKeepInitialEstimateUnbiased)
+{
+    // Mean of initial estimates (target pdf x weight, unshadowed) with and without tiles agree within a few standard errors.
+    // Pixels of a tile share light samples, so the standard error is computed from per-frame means.
+    const uint2 dim = uint2(128, 128);
+    const uint kFrameCount = 16;
+    SyntheticGBuffer syntheticGBuffer(dim);
+    syntheticGBuffer.update(kLightTileSceneBound, 0);
+    auto pCPUReSTIR = CPUReSTIR::create();
+    pCPUReSTIR->setLights(createSyntheticLights(kLightTileSceneBound, 10000, 1));
+
+    CPUReSTIR::Params params;
+    params.enableTemporalResampling = false;
+    params.enableSpatialResampling = false;
+
+    double means[2], standardErrors[2];
+    for (uint useLightTiles = 0; useLightTiles < 2; useLightTiles++)
+    {
+        params.useLightTiles = useLightTiles != 0;
+        double sum = 0.0, squareSum = 0.0;
+        std::vector<float4> lightTexture;
+        for (uint frame = 0; frame < kFrameCount; frame++)
+        {
+            params.frameCount = frame;
+            pCPUReSTIR->run(syntheticGBuffer.gBuffer, params, lightTexture);
+
+            const CPUReSTIR::ReservoirBuffer& reservoirs = pCPUReSTIR->getReservoirs();
+            double frameSum = 0.0;
+            size_t pixelCount = 0;
+            for (size_t i = 0; i < reservoirs.size(); i++)
+            {
+                if (syntheticGBuffer.normals[i] == float3(0)) continue;
+                frameSum += (double)reservoirs.targetPdf[i] * reservoirs.weight[i];
+                pixelCount++;
+            }
+            double frameMean = frameSum / pixelCount;
+            sum += frameMean;
+            squareSum += frameMean * frameMean;
+        }
+        means[useLightTiles] = sum / kFrameCount;
+        standardErrors[useLightTiles] = std::sqrt(std::max(0.0, (squareSum - sum * means[useLightTiles]) / (kFrameCount - 1)) / kFrameCount);
+    }
+
+    const double z = (means[1] - means[0]) / std::sqrt(standardErrors[0] * standardErrors[0] + standardErrors[1] * standardErrors[1]);
+    HIME_EXPECT_MSG(std::abs(z) < 4.0, "mean " + std::to_string(means[0]) + " direct, " + std::to_string(means[1]) + " with tiles, z = " + std::to_string(z));
+}
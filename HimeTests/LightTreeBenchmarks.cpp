@@ -0,0 +1,278 @@
+#include "HimeTest.h"
+#include "LightTreeTestScenes.h"
+#include "HimeUtils/HimeParallel.h"
+#include <algorithm>
+#include <random>
+
+using namespace Falcor;
+using namespace LightTreeTestScenes;
+
+namespace
+{
+    /** Synthetic emitter mesh in a unit cube, leaves are unsorted triangle centers.
+    */
+    struct EmitterMesh
+    {
+        std::string name;
+        std::vector<LightTreeNode> leaves;
+    };
+
+    /** Flat grid of two triangles per cell with stripes of emission, like a tessellated sign.
+    */
+    EmitterMesh createPanelMesh(uint2 dim)
+    {
+        EmitterMesh mesh = { "panel" };
+        for (uint y = 0; y < dim.y; y++)
+        {
+            for (uint x = 0; x < dim.x; x++)
+            {
+                float emission = (x / 32 + y / 32) % 3 == 0 ? 0.f : 1.f + float(x % 7);
+                for (uint t = 0; t < 2; t++)
+                {
+                    float3 uv = float3((x + (t ? 0.667f : 0.333f)) / dim.x, (y + (t ? 0.667f : 0.333f)) / dim.y, 0.5f);
+                    float3 center = float3(0.1f + 0.8f * uv.x, 0.1f + 0.8f * uv.y, uv.z);
+                    mesh.leaves.push_back(createLeaf((uint)mesh.leaves.size(), center, float3(emission / (2.f * dim.x * dim.y))));
+                }
+            }
+        }
+        return mesh;
+    }
+
+    /** Thin helix tube, most triangles are close to each other but far from shading points.
+    */
+    EmitterMesh createTubeMesh(uint segmentCount, uint sideCount)
+    {
+        EmitterMesh mesh = { "tube" };
+        const float kTwoPi = 2.f * glm::pi<float>();
+        for (uint i = 0; i < segmentCount; i++)
+        {
+            for (uint j = 0; j < sideCount * 2; j++)
+            {
+                float u = kTwoPi * 8.f * (i + 0.5f) / segmentCount;
+                float v = kTwoPi * (j / 2 + (j % 2 ? 0.667f : 0.333f)) / sideCount;
+                float3 axis = float3(0.5f + 0.3f * std::cos(u), (i + 0.5f) / segmentCount, 0.5f + 0.3f * std::sin(u));
+                float3 radial = float3(std::cos(u), 0.f, std::sin(u));
+                float3 center = axis + 0.01f * (radial * std::cos(v) + float3(0, 1, 0) * std::sin(v));
+                mesh.leaves.push_back(createLeaf((uint)mesh.leaves.size(), center, float3(1.f / (segmentCount * sideCount * 2))));
+            }
+        }
+        return mesh;
+    }
+}
+
+HIME_BENCHMARK(LightTreeConstruction)
+{
+    // Node traffic of the GPU passes is counted from their access pattern, GPU time of both is in the profiler (Construct Light Tree).
+    const uint maxLightCount = HimeTest::isQuickRun() ? 1 << 14 : 1 << 20;
+    const int repeatCount = HimeTest::isQuickRun() ? 1 : 3;
+    for (uint lightCount = 1 << 10; lightCount <= maxLightCount; lightCount <<= 2)
+    {
+        auto leaves = createLeaves(Layout::Uniform, lightCount, 1);
+        AABB sceneBound = computeCubicBound(leaves);
+        LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+
+        // Level batches read every node below a node in the source level and write the node. Bottom-up reads two children,
+        // writes the node and touches one ready counter twice.
+        LightTreeHelpers::LightTreeLayout layout = LightTreeHelpers::computeLayout(lightCount);
+        std::vector<LightTreeHelpers::ConstructionBatch> batches = LightTreeHelpers::computeConstructionBatches(layout.levelCount);
+        uint64_t batchNodeCount = 0;
+        for (const LightTreeHelpers::ConstructionBatch& batch : batches)
+        {
+            for (int level = batch.dstLevelStart; level <= batch.dstLevelEnd; level++)
+            {
+                batchNodeCount += (uint64_t)CompleteBinaryTreeHelpers::getCurrentLevelNodeCount(level) * ((1ull << (batch.srcLevel - level)) + 1);
+            }
+        }
+        const double batchTraffic = (double)batchNodeCount * sizeof(LightTreeNode) / (1 << 20);
+        const double bottomUpTraffic = (double)(layout.leafCount - 1) * (3 * sizeof(LightTreeNode) + 2 * sizeof(uint)) / (1 << 20);
+
+        double hostTime = 1e30;
+        for (int r = 0; r < repeatCount; r++)
+        {
+            HimeTest::Timer timer;
+            std::vector<LightTreeNode> lightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+            hostTime = std::min(hostTime, timer.elapsed());
+        }
+
+        std::printf("    %u leaves: level batches %zu dispatches, %.2f MB; bottom-up 1 dispatch, %.2f MB; host builder %.2f ms (%u threads)\n",
+            lightCount, batches.size(), batchTraffic, bottomUpTraffic, hostTime * 1e3, HimeParallelHelpers::getWorkerCount());
+    }
+}
+
+HIME_BENCHMARK(LeafClusterTraversal)
+{
+    // Emitter meshes of about a million triangles (quick run: 64K) clustered with 1 to 16 triangles per leaf. One sample per cut node,
+    // estimate of unshadowed irradiance is sum of contribution / pdf, error is against the sum over all triangles.
+    EmitterMesh meshes[2] = { HimeTest::isQuickRun() ? createPanelMesh(uint2(256, 128)) : createPanelMesh(uint2(1024, 512)),
+        HimeTest::isQuickRun() ? createTubeMesh(1024, 32) : createTubeMesh(4096, 128) };
+    const AABB sceneBound(float3(0.f), float3(1.f));
+    const uint kCutSize = 8;
+    const float kErrorLimit = 0.001f;
+    const uint kShadingPointCount = 128;
+    const uint kSampleCount = 16;
+    const float radius = sceneBound.radius();
+    const float minDistance2 = (kErrorLimit * radius) * (kErrorLimit * radius);
+    auto evalLight = [&](const LightTreeNode& light, const float3& posW, const float3& normal)
+    {
+        float3 d = (light.aabbMinPoint + light.aabbMaxPoint) * 0.5f - posW;
+        float dlen2 = dot(d, d);
+        float cosTheta = dlen2 > 0.f ? dot(normal, d) / std::sqrt(dlen2) : 0.f;
+        return cosTheta > 0.f ? length(light.intensity) * cosTheta / std::max(dlen2, minDistance2) : 0.f;
+    };
+
+    for (EmitterMesh& mesh : meshes)
+    {
+        for (auto& leaf : mesh.leaves) leaf.mortonCode = MortonCodeHelpers::computeMortonCodeByPos(leaf.aabbMinPoint, LightTreeHelpers::LightTreeMortonCode::kQuantLevels, sceneBound);
+        LightTreeHelpers::sortLeaves(mesh.leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+        std::vector<const LightTreeNode*> triangles(mesh.leaves.size());
+        for (const LightTreeNode& leaf : mesh.leaves) triangles[leaf.lightIdx] = &leaf;
+
+        // Shading points next to the mesh, with exact unshadowed irradiance of all triangles.
+        const std::vector<ShadingPoint> shadingPoints = createShadingPoints(mesh.leaves, sceneBound, kShadingPointCount, 1);
+        std::vector<double> references(kShadingPointCount, 0.0);
+        HimeParallelHelpers::parallelFor(0, kShadingPointCount, [&](size_t begin, size_t end, unsigned int)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                for (const LightTreeNode& leaf : mesh.leaves) references[i] += evalLight(leaf, shadingPoints[i].posW, shadingPoints[i].normal);
+            }
+        }, 1);
+
+        for (uint trianglesPerLeaf : { 1u, 2u, 4u, 8u, 16u })
+        {
+            HimeTest::Timer buildTimer;
+            LightTreeHelpers::ClusteredLeaves clusters = LightTreeHelpers::clusterLeaves(mesh.leaves, trianglesPerLeaf, sceneBound);
+            std::vector<LightTreeNode> lightTree = LightTreeHelpers::buildLightTree(clusters.leaves, sceneBound);
+            const double buildTime = buildTimer.elapsed();
+            LightTreeHelpers::LightTreeView view = LightTreeHelpers::LightTreeView::create(lightTree);
+
+            std::mt19937 rng(2);
+            std::uniform_real_distribution<float> unit(0.f, 1.f);
+            uint64_t depthSum = 0, sampleCount = 0;
+            double errorSum = 0.0;
+            HimeTest::Timer sampleTimer;
+            for (uint i = 0; i < kShadingPointCount; i++)
+            {
+                const ShadingPoint& shadingPoint = shadingPoints[i];
+                double estimate = 0.0;
+                for (uint s = 0; s < kSampleCount; s++)
+                {
+                    std::vector<uint> cut = LightTreeHelpers::findCut(view, shadingPoint.posW, shadingPoint.normal, kCutSize, kErrorLimit, radius);
+                    for (uint cutNode : cut)
+                    {
+                        uint nodeId = cutNode;
+                        float r = unit(rng), nodeProb = 1.f;
+                        uint startLevel = uintLog2(nodeId + 1);
+                        if (LightTreeHelpers::traverseLightTree(view, shadingPoint.posW, shadingPoint.normal, nodeId, r, nodeProb)) continue;
+                        depthSum += uintLog2(nodeId + 1) - startLevel;
+                        sampleCount++;
+
+                        uint lightIdx = LightTreeHelpers::sampleLeafTriangle(clusters, lightTree[nodeId].lightIdx, r, nodeProb);
+                        if (nodeProb > 0.f) estimate += evalLight(*triangles[lightIdx], shadingPoint.posW, shadingPoint.normal) / nodeProb;
+                    }
+                }
+                estimate /= kSampleCount;
+                if (references[i] > 0.0) errorSum += std::abs(estimate - references[i]) / references[i];
+            }
+            const double sampleTime = sampleTimer.elapsed();
+
+            std::printf("    %s of %zu triangles, %2u triangles per leaf: %u nodes, build %.2f ms, traversal depth %.2f, %.0f ns per sample, mean relative error %.3f (%u threads)\n",
+                mesh.name.c_str(), mesh.leaves.size(), trianglesPerLeaf, (uint)lightTree.size(), buildTime * 1e3, (double)depthSum / std::max<uint64_t>(sampleCount, 1),
+                sampleTime * 1e9 / std::max<uint64_t>(sampleCount, 1), errorSum / kShadingPointCount, HimeParallelHelpers::getWorkerCount());
+        }
+    }
+}
+
+HIME_BENCHMARK(LBVHMemory)
+{
+    // Complete binary tree stores nodes of 2 * nextPow2(lightCount) - 1, LBVH stores 2 * lightCount - 1 nodes and their child links.
+    const int repeatCount = HimeTest::isQuickRun() ? 1 : 3;
+    for (uint lightCount : { 1000u, 65536u, 65537u, 1048577u })
+    {
+        const size_t completeTreeSize = (size_t)LightTreeHelpers::computeLayout(lightCount).nodeCount * sizeof(LightTreeNode);
+        const size_t lbvhSize = (size_t)(2 * lightCount - 1) * (sizeof(LightTreeNode) + sizeof(uint2));
+        std::printf("    %u lights: complete binary tree %.2f MB, LBVH %.2f MB, saved %.1f%%", lightCount, completeTreeSize / double(1 << 20), lbvhSize / double(1 << 20),
+            100.0 * (1.0 - (double)lbvhSize / completeTreeSize));
+        if (HimeTest::isQuickRun() && lightCount > (1 << 16))
+        {
+            std::printf("\n");
+            continue;
+        }
+
+        auto leaves = createLeaves(Layout::Uniform, lightCount, 1);
+        AABB sceneBound = computeCubicBound(leaves);
+        LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+        double completeTreeTime = 1e30, lbvhTime = 1e30;
+        for (int r = 0; r < repeatCount; r++)
+        {
+            HimeTest::Timer completeTreeTimer;
+            std::vector<LightTreeNode> lightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+            completeTreeTime = std::min(completeTreeTime, completeTreeTimer.elapsed());
+            HimeTest::Timer lbvhTimer;
+            LightTreeHelpers::LBVH lbvh = LightTreeHelpers::buildLBVH(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+            lbvhTime = std::min(lbvhTime, lbvhTimer.elapsed());
+        }
+        std::printf(", host builders %.2f ms and %.2f ms (%u threads)\n", completeTreeTime * 1e3, lbvhTime * 1e3, HimeParallelHelpers::getWorkerCount());
+    }
+}
+
+HIME_BENCHMARK(CompactLightTreeBandwidth)
+{
+    // Compact tree is packed from the full tree after every build or refit and traversal reads only packed nodes. The full tree
+    // is kept for construction, refit and cache, so the compact tree is extra memory and only traversal bandwidth is saved.
+    const uint maxLightCount = HimeTest::isQuickRun() ? 1 << 15 : 1 << 20;
+    const uint shadingPointCount = HimeTest::isQuickRun() ? 256 : 4096;
+    const uint cutSize = 8;
+    const float errorLimit = 0.001f;
+    for (uint lightCount = 1 << 10; lightCount <= maxLightCount; lightCount <<= 5)
+    {
+        auto leaves = createLeaves(Layout::Clustered, lightCount, 1);
+        AABB sceneBound = computeCubicBound(leaves);
+        LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+        std::vector<LightTreeNode> lightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+        const float3 boundMin = sceneBound.minPoint;
+        const float3 boundExtent = sceneBound.extent();
+
+        std::vector<PackedLightTreeNode> packedLightTree(lightTree.size());
+        HimeTest::Timer packTimer;
+        HimeParallelHelpers::parallelFor(0, lightTree.size(), [&](size_t begin, size_t end, unsigned int)
+        {
+            for (size_t i = begin; i < end; i++) packedLightTree[i] = packLightTreeNode(lightTree[i], boundMin, boundExtent);
+        });
+        const double packTime = packTimer.elapsed();
+
+        // Traversal sees the unpacked tree: its bounds are looser, so cuts and traversal depth can change.
+        std::vector<LightTreeNode> unpackedLightTree(lightTree.size());
+        for (size_t i = 0; i < lightTree.size(); i++) unpackedLightTree[i] = unpackLightTreeNode(packedLightTree[i], boundMin, boundExtent);
+        const double areaRatio = LightTreeHelpers::computeSurfaceAreaSum(unpackedLightTree) / std::max(LightTreeHelpers::computeSurfaceAreaSum(lightTree), 1e-30);
+
+        // Each traversal step reads both children.
+        const auto shadingPoints = createShadingPoints(leaves, sceneBound, shadingPointCount, 2);
+        auto countSteps = [&](const std::vector<LightTreeNode>& nodes)
+        {
+            LightTreeHelpers::LightTreeView view = LightTreeHelpers::LightTreeView::create(nodes);
+            std::mt19937 rng(3);
+            std::uniform_real_distribution<float> unit(0.f, 1.f);
+            uint64_t stepCount = 0, sampleCount = 0;
+            for (const ShadingPoint& shadingPoint : shadingPoints)
+            {
+                for (uint cutNode : LightTreeHelpers::findCut(view, shadingPoint.posW, shadingPoint.normal, cutSize, errorLimit, sceneBound.radius()))
+                {
+                    uint nodeId = cutNode;
+                    float r = unit(rng), nodeProb = 1.f;
+                    uint startLevel = uintLog2(nodeId + 1);
+                    if (LightTreeHelpers::traverseLightTree(view, shadingPoint.posW, shadingPoint.normal, nodeId, r, nodeProb)) continue;
+                    stepCount += uintLog2(nodeId + 1) - startLevel;
+                    sampleCount++;
+                }
+            }
+            return (double)stepCount / std::max<uint64_t>(sampleCount, 1);
+        };
+        const double fullSteps = countSteps(lightTree);
+        const double compactSteps = countSteps(unpackedLightTree);
+
+        std::printf("    %u lights: full tree %.2f MB, compact tree %.2f MB extra, packed in %.2f ms (%u threads), surface area %.3fx, traversal reads %.0f bytes per sample (full) vs %.0f (compact)\n",
+            lightCount, lightTree.size() * sizeof(LightTreeNode) / double(1 << 20), packedLightTree.size() * sizeof(PackedLightTreeNode) / double(1 << 20), packTime * 1e3,
+            HimeParallelHelpers::getWorkerCount(), areaRatio, fullSteps * 2 * sizeof(LightTreeNode), compactSteps * 2 * sizeof(PackedLightTreeNode));
+    }
+}
@@ -0,0 +1,219 @@
+#include "HimeTest.h"
+#include "LightTreeTestScenes.h"
+#include "RealtimeStochasticLightcuts/LightTreeCache.h"
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+using namespace Falcor;
+using namespace LightTreeTestScenes;
+
+namespace
+{
+    /** Empty directory in the temp directory, removed with its files when destroyed.
+    */
+    struct TempDirectory
+    {
+        std::string path;
+
+        explicit TempDirectory(const char* name)
+        {
+            path = (std::filesystem::temp_directory_path() / name).string();
+            std::error_code error;
+            std::filesystem::remove_all(path, error);
+        }
+
+        ~TempDirectory()
+        {
+            std::error_code error;
+            std::filesystem::remove_all(path, error);
+        }
+    };
+
+    struct CachedLightTree
+    {
+        LightTreeCache::Key key;
+        std::vector<LightTreeNode> nodes;
+    };
+
+    CachedLightTree createCachedLightTree(uint lightCount, uint seed)
+    {
+        auto leaves = createLeaves(Layout::Clustered, lightCount, seed);
+        AABB sceneBound = computeCubicBound(leaves);
+        LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+
+        CachedLightTree lightTree;
+        lightTree.nodes = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+        lightTree.key.emissiveHash = 0x0123456789ABCDEFull + seed;
+        lightTree.key.quantLevels = LightTreeHelpers::LightTreeMortonCode::kQuantLevels;
+        lightTree.key.lightCount = lightCount;
+        lightTree.key.nodeCount = (uint32_t)lightTree.nodes.size();
+        lightTree.key.boundMin = sceneBound.minPoint;
+        lightTree.key.boundMax = sceneBound.maxPoint;
+        return lightTree;
+    }
+
+    /** Overwrite bytes of a file in place.
+    */
+    void patchFile(const std::string& path, size_t offset, const void* pData, size_t size)
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp((std::streamoff)offset);
+        file.write(static_cast<const char*>(pData), (std::streamsize)size);
+    }
+}
+
+HIME_TEST(LightTreeCacheRoundTrip)
+{
+    TempDirectory directory("HimeTestsLightTreeCacheRoundTrip");
+    CachedLightTree lightTree = createCachedLightTree(3000, 1);
+    HIME_EXPECT(LightTreeCache::MappedLightTree::open(directory.path, lightTree.key) == nullptr);
+
+    // Directory is created by save(), and no temporary file is left.
+    HIME_EXPECT(LightTreeCache::save(directory.path, lightTree.key, lightTree.nodes.data()));
+    size_t fileCount = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(directory.path)) fileCount += entry.path().extension() == ".lighttree" ? 1 : 100;
+    HIME_EXPECT(fileCount == 1);
+
+    auto pMapped = LightTreeCache::MappedLightTree::open(directory.path, lightTree.key);
+    HIME_EXPECT(pMapped != nullptr);
+    if (pMapped == nullptr) return;
+    HIME_EXPECT(pMapped->getHeader().version == LightTreeCache::kVersion);
+    HIME_EXPECT(pMapped->getNodeCount() == lightTree.nodes.size());
+    HIME_EXPECT(memcmp(pMapped->getNodes(), lightTree.nodes.data(), lightTree.nodes.size() * sizeof(LightTreeNode)) == 0);
+
+    // Saving again replaces the file while the old one is still mapped.
+    HIME_EXPECT(LightTreeCache::save(directory.path, lightTree.key, lightTree.nodes.data()));
+}
+
+HIME_TEST(LightTreeCacheRejectsMismatchedFiles)
+{
+    TempDirectory directory("HimeTestsLightTreeCacheMismatch");
+    CachedLightTree lightTree = createCachedLightTree(1000, 2);
+    const std::string path = LightTreeCache::getFilePath(directory.path, lightTree.key);
+
+    // Every key field is part of the file name.
+    HIME_EXPECT(LightTreeCache::save(directory.path, lightTree.key, lightTree.nodes.data()));
+    for (int field = 0; field < 4; field++)
+    {
+        LightTreeCache::Key otherKey = lightTree.key;
+        if (field == 0) otherKey.emissiveHash++;
+        if (field == 1) otherKey.leafOrder++;
+        if (field == 2) otherKey.isBottomUp = 1;
+        if (field == 3) otherKey.boundMax.x += 1.f;
+        HIME_EXPECT(LightTreeCache::getFilePath(directory.path, otherKey) != path);
+        HIME_EXPECT(LightTreeCache::MappedLightTree::open(directory.path, otherKey) == nullptr);
+    }
+
+    // File of another key at this path (file name hash collision).
+    {
+        LightTreeCache::Key otherKey = lightTree.key;
+        otherKey.emissiveHash++;
+        HIME_EXPECT(LightTreeCache::save(directory.path, otherKey, lightTree.nodes.data()));
+        std::filesystem::rename(LightTreeCache::getFilePath(directory.path, otherKey), path);
+        HIME_EXPECT(LightTreeCache::MappedLightTree::open(directory.path, lightTree.key) == nullptr);
+    }
+
+    // Other version.
+    {
+        HIME_EXPECT(LightTreeCache::save(directory.path, lightTree.key, lightTree.nodes.data()));
+        const uint32_t version = LightTreeCache::kVersion + 1;
+        patchFile(path, offsetof(LightTreeCache::Header, version), &version, sizeof(version));
+        HIME_EXPECT(LightTreeCache::MappedLightTree::open(directory.path, lightTree.key) == nullptr);
+    }
+
+    // Truncated file.
+    {
+        HIME_EXPECT(LightTreeCache::save(directory.path, lightTree.key, lightTree.nodes.data()));
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) - sizeof(LightTreeNode));
+        HIME_EXPECT(LightTreeCache::MappedLightTree::open(directory.path, lightTree.key) == nullptr);
+        std::filesystem::resize_file(path, sizeof(LightTreeCache::Header) / 2);
+        HIME_EXPECT(LightTreeCache::MappedLightTree::open(directory.path, lightTree.key) == nullptr);
+    }
+
+    // Empty file can't be mapped.
+    {
+        std::filesystem::resize_file(path, 0);
+        HIME_EXPECT(HimeMappedFile::open(path) == nullptr);
+    }
+}
+
+HIME_TEST(EmissiveFingerprintAVX2MatchesScalar)
+{
+    std::mt19937 rng(3);
+    std::vector<uint32_t> words(LightTreeCache::EmissiveFingerprint::kChunkTriangleCount * LightTreeCache::EmissiveFingerprint::kWordsPerTriangle);
+    for (auto& word : words) word = rng();
+
+    for (size_t count : { (size_t)0, (size_t)8, (size_t)56, (size_t)1000, words.size() })
+    {
+        const uint64_t scalarHash = LightTreeCache::EmissiveFingerprint::hashWordsScalar(words.data(), count);
+        HIME_EXPECT(LightTreeCache::EmissiveFingerprint::hashWords(words.data(), count) == scalarHash);
+#if HIME_CPU_X64
+        if (HimeCpuHelpers::hasAVX2()) HIME_EXPECT_MSG(LightTreeCache::EmissiveFingerprint::hashWordsAVX2(words.data(), count) == scalarHash, std::to_string(count) + " words");
+#endif
+    }
+#if HIME_CPU_X64
+    if (!HimeCpuHelpers::hasAVX2()) std::printf("    AVX2 is not supported, only scalar path tested\n");
+#endif
+
+    // Every word is hashed.
+    const uint64_t hash = LightTreeCache::EmissiveFingerprint::hashWords(words.data(), words.size());
+    words[words.size() - 1] ^= 1;
+    HIME_EXPECT(LightTreeCache::EmissiveFingerprint::hashWords(words.data(), words.size()) != hash);
+}
+
+HIME_TEST(EmissiveFingerprintIsIncremental)
+{
+    using Fingerprint = LightTreeCache::EmissiveFingerprint;
+    const size_t triangleCount = 10 * Fingerprint::kChunkTriangleCount + 300;
+    std::vector<uint32_t> triangleWords(triangleCount * Fingerprint::kWordsPerTriangle);
+    std::mt19937 rng(4);
+    for (auto& word : triangleWords) word = rng();
+
+    std::vector<uint8_t> isPacked(triangleCount, 0);
+    auto packTriangle = [&](size_t triangleIdx, uint32_t* pWords)
+    {
+        isPacked[triangleIdx] = 1;
+        memcpy(pWords, triangleWords.data() + triangleIdx * Fingerprint::kWordsPerTriangle, Fingerprint::kWordsPerTriangle * sizeof(uint32_t));
+    };
+    auto countPacked = [&]()
+    {
+        size_t count = 0;
+        for (uint8_t& packed : isPacked)
+        {
+            count += packed;
+            packed = 0;
+        }
+        return count;
+    };
+
+    Fingerprint fingerprint;
+    const uint64_t initialHash = fingerprint.update(triangleCount, packTriangle);
+    HIME_EXPECT(countPacked() == triangleCount);
+    HIME_EXPECT(fingerprint.getChunkCount() == 11 && fingerprint.getHashedChunkCount() == 11 && fingerprint.getChangedChunkCount() == 11);
+
+    // Change triangles in chunks 2 and 10 (the partial last chunk), only those chunks are packed and hashed.
+    const size_t changedTriangles[] = { 2 * Fingerprint::kChunkTriangleCount + 5, triangleCount - 1 };
+    for (size_t triangleIdx : changedTriangles) triangleWords[triangleIdx * Fingerprint::kWordsPerTriangle + 3] ^= 0x100;
+    const std::vector<Fingerprint::TriangleRange> dirtyRanges = { { changedTriangles[1], changedTriangles[1] + 1 }, { changedTriangles[0] - 2, changedTriangles[0] + 1 } };
+    const uint64_t incrementalHash = fingerprint.update(triangleCount, dirtyRanges, packTriangle);
+    HIME_EXPECT(countPacked() == Fingerprint::kChunkTriangleCount + 300);
+    HIME_EXPECT(fingerprint.getHashedChunkCount() == 2 && fingerprint.getChangedChunkCount() == 2);
+    HIME_EXPECT(incrementalHash != initialHash);
+
+    // Same fingerprint as hashing everything again.
+    Fingerprint fullFingerprint;
+    HIME_EXPECT(fullFingerprint.update(triangleCount, packTriangle) == incrementalHash);
+    countPacked();
+
+    // Dirty range without changed data, chunk is hashed but unchanged.
+    HIME_EXPECT(fingerprint.update(triangleCount, { { 0, 1 } }, packTriangle) == incrementalHash);
+    HIME_EXPECT(fingerprint.getHashedChunkCount() == 1 && fingerprint.getChangedChunkCount() == 0);
+
+    // Triangle count changed, all chunks are hashed whatever the dirty ranges are.
+    countPacked();
+    fingerprint.update(triangleCount - 300, { { 0, 1 } }, packTriangle);
+    HIME_EXPECT(countPacked() == triangleCount - 300);
+    HIME_EXPECT(fingerprint.getChunkCount() == 10 && fingerprint.getHashedChunkCount() == 10 && fingerprint.getChangedChunkCount() == 10);
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "RealtimeStochasticLightcuts/LightTreeHelpers.h"
+#include "HimeUtils/HimeMortonCode.h"
+#include <cmath>
+#include <random>
+
+/** Synthetic emissive triangles for light tree tests, stored as unsorted leaves like gSortingHelper
+    written by GenerateLightTreeLeaves.cs.slang (aabb is the triangle center, intensity is emission times area).
+*/
+namespace LightTreeTestScenes
+{
+    using namespace Falcor;
+
+    enum class Layout
+    {
+        Uniform,   ///< Lights spread uniformly in a unit cube.
+        Clustered, ///< Dense blobs of lights, like lamps made of many small triangles.
+        Panels,    ///< Lights on a few thin axis aligned panels, like area lights of a room.
+    };
+
+    /** Cubic bound of leaves, same as RealtimeStochasticLightcuts::sceneBoundHelper() on the scene bound.
+    */
+    inline AABB computeCubicBound(const std::vector<LightTreeNode>& leaves)
+    {
+        AABB bound;
+        for (const auto& leaf : leaves) bound.include(leaf.aabbMinPoint).include(leaf.aabbMaxPoint);
+        float3 extent = bound.extent();
+        float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+        bound.maxPoint = bound.minPoint + float3(maxExtent);
+        return bound;
+    }
+
+    inline LightTreeNode createLeaf(uint lightIdx, const float3& center, const float3& intensity)
+    {
+        LightTreeNode leaf;
+        leaf.id = 0;
+        leaf.lightIdx = lightIdx;
+        leaf.intensity = intensity;
+        leaf.aabbMinPoint = center;
+        leaf.aabbMaxPoint = center;
+        return leaf;
+    }
+
+    /** Leaves of lightCount lights, morton codes are computed with the cubic bound of all leaves.
+    */
+    inline std::vector<LightTreeNode> createLeaves(Layout layout, uint lightCount, uint seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::normal_distribution<float> normal(0.f, 1.f);
+
+        std::vector<float3> clusterCenters(64);
+        for (auto& center : clusterCenters) center = float3(unit(rng), unit(rng), unit(rng));
+
+        std::vector<LightTreeNode> leaves(lightCount);
+        for (uint i = 0; i < lightCount; i++)
+        {
+            float3 center;
+            switch (layout)
+            {
+            case Layout::Clustered:
+                center = clusterCenters[rng() % clusterCenters.size()] + float3(normal(rng), normal(rng), normal(rng)) * 0.01f;
+                break;
+            case Layout::Panels:
+            {
+                uint panel = rng() % 6;
+                float u = unit(rng), v = unit(rng), w = 0.05f + 0.9f * float(panel / 3) + unit(rng) * 1e-3f;
+                center = panel % 3 == 0 ? float3(w, u, v) : (panel % 3 == 1 ? float3(u, w, v) : float3(u, v, w));
+                break;
+            }
+            case Layout::Uniform:
+            default:
+                center = float3(unit(rng), unit(rng), unit(rng));
+                break;
+            }
+            float3 intensity = float3(unit(rng), unit(rng), unit(rng)) * (0.1f + 10.f * unit(rng) * unit(rng));
+            leaves[i] = createLeaf(i, center, intensity);
+        }
+
+        AABB sceneBound = computeCubicBound(leaves);
+        for (auto& leaf : leaves) leaf.mortonCode = MortonCodeHelpers::computeMortonCodeByPos(leaf.aabbMinPoint, LightTreeHelpers::LightTreeMortonCode::kQuantLevels, sceneBound);
+        return leaves;
+    }
+
+    struct ShadingPoint
+    {
+        float3 posW;
+        float3 normal;
+    };
+
+    /** Shading points next to random lights (within 5% of scene extent) with random normals.
+    */
+    inline std::vector<ShadingPoint> createShadingPoints(const std::vector<LightTreeNode>& leaves, const AABB& sceneBound, uint count, uint seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::vector<ShadingPoint> shadingPoints(count);
+        for (auto& shadingPoint : shadingPoints)
+        {
+            const LightTreeNode& leaf = leaves[rng() % leaves.size()];
+            float3 offset = (float3(unit(rng), unit(rng), unit(rng)) - 0.5f) * sceneBound.extent() * 0.1f;
+            shadingPoint.posW = (leaf.aabbMinPoint + leaf.aabbMaxPoint) * 0.5f + offset;
+            shadingPoint.normal = normalize(float3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f));
+        }
+        return shadingPoints;
+    }
+
+    enum class GBufferLayout
+    {
+        Random,  ///< Points in scene bound with random normals, neighbor pixels are unrelated.
+        Surface, ///< Height field across scene bound, neighbor pixels have close positions and normals as in a rendered G-buffer.
+    };
+
+    /** Shading points of a width x height G-buffer, every 16th pixel is background (zero normal).
+    */
+    struct GBuffer
+    {
+        uint2 dim;
+        std::vector<float3> positions;
+        std::vector<float3> normals;
+    };
+
+    inline GBuffer createGBuffer(GBufferLayout layout, const AABB& sceneBound, uint2 dim, uint seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        const float3 extent = sceneBound.extent();
+        const float kFrequency = 4.f * glm::pi<float>();
+        const size_t pixelCount = (size_t)dim.x * dim.y;
+
+        GBuffer gBuffer;
+        gBuffer.dim = dim;
+        gBuffer.positions.resize(pixelCount);
+        gBuffer.normals.resize(pixelCount);
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            if (layout == GBufferLayout::Random)
+            {
+                gBuffer.positions[i] = sceneBound.minPoint + float3(unit(rng), unit(rng), unit(rng)) * extent;
+                gBuffer.normals[i] = normalize(float3(unit(rng), unit(rng), unit(rng)) - 0.5f);
+            }
+            else
+            {
+                // Height h(u, v) = 0.5 + 0.1 * sin(4 pi u) * cos(4 pi v) in scene bound.
+                float u = ((float)(i % dim.x) + 0.5f) / dim.x;
+                float v = ((float)(i / dim.x) + 0.5f) / dim.y;
+                float h = 0.5f + 0.1f * std::sin(kFrequency * u) * std::cos(kFrequency * v);
+                float dhdu = 0.1f * kFrequency * std::cos(kFrequency * u) * std::cos(kFrequency * v);
+                float dhdv = -0.1f * kFrequency * std::sin(kFrequency * u) * std::sin(kFrequency * v);
+                gBuffer.positions[i] = sceneBound.minPoint + float3(u, h, v) * extent;
+                gBuffer.normals[i] = normalize(float3(-dhdu * extent.y / extent.x, 1.f, -dhdv * extent.y / extent.z));
+            }
+            if (i % 16 == 0) gBuffer.normals[i] = float3(0);
+        }
+        return gBuffer;
+    }
+
+    inline const char* getGBufferLayoutName(GBufferLayout layout)
+    {
+        return layout == GBufferLayout::Random ? "random G-buffer" : "surface G-buffer";
+    }
+
+    inline const char* getLayoutName(Layout layout)
+    {
+        switch (layout)
+        {
+        case Layout::Clustered: return "clustered";
+        case Layout::Panels: return "panels";
+        default: return "uniform";
+        }
+    }
+}
@@ -0,0 +1,360 @@
+#include "HimeTest.h"
+#include "LightTreeTestScenes.h"
+#include <algorithm>
+#include <map>
+
+using namespace Falcor;
+using namespace LightTreeTestScenes;
+
+namespace
+{
+    double computeSurfaceAreaSum(std::vector<LightTreeNode> leaves, LightTreeHelpers::LeafOrder order, const AABB& sceneBound, bool isSorted = true)
+    {
+        if (isSorted) LightTreeHelpers::sortLeaves(leaves, order, sceneBound);
+        return LightTreeHelpers::computeSurfaceAreaSum(LightTreeHelpers::buildLightTree(leaves, sceneBound));
+    }
+}
+
+HIME_TEST(HilbertOrderReducesSurfaceArea)
+{
+    for (Layout layout : { Layout::Uniform, Layout::Clustered, Layout::Panels })
+    {
+        auto leaves = createLeaves(layout, 1 << 16, 1);
+        AABB sceneBound = computeCubicBound(leaves);
+        double unsortedArea = computeSurfaceAreaSum(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound, false);
+        double mortonArea = computeSurfaceAreaSum(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+        double hilbertArea = computeSurfaceAreaSum(leaves, LightTreeHelpers::LeafOrder::Hilbert, sceneBound);
+        std::printf("    %s: morton %.4g, hilbert %.4g (%.3fx), unsorted %.4g\n", getLayoutName(layout), mortonArea, hilbertArea, hilbertArea / mortonArea, unsortedArea);
+
+        // Measured 0.56x to 0.70x on these layouts, and both orders are about 100x tighter than unsorted leaves.
+        HIME_EXPECT(hilbertArea < 0.8 * mortonArea);
+        HIME_EXPECT(mortonArea < 0.02 * unsortedArea);
+    }
+}
+
+HIME_TEST(RefitMatchesRebuild)
+{
+    for (Layout layout : { Layout::Uniform, Layout::Clustered, Layout::Panels })
+    {
+        auto leaves = createLeaves(layout, 50000, 2);
+        AABB sceneBound = computeCubicBound(leaves);
+        LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+        std::vector<LightTreeNode> refittedLightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+
+        // Move and brighten about 1% of lights.
+        const uint kStride = 97;
+        const float3 offset = sceneBound.extent() * 0.01f;
+        const uint leafOffset = CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(LightTreeHelpers::computeLayout((uint)leaves.size()).levelCount - 1);
+        std::vector<uint> dirtyNodes;
+        for (uint i = 0; i < leaves.size(); i += kStride)
+        {
+            leaves[i].intensity *= 2.f;
+            leaves[i].aabbMinPoint += offset;
+            leaves[i].aabbMaxPoint += offset;
+            refittedLightTree[leafOffset + i] = leaves[i];
+            dirtyNodes.push_back(leafOffset + i);
+        }
+
+        // Refit and bottom-up construction merge nodes pairwise in the same order, so nodes are bit identical.
+        LightTreeHelpers::refitLightTree(refittedLightTree, dirtyNodes, sceneBound);
+        std::vector<LightTreeNode> rebuiltLightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+        HIME_EXPECT_MSG(memcmp(refittedLightTree.data(), rebuiltLightTree.data(), rebuiltLightTree.size() * sizeof(LightTreeNode)) == 0, getLayoutName(layout));
+    }
+}
+
+HIME_TEST(LevelBatchConstructionMatchesBottomUp)
+{
+    for (uint levelCount : { 2u, 5u, 12u, 21u })
+    {
+        // Every internal level is written by exactly one batch, batches go from leaf level up.
+        int srcLevel = (int)levelCount - 1;
+        for (const LightTreeHelpers::ConstructionBatch& batch : LightTreeHelpers::computeConstructionBatches(levelCount))
+        {
+            HIME_EXPECT(batch.srcLevel == srcLevel && batch.dstLevelEnd == srcLevel - 1 && batch.dstLevelStart <= batch.dstLevelEnd);
+            int workLoad = 0;
+            for (int level = batch.dstLevelStart; level <= batch.dstLevelEnd; level++) workLoad += CompleteBinaryTreeHelpers::getCurrentLevelNodeCount(level);
+            HIME_EXPECT(batch.workLoad == workLoad);
+            srcLevel = batch.dstLevelStart;
+        }
+        HIME_EXPECT(srcLevel == 0);
+    }
+
+    for (Layout layout : { Layout::Uniform, Layout::Clustered, Layout::Panels })
+    {
+        for (LightTreeHelpers::LeafOrder order : { LightTreeHelpers::LeafOrder::Morton, LightTreeHelpers::LeafOrder::Hilbert })
+        {
+            // Not a power of two, so both modes see bogus leaves.
+            auto leaves = createLeaves(layout, 50000, 5);
+            AABB sceneBound = computeCubicBound(leaves);
+            LightTreeHelpers::sortLeaves(leaves, order, sceneBound);
+            std::vector<LightTreeNode> bottomUpLightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+            std::vector<LightTreeNode> batchLightTree = LightTreeHelpers::buildLightTreeByLevelBatches(leaves, sceneBound);
+            HIME_EXPECT(batchLightTree.size() == bottomUpLightTree.size());
+
+            // Only debug data (child range or source range) and intensity rounding differ between the modes.
+            const uint leafOffset = CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(LightTreeHelpers::computeLayout((uint)leaves.size()).levelCount - 1);
+            uint mismatchCount = 0;
+            float maxRelativeError = 0.f;
+            for (uint nodeIdx = 0; nodeIdx < leafOffset; nodeIdx++)
+            {
+                const LightTreeNode& a = bottomUpLightTree[nodeIdx];
+                const LightTreeNode& b = batchLightTree[nodeIdx];
+                if (a.id != b.id || a.lightIdx != b.lightIdx || a.mortonCode != b.mortonCode || a.aabbMinPoint != b.aabbMinPoint || a.aabbMaxPoint != b.aabbMaxPoint) mismatchCount++;
+                for (int c = 0; c < 3; c++)
+                {
+                    if (a.intensity[c] > 0.f) maxRelativeError = std::max(maxRelativeError, std::abs(a.intensity[c] - b.intensity[c]) / a.intensity[c]);
+                }
+
+                const uint nodeLevel = uintLog2(nodeIdx + 1);
+                if (a.paddingAndDebug != float4(float(CompleteBinaryTreeHelpers::getLeftChild(nodeIdx)), float(CompleteBinaryTreeHelpers::getRightChild(nodeIdx) + 1), 0.f, 0.f)) mismatchCount++;
+                const uint start = (uint)b.paddingAndDebug.x, end = (uint)b.paddingAndDebug.y;
+                const uint srcLevel = uintLog2(start + 1);
+                if (srcLevel <= nodeLevel || end - start != (1u << (srcLevel - nodeLevel)) || ((start + 1) >> (srcLevel - nodeLevel)) - 1 != nodeIdx) mismatchCount++;
+            }
+            const std::string name = std::string(getLayoutName(layout)) + (order == LightTreeHelpers::LeafOrder::Hilbert ? " hilbert" : " morton");
+            HIME_EXPECT_MSG(mismatchCount == 0, name + ": " + std::to_string(mismatchCount) + " mismatched nodes");
+            HIME_EXPECT_MSG(maxRelativeError < 1e-4f, name + ": relative intensity error " + std::to_string(maxRelativeError));
+        }
+    }
+}
+
+HIME_TEST(LeafOrderViolationsCountedOnce)
+{
+    const auto order = LightTreeHelpers::LeafOrder::Morton;
+    auto leaves = createLeaves(Layout::Uniform, 3000, 3);
+    AABB sceneBound = computeCubicBound(leaves);
+    LightTreeHelpers::sortLeaves(leaves, order, sceneBound);
+    std::vector<LightTreeNode> lightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+    std::vector<uint> orderFlags(leaves.size(), 0);
+
+    const uint leafOffset = CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(LightTreeHelpers::computeLayout((uint)leaves.size()).levelCount - 1);
+    auto countViolatedPairs = [&]()
+    {
+        int count = 0;
+        for (uint i = 0; i + 1 < leaves.size(); i++)
+        {
+            if (LightTreeHelpers::computeLeafSortKey(lightTree[leafOffset + i], order, sceneBound) > LightTreeHelpers::computeLeafSortKey(lightTree[leafOffset + i + 1], order, sceneBound)) count++;
+        }
+        return count;
+    };
+
+    // Move one leaf across leaf order in several refits, only its two pairs can be out of order.
+    const uint movedLeaf = 1000;
+    const LightTreeNode originalLeaf = lightTree[leafOffset + movedLeaf];
+    const std::vector<uint> dirtyNodes = { leafOffset + movedLeaf };
+    int violationCount = 0;
+    for (uint target : { 2000u, 2500u, 100u, 2999u })
+    {
+        lightTree[leafOffset + movedLeaf].aabbMinPoint = leaves[target].aabbMinPoint;
+        lightTree[leafOffset + movedLeaf].aabbMaxPoint = leaves[target].aabbMaxPoint;
+        violationCount += LightTreeHelpers::updateLeafOrderFlags(lightTree, dirtyNodes, order, sceneBound, orderFlags);
+        HIME_EXPECT(violationCount == countViolatedPairs());
+        HIME_EXPECT(violationCount >= 1 && violationCount <= 2);
+    }
+
+    // Back in order, pairs are subtracted again.
+    lightTree[leafOffset + movedLeaf] = originalLeaf;
+    violationCount += LightTreeHelpers::updateLeafOrderFlags(lightTree, dirtyNodes, order, sceneBound, orderFlags);
+    HIME_EXPECT(violationCount == 0);
+}
+
+HIME_TEST(PackedBoundsRoundOutward)
+{
+    // Odd bound, so decoded positions rarely land on exact floats.
+    const float boundMin = -3.17f, boundExtent = 11.3f;
+    const float step = boundExtent / float(kLightTreeBoundQuantMax);
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    std::vector<float> positions = { boundMin, boundMin + boundExtent, std::nextafter(boundMin + boundExtent, boundMin), std::nextafter(boundMin, boundMin + boundExtent) };
+    for (uint i = 0; i < 100000; i++) positions.push_back(boundMin + unit(rng) * boundExtent);
+    for (uint q : { 1u, 2u, 1000u, kLightTreeBoundQuantMax - 1 })
+    {
+        float pos = dequantizeLightTreeBound(q, boundMin, boundExtent);
+        positions.insert(positions.end(), { pos, std::nextafter(pos, boundMin), std::nextafter(pos, boundMin + boundExtent) });
+    }
+
+    uint failedCount = 0;
+    for (float pos : positions)
+    {
+        float minPos = dequantizeLightTreeBound(quantizeLightTreeBound(pos, boundMin, boundExtent, false), boundMin, boundExtent);
+        float maxPos = dequantizeLightTreeBound(quantizeLightTreeBound(pos, boundMin, boundExtent, true), boundMin, boundExtent);
+        // Outward and at most one step (plus rounding) away.
+        if (!(minPos <= pos && pos - minPos <= step * 1.01f)) failedCount++;
+        if (!(maxPos >= pos && maxPos - pos <= step * 1.01f)) failedCount++;
+    }
+    HIME_EXPECT_MSG(failedCount == 0, std::to_string(failedCount) + " positions rounded inward");
+
+    // Out of bound positions clamp to the bound.
+    HIME_EXPECT(quantizeLightTreeBound(boundMin - 1.f, boundMin, boundExtent, false) == 0);
+    HIME_EXPECT(quantizeLightTreeBound(boundMin + boundExtent + 1.f, boundMin, boundExtent, true) == kLightTreeBoundQuantMax);
+}
+
+HIME_TEST(ClusteredLeavesPartitionTriangles)
+{
+    for (Layout layout : { Layout::Uniform, Layout::Clustered, Layout::Panels })
+    {
+        // Odd triangle count so the last leaf is partial, and a run of dark triangles so some leaves fall back to a uniform cdf.
+        auto leaves = createLeaves(layout, 10001, 5);
+        for (uint i = 4000; i < 4040; i++) leaves[i].intensity = float3(0.f);
+        AABB sceneBound = computeCubicBound(leaves);
+        LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+
+        for (uint trianglesPerLeaf : { 1u, 3u, 8u, 16u })
+        {
+            const std::string config = std::string(getLayoutName(layout)) + ", " + std::to_string(trianglesPerLeaf) + " triangles per leaf";
+            LightTreeHelpers::ClusteredLeaves clusters = LightTreeHelpers::clusterLeaves(leaves, trianglesPerLeaf, sceneBound);
+            HIME_EXPECT_MSG(clusters.leaves.size() == (leaves.size() + trianglesPerLeaf - 1) / trianglesPerLeaf, config);
+            HIME_EXPECT_MSG(clusters.triangles.size() == leaves.size() && clusters.triangleCdf.size() == leaves.size(), config);
+
+            std::vector<const LightTreeNode*> triangles(leaves.size(), nullptr);
+            for (const LightTreeNode& leaf : leaves) triangles[leaf.lightIdx] = &leaf;
+
+            std::vector<uint> hits(leaves.size(), 0);
+            uint badIntensityCount = 0, badBoundCount = 0, badCdfCount = 0;
+            for (uint leafIdx = 0; leafIdx < clusters.leaves.size(); leafIdx++)
+            {
+                const LightTreeNode& node = clusters.leaves[leafIdx];
+                const uint first = leafIdx * clusters.trianglesPerLeaf;
+                const uint count = clusters.getTriangleCount(leafIdx);
+                if (node.lightIdx != leafIdx) badIntensityCount++;
+
+                float3 intensitySum = float3(0.f);
+                float prevCdf = 0.f;
+                for (uint t = 0; t < count; t++)
+                {
+                    const LightTreeNode& triangle = *triangles[clusters.triangles[first + t]];
+                    hits[triangle.lightIdx]++;
+                    intensitySum += triangle.intensity;
+                    bool isInside = triangle.aabbMinPoint.x >= node.aabbMinPoint.x && triangle.aabbMinPoint.y >= node.aabbMinPoint.y && triangle.aabbMinPoint.z >= node.aabbMinPoint.z
+                        && triangle.aabbMaxPoint.x <= node.aabbMaxPoint.x && triangle.aabbMaxPoint.y <= node.aabbMaxPoint.y && triangle.aabbMaxPoint.z <= node.aabbMaxPoint.z;
+                    if (!isInside) badBoundCount++;
+
+                    float cdf = clusters.triangleCdf[first + t];
+                    if (cdf < prevCdf || cdf > 1.f) badCdfCount++;
+                    prevCdf = cdf;
+                }
+                if (prevCdf != 1.f) badCdfCount++;
+
+                // Leaf intensity is its triangles summed in order.
+                if (length(node.intensity - intensitySum) > 1e-5f * length(intensitySum)) badIntensityCount++;
+            }
+
+            uint missedCount = 0;
+            for (uint h : hits) missedCount += h == 1 ? 0 : 1;
+            HIME_EXPECT_MSG(missedCount == 0, config + ": " + std::to_string(missedCount) + " triangles not in exactly one leaf");
+            HIME_EXPECT_MSG(badIntensityCount == 0, config + ": " + std::to_string(badIntensityCount) + " leaves with wrong intensity or index");
+            HIME_EXPECT_MSG(badBoundCount == 0, config + ": " + std::to_string(badBoundCount) + " triangles outside their leaf");
+            HIME_EXPECT_MSG(badCdfCount == 0, config + ": " + std::to_string(badCdfCount) + " cdf entries not monotonic or not ending at 1");
+        }
+    }
+}
+
+HIME_TEST(LeafTriangleSamplingFollowsIntensity)
+{
+    auto leaves = createLeaves(Layout::Clustered, 4096, 6);
+    for (uint i = 0; i < 16; i++) leaves[i].intensity = float3(0.f);
+    AABB sceneBound = computeCubicBound(leaves);
+    LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+    std::vector<float> triangleIntensities(leaves.size());
+    for (const LightTreeNode& leaf : leaves) triangleIntensities[leaf.lightIdx] = length(leaf.intensity);
+
+    const uint kTrianglesPerLeaf = 8;
+    const uint kSampleCount = 20000;
+    LightTreeHelpers::ClusteredLeaves clusters = LightTreeHelpers::clusterLeaves(leaves, kTrianglesPerLeaf, sceneBound);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    // Triangle probability is its intensity over the summed intensity of its leaf (uniform in a dark leaf), and is multiplied into nodeProb.
+    uint badProbCount = 0, badRandomCount = 0;
+    double maxZ = 0.0;
+    for (uint leafIdx = 0; leafIdx < clusters.leaves.size(); leafIdx += 37)
+    {
+        const uint first = leafIdx * kTrianglesPerLeaf;
+        const uint count = clusters.getTriangleCount(leafIdx);
+        double leafIntensity = 0.0;
+        for (uint t = 0; t < count; t++) leafIntensity += triangleIntensities[clusters.triangles[first + t]];
+
+        std::map<uint, uint> sampleCounts;
+        for (uint s = 0; s < kSampleCount; s++)
+        {
+            float r = unit(rng), nodeProb = 0.5f;
+            uint lightIdx = LightTreeHelpers::sampleLeafTriangle(clusters, leafIdx, r, nodeProb);
+            sampleCounts[lightIdx]++;
+            double expectedProb = leafIntensity > 0.0 ? triangleIntensities[lightIdx] / leafIntensity : 1.0 / count;
+            if (std::abs(nodeProb - 0.5 * expectedProb) > 1e-5) badProbCount++;
+            if (!(r >= 0.f && r < 1.f)) badRandomCount++;
+        }
+
+        for (uint t = 0; t < count; t++)
+        {
+            const uint lightIdx = clusters.triangles[first + t];
+            double p = leafIntensity > 0.0 ? triangleIntensities[lightIdx] / leafIntensity : 1.0 / count;
+            double expected = p * kSampleCount;
+            double sigma = std::sqrt(std::max(expected * (1.0 - p), 1.0));
+            maxZ = std::max(maxZ, std::abs(sampleCounts[lightIdx] - expected) / sigma);
+        }
+    }
+    HIME_EXPECT_MSG(badProbCount == 0, std::to_string(badProbCount) + " samples with wrong pdf");
+    HIME_EXPECT_MSG(badRandomCount == 0, std::to_string(badRandomCount) + " rescaled random numbers out of [0, 1)");
+    HIME_EXPECT_MSG(maxZ < 4.5, "max |z| of triangle sample counts " + std::to_string(maxZ));
+}
+
+HIME_TEST(LBVHCutsCoverEveryLightOnce)
+{
+    // Odd light count, so the complete binary tree has bogus leaves and LBVH is unbalanced.
+    const uint kLightCount = 20001;
+    const uint kCutSize = 16;
+    const float kErrorLimit = 0.001f;
+    for (Layout layout : { Layout::Uniform, Layout::Clustered, Layout::Panels })
+    {
+        auto leaves = createLeaves(layout, kLightCount, 8);
+        AABB sceneBound = computeCubicBound(leaves);
+        LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+        std::vector<LightTreeNode> lightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+        LightTreeHelpers::LBVH lbvh = LightTreeHelpers::buildLBVH(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+        HIME_EXPECT(lbvh.nodes.size() == 2 * kLightCount - 1 && lbvh.children.size() == lbvh.nodes.size());
+
+        const LightTreeHelpers::LightTreeView views[2] = { LightTreeHelpers::LightTreeView::create(lightTree), LightTreeHelpers::LightTreeView::create(lbvh) };
+        const std::vector<uint> lightCounts[2] = { LightTreeHelpers::computeNodeLightCounts(views[0]), LightTreeHelpers::computeNodeLightCounts(views[1]) };
+        HIME_EXPECT(lightCounts[0][0] == kLightCount && lightCounts[1][0] == kLightCount);
+
+        // A valid cut covers every light exactly once. Cuts can be smaller than cut size when no node left has error to split.
+        uint invalidCutCount[2] = { 0, 0 };
+        double cutErrorSum[2] = { 0.0, 0.0 };
+        for (const ShadingPoint& shadingPoint : createShadingPoints(leaves, sceneBound, 256, 9))
+        {
+            for (uint t = 0; t < 2; t++)
+            {
+                std::vector<uint> cut = LightTreeHelpers::findCut(views[t], shadingPoint.posW, shadingPoint.normal, kCutSize, kErrorLimit, sceneBound.radius());
+                std::vector<uint> coveredLights;
+                for (uint nodeIdx : cut)
+                {
+                    cutErrorSum[t] += LightTreeHelpers::computeNodeError(views[t].pNodes[nodeIdx], shadingPoint.posW, shadingPoint.normal, kErrorLimit, sceneBound.radius());
+                    std::vector<uint> stack = { nodeIdx };
+                    while (!stack.empty())
+                    {
+                        uint idx = stack.back();
+                        stack.pop_back();
+                        if (!views[t].isLeaf(idx))
+                        {
+                            uint2 children = views[t].getChildren(idx);
+                            stack.insert(stack.end(), { children.x, children.y });
+                        }
+                        else if (!views[t].pNodes[idx].isBogus()) coveredLights.push_back(views[t].pNodes[idx].lightIdx);
+                    }
+                }
+                std::sort(coveredLights.begin(), coveredLights.end());
+                bool isValid = coveredLights.size() == kLightCount && std::adjacent_find(coveredLights.begin(), coveredLights.end()) == coveredLights.end();
+                if (!isValid || cut.size() > kCutSize) invalidCutCount[t]++;
+            }
+        }
+        std::printf("    %s: summed cut error %.4g (complete binary tree), %.4g (LBVH)\n", getLayoutName(layout), cutErrorSum[0], cutErrorSum[1]);
+        HIME_EXPECT_MSG(invalidCutCount[0] == 0 && invalidCutCount[1] == 0, std::string(getLayoutName(layout)) + ": " + std::to_string(invalidCutCount[0])
+            + " invalid cuts in complete binary tree, " + std::to_string(invalidCutCount[1]) + " in LBVH");
+
+        // Both trees split the same sorted leaves, LBVH at key prefix boundaries instead of index midpoints. Midpoints cut through morton
+        // cells, so node bounds of the complete binary tree overlap more: LBVH error is measured 0.002x to 0.013x of it on these layouts.
+        HIME_EXPECT_MSG(cutErrorSum[1] < 1.25 * cutErrorSum[0], std::string(getLayoutName(layout)) + ": LBVH cut error " + std::to_string(cutErrorSum[1] / cutErrorSum[0]) + "x");
+    }
+}
@@ -0,0 +1,44 @@
+#include "HimeTest.h"
+#include "LightTreeTestScenes.h"
+#include <algorithm>
+
+using namespace Falcor;
+using namespace LightTreeTestScenes;
+
+HIME_BENCHMARK(CutSelection)
+{
+    const uint lightCount = HimeTest::isQuickRun() ? 1 << 14 : 1 << 20;
+    const uint shadingPointCount = HimeTest::isQuickRun() ? 256 : 4096;
+    const float errorLimit = 0.001f;
+
+    auto leaves = createLeaves(Layout::Uniform, lightCount, 1);
+    AABB sceneBound = computeCubicBound(leaves);
+    LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+    std::vector<LightTreeNode> lightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+    LightTreeHelpers::LightTreeView view = LightTreeHelpers::LightTreeView::create(lightTree);
+
+    // Shading points next to lights, so cuts are not stopped early by error limit.
+    const auto shadingPoints = createShadingPoints(leaves, sceneBound, shadingPointCount, 2);
+    // Both methods visit the same nodes, so they run in alternating order and the fastest of several runs is kept, with warm caches for both.
+    const int repeatCount = HimeTest::isQuickRun() ? 3 : 5;
+    for (uint cutSize = 4; cutSize <= kMaxLightcutSize; cutSize *= 2)
+    {
+        double times[2] = { 1e30, 1e30 };
+        size_t nodeCount = 0;
+        for (int r = 0; r < 2 * repeatCount; r++)
+        {
+            const uint method = r % 2 == 0 ? (r / 2) % 2 : 1 - (r / 2) % 2;
+            HimeTest::Timer timer;
+            for (const ShadingPoint& shadingPoint : shadingPoints)
+            {
+                std::vector<uint> cut = method == 0
+                    ? LightTreeHelpers::findCutByLinearScan(view, shadingPoint.posW, shadingPoint.normal, cutSize, errorLimit, sceneBound.radius())
+                    : LightTreeHelpers::findCut(view, shadingPoint.posW, shadingPoint.normal, cutSize, errorLimit, sceneBound.radius());
+                nodeCount += cut.size();
+            }
+            times[method] = std::min(times[method], timer.elapsed() * 1e6 / shadingPointCount);
+        }
+        std::printf("    cut size %u: linear scan %.2f us, heap %.2f us per shading point (%.2fx), %.1f nodes per cut\n", cutSize, times[0], times[1], times[0] / times[1],
+            (double)nodeCount / (2.0 * repeatCount * shadingPointCount));
+    }
+}
@@ -0,0 +1,98 @@
+#include "HimeTest.h"
+#include "LightTreeTestScenes.h"
+#include <algorithm>
+
+using namespace Falcor;
+using namespace LightTreeTestScenes;
+
+HIME_TEST(LightcutHeapKeepsMaxErrorOnTop)
+{
+    // Small cuts are scanned linearly, larger ones are kept in heap order.
+    for (uint cutSize : { kLightcutLinearScanMaxSize, kMaxLightcutSize })
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        LightcutHeap heap;
+        heap.reset(cutSize);
+        HIME_EXPECT(heap.useLinearScan == (cutSize <= kLightcutLinearScanMaxSize));
+        std::vector<float> errors;
+        uint badTopCount = 0;
+        for (uint i = 0; i < 4096; i++)
+        {
+            // Grow to cut size, then keep splitting the top like findCut().
+            float error = unit(rng);
+            if (heap.size < cutSize)
+            {
+                heap.push(i, error);
+                errors.push_back(error);
+            }
+            else
+            {
+                errors.erase(std::find(errors.begin(), errors.end(), heap.top().error));
+                heap.replaceTop(i, error);
+                errors.push_back(error);
+            }
+            if (heap.top().error != *std::max_element(errors.begin(), errors.end())) badTopCount++;
+        }
+        HIME_EXPECT(heap.size == cutSize);
+        HIME_EXPECT_MSG(badTopCount == 0, "cut size " + std::to_string(cutSize) + ": " + std::to_string(badTopCount) + " steps without max error on top");
+    }
+}
+
+HIME_TEST(LightcutHeapSelectsProportionalToError)
+{
+    LightcutHeap heap;
+    const float errors[] = { 4.f, 0.f, 1.f, 3.f, 2.f };
+    for (uint i = 0; i < 5; i++) heap.push(i, errors[i]);
+
+    // Selected nodes follow error / error sum, and rescaled r stays uniform in [0, 1).
+    const uint kSampleCount = 100000;
+    std::vector<uint> hits(5, 0);
+    double rescaledSum = 0.0;
+    uint badSelectionCount = 0;
+    for (uint s = 0; s < kSampleCount; s++)
+    {
+        LightcutSelection selection = heap.selectNode((s + 0.5f) / kSampleCount);
+        if (selection.heapIdx >= heap.size || !(selection.r >= 0.f && selection.r < 1.f)) { badSelectionCount++; continue; }
+        uint nodeId = heap.nodes[selection.heapIdx].nodeId;
+        if (selection.prob != errors[nodeId] / 10.f) badSelectionCount++;
+        hits[nodeId]++;
+        rescaledSum += selection.r;
+    }
+    HIME_EXPECT(badSelectionCount == 0);
+    for (uint i = 0; i < 5; i++) HIME_EXPECT_MSG(std::abs((double)hits[i] / kSampleCount - errors[i] / 10.0) < 1e-3, "node " + std::to_string(i));
+    HIME_EXPECT(std::abs(rescaledSum / kSampleCount - 0.5) < 1e-3);
+
+    // No node is selected when all errors are zero.
+    LightcutHeap zeroHeap;
+    zeroHeap.push(0, 0.f);
+    zeroHeap.push(1, 0.f);
+    HIME_EXPECT(zeroHeap.selectNode(0.5f).heapIdx == zeroHeap.size);
+}
+
+HIME_TEST(HeapCutMatchesLinearScan)
+{
+    auto leaves = createLeaves(Layout::Clustered, 1 << 14, 1);
+    AABB sceneBound = computeCubicBound(leaves);
+    LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+    std::vector<LightTreeNode> lightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+    LightTreeHelpers::LightTreeView view = LightTreeHelpers::LightTreeView::create(lightTree);
+    const float errorLimit = 0.001f;
+
+    // Shading points next to lights, so cuts are not stopped early by error limit.
+    const auto shadingPoints = createShadingPoints(leaves, sceneBound, 256, 2);
+    for (uint cutSize = 4; cutSize <= kMaxLightcutSize; cutSize *= 2)
+    {
+        // Both keep the same set of cut nodes, only their order differs.
+        uint mismatchCount = 0;
+        for (const ShadingPoint& shadingPoint : shadingPoints)
+        {
+            std::vector<uint> linearCut = LightTreeHelpers::findCutByLinearScan(view, shadingPoint.posW, shadingPoint.normal, cutSize, errorLimit, sceneBound.radius());
+            std::vector<uint> heapCut = LightTreeHelpers::findCut(view, shadingPoint.posW, shadingPoint.normal, cutSize, errorLimit, sceneBound.radius());
+            std::sort(linearCut.begin(), linearCut.end());
+            std::sort(heapCut.begin(), heapCut.end());
+            if (linearCut != heapCut || heapCut.size() > cutSize) mismatchCount++;
+        }
+        HIME_EXPECT_MSG(mismatchCount == 0, "cut size " + std::to_string(cutSize) + ": " + std::to_string(mismatchCount) + " cuts differ");
+    }
+}
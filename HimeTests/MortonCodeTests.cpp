@@ -0,0 +1,185 @@
+#include "HimeTest.h"
+#include "HimeUtils/HimeMortonCode.h"
+#include <random>
+
+using namespace Falcor;
+
+namespace
+{
+    std::vector<uint3> createQuantPositions(size_t count, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::vector<uint3> values(count);
+        for (auto& v : values) v = uint3(rng() & 1023, rng() & 1023, rng() & 1023);
+
+        // Corners of the quantization grid.
+        for (size_t i = 0; i < std::min<size_t>(count, 8); i++) values[i] = uint3(i & 1 ? 1023 : 0, i & 2 ? 1023 : 0, i & 4 ? 1023 : 0);
+        return values;
+    }
+
+    std::vector<float3> createPositions(size_t count, const AABB& bound, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> dist(-0.1f, 1.1f); // Some positions are outside of bound and clamped.
+        std::vector<float3> positions(count);
+        for (auto& p : positions) p = bound.minPoint + float3(dist(rng), dist(rng), dist(rng)) * bound.extent();
+        if (count > 2)
+        {
+            positions[0] = bound.minPoint;
+            positions[1] = bound.maxPoint;
+        }
+        return positions;
+    }
+}
+
+HIME_TEST(MortonBatchInterleaveMatchesScalar)
+{
+    // Odd count leaves a scalar tail after the 8-wide groups.
+    for (size_t count : { size_t(0), size_t(5), size_t(8), size_t(1003) })
+    {
+        auto values = createQuantPositions(count, uint32_t(count));
+        std::vector<uint> codes(count);
+        interleave_30bits_uint3_batch(values.data(), codes.data(), count);
+        for (size_t i = 0; i < count; i++) HIME_EXPECT(codes[i] == interleave_30bits_uint3(values[i]));
+
+        std::vector<uint3> decoded(count);
+        deinterleave_30bits_uint3_batch(codes.data(), decoded.data(), count);
+        for (size_t i = 0; i < count; i++) HIME_EXPECT(decoded[i] == values[i]);
+    }
+}
+
+HIME_TEST(MortonAVX2PathsMatchScalar)
+{
+#if HIME_CPU_X64
+    if (!HimeCpuHelpers::hasAVX2())
+    {
+        std::printf("    AVX2 is not supported, skipped\n");
+        return;
+    }
+
+    const size_t count = 4099;
+    auto values = createQuantPositions(count, 1);
+    std::vector<uint> codes(count, 0);
+    size_t encodedCount = interleave_30bits_uint3_batch_avx2(values.data(), codes.data(), count);
+    HIME_EXPECT(encodedCount == count / 8 * 8);
+    for (size_t i = 0; i < encodedCount; i++) HIME_EXPECT(codes[i] == interleave_30bits_uint3(values[i]));
+
+    for (size_t i = 0; i < count; i++) codes[i] = interleave_30bits_uint3(values[i]);
+    std::vector<uint3> decoded(count);
+    size_t decodedCount = deinterleave_30bits_uint3_batch_avx2(codes.data(), decoded.data(), count);
+    HIME_EXPECT(decodedCount == count / 8 * 8);
+    for (size_t i = 0; i < decodedCount; i++) HIME_EXPECT(decoded[i] == values[i]);
+
+    const AABB bound(float3(-3.f, 0.5f, 10.f), float3(5.f, 8.5f, 18.f));
+    auto positions = createPositions(count, bound, 2);
+    std::vector<uint> posCodes(count, 0);
+    size_t end = MortonCodeHelpers::computeMortonCodesByPosAVX2(positions.data(), 3, count, 1024, bound, posCodes.data());
+    HIME_EXPECT(end == 3 + (count - 3) / 8 * 8);
+    for (size_t i = 3; i < end; i++) HIME_EXPECT(posCodes[i] == MortonCodeHelpers::computeMortonCodeByPos(positions[i], 1024, bound));
+#else
+    std::printf("    Not x64, skipped\n");
+#endif
+}
+
+HIME_TEST(MortonBatchPositionsMatchScalar)
+{
+    const AABB bound(float3(-3.f, 0.5f, 10.f), float3(5.f, 8.5f, 18.f));
+    for (uint quantLevels : { 16u, 1024u })
+    {
+        const size_t count = 20001;
+        auto positions = createPositions(count, bound, quantLevels);
+        std::vector<uint> codes(count);
+        MortonCodeHelpers::computeMortonCodesByPos(positions.data(), count, quantLevels, bound, codes.data());
+        for (size_t i = 0; i < count; i++) HIME_EXPECT(codes[i] == MortonCodeHelpers::computeMortonCodeByPos(positions[i], quantLevels, bound));
+
+        std::vector<float3> decoded(count);
+        MortonCodeHelpers::computePosByMortonCodes(codes.data(), count, float(quantLevels), bound, decoded.data());
+        for (size_t i = 0; i < count; i++) HIME_EXPECT(decoded[i] == MortonCodeHelpers::computePosByMortonCode(codes[i], float(quantLevels), bound));
+    }
+}
+
+namespace
+{
+    /** Encode random positions with BitsPerAxis, and check decoding, prefix bounds and prefix comparison.
+    */
+    template<uint BitsPerAxis>
+    void checkMortonCodeRoundTrip()
+    {
+        using Traits = MortonCodeTraits<BitsPerAxis>;
+        using CodeType = typename Traits::CodeType;
+        std::mt19937 rng(BitsPerAxis);
+        const uint kMaxQuant = Traits::kQuantLevels - 1;
+
+        // Quantized positions round trip exactly.
+        for (int i = 0; i < 10000; i++)
+        {
+            uint3 quantPos = uint3(rng() % Traits::kQuantLevels, rng() % Traits::kQuantLevels, rng() % Traits::kQuantLevels);
+            if (i < 8) quantPos = uint3(i & 1 ? kMaxQuant : 0, i & 2 ? kMaxQuant : 0, i & 4 ? kMaxQuant : 0);
+            CodeType code = Traits::interleave(quantPos);
+            HIME_EXPECT(code >> Traits::kCodeBits == 0);
+            HIME_EXPECT(Traits::deinterleave(code) == quantPos);
+        }
+        HIME_EXPECT(Traits::interleave(uint3(kMaxQuant)) == (CodeType(1) << Traits::kCodeBits) - 1);
+
+        // Positions decode to the min corner of their cell, and the cell of every prefix contains them.
+        const AABB bound(float3(-2.f, -2.f, -2.f), float3(6.f, 6.f, 6.f));
+        const float cellSize = bound.extent().x / float(Traits::kQuantLevels);
+        std::uniform_real_distribution<float> dist(0.f, 1.f);
+        for (int i = 0; i < 2000; i++)
+        {
+            float3 pos = bound.minPoint + float3(dist(rng), dist(rng), dist(rng)) * bound.extent();
+            CodeType code = MortonCodeHelpers::computeMortonCodeByPos<BitsPerAxis>(pos, bound);
+            float3 cellMin = MortonCodeHelpers::computePosByMortonCode<BitsPerAxis>(code, bound);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                HIME_EXPECT(cellMin[axis] <= pos[axis] + 1e-5f);
+                HIME_EXPECT(pos[axis] - cellMin[axis] <= cellSize + 1e-5f);
+            }
+
+            for (uint prefixLength : { 3u, Traits::kCodeBits / 2, Traits::kCodeBits - 3 })
+            {
+                AABB prefixBound = MortonCodeHelpers::computeAABBByMortonCode<BitsPerAxis>(code, prefixLength, bound);
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    HIME_EXPECT(prefixBound.minPoint[axis] <= pos[axis] + 1e-5f);
+                    HIME_EXPECT(pos[axis] <= prefixBound.maxPoint[axis] + cellSize + 1e-5f);
+                }
+
+                CodeType flipLow = code ^ (CodeType(1) << (Traits::kCodeBits - prefixLength - 1));
+                CodeType flipHigh = code ^ (CodeType(1) << (Traits::kCodeBits - prefixLength));
+                HIME_EXPECT(MortonCodeHelpers::hasSameMortonCodePrefix<BitsPerAxis>(code, flipLow, prefixLength));
+                HIME_EXPECT(!MortonCodeHelpers::hasSameMortonCodePrefix<BitsPerAxis>(code, flipHigh, prefixLength));
+            }
+        }
+    }
+}
+
+HIME_TEST(Morton30BitRoundTrip)
+{
+    checkMortonCodeRoundTrip<10>();
+}
+
+HIME_TEST(Morton63BitRoundTrip)
+{
+    checkMortonCodeRoundTrip<21>();
+}
+
+HIME_TEST(Morton63BitSeparatesClusteredPoints)
+{
+    // Points 1e-4 apart in a unit bound share 30-bit codes (cell size 1e-3) but not 63-bit codes (cell size 5e-7).
+    const AABB bound(float3(0.f), float3(1.f));
+    std::vector<uint> codes30;
+    std::vector<uint64_t> codes63;
+    for (int i = 0; i < 1000; i++)
+    {
+        float3 pos = float3(0.5f + i * 1e-4f, 0.25f, 0.75f);
+        codes30.push_back(MortonCodeHelpers::computeMortonCodeByPos<10>(pos, bound));
+        codes63.push_back(MortonCodeHelpers::computeMortonCodeByPos<21>(pos, bound));
+    }
+    std::sort(codes30.begin(), codes30.end());
+    std::sort(codes63.begin(), codes63.end());
+    size_t unique30 = std::unique(codes30.begin(), codes30.end()) - codes30.begin();
+    size_t unique63 = std::unique(codes63.begin(), codes63.end()) - codes63.begin();
+    HIME_EXPECT(unique30 <= 104); // 0.1 / (1 / 1024) cells
+    HIME_EXPECT(unique63 == 1000);
+}
@@ -0,0 +1,54 @@
+#include "HimeTest.h"
+#include "HimeUtils/HimeParallel.h"
+#include <atomic>
+
+using namespace Falcor;
+
+HIME_TEST(ThreadPoolRunsEachTaskOnce)
+{
+    HimeParallelHelpers::ThreadPool pool(3);
+    for (unsigned int taskCount : { 0u, 1u, 2u, 7u, 64u })
+    {
+        for (int job = 0; job < 50; job++)
+        {
+            std::vector<std::atomic<int>> runCounts(taskCount);
+            auto task = [&](unsigned int taskIdx) { runCounts[taskIdx]++; };
+            pool.run(taskCount, task);
+            for (unsigned int i = 0; i < taskCount; i++) HIME_EXPECT(runCounts[i] == 1);
+        }
+    }
+}
+
+HIME_TEST(ThreadPoolRunsNestedJobsSerially)
+{
+    HimeParallelHelpers::ThreadPool pool(2);
+    std::atomic<int> innerCount = 0;
+    auto outer = [&](unsigned int)
+    {
+        auto inner = [&](unsigned int) { innerCount++; };
+        pool.run(4, inner);
+    };
+    pool.run(4, outer);
+    HIME_EXPECT(innerCount == 16);
+}
+
+HIME_TEST(ParallelForCoversRangeWithStableChunks)
+{
+    for (size_t count : { size_t(0), size_t(1), size_t(4095), size_t(4096), size_t(100000) })
+    {
+        std::vector<int> hits(count, 0);
+        std::vector<std::pair<size_t, size_t>> chunks(HimeParallelHelpers::getChunkCount(count, 4096));
+        HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int chunkIdx)
+        {
+            chunks[chunkIdx] = { begin, end };
+            for (size_t i = begin; i < end; i++) hits[i]++;
+        });
+        for (size_t i = 0; i < count; i++) HIME_EXPECT(hits[i] == 1);
+
+        // Same input, same chunk ranges.
+        HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int chunkIdx)
+        {
+            HIME_EXPECT(chunks[chunkIdx].first == begin && chunks[chunkIdx].second == end);
+        });
+    }
+}
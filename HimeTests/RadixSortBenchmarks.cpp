@@ -0,0 +1,53 @@
+#include "HimeTest.h"
+#include "HimeUtils/RadixSort/RadixSort.h"
+#include <algorithm>
+#include <random>
+
+using namespace Falcor;
+
+namespace
+{
+    template<typename Sorter>
+    void benchmarkSort(const char* name, uint32_t keyBits)
+    {
+        using Pair = typename Sorter::KeyIndexPair;
+        using KeyType = decltype(Pair::key);
+        const std::vector<size_t> counts = HimeTest::isQuickRun() ? std::vector<size_t>{ 1 << 16 } : std::vector<size_t>{ 1 << 16, 1 << 20, 1 << 22 };
+        const int repeatCount = HimeTest::isQuickRun() ? 1 : 5;
+
+        auto pSorter = Sorter::create();
+        for (size_t count : counts)
+        {
+            std::mt19937_64 rng(1);
+            const KeyType keyMask = KeyType((uint64_t(1) << keyBits) - 1);
+            std::vector<Pair> source(count);
+            for (size_t i = 0; i < count; i++) source[i] = { uint32_t(i), KeyType(rng()) & keyMask };
+
+            double radixTime = 1e30, stdTime = 1e30;
+            for (int r = 0; r < repeatCount; r++)
+            {
+                auto pairs = source;
+                HimeTest::Timer timer;
+                pSorter->sort(pairs.data(), count, keyBits);
+                radixTime = std::min(radixTime, timer.elapsed());
+
+                pairs = source;
+                timer = HimeTest::Timer();
+                std::stable_sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.key < b.key; });
+                stdTime = std::min(stdTime, timer.elapsed());
+            }
+            std::printf("    %s %zu pairs: radix %.2f ms (%.1f Mkeys/s), std::stable_sort %.2f ms, %.2fx, %u workers\n", name, count,
+                radixTime * 1e3, count / radixTime * 1e-6, stdTime * 1e3, stdTime / radixTime, HimeParallelHelpers::getWorkerCount());
+        }
+    }
+}
+
+HIME_BENCHMARK(RadixSort30BitKeys)
+{
+    benchmarkSort<HimeRadixSort>("30-bit", 30);
+}
+
+HIME_BENCHMARK(RadixSort63BitKeys)
+{
+    benchmarkSort<HimeRadixSort64>("63-bit", 63);
+}
@@ -0,0 +1,95 @@
+#include "HimeTest.h"
+#include "HimeUtils/RadixSort/RadixSort.h"
+#include <algorithm>
+#include <random>
+
+using namespace Falcor;
+
+namespace
+{
+    template<typename Sorter>
+    std::vector<typename Sorter::KeyIndexPair> createPairs(size_t count, uint32_t keyBits, uint32_t distinctKeys, uint32_t seed)
+    {
+        using KeyType = decltype(Sorter::KeyIndexPair::key);
+        std::mt19937_64 rng(seed);
+        const KeyType keyMask = keyBits >= 64 ? ~KeyType(0) : KeyType((uint64_t(1) << keyBits) - 1);
+
+        std::vector<KeyType> keys(distinctKeys);
+        for (auto& key : keys) key = KeyType(rng()) & keyMask;
+
+        std::vector<typename Sorter::KeyIndexPair> pairs(count);
+        for (size_t i = 0; i < count; i++) pairs[i] = { uint32_t(i), keys[rng() % distinctKeys] };
+        return pairs;
+    }
+
+    /** Sort with the radix sorter and std::stable_sort, and check both orders are identical.
+    */
+    template<typename Sorter>
+    bool sortMatchesStableSort(size_t count, uint32_t keyBits, uint32_t distinctKeys, uint32_t seed)
+    {
+        auto pairs = createPairs<Sorter>(count, keyBits, distinctKeys, seed);
+        auto expected = pairs;
+        std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.key < b.key; });
+
+        auto pSorter = Sorter::create();
+        pSorter->sort(pairs.data(), pairs.size(), keyBits);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (pairs[i].key != expected[i].key || pairs[i].index != expected[i].index) return false;
+        }
+        return true;
+    }
+}
+
+HIME_TEST(RadixSort32MatchesStableSort)
+{
+    for (size_t count : { size_t(0), size_t(1), size_t(2), size_t(1000), size_t(16384), size_t(200003) })
+    {
+        HIME_EXPECT_MSG((sortMatchesStableSort<HimeRadixSort>(count, 30, 1u << 20, 1)), std::to_string(count));
+        HIME_EXPECT_MSG((sortMatchesStableSort<HimeRadixSort>(count, 32, 1u << 20, 2)), std::to_string(count));
+    }
+}
+
+HIME_TEST(RadixSort64MatchesStableSort)
+{
+    for (size_t count : { size_t(0), size_t(1), size_t(1000), size_t(200003) })
+    {
+        HIME_EXPECT_MSG((sortMatchesStableSort<HimeRadixSort64>(count, 63, 1u << 20, 3)), std::to_string(count));
+        HIME_EXPECT_MSG((sortMatchesStableSort<HimeRadixSort64>(count, 64, 1u << 20, 4)), std::to_string(count));
+    }
+}
+
+HIME_TEST(RadixSortIsStableWithDuplicateKeys)
+{
+    HIME_EXPECT((sortMatchesStableSort<HimeRadixSort>(100000, 30, 7, 5)));
+    HIME_EXPECT((sortMatchesStableSort<HimeRadixSort64>(100000, 63, 7, 6)));
+
+    // All keys equal, every pass is skipped.
+    HIME_EXPECT((sortMatchesStableSort<HimeRadixSort>(50000, 30, 1, 7)));
+}
+
+HIME_TEST(RadixSortReusesScratchAcrossSizes)
+{
+    auto pSorter = HimeRadixSort::create();
+    for (size_t count : { size_t(100000), size_t(10), size_t(50000) })
+    {
+        auto pairs = createPairs<HimeRadixSort>(count, 30, 1u << 16, uint32_t(count));
+        pSorter->sort(pairs.data(), pairs.size(), 30);
+        bool isSorted = std::is_sorted(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return a.key < b.key; });
+        HIME_EXPECT(isSorted);
+    }
+}
+
+HIME_TEST(RadixSortGatherReordersPayloads)
+{
+    const size_t count = 70000;
+    auto pairs = createPairs<HimeRadixSort>(count, 30, 1u << 20, 8);
+    std::vector<uint64_t> payloads(count);
+    for (size_t i = 0; i < count; i++) payloads[i] = uint64_t(pairs[i].key) << 32 | i;
+
+    HimeRadixSort::create()->sort(pairs.data(), count, 30);
+    std::vector<uint64_t> sortedPayloads(count);
+    HimeRadixSort::gather(payloads.data(), pairs.data(), count, sortedPayloads.data());
+
+    for (size_t i = 0; i < count; i++) HIME_EXPECT(sortedPayloads[i] == (uint64_t(pairs[i].key) << 32 | pairs[i].index));
+}
@@ -0,0 +1,155 @@
+#include "HimeTest.h"
+#include "ReSTIR/CPUReSTIR.h"
+#include "ReSTIR/ReservoirHashGrid.h"
+#include "ReSTIR/SyntheticScene.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Falcor;
+
+namespace
+{
+    const AABB kHashGridSceneBound(float3(0.f), float3(10.f, 2.f, 10.f));
+    const uint kHashGridMaxAge = 4;
+}
+
+HIME_BENCHMARK(ReservoirHashGridLookup)
+{
+    // Grid is filled by inserts of maxAge frames on a static surface, and every surface pixel looks up its cell.
+    const uint2 dim = HimeTest::isQuickRun() ? uint2(320, 180) : uint2(1920, 1080);
+    const size_t pixelCount = (size_t)dim.x * dim.y;
+    SyntheticGBuffer syntheticGBuffer(dim);
+    syntheticGBuffer.update(kHashGridSceneBound, 0);
+    const CPUReSTIR::GBuffer& gBuffer = syntheticGBuffer.gBuffer;
+
+    ReservoirData reservoir;
+    reservoir.lightData = ReservoirData::c_LightValidBit;
+    reservoir.M = 1;
+
+    ReservoirHashGrid grid;
+    grid.resize(1 << 15);
+    for (float cellSize : { 0.005f, 0.01f, 0.02f, 0.04f })
+    {
+        grid.clear();
+        std::vector<uint4> keys(pixelCount);
+        for (size_t i = 0; i < pixelCount; i++) keys[i] = ReservoirHashGrid::computeKey(gBuffer.positions[i], gBuffer.normals[i], gBuffer.cameraPosW, cellSize);
+
+        size_t insertCount = 0, failedInsertCount = 0, lookupCount = 0;
+        size_t hitCounts[2] = {};
+        double insertTime = 0.0, lookupTime = 0.0;
+        for (uint frame = 0; frame < kHashGridMaxAge; frame++)
+        {
+            HimeTest::Timer insertTimer;
+            for (size_t i = 0; i < pixelCount; i++)
+            {
+                if (gBuffer.normals[i] == float3(0) || !ReservoirHashGrid::isInsertPixel(uint2((uint)(i % dim.x), (uint)(i / dim.x)), frame)) continue;
+                insertCount++;
+                failedInsertCount += grid.insert(keys[i], frame, kHashGridMaxAge, reservoir, false) ? 0 : 1;
+            }
+            insertTime += insertTimer.elapsed();
+
+            // Hit rate after first frame and after grid is full.
+            if (frame != 0 && frame != kHashGridMaxAge - 1) continue;
+            size_t& hitCount = hitCounts[frame == 0 ? 0 : 1];
+            ReservoirData cachedReservoir;
+            HimeTest::Timer lookupTimer;
+            for (size_t i = 0; i < pixelCount; i++)
+            {
+                if (gBuffer.normals[i] == float3(0)) continue;
+                lookupCount++;
+                hitCount += grid.lookup(keys[i], frame + 1, kHashGridMaxAge, cachedReservoir) ? 1 : 0;
+            }
+            lookupTime += lookupTimer.elapsed();
+        }
+
+        const size_t lookupsPerPass = lookupCount / 2;
+        std::printf("    cell size %.3f, %ux%u: hit rate %.1f%% after 1 frame, %.1f%% after %u frames, %u/%u slots used, %zu/%zu inserts failed, %.1f ns per insert, %.1f ns per lookup\n",
+            cellSize, dim.x, dim.y, 100.0 * hitCounts[0] / lookupsPerPass, 100.0 * hitCounts[1] / lookupsPerPass, kHashGridMaxAge,
+            grid.getOccupiedSlotCount(kHashGridMaxAge - 1, kHashGridMaxAge), grid.getSlotCount(), failedInsertCount, insertCount,
+            insertTime * 1e9 / std::max<size_t>(insertCount, 1), lookupTime * 1e9 / std::max<size_t>(lookupCount, 1));
+    }
+}
+
+HIME_BENCHMARK(ReservoirHashGridDisocclusionNoise)
+{
+    // A quarter of 64x64 regions lose their history in each frame (motion vectors point off screen). Noise is relative standard
+    // deviation of their estimates (target pdf x weight, unshadowed) over frames. Regions are larger than spatial sample radius,
+    // so most spatial neighbors of a disoccluded pixel are disoccluded too.
+    const uint2 dim = HimeTest::isQuickRun() ? uint2(160, 90) : uint2(320, 180);
+    const size_t pixelCount = (size_t)dim.x * dim.y;
+    const std::vector<CPUReSTIR::Light> lights = createSyntheticLights(kHashGridSceneBound, 20000, 1);
+    SyntheticGBuffer syntheticGBuffer(dim);
+    syntheticGBuffer.update(kHashGridSceneBound, 0);
+
+    const uint kWarmupFrameCount = 4;
+    const uint frameCount = HimeTest::isQuickRun() ? 8 : 32;
+    const uint kRegionSize = 64;
+    auto isDisoccluded = [&](size_t pixelIdx, uint frame)
+    {
+        uint regionX = (uint)(pixelIdx % dim.x) / kRegionSize;
+        uint regionY = (uint)(pixelIdx / dim.x) / kRegionSize;
+        return (regionX * 7 + regionY * 3 + frame) % 4 == 0;
+    };
+
+    for (uint candidateCount : { 32u, 16u, 8u })
+    {
+        for (bool useHashGrid : { false, true })
+        {
+            CPUReSTIR::Params params;
+            params.initialCandidateCount = candidateCount;
+            params.useHashGrid = useHashGrid;
+            params.hashGridMaxAge = kHashGridMaxAge;
+
+            // Fresh history, grid and random numbers for each configuration.
+            auto pCPUReSTIR = CPUReSTIR::create();
+            pCPUReSTIR->setLights(lights);
+
+            std::vector<double> sums(pixelCount, 0.0), squareSums(pixelCount, 0.0);
+            std::vector<uint> counts(pixelCount, 0);
+            size_t disocclusionCount = 0, hitCount = 0;
+            double temporalTime = 0.0;
+            std::vector<float4> lightTexture;
+            HimeTest::Timer timer;
+            for (uint frame = 0; frame < kWarmupFrameCount + frameCount; frame++)
+            {
+                for (size_t i = 0; i < pixelCount; i++) syntheticGBuffer.motionVectors[i] = isDisoccluded(i, frame) ? float2(-2.f, 0.f) : float2(0.f);
+
+                params.frameCount = frame;
+                pCPUReSTIR->run(syntheticGBuffer.gBuffer, params, lightTexture);
+                if (frame < kWarmupFrameCount) continue;
+
+                const CPUReSTIR::Stats& stats = pCPUReSTIR->getStats();
+                disocclusionCount += stats.disocclusionCount;
+                hitCount += stats.hashGridHitCount;
+                temporalTime += stats.temporalResampleTime;
+
+                const CPUReSTIR::ReservoirBuffer& reservoirs = pCPUReSTIR->getReservoirs();
+                for (size_t i = 0; i < pixelCount; i++)
+                {
+                    if (syntheticGBuffer.normals[i] == float3(0) || !isDisoccluded(i, frame)) continue;
+                    double estimate = (double)reservoirs.targetPdf[i] * reservoirs.weight[i];
+                    sums[i] += estimate;
+                    squareSums[i] += estimate * estimate;
+                    counts[i]++;
+                }
+            }
+            const double frameTime = timer.elapsed() * 1e3 / (kWarmupFrameCount + frameCount);
+
+            double relativeStdSum = 0.0, meanSum = 0.0;
+            size_t measuredCount = 0;
+            for (size_t i = 0; i < pixelCount; i++)
+            {
+                if (counts[i] < 2 || sums[i] <= 0.0) continue;
+                double mean = sums[i] / counts[i];
+                double variance = std::max(0.0, (squareSums[i] - sums[i] * mean) / (counts[i] - 1));
+                relativeStdSum += std::sqrt(variance) / mean;
+                meanSum += mean;
+                measuredCount++;
+            }
+
+            std::printf("    %u candidates, hash grid %s, %ux%u: relative std at disocclusions %.3f, mean estimate %.3f, hit rate %.1f%%, temporal resample %.2f ms, frame %.2f ms\n",
+                candidateCount, useHashGrid ? "on " : "off", dim.x, dim.y, relativeStdSum / std::max<size_t>(measuredCount, 1), meanSum / std::max<size_t>(measuredCount, 1),
+                100.0 * hitCount / std::max<size_t>(disocclusionCount, 1), temporalTime / frameCount, frameTime);
+        }
+    }
+}
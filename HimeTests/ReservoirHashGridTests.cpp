@@ -0,0 +1,168 @@
+#include "HimeTest.h"
+#include "ReSTIR/ReservoirHashGrid.h"
+#include <set>
+
+using namespace Falcor;
+
+namespace
+{
+    const uint kMaxAge = 4;
+    const float3 kCameraPosW = float3(0.f, 10.f, 0.f);
+
+    ReservoirData createReservoir(uint lightIdx, uint M)
+    {
+        ReservoirData reservoir;
+        reservoir.lightData = lightIdx | ReservoirData::c_LightValidBit;
+        reservoir.uvData = 0x12345678;
+        reservoir.targetPdf = 2.f;
+        reservoir.weightSum = 0.25f;
+        reservoir.M = M;
+        reservoir.spatialDistance = int2(0);
+        reservoir.age = 0;
+        return reservoir;
+    }
+
+    /** Keys of distinct cells along x, at the same level and normal bin.
+    */
+    uint4 getCellKey(int cellX)
+    {
+        uint4 key = ReservoirHashGrid::computeKey(float3(0.5f, 0.f, 0.5f), float3(0.f, 1.f, 0.f), kCameraPosW, 0.02f);
+        key.x = (uint)cellX;
+        return key;
+    }
+
+    bool lookupLight(const ReservoirHashGrid& grid, const uint4& key, uint frameCount, uint maxAge, uint& lightIdx)
+    {
+        ReservoirData reservoir;
+        if (!grid.lookup(key, frameCount, maxAge, reservoir)) return false;
+        lightIdx = reservoir.getLightIndex();
+        return true;
+    }
+}
+
+HIME_TEST(ReservoirHashGridKeysAreStable)
+{
+    // Cell size is 0.02 * 10 = 0.2, rounded down to 0.125, points inside one cell share a key.
+    const float3 normal = float3(0.f, 1.f, 0.f);
+    const uint4 key = ReservoirHashGrid::computeKey(float3(0.51f, 0.f, 0.26f), normal, kCameraPosW, 0.02f);
+    HIME_EXPECT(key == uint4(4, 0, 2, 124 | (2 << 8)));
+    HIME_EXPECT(ReservoirHashGrid::computeKey(float3(0.6f, 0.1f, 0.374f), normal, kCameraPosW, 0.02f) == key);
+    HIME_EXPECT(ReservoirHashGrid::computeKey(float3(0.49f, 0.f, 0.26f), normal, kCameraPosW, 0.02f) != key);
+
+    // Negative cells, opposite normals and the next level are different keys.
+    HIME_EXPECT(ReservoirHashGrid::computeKey(float3(-0.01f, 0.f, 0.26f), normal, kCameraPosW, 0.02f).x == (uint)-1);
+    HIME_EXPECT(ReservoirHashGrid::computeKey(float3(0.51f, 0.f, 0.26f), -normal, kCameraPosW, 0.02f).w == (124 | (3 << 8)));
+    HIME_EXPECT(ReservoirHashGrid::computeKey(float3(0.51f, 0.f, 0.26f), normal, kCameraPosW, 0.04f).w == (125 | (2 << 8)));
+
+    // Bucket and checksum hashes are the ones of ReservoirHashGrid.slang, pinned so host and GPU grids stay interchangeable.
+    ReservoirHashGrid grid;
+    grid.resize(1 << 15);
+    HIME_EXPECT_MSG(grid.getBucket(key) == 0x5c61u, "bucket " + std::to_string(grid.getBucket(key)));
+    HIME_EXPECT_MSG(ReservoirHashGrid::getChecksum(key) == 0xe9cb0184u, "checksum " + std::to_string(ReservoirHashGrid::getChecksum(key)));
+
+    // Checksums are never 0, the empty slot.
+    std::set<uint> checksums;
+    for (int x = -512; x < 512; x++)
+    {
+        uint checksum = ReservoirHashGrid::getChecksum(getCellKey(x));
+        HIME_EXPECT(checksum != 0);
+        checksums.insert(checksum);
+    }
+    HIME_EXPECT(checksums.size() == 1024);
+}
+
+HIME_TEST(ReservoirHashGridLookupHitsAfterInsert)
+{
+    ReservoirHashGrid grid;
+    grid.resize(1024);
+
+    // Reservoir of the inserting pixel, spatial distance and age belong to that pixel.
+    ReservoirData reservoir = createReservoir(42, 7);
+    reservoir.spatialDistance = int2(5, -3);
+    reservoir.age = 6;
+    for (bool isCompact : { false, true })
+    {
+        grid.clear();
+        HIME_EXPECT(grid.insert(getCellKey(1), 0, kMaxAge, reservoir, isCompact));
+        HIME_EXPECT(grid.getOccupiedSlotCount(0, kMaxAge) == 1);
+
+        ReservoirData cached;
+        HIME_EXPECT(grid.lookup(getCellKey(1), 1, kMaxAge, cached));
+        HIME_EXPECT(cached.getLightIndex() == 42 && cached.M == 7 && cached.uvData == reservoir.uvData);
+        HIME_EXPECT(cached.targetPdf == 2.f && cached.weightSum == 0.25f);
+        HIME_EXPECT_MSG(cached.spatialDistance == int2(0) && cached.age == 0, "spatial distance " + std::to_string(cached.spatialDistance.x) + ", "
+            + std::to_string(cached.spatialDistance.y) + ", age " + std::to_string(cached.age));
+
+        // Other cells miss.
+        HIME_EXPECT(!grid.lookup(getCellKey(2), 1, kMaxAge, cached));
+    }
+}
+
+HIME_TEST(ReservoirHashGridFirstInsertWins)
+{
+    ReservoirHashGrid grid;
+    grid.resize(1024);
+
+    // Later inserts of the same cell in a frame succeed without writing, so a cell never mixes reservoirs.
+    HIME_EXPECT(grid.insert(getCellKey(1), 3, kMaxAge, createReservoir(10, 1), false));
+    HIME_EXPECT(grid.insert(getCellKey(1), 3, kMaxAge, createReservoir(11, 1), false));
+    uint lightIdx = 0;
+    HIME_EXPECT(lookupLight(grid, getCellKey(1), 4, kMaxAge, lightIdx) && lightIdx == 10);
+
+    // Next frame's first insert replaces it, in the same slot.
+    HIME_EXPECT(grid.insert(getCellKey(1), 4, kMaxAge, createReservoir(12, 1), false));
+    HIME_EXPECT(grid.insert(getCellKey(1), 4, kMaxAge, createReservoir(13, 1), false));
+    HIME_EXPECT(lookupLight(grid, getCellKey(1), 5, kMaxAge, lightIdx) && lightIdx == 12);
+    HIME_EXPECT(grid.getOccupiedSlotCount(4, kMaxAge) == 1);
+}
+
+HIME_TEST(ReservoirHashGridEntriesExpire)
+{
+    ReservoirHashGrid grid;
+    grid.resize(1024);
+
+    // Insert in frame 10 is seen by lookups of frames 11 to 10 + maxAge, which run before inserts of their frame.
+    HIME_EXPECT(grid.insert(getCellKey(1), 10, kMaxAge, createReservoir(10, 1), false));
+    uint lightIdx = 0;
+    for (uint frame = 11; frame <= 10 + kMaxAge; frame++) HIME_EXPECT_MSG(lookupLight(grid, getCellKey(1), frame, kMaxAge, lightIdx), "frame " + std::to_string(frame));
+    HIME_EXPECT(!lookupLight(grid, getCellKey(1), 11 + kMaxAge, kMaxAge, lightIdx));
+    HIME_EXPECT(grid.getOccupiedSlotCount(10 + kMaxAge, kMaxAge) == 1);
+    HIME_EXPECT(grid.getOccupiedSlotCount(11 + kMaxAge, kMaxAge) == 0);
+
+    // Refreshed by a new insert.
+    HIME_EXPECT(grid.insert(getCellKey(1), 20, kMaxAge, createReservoir(11, 1), false));
+    HIME_EXPECT(lookupLight(grid, getCellKey(1), 21, kMaxAge, lightIdx) && lightIdx == 11);
+}
+
+HIME_TEST(ReservoirHashGridEvictsOldestStaleSlot)
+{
+    // One bucket, so all cells compete for its slots.
+    ReservoirHashGrid grid;
+    grid.resize(1);
+    const uint kSlotCount = ReservoirHashGrid::kBucketSize;
+
+    // Full bucket of fresh cells rejects new cells.
+    for (uint i = 0; i < kSlotCount; i++) HIME_EXPECT(grid.insert(getCellKey(i), 0, kMaxAge, createReservoir(i, 1), false));
+    HIME_EXPECT(!grid.insert(getCellKey(100), 1, kMaxAge, createReservoir(100, 1), false));
+
+    // Cells 0 to 3 are stale at frame 14, cell 0 is the oldest and its slot is reused.
+    grid.clear();
+    const uint kInsertFrames[] = { 0, 1, 2, 3, 10, 11, 12, 13 };
+    for (uint i = 0; i < kSlotCount; i++) HIME_EXPECT(grid.insert(getCellKey(i), kInsertFrames[i], kMaxAge, createReservoir(i, 1), false));
+    HIME_EXPECT(grid.insert(getCellKey(100), 14, kMaxAge, createReservoir(100, 1), false));
+
+    // Lookups with a large max age see every slot still in the bucket.
+    const uint kLargeMaxAge = 1000;
+    uint lightIdx = 0;
+    HIME_EXPECT(!lookupLight(grid, getCellKey(0), 15, kLargeMaxAge, lightIdx));
+    for (uint i = 1; i < kSlotCount; i++) HIME_EXPECT_MSG(lookupLight(grid, getCellKey(i), 15, kLargeMaxAge, lightIdx) && lightIdx == i, "cell " + std::to_string(i));
+    HIME_EXPECT(lookupLight(grid, getCellKey(100), 15, kMaxAge, lightIdx) && lightIdx == 100);
+
+    // Next evictions take cells 1, 2 and 3 in order, then the bucket is fresh again.
+    for (uint i = 1; i <= 3; i++)
+    {
+        HIME_EXPECT(grid.insert(getCellKey(100 + i), 14, kMaxAge, createReservoir(100 + i, 1), false));
+        HIME_EXPECT_MSG(!lookupLight(grid, getCellKey(i), 15, kLargeMaxAge, lightIdx), "cell " + std::to_string(i));
+    }
+    HIME_EXPECT(!grid.insert(getCellKey(200), 14, kMaxAge, createReservoir(200, 1), false));
+}
@@ -0,0 +1,127 @@
+#include "HimeTest.h"
+#include "ReSTIR/CompactReservoir.h"
+#include "ReSTIR/ReservoirResampling.slangh"
+#include <random>
+
+using namespace Falcor;
+
+namespace
+{
+    struct Candidate
+    {
+        uint lightIndex;
+        float2 uv;
+        float targetPdf;
+        float invSourcePdf;
+    };
+
+    std::vector<Candidate> createCandidates(uint count, uint seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::lognormal_distribution<float> pdf(0.f, 1.f);
+        std::vector<Candidate> candidates(count);
+        for (uint i = 0; i < count; i++) candidates[i] = { i, float2(unit(rng), unit(rng)), pdf(rng), pdf(rng) };
+        return candidates;
+    }
+
+    float getRISWeight(const Candidate& candidate) { return candidate.targetPdf * candidate.invSourcePdf; }
+}
+
+HIME_TEST(StreamedReservoirSelectsProportionalToWeight)
+{
+    // Algorithm (3) of the ReSTIR paper: candidate i is kept with probability w(i) / sum of w.
+    const uint kCandidateCount = 8;
+    const uint kTrialCount = 200000;
+    const std::vector<Candidate> candidates = createCandidates(kCandidateCount, 1);
+    double weightSum = 0.0;
+    for (const Candidate& candidate : candidates) weightSum += getRISWeight(candidate);
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::vector<uint> histogram(kCandidateCount, 0);
+    for (uint t = 0; t < kTrialCount; t++)
+    {
+        ReservoirData reservoir = createEmptyReservoir();
+        for (const Candidate& candidate : candidates) streamSample(reservoir, candidate.lightIndex, candidate.uv, unit(rng), candidate.targetPdf, candidate.invSourcePdf);
+        histogram[reservoir.getLightIndex()]++;
+
+        if (t == 0)
+        {
+            HIME_EXPECT(reservoir.M == kCandidateCount && reservoir.isValid());
+            HIME_EXPECT(std::abs(reservoir.weightSum - weightSum) <= 1e-5 * weightSum);
+            const Candidate& selected = candidates[reservoir.getLightIndex()];
+            HIME_EXPECT(reservoir.targetPdf == selected.targetPdf);
+            HIME_EXPECT(length(reservoir.getSampleUV() - selected.uv) < 1e-4f);
+        }
+    }
+
+    // 5 sigma of binomial counts.
+    for (uint i = 0; i < kCandidateCount; i++)
+    {
+        double p = getRISWeight(candidates[i]) / weightSum;
+        double sigma = std::sqrt(kTrialCount * p * (1.0 - p));
+        HIME_EXPECT_MSG(std::abs(histogram[i] - kTrialCount * p) < 5.0 * sigma + 1.0, "candidate " + std::to_string(i));
+    }
+}
+
+HIME_TEST(CombinedReservoirsMatchStreaming)
+{
+    // Combining finalized reservoirs (Algorithm (4)) adds their RIS weight sums, so it gives the same weight sum, M and
+    // reservoir weight as streaming all their candidates into one reservoir.
+    const std::vector<Candidate> candidates = createCandidates(24, 3);
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    for (uint t = 0; t < 100; t++)
+    {
+        ReservoirData streamed = createEmptyReservoir();
+        ReservoirData parts[3] = { createEmptyReservoir(), createEmptyReservoir(), createEmptyReservoir() };
+        for (uint i = 0; i < candidates.size(); i++)
+        {
+            const Candidate& c = candidates[i];
+            streamSample(streamed, c.lightIndex, c.uv, unit(rng), c.targetPdf, c.invSourcePdf);
+            streamSample(parts[i % 3], c.lightIndex, c.uv, unit(rng), c.targetPdf, c.invSourcePdf);
+        }
+        const float streamedWeightSum = streamed.weightSum;
+        finalizeResampling(streamed, 1.f, (float)streamed.M);
+
+        ReservoirData combined = createEmptyReservoir();
+        for (ReservoirData& part : parts)
+        {
+            finalizeResampling(part, 1.f, (float)part.M);
+            combineReservoirs(combined, part, unit(rng), part.targetPdf);
+        }
+        HIME_EXPECT(combined.M == streamed.M);
+        HIME_EXPECT(std::abs(combined.weightSum - streamedWeightSum) <= 1e-5f * streamedWeightSum);
+
+        // Both keep a sample with its own target pdf, so the reservoir weight is the same for the same sample.
+        finalizeResampling(combined, 1.f, (float)combined.M);
+        if (combined.lightData == streamed.lightData) HIME_EXPECT(std::abs(combined.weightSum - streamed.weightSum) <= 1e-5f * streamed.weightSum);
+        const Candidate& selected = candidates[combined.getLightIndex()];
+        HIME_EXPECT(std::abs(combined.weightSum * selected.targetPdf * combined.M - streamedWeightSum) <= 1e-4f * streamedWeightSum);
+    }
+
+    // Reservoir without candidates or target pdf has zero weight.
+    ReservoirData empty = createEmptyReservoir();
+    finalizeResampling(empty, 1.f, 0.f);
+    HIME_EXPECT(empty.weightSum == 0.f && !empty.isValid());
+}
+
+HIME_TEST(NeighborRejectionThresholds)
+{
+    const float3 normal(0.f, 0.f, 1.f);
+    const float3 tilted = normalize(float3(1.f, 0.f, 1.f)); // cos = 0.707
+
+    HIME_EXPECT(isValidNeighbor(normal, normal, 10.f, 10.f, 0.5f, 0.1f));
+    HIME_EXPECT(isValidNeighbor(normal, tilted, 10.f, 10.f, 0.7f, 0.1f));
+    HIME_EXPECT(!isValidNeighbor(normal, tilted, 10.f, 10.f, 0.8f, 0.1f));
+
+    // Relative depth difference in both directions.
+    HIME_EXPECT(isValidNeighbor(normal, normal, 10.f, 10.9f, 0.5f, 0.1f));
+    HIME_EXPECT(isValidNeighbor(normal, normal, 10.f, 9.1f, 0.5f, 0.1f));
+    HIME_EXPECT(!isValidNeighbor(normal, normal, 10.f, 11.1f, 0.5f, 0.1f));
+    HIME_EXPECT(!isValidNeighbor(normal, normal, 10.f, 8.9f, 0.5f, 0.1f));
+
+    // Zero threshold disables the depth test.
+    HIME_EXPECT(isValidNeighbor(normal, normal, 10.f, 100.f, 0.5f, 0.f));
+}
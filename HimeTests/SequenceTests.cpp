@@ -0,0 +1,139 @@
+#include "HimeTest.h"
+#include "HimeUtils/HimeSequence.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Falcor;
+using namespace HimeSequenceHelpers;
+
+namespace
+{
+    /** Points of the first count entries in each of cellCount.x * cellCount.y cells of [0, 1)^2, row major.
+    */
+    std::vector<uint> countCells(const std::vector<float2>& points, uint count, uint2 cellCount)
+    {
+        std::vector<uint> cells((size_t)cellCount.x * cellCount.y, 0);
+        for (uint i = 0; i < count; i++)
+        {
+            uint x = std::min((uint)(points[i].x * cellCount.x), cellCount.x - 1);
+            uint y = std::min((uint)(points[i].y * cellCount.y), cellCount.y - 1);
+            cells[y * cellCount.x + x]++;
+        }
+        return cells;
+    }
+}
+
+HIME_TEST(R2SequenceIsStratified)
+{
+    const std::vector<float2>& points = getR2();
+    HIME_EXPECT(points.size() == kSequenceLength);
+
+    for (uint count : { 256u, 1024u, 4096u, kSequenceLength })
+    {
+        // Three distance theorem: projections of the first count points have at most 2 points in a 1 / count bin.
+        for (uint2 cellCount : { uint2(count, 1), uint2(1, count) })
+        {
+            std::vector<uint> cells = countCells(points, count, cellCount);
+            uint maxCount = *std::max_element(cells.begin(), cells.end());
+            HIME_EXPECT_MSG(maxCount <= 2, std::to_string(count) + " points: " + std::to_string(maxCount) + " in a 1D bin");
+        }
+
+        // 16 points per 2D cell on average, measured within 13 to 19, random points would spread from about 4 to 30.
+        const uint cellRes = (uint)std::sqrt((double)count / 16.0);
+        std::vector<uint> cells = countCells(points, count, uint2(cellRes));
+        auto [minIt, maxIt] = std::minmax_element(cells.begin(), cells.end());
+        const double expected = (double)count / (cellRes * cellRes);
+        HIME_EXPECT_MSG(*minIt >= expected * 0.75 && *maxIt <= expected * 1.25, std::to_string(count) + " points in " + std::to_string(cellRes) + "^2 cells: "
+            + std::to_string(*minIt) + " to " + std::to_string(*maxIt));
+    }
+}
+
+HIME_TEST(SobolSequenceIsStratified)
+{
+    // (0, 2)-sequence: 2^k consecutive points starting at a multiple of 2^k have exactly one point in each elementary
+    // interval of area 2^-k, of any aspect ratio.
+    const std::vector<float2>& points = getSobol();
+    HIME_EXPECT(points.size() == kSequenceLength);
+
+    for (uint log2Count : { 4u, 8u, 13u })
+    {
+        const uint count = 1u << log2Count;
+        for (uint first = 0; first < kSequenceLength; first += count)
+        {
+            const std::vector<float2> block(points.begin() + first, points.begin() + first + count);
+            for (uint log2X = 0; log2X <= log2Count; log2X++)
+            {
+                std::vector<uint> cells = countCells(block, count, uint2(1u << log2X, 1u << (log2Count - log2X)));
+                bool isStratified = std::all_of(cells.begin(), cells.end(), [](uint cellCount) { return cellCount == 1; });
+                HIME_EXPECT_MSG(isStratified, "points " + std::to_string(first) + " to " + std::to_string(first + count) + ", " + std::to_string(1u << log2X) + "x"
+                    + std::to_string(1u << (log2Count - log2X)) + " cells");
+                if (!isStratified) return;
+            }
+        }
+    }
+
+    // Points are exact multiples of 2^-24, same as the table uploaded to GPU.
+    for (const float2& p : points) HIME_EXPECT(p.x >= 0.f && p.x < 1.f && p.y >= 0.f && p.y < 1.f && p.x * 16777216.f == std::floor(p.x * 16777216.f));
+}
+
+HIME_TEST(R2DiskStaysInRadius)
+{
+    const std::vector<float2>& points = getR2Disk();
+    HIME_EXPECT(points.size() == kSequenceLength);
+
+    float maxRadius = 0.f;
+    float2 mean = float2(0.f);
+    for (const float2& p : points)
+    {
+        maxRadius = std::max(maxRadius, length(p));
+        mean += p / (float)points.size();
+    }
+    HIME_EXPECT_MSG(maxRadius <= 0.5f, "max radius " + std::to_string(maxRadius));
+
+    // Disk is covered, not only its center, and points are centered at origin.
+    HIME_EXPECT_MSG(maxRadius > 0.49f, "max radius " + std::to_string(maxRadius));
+    HIME_EXPECT_MSG(length(mean) < 1e-3f, "mean " + std::to_string(mean.x) + ", " + std::to_string(mean.y));
+}
+
+HIME_TEST(BlueNoiseValuesAreUniqueRanks)
+{
+    // Each value is (rank + 0.5) / count of a distinct rank, so sorted values are all ranks in order.
+    const std::vector<float>& values = getBlueNoise();
+    const uint count = kBlueNoiseSize * kBlueNoiseSize;
+    HIME_EXPECT(values.size() == count);
+
+    std::vector<float> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    bool isRanked = true;
+    for (uint rank = 0; rank < count; rank++) isRanked &= sorted[rank] == (float(rank) + 0.5f) / float(count);
+    HIME_EXPECT(isRanked);
+    HIME_EXPECT(sorted.front() > 0.f && sorted.back() < 1.f);
+
+    // Host lookup tiles the table.
+    HIME_EXPECT(getBlueNoise(uint2(3, 5)) == values[5 * kBlueNoiseSize + 3]);
+    HIME_EXPECT(getBlueNoise(uint2(3 + kBlueNoiseSize, 5 + 2 * kBlueNoiseSize)) == values[5 * kBlueNoiseSize + 3]);
+}
+
+HIME_TEST(SequenceWrapRotationMatchesShader)
+{
+    // First wrap is not rotated.
+    for (uint sampleIdx : { 0u, 1u, kSequenceLength / 2, kSequenceLength - 1 }) HIME_EXPECT(getSequenceWrapRotation(sampleIdx) == float2(0.f));
+
+    // Same integer math as getSequenceWrapRotation() in HimeSequence.slang: 32 bit products wrap, top 24 bits are kept.
+    for (uint wrapIdx : { 1u, 2u, 3u, 1000u, 0xffffffffu / kSequenceLength })
+    {
+        const uint64_t x = ((uint64_t)wrapIdx * 3242174889ull) & 0xffffffffull;
+        const uint64_t y = ((uint64_t)wrapIdx * 2447445414ull) & 0xffffffffull;
+        const float2 expected = float2((float)(x >> 8) / 16777216.f, (float)(y >> 8) / 16777216.f);
+        for (uint offset : { 0u, kSequenceLength - 1 })
+        {
+            const uint sampleIdx = wrapIdx * kSequenceLength + offset;
+            HIME_EXPECT_MSG(getSequenceWrapRotation(sampleIdx) == expected, "wrap " + std::to_string(wrapIdx) + ", sample " + std::to_string(sampleIdx));
+        }
+    }
+
+    // Rotated wraps keep stratification: 1D samples of one pixel over a wrap hit every 1 / kSequenceLength bin once.
+    std::vector<uint> bins(kSequenceLength, 0);
+    for (uint i = 0; i < kSequenceLength; i++) bins[std::min((uint)(sampleSobol1D(uint2(7, 9), kSequenceLength + i) * kSequenceLength), kSequenceLength - 1)]++;
+    HIME_EXPECT(std::all_of(bins.begin(), bins.end(), [](uint count) { return count == 1; }));
+}
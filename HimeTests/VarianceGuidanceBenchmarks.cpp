@@ -0,0 +1,79 @@
+#include "HimeTest.h"
+#include "ATrousWaveletFilter/CPUATrousFilter.h"
+#include "ATrousWaveletFilter/CPUTemporalAccumulation.h"
+#include "ATrousWaveletFilter/SyntheticFrame.h"
+#include "HimeUtils/HimeParallel.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Falcor;
+
+HIME_BENCHMARK(VarianceGuidance)
+{
+    // Camera pans one pixel per frame over the synthetic frame, with new noise each frame.
+    const uint2 dim = HimeTest::isQuickRun() ? uint2(160, 90) : uint2(480, 270);
+    const uint frameCount = 16;
+    const std::vector<float2> motionVectors((size_t)dim.x * dim.y, float2(1.f / dim.x, 0.f));
+
+    auto pAccumulation = CPUTemporalAccumulation::create();
+    std::vector<float4> colorAndVariance;
+    for (uint frameIdx = 0; frameIdx < frameCount; frameIdx++)
+    {
+        SyntheticFrame syntheticFrame(dim, frameIdx, frameIdx);
+        CPUTemporalAccumulation::Params params;
+        params.cameraPosW = syntheticFrame.cameraPosW;
+        pAccumulation->run(syntheticFrame.frame, frameIdx > 0 ? motionVectors.data() : nullptr, params, colorAndVariance);
+    }
+    const double temporalTime = pAccumulation->getStats().time;
+
+    SyntheticFrame lastFrame(dim, frameCount - 1, frameCount - 1);
+    CPUATrousFilter::Frame accumulatedFrame = lastFrame.frame;
+    accumulatedFrame.color = colorAndVariance.data();
+    accumulatedFrame.inputColor = lastFrame.color.data();
+
+    auto computeRMSE = [&](const std::vector<float4>& output)
+    {
+        double sum = 0.0;
+        for (size_t i = 0; i < output.size(); i++)
+        {
+            float3 d = float3(output[i]) - float3(lastFrame.reference[i]);
+            sum += dot(d, d) / 3.0;
+        }
+        return std::sqrt(sum / output.size());
+    };
+    std::printf("    %ux%u, %u frames, %.1f%% pixels reprojected in last frame, noisy input RMSE %.4f, accumulated input RMSE %.4f, accumulation %.2f ms\n", dim.x, dim.y, frameCount,
+        pAccumulation->getStats().reprojectedRatio * 100.0, computeRMSE(lastFrame.color), computeRMSE(colorAndVariance), temporalTime);
+
+    // Accumulated input with fixed weights separates gains of accumulation and of variance guided weights.
+    struct Config
+    {
+        const char* name;
+        bool useAccumulation;
+        bool useVarianceGuidance;
+        uint iterations;
+    };
+    const Config kConfigs[] = {
+        { "fixed weights", false, false, 2 }, { "fixed weights", false, false, 4 }, { "fixed weights", false, false, 5 },
+        { "accumulated, fixed weights", true, false, 2 }, { "accumulated, fixed weights", true, false, 4 },
+        { "accumulated, variance guided", true, true, 1 }, { "accumulated, variance guided", true, true, 2 }, { "accumulated, variance guided", true, true, 3 },
+    };
+
+    // Temporal accumulation time is added to filters of accumulated input.
+    auto pFilter = CPUATrousFilter::create();
+    std::vector<float4> output;
+    for (const Config& config : kConfigs)
+    {
+        CPUATrousFilter::Params params;
+        params.useVarianceGuidance = config.useVarianceGuidance;
+        params.iterations = config.iterations;
+
+        double time = 1e30;
+        for (int r = 0; r < 3; r++)
+        {
+            pFilter->run(config.useAccumulation ? accumulatedFrame : lastFrame.frame, params, output);
+            time = std::min(time, pFilter->getStats().time);
+        }
+        std::printf("    %s, %u iterations: RMSE %.4f, %.2f ms (%u threads)\n", config.name, config.iterations, computeRMSE(output),
+            time + (config.useAccumulation ? temporalTime : 0.0), HimeParallelHelpers::getWorkerCount());
+    }
+}
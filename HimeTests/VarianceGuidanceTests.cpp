@@ -0,0 +1,232 @@
+#include "HimeTest.h"
+#include "ATrousWaveletFilter/CPUATrousFilter.h"
+#include "ATrousWaveletFilter/CPUTemporalAccumulation.h"
+#include "ATrousWaveletFilter/SyntheticFrame.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Falcor;
+
+namespace
+{
+    const uint kFrameCount = 16;
+
+    /** Camera pans one pixel per frame over synthetic frames with new noise each frame, returns accumulated color and variance of the last one.
+    */
+    std::vector<float4> accumulateSyntheticFrames(uint2 dim, uint frameCount, double* pReprojectedRatio = nullptr)
+    {
+        const std::vector<float2> motionVectors((size_t)dim.x * dim.y, float2(1.f / dim.x, 0.f));
+        auto pAccumulation = CPUTemporalAccumulation::create();
+        std::vector<float4> colorAndVariance;
+        for (uint frameIdx = 0; frameIdx < frameCount; frameIdx++)
+        {
+            SyntheticFrame syntheticFrame(dim, frameIdx, frameIdx);
+            CPUTemporalAccumulation::Params params;
+            params.cameraPosW = syntheticFrame.cameraPosW;
+            pAccumulation->run(syntheticFrame.frame, frameIdx > 0 ? motionVectors.data() : nullptr, params, colorAndVariance);
+        }
+        if (pReprojectedRatio) *pReprojectedRatio = pAccumulation->getStats().reprojectedRatio;
+        return colorAndVariance;
+    }
+
+    /** Root mean squared error of rgb.
+    */
+    double computeRMSE(const std::vector<float4>& output, const std::vector<float4>& reference)
+    {
+        double sum = 0.0;
+        for (size_t i = 0; i < output.size(); i++)
+        {
+            float3 d = float3(output[i]) - float3(reference[i]);
+            sum += dot(d, d) / 3.0;
+        }
+        return std::sqrt(sum / output.size());
+    }
+
+    float computeMaxError(const std::vector<float4>& a, const std::vector<float4>& b)
+    {
+        float maxError = 0.f;
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            float4 d = a[i] - b[i];
+            float error = std::max({ std::abs(d.x), std::abs(d.y), std::abs(d.z), std::abs(d.w) });
+            maxError = std::isfinite(error) ? std::max(maxError, error) : INFINITY;
+        }
+        return maxError;
+    }
+
+    /** Reprojected ratio of a static frame accumulated over the synthetic frame, with changeFunc applied to normal and position of the second frame.
+    */
+    template<typename ChangeFunc>
+    double computeReprojectedRatio(ChangeFunc changeFunc)
+    {
+        const uint2 dim = uint2(160, 90);
+        SyntheticFrame first(dim, 0), second(dim, 1);
+        for (size_t i = 0; i < second.normal.size(); i++) changeFunc(second.normal[i], second.position[i]);
+
+        auto pAccumulation = CPUTemporalAccumulation::create();
+        CPUTemporalAccumulation::Params params;
+        params.cameraPosW = first.cameraPosW;
+        std::vector<float4> colorAndVariance;
+        pAccumulation->run(first.frame, nullptr, params, colorAndVariance);
+        pAccumulation->run(second.frame, nullptr, params, colorAndVariance);
+        return pAccumulation->getStats().reprojectedRatio;
+    }
+
+    bool isWall(const float4& normal) { return normal.y == 0.f; }
+}
+
+HIME_TEST(TemporalAccumulationKeepsPannedHistory)
+{
+    // Reprojected positions land exactly on the same surface, only the column entering the frame has no history.
+    const uint2 dim = uint2(160, 90);
+    double reprojectedRatio = 0.0;
+    accumulateSyntheticFrames(dim, 4, &reprojectedRatio);
+    HIME_EXPECT_MSG(std::abs(reprojectedRatio - (double)(dim.x - 1) / dim.x) < 1e-9, "reprojected " + std::to_string(reprojectedRatio));
+}
+
+HIME_TEST(TemporalAccumulationRejectsDisocclusion)
+{
+    // Walls are 15 to 20 units from the camera, 0.05 relative plane distance is about 1 unit.
+    size_t wallCount = 0, pixelCount = 0;
+    computeReprojectedRatio([&](float4& normal, float4&) { wallCount += isWall(normal) ? 1 : 0; pixelCount++; });
+    const double floorRatio = (double)(pixelCount - wallCount) / pixelCount;
+
+    double ratio = computeReprojectedRatio([](float4&, float4&) {});
+    HIME_EXPECT_MSG(ratio == 1.0, "static: reprojected " + std::to_string(ratio));
+
+    // Small depth change along the normal, and sliding along the surface, keep history.
+    ratio = computeReprojectedRatio([](float4& normal, float4& position) { if (isWall(normal)) position -= normal * 0.2f; });
+    HIME_EXPECT_MSG(ratio == 1.0, "wall moved by 0.2: reprojected " + std::to_string(ratio));
+    ratio = computeReprojectedRatio([](float4& normal, float4& position) { if (!isWall(normal)) position.x += 3.f; });
+    HIME_EXPECT_MSG(ratio == 1.0, "floor slid by 3: reprojected " + std::to_string(ratio));
+
+    // Wall moved toward the camera occludes its previous position.
+    ratio = computeReprojectedRatio([](float4& normal, float4& position) { if (isWall(normal)) position.z -= 2.f; });
+    HIME_EXPECT_MSG(std::abs(ratio - floorRatio) < 1e-9, "wall moved by 2: reprojected " + std::to_string(ratio) + ", expected " + std::to_string(floorRatio));
+
+    // Normal rotated by 10 degrees is kept, by 45 degrees is rejected.
+    auto rotateWalls = [](float degrees)
+    {
+        return [degrees](float4& normal, float4&)
+        {
+            if (!isWall(normal)) return;
+            const float c = std::cos(glm::radians(degrees)), s = std::sin(glm::radians(degrees));
+            normal = float4(c * normal.x + s * normal.z, normal.y, -s * normal.x + c * normal.z, 0.f);
+        };
+    };
+    ratio = computeReprojectedRatio(rotateWalls(10.f));
+    HIME_EXPECT_MSG(ratio == 1.0, "walls rotated by 10 degrees: reprojected " + std::to_string(ratio));
+    ratio = computeReprojectedRatio(rotateWalls(45.f));
+    HIME_EXPECT_MSG(std::abs(ratio - floorRatio) < 1e-9, "walls rotated by 45 degrees: reprojected " + std::to_string(ratio) + ", expected " + std::to_string(floorRatio));
+}
+
+HIME_TEST(GuidedCPUATrousFilterMatchesReference)
+{
+    const uint2 dim = uint2(333, 197);
+    std::vector<float4> colorAndVariance = accumulateSyntheticFrames(dim, 3);
+    SyntheticFrame lastFrame(dim, 2, 2);
+    CPUATrousFilter::Frame frame = lastFrame.frame;
+    frame.color = colorAndVariance.data();
+    frame.inputColor = lastFrame.color.data();
+
+    CPUATrousFilter::Params params;
+    params.useVarianceGuidance = true;
+    auto pFilter = CPUATrousFilter::create();
+    std::vector<float4> reference, filtered;
+
+    // Filtered variance isn't in the output, it scales color weights of following iterations.
+    for (uint iterations : { 1u, 3u, 4u })
+    {
+        params.iterations = iterations;
+        CPUATrousFilter::runReference(frame, params, reference);
+
+        float maxValue = 0.f;
+        for (const float4& color : reference) maxValue = std::max({ maxValue, std::abs(color.x), std::abs(color.y), std::abs(color.z) });
+
+        for (uint fusedIterationCount : { 1u, 2u, iterations })
+        {
+            for (uint tileSize : { 16u, 64u })
+            {
+                params.fusedIterationCount = fusedIterationCount;
+                params.tileSize = tileSize;
+                pFilter->run(frame, params, filtered);
+
+                float relativeError = computeMaxError(filtered, reference) / std::max(maxValue, 1e-30f);
+                HIME_EXPECT_MSG(relativeError < 1e-4f, std::to_string(iterations) + " iterations, " + std::to_string(fusedIterationCount) + " fused, tile size "
+                    + std::to_string(tileSize) + ": max error " + std::to_string(relativeError * 1e6f) + " ppm");
+            }
+        }
+    }
+
+#if HIME_CPU_X64
+    if (HimeCpuHelpers::hasAVX2())
+    {
+        std::vector<float4> sse;
+        params.useAVX2 = false;
+        pFilter->run(frame, params, sse);
+        params.useAVX2 = true;
+        pFilter->run(frame, params, filtered);
+        HIME_EXPECT_MSG(computeMaxError(sse, filtered) == 0.f, "AVX2 and SSE max difference " + std::to_string(computeMaxError(sse, filtered)));
+    }
+#endif
+}
+
+HIME_TEST(VarianceGuidanceRestoresAlpha)
+{
+    const uint2 dim = uint2(64, 48);
+    std::vector<float4> colorAndVariance = accumulateSyntheticFrames(dim, 3);
+    SyntheticFrame lastFrame(dim, 2, 2);
+    for (size_t i = 0; i < lastFrame.color.size(); i++) lastFrame.color[i].w = (float)(i % 7) / 7.f;
+    CPUATrousFilter::Frame frame = lastFrame.frame;
+    frame.color = colorAndVariance.data();
+    frame.inputColor = lastFrame.color.data();
+
+    CPUATrousFilter::Params params;
+    params.useVarianceGuidance = true;
+    params.tileSize = 16;
+    std::vector<float4> reference, filtered;
+    CPUATrousFilter::runReference(frame, params, reference);
+    CPUATrousFilter::create()->run(frame, params, filtered);
+
+    bool isRestored = true;
+    for (size_t i = 0; i < reference.size(); i++) isRestored &= reference[i].w == lastFrame.color[i].w && filtered[i].w == lastFrame.color[i].w;
+    HIME_EXPECT(isRestored);
+
+    // Without input color, alpha is 1.
+    frame.inputColor = nullptr;
+    CPUATrousFilter::create()->run(frame, params, filtered);
+    HIME_EXPECT(std::all_of(filtered.begin(), filtered.end(), [](const float4& color) { return color.w == 1.f; }));
+}
+
+HIME_TEST(VarianceGuidanceReducesError)
+{
+    // Accumulated input with fixed weights separates gains of accumulation and of variance guided weights.
+    const uint2 dim = uint2(480, 270);
+    std::vector<float4> colorAndVariance = accumulateSyntheticFrames(dim, kFrameCount);
+    SyntheticFrame lastFrame(dim, kFrameCount - 1, kFrameCount - 1);
+    CPUATrousFilter::Frame accumulatedFrame = lastFrame.frame;
+    accumulatedFrame.color = colorAndVariance.data();
+
+    auto pFilter = CPUATrousFilter::create();
+    auto filter = [&](const CPUATrousFilter::Frame& frame, bool useVarianceGuidance, uint iterations)
+    {
+        CPUATrousFilter::Params params;
+        params.useVarianceGuidance = useVarianceGuidance;
+        params.iterations = iterations;
+        std::vector<float4> output;
+        pFilter->run(frame, params, output);
+        return computeRMSE(output, lastFrame.reference);
+    };
+
+    const double noisyError = computeRMSE(lastFrame.color, lastFrame.reference);
+    const double accumulatedError = computeRMSE(colorAndVariance, lastFrame.reference);
+    const double fixedError = filter(lastFrame.frame, false, 4);
+    const double accumulatedFixedError = filter(accumulatedFrame, false, 2);
+    const double guidedError = filter(accumulatedFrame, true, 2);
+    const std::string errors = "noisy " + std::to_string(noisyError) + ", accumulated " + std::to_string(accumulatedError) + ", 4 fixed iterations " + std::to_string(fixedError)
+        + ", accumulated with 2 fixed iterations " + std::to_string(accumulatedFixedError) + ", accumulated with 2 guided iterations " + std::to_string(guidedError);
+
+    HIME_EXPECT_MSG(accumulatedError < noisyError, errors);
+    HIME_EXPECT_MSG(guidedError < fixedError, errors);
+    HIME_EXPECT_MSG(guidedError < accumulatedFixedError, errors);
+}
@@ -0,0 +1,78 @@
+#include "HimeTest.h"
+#include "LightTreeTestScenes.h"
+#include "RealtimeStochasticLightcuts/WideLightTree.h"
+#include <algorithm>
+#include <random>
+
+using namespace Falcor;
+using namespace LightTreeTestScenes;
+
+HIME_BENCHMARK(WideLightTreeSampling)
+{
+    const uint lightCount = HimeTest::isQuickRun() ? 1 << 14 : 1 << 20;
+    const uint shadingPointCount = HimeTest::isQuickRun() ? 256 : 4096;
+    const uint cutSize = 8;
+    const float errorLimit = 0.001f;
+
+    auto leaves = createLeaves(Layout::Uniform, lightCount, 1);
+    AABB sceneBound = computeCubicBound(leaves);
+    LightTreeHelpers::sortLeaves(leaves, LightTreeHelpers::LeafOrder::Morton, sceneBound);
+    std::vector<LightTreeNode> lightTree = LightTreeHelpers::buildLightTree(leaves, sceneBound);
+    LightTreeHelpers::LightTreeView view = LightTreeHelpers::LightTreeView::create(lightTree);
+    const float minDistance = errorLimit * sceneBound.radius();
+
+    const auto shadingPoints = createShadingPoints(leaves, sceneBound, shadingPointCount, 2);
+    std::vector<float> randoms(shadingPointCount * cutSize);
+    {
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        for (auto& r : randoms) r = unit(rng);
+    }
+
+    auto report = [&](const std::string& name, auto&& sampleShadingPoint)
+    {
+        uint64_t depthSum = 0, sampleCount = 0;
+        HimeTest::Timer timer;
+        for (uint i = 0; i < shadingPointCount; i++) sampleShadingPoint(i, depthSum, sampleCount);
+        double time = timer.elapsed();
+        std::printf("    %s: traversal depth %.2f, %.0f ns per sample (cut selection included)\n", name.c_str(),
+            (double)depthSum / std::max<uint64_t>(sampleCount, 1), time * 1e9 / std::max<uint64_t>(sampleCount, 1));
+    };
+
+    report("binary light tree", [&](uint i, uint64_t& depthSum, uint64_t& sampleCount)
+    {
+        const ShadingPoint& shadingPoint = shadingPoints[i];
+        std::vector<uint> cut = LightTreeHelpers::findCut(view, shadingPoint.posW, shadingPoint.normal, cutSize, errorLimit, sceneBound.radius());
+        for (size_t c = 0; c < cut.size(); c++)
+        {
+            uint nodeId = cut[c];
+            float r = randoms[i * cutSize + c], nodeProb = 1.f;
+            uint startLevel = uintLog2(nodeId + 1);
+            if (LightTreeHelpers::traverseLightTree(view, shadingPoint.posW, shadingPoint.normal, nodeId, r, nodeProb)) continue;
+            depthSum += uintLog2(nodeId + 1) - startLevel;
+            sampleCount++;
+        }
+    });
+
+    auto reportWide = [&](auto width)
+    {
+        constexpr uint kWidth = decltype(width)::value;
+        WideLightTree<kWidth> wideLightTree;
+        wideLightTree.build(view);
+        report(std::to_string(kWidth) + "-wide light tree (" + std::to_string(wideLightTree.getNodes().size()) + " nodes)", [&](uint i, uint64_t& depthSum, uint64_t& sampleCount)
+        {
+            const ShadingPoint& shadingPoint = shadingPoints[i];
+            auto cut = wideLightTree.findCut(shadingPoint.posW, shadingPoint.normal, cutSize, minDistance * minDistance);
+            for (size_t c = 0; c < cut.size(); c++)
+            {
+                float r = randoms[i * cutSize + c], prob = 1.f;
+                uint lightIdx = 0, depth = 0;
+                if (!wideLightTree.sampleLight(cut[c], shadingPoint.posW, shadingPoint.normal, minDistance * minDistance, r, lightIdx, prob, depth)) continue;
+                depthSum += depth;
+                sampleCount++;
+            }
+        });
+    };
+    reportWide(std::integral_constant<uint, 4>());
+    reportWide(std::integral_constant<uint, 8>());
+}
@@ -0,0 +1,188 @@
+#include "HimeTest.h"
+#include "LightTreeTestScenes.h"
+#include "RealtimeStochasticLightcuts/WideLightTree.h"
+#include <cmath>
+
+using namespace Falcor;
+using namespace LightTreeTestScenes;
+
+namespace
+{
+    const float kErrorLimit = 0.001f;
+
+    struct TestLightTree
+    {
+        AABB sceneBound;
+        std::vector<LightTreeNode> leaves;
+        std::vector<LightTreeNode> nodes;
+        LightTreeHelpers::LightTreeView view;
+    };
+
+    TestLightTree createLightTree(Layout layout, uint lightCount, uint seed)
+    {
+        TestLightTree lightTree;
+        lightTree.leaves = createLeaves(layout, lightCount, seed);
+        lightTree.sceneBound = computeCubicBound(lightTree.leaves);
+        LightTreeHelpers::sortLeaves(lightTree.leaves, LightTreeHelpers::LeafOrder::Morton, lightTree.sceneBound);
+        lightTree.nodes = LightTreeHelpers::buildLightTree(lightTree.leaves, lightTree.sceneBound);
+        lightTree.view = LightTreeHelpers::LightTreeView::create(lightTree.nodes);
+        return lightTree;
+    }
+
+    template<uint Width>
+    void checkStructure(const WideLightTree<Width>& wideLightTree, uint lightCount)
+    {
+        using Node = WideLightTreeNode<Width>;
+        std::vector<uint> lightHits(lightCount, 0);
+        uint badNodeCount = 0;
+        for (const Node& node : wideLightTree.getNodes())
+        {
+            if (node.childCount < 2 || node.childCount > Width) badNodeCount++;
+            for (uint lane = 0; lane < Width; lane++)
+            {
+                if (lane >= node.childCount)
+                {
+                    if (node.children[lane] != kInvalidLightTreeNode || node.intensity[lane] != 0.f) badNodeCount++;
+                    continue;
+                }
+                if (node.isLeaf(lane)) lightHits[node.children[lane] & ~Node::kLeafFlag]++;
+                else if (node.children[lane] >= wideLightTree.getNodes().size()) badNodeCount++;
+            }
+        }
+
+        uint missedCount = 0;
+        for (uint hits : lightHits) missedCount += hits == 1 ? 0 : 1;
+        HIME_EXPECT(wideLightTree.getLightCount() == lightCount);
+        HIME_EXPECT_MSG(missedCount == 0, std::to_string(missedCount) + " lights not under exactly one leaf lane");
+        HIME_EXPECT_MSG(badNodeCount == 0, std::to_string(badNodeCount) + " bad nodes or lanes");
+    }
+
+    /** Probability of every light reached from wide node child, with the same child probabilities as sampleLight().
+        Mass of dead branches (no child can contribute) is dropped, as in sampleLight(). Counts nodes whose child probabilities don't sum to 1.
+    */
+    template<uint Width>
+    void accumulateLightProbs(const WideLightTree<Width>& wideLightTree, uint child, float prob, const ShadingPoint& shadingPoint, float minDistance2, std::vector<double>& lightProbs, uint& badNodeCount)
+    {
+        using Tree = WideLightTree<Width>;
+        if (child & Tree::Node::kLeafFlag)
+        {
+            lightProbs[child & ~Tree::Node::kLeafFlag] += prob;
+            return;
+        }
+
+        const auto& node = wideLightTree.getNodes()[child];
+        typename Tree::ChildTerms terms;
+        float probs[Width];
+        Tree::evaluateChildren(node, shadingPoint.posW, shadingPoint.normal, minDistance2, terms);
+        if (!Tree::computeChildProbs(node, terms, probs)) return;
+        float probSum = 0.f;
+        for (uint lane = 0; lane < node.childCount; lane++)
+        {
+            probSum += probs[lane];
+            if (probs[lane] > 0.f) accumulateLightProbs(wideLightTree, node.children[lane], prob * probs[lane], shadingPoint, minDistance2, lightProbs, badNodeCount);
+        }
+        if (std::abs(probSum - 1.f) > 1e-5f) badNodeCount++;
+    }
+
+    template<uint Width>
+    void checkSampling(const TestLightTree& lightTree)
+    {
+        WideLightTree<Width> wideLightTree;
+        wideLightTree.build(lightTree.view);
+        const float minDistance = kErrorLimit * lightTree.sceneBound.radius();
+        const float minDistance2 = minDistance * minDistance;
+
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        uint badSumCount = 0, badProbCount = 0;
+        for (const ShadingPoint& shadingPoint : createShadingPoints(lightTree.leaves, lightTree.sceneBound, 32, 6))
+        {
+            // Child probabilities of every node sum to 1, light probabilities at most 1 (dead branches).
+            std::vector<double> lightProbs(lightTree.leaves.size(), 0.0);
+            accumulateLightProbs(wideLightTree, 0, 1.f, shadingPoint, minDistance2, lightProbs, badSumCount);
+            double probSum = 0.0;
+            for (double prob : lightProbs) probSum += prob;
+            if (probSum > 1.0 + 1e-4) badSumCount++;
+
+            // Sampled lights report the probability of their path.
+            typename WideLightTree<Width>::CutNode root = { 0, 0, 0.f };
+            for (uint s = 0; s < 16; s++)
+            {
+                float r = unit(rng), prob = 0.f;
+                uint lightIdx = 0, depth = 0;
+                if (!wideLightTree.sampleLight(root, shadingPoint.posW, shadingPoint.normal, minDistance2, r, lightIdx, prob, depth)) continue;
+                if (std::abs(prob - lightProbs[lightIdx]) > 1e-5 * std::max(1.0, lightProbs[lightIdx]) || !(prob > 0.f)) badProbCount++;
+            }
+        }
+        HIME_EXPECT_MSG(badSumCount == 0, std::to_string(Width) + "-wide: " + std::to_string(badSumCount) + " nodes with child probabilities not summing to 1");
+        HIME_EXPECT_MSG(badProbCount == 0, std::to_string(Width) + "-wide: " + std::to_string(badProbCount) + " samples with wrong probability");
+    }
+}
+
+HIME_TEST(WideLightTreeCoversEveryLightOnce)
+{
+    for (uint lightCount : { 2u, 3u, 1000u, 40000u })
+    {
+        TestLightTree lightTree = createLightTree(Layout::Clustered, lightCount, 7);
+        WideLightTree<4> wideLightTree4;
+        wideLightTree4.build(lightTree.view);
+        checkStructure(wideLightTree4, lightCount);
+        WideLightTree<8> wideLightTree8;
+        wideLightTree8.build(lightTree.view);
+        checkStructure(wideLightTree8, lightCount);
+    }
+}
+
+HIME_TEST(WideLightTreeSamplingProbabilities)
+{
+    TestLightTree lightTree = createLightTree(Layout::Uniform, 5000, 8);
+    checkSampling<4>(lightTree);
+    checkSampling<8>(lightTree);
+}
+
+HIME_TEST(WideLightTreeReducesTraversalDepth)
+{
+    TestLightTree lightTree = createLightTree(Layout::Uniform, 1 << 16, 9);
+    const float minDistance = kErrorLimit * lightTree.sceneBound.radius();
+    const auto shadingPoints = createShadingPoints(lightTree.leaves, lightTree.sceneBound, 1024, 10);
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    // Samples start from the root, depth counts nodes whose children are evaluated.
+    double binaryDepthSum = 0.0;
+    uint binarySampleCount = 0;
+    for (const ShadingPoint& shadingPoint : shadingPoints)
+    {
+        uint nodeId = 0;
+        float r = unit(rng), nodeProb = 1.f;
+        if (LightTreeHelpers::traverseLightTree(lightTree.view, shadingPoint.posW, shadingPoint.normal, nodeId, r, nodeProb)) continue;
+        binaryDepthSum += uintLog2(nodeId + 1);
+        binarySampleCount++;
+    }
+    const double binaryDepth = binaryDepthSum / std::max(binarySampleCount, 1u);
+
+    auto measureDepth = [&](auto wideLightTree)
+    {
+        wideLightTree.build(lightTree.view);
+        double depthSum = 0.0;
+        uint sampleCount = 0;
+        typename decltype(wideLightTree)::CutNode root = { 0, 0, 0.f };
+        for (const ShadingPoint& shadingPoint : shadingPoints)
+        {
+            float r = unit(rng), prob = 1.f;
+            uint lightIdx = 0, depth = 0;
+            if (!wideLightTree.sampleLight(root, shadingPoint.posW, shadingPoint.normal, minDistance * minDistance, r, lightIdx, prob, depth)) continue;
+            depthSum += depth;
+            sampleCount++;
+        }
+        return depthSum / std::max(sampleCount, 1u);
+    };
+    const double depth4 = measureDepth(WideLightTree<4>());
+    const double depth8 = measureDepth(WideLightTree<8>());
+    std::printf("    traversal depth: binary %.2f, 4-wide %.2f (%.2fx), 8-wide %.2f (%.2fx)\n", binaryDepth, depth4, depth4 / binaryDepth, depth8, depth8 / binaryDepth);
+
+    // log4 and log8 of the light count are 1/2 and 1/3 of log2, surface area driven collapse adds a little.
+    HIME_EXPECT(binaryDepth > 15.0);
+    HIME_EXPECT(depth4 < 0.6 * binaryDepth);
+    HIME_EXPECT(depth8 < 0.45 * binaryDepth);
+}
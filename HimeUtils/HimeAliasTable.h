@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <vector>
+#include "HimeParallel.h"
+
+namespace Falcor
+{
+    /** Entry of an alias table, same layout as HimeAliasTableEntry in HimeAliasTable.slang.
+        Index i is selected with probability threshold, otherwise alias is selected.
+    */
+    struct HimeAliasTableEntry
+    {
+        float threshold = 1.f;
+        uint32_t alias = 0;
+    };
+    static_assert(sizeof(HimeAliasTableEntry) == 8, "HimeAliasTableEntry must match uint2 layout on GPU");
+
+    /** Multi-threaded alias table builder (Vose's method) on CPU.
+
+        Weights are scaled to mean 1 and split into small (< 1) and large (>= 1) sets with a stable parallel partition,
+        without sorting. Vose's sweep pairs smalls with the current large in order, and a large becomes small once
+        its remaining weight drops below 1. With D(i) the summed deficit (1 - q) of the first i smalls and E(j) the
+        summed surplus (q - 1) of the first j larges, the sweep has a closed form:
+         - small i is aliased to the first large j with E(j + 1) >= D(i),
+         - large j keeps 1 + E(j + 1) - D(i) for the first small i with D(i) > E(j + 1), and is aliased to large j + 1.
+        Both are found with one binary search per chunk and a linear walk, so every step runs on all cores. Aliases are
+        identical with the sequential sweep, thresholds only differ by rounding.
+
+        Header only and standard library only, which means it also works on machines without GPU.
+    */
+    class HimeAliasTableBuilder
+    {
+    public:
+        using SharedPtr = std::shared_ptr<HimeAliasTableBuilder>;
+
+        static const size_t kMinChunkSize = 16384; ///< Below this, a chunk is not worth a thread.
+
+        static SharedPtr create() { return SharedPtr(new HimeAliasTableBuilder()); }
+
+        /** Build alias table of weights.
+            \param[in] pWeights Weights, negative weights are treated as zero.
+            \param[in] count Number of weights.
+            \param[out] pEntries Alias table, count entries.
+            \return Sum of weights. If it's zero, all entries select themselves (uniform sampling).
+        */
+        double build(const float* pWeights, size_t count, HimeAliasTableEntry* pEntries)
+        {
+            if (count == 0) return 0.0;
+
+            // Sum of weights, and number of smalls per chunk.
+            const unsigned int chunkCount = HimeParallelHelpers::getChunkCount(count, kMinChunkSize);
+            std::vector<double> chunkSums(chunkCount);
+            HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int chunkIdx)
+            {
+                double sum = 0.0;
+                for (size_t i = begin; i < end; i++) sum += std::max(pWeights[i], 0.f);
+                chunkSums[chunkIdx] = sum;
+            }, kMinChunkSize);
+            const double weightSum = std::accumulate(chunkSums.begin(), chunkSums.end(), 0.0);
+
+            if (!(weightSum > 0.0))
+            {
+                HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int)
+                {
+                    for (size_t i = begin; i < end; i++) pEntries[i] = { 1.f, (uint32_t)i };
+                }, kMinChunkSize);
+                return 0.0;
+            }
+
+            const double scale = (double)count / weightSum;
+            auto scaledWeight = [&](size_t i) { return std::max(pWeights[i], 0.f) * scale; };
+
+            std::vector<size_t> chunkSmallCounts(chunkCount);
+            HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int chunkIdx)
+            {
+                size_t smallCount = 0;
+                for (size_t i = begin; i < end; i++) smallCount += scaledWeight(i) < 1.0 ? 1 : 0;
+                chunkSmallCounts[chunkIdx] = smallCount;
+            }, kMinChunkSize);
+
+            // Stable partition, chunk c writes after smalls and larges of chunks before it.
+            std::vector<size_t> chunkSmallOffsets(chunkCount);
+            std::exclusive_scan(chunkSmallCounts.begin(), chunkSmallCounts.end(), chunkSmallOffsets.begin(), size_t(0));
+            const size_t smallCount = chunkSmallOffsets.back() + chunkSmallCounts.back();
+            const size_t largeCount = count - smallCount;
+            mSmalls.resize(smallCount);
+            mLarges.resize(largeCount);
+            HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int chunkIdx)
+            {
+                size_t smallIdx = chunkSmallOffsets[chunkIdx];
+                size_t largeIdx = begin - smallIdx;
+                for (size_t i = begin; i < end; i++)
+                {
+                    if (scaledWeight(i) < 1.0) mSmalls[smallIdx++] = (uint32_t)i;
+                    else mLarges[largeIdx++] = (uint32_t)i;
+                }
+            }, kMinChunkSize);
+
+            // No large means rounding made all weights slightly below mean, they are uniform.
+            if (largeCount == 0)
+            {
+                HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int)
+                {
+                    for (size_t i = begin; i < end; i++) pEntries[i] = { 1.f, (uint32_t)i };
+                }, kMinChunkSize);
+                return weightSum;
+            }
+
+            // D(i) and E(j), one more element than smalls and larges.
+            computePrefixSums(mSmalls, [&](uint32_t i) { return 1.0 - scaledWeight(i); }, mDeficits);
+            computePrefixSums(mLarges, [&](uint32_t i) { return scaledWeight(i) - 1.0; }, mSurpluses);
+
+            // Small i is aliased to the first large j with E(j + 1) >= D(i).
+            HimeParallelHelpers::parallelFor(0, smallCount, [&](size_t begin, size_t end, unsigned int)
+            {
+                size_t j = std::lower_bound(mSurpluses.begin() + 1, mSurpluses.end(), mDeficits[begin]) - (mSurpluses.begin() + 1);
+                for (size_t i = begin; i < end; i++)
+                {
+                    while (j < largeCount && mSurpluses[j + 1] < mDeficits[i]) j++;
+                    pEntries[mSmalls[i]] = { (float)scaledWeight(mSmalls[i]), mLarges[std::min(j, largeCount - 1)] };
+                }
+            }, kMinChunkSize);
+
+            // Large j becomes small before the first small i with D(i) > E(j + 1), last large keeps the rest.
+            HimeParallelHelpers::parallelFor(0, largeCount, [&](size_t begin, size_t end, unsigned int)
+            {
+                size_t i = std::upper_bound(mDeficits.begin(), mDeficits.end(), mSurpluses[begin + 1]) - mDeficits.begin();
+                for (size_t j = begin; j < end; j++)
+                {
+                    while (i <= smallCount && !(mDeficits[i] > mSurpluses[j + 1])) i++;
+                    if (i > smallCount || j + 1 == largeCount)
+                    {
+                        pEntries[mLarges[j]] = { 1.f, mLarges[j] };
+                        continue;
+                    }
+                    double threshold = 1.0 + mSurpluses[j + 1] - mDeficits[i];
+                    pEntries[mLarges[j]] = { (float)std::min(std::max(threshold, 0.0), 1.0), mLarges[j + 1] };
+                }
+            }, kMinChunkSize);
+
+            return weightSum;
+        }
+
+        /** Build alias table by sorting weights and pairing them in one sequential sweep, as Falcor's AliasTable used by
+            EmissivePowerSampler does. O(n log n) and single threaded, only kept as baseline of alias table benchmark.
+        */
+        static double buildBySorting(const float* pWeights, size_t count, HimeAliasTableEntry* pEntries)
+        {
+            if (count == 0) return 0.0;
+
+            double weightSum = 0.0;
+            for (size_t i = 0; i < count; i++) weightSum += std::max(pWeights[i], 0.f);
+            if (!(weightSum > 0.0))
+            {
+                for (size_t i = 0; i < count; i++) pEntries[i] = { 1.f, (uint32_t)i };
+                return 0.0;
+            }
+
+            const double scale = (double)count / weightSum;
+            std::vector<double> scaledWeights(count);
+            for (size_t i = 0; i < count; i++) scaledWeights[i] = std::max(pWeights[i], 0.f) * scale;
+
+            std::vector<uint32_t> order(count);
+            std::iota(order.begin(), order.end(), 0u);
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return scaledWeights[a] < scaledWeights[b]; });
+
+            // Smallest weight takes its deficit from largest weight, which moves to small side once it's below 1.
+            size_t smallIdx = 0, largeIdx = count - 1;
+            while (smallIdx < largeIdx)
+            {
+                uint32_t small = order[smallIdx], large = order[largeIdx];
+                if (!(scaledWeights[small] < 1.0)) break;
+                pEntries[small] = { (float)scaledWeights[small], large };
+                scaledWeights[large] -= 1.0 - scaledWeights[small];
+                if (scaledWeights[large] < 1.0) order[smallIdx] = large, largeIdx--;
+                else smallIdx++;
+            }
+            for (size_t i = smallIdx; i <= largeIdx; i++) pEntries[order[i]] = { 1.f, order[i] };
+            return weightSum;
+        }
+
+    private:
+        HimeAliasTableBuilder() = default;
+
+        /** prefixSums[k] = sum of value(indices[0, k)), indices.size() + 1 elements.
+        */
+        template<typename ValueFunc>
+        void computePrefixSums(const std::vector<uint32_t>& indices, ValueFunc&& value, std::vector<double>& prefixSums)
+        {
+            const size_t count = indices.size();
+            prefixSums.resize(count + 1);
+            prefixSums[0] = 0.0;
+
+            const unsigned int chunkCount = HimeParallelHelpers::getChunkCount(count, kMinChunkSize);
+            std::vector<double> chunkSums(chunkCount, 0.0);
+            HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int chunkIdx)
+            {
+                double sum = 0.0;
+                for (size_t k = begin; k < end; k++)
+                {
+                    sum += value(indices[k]);
+                    prefixSums[k + 1] = sum;
+                }
+                chunkSums[chunkIdx] = sum;
+            }, kMinChunkSize);
+
+            std::exclusive_scan(chunkSums.begin(), chunkSums.end(), chunkSums.begin(), 0.0);
+            HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int chunkIdx)
+            {
+                for (size_t k = begin; k < end; k++) prefixSums[k + 1] += chunkSums[chunkIdx];
+            }, kMinChunkSize);
+        }
+
+        std::vector<uint32_t> mSmalls;
+        std::vector<uint32_t> mLarges;
+        std::vector<double> mDeficits;  ///< D(i), summed deficit of first i smalls.
+        std::vector<double> mSurpluses; ///< E(j), summed surplus of first j larges.
+    };
+
+    /** Two-level alias table, which can be updated incrementally when weights of a few items change.
+
+        Items are grouped into buckets of kBucketSize consecutive items. Each bucket has its own alias table (aliases are
+        global indices inside the bucket), and buckets are selected with another alias table of bucket weight sums.
+        The probability of selecting item i is still weight(i) / sum of weights, and item indices never move, so
+        indices stored elsewhere stay valid after update.
+
+        update() compares new weights with last ones and only rebuilds buckets containing changed weights, then rebuilds
+        the small bucket table. Dirty buckets are kept so that only their range needs to be uploaded to GPU.
+    */
+    class HimeIncrementalAliasTable
+    {
+    public:
+        using SharedPtr = std::shared_ptr<HimeIncrementalAliasTable>;
+
+        static const uint32_t kBucketSize = 256;
+        static const size_t kMinBucketChunkSize = 64;
+
+        static SharedPtr create() { return SharedPtr(new HimeIncrementalAliasTable()); }
+
+        /** Update table with new weights. If count changes, all buckets are rebuilt.
+            \param[in] pWeights Weights, negative weights are treated as zero.
+            \param[in] count Number of weights.
+            \return Number of rebuilt buckets.
+        */
+        uint32_t update(const float* pWeights, size_t count)
+        {
+            const uint32_t bucketCount = (uint32_t)((count + kBucketSize - 1) / kBucketSize);
+            const bool rebuildAll = count != mWeights.size();
+            if (rebuildAll)
+            {
+                mWeights.assign(pWeights, pWeights + count);
+                mEntries.resize(count);
+                mBucketSums.resize(bucketCount);
+                mBucketEntries.resize(bucketCount);
+                mWeightSum = 0.0;
+            }
+
+            // Copy changed buckets and mark them, buckets are independent.
+            std::vector<uint8_t> isDirty(bucketCount, rebuildAll ? 1 : 0);
+            HimeParallelHelpers::parallelFor(0, bucketCount, [&](size_t begin, size_t end, unsigned int)
+            {
+                for (size_t b = begin; b < end; b++)
+                {
+                    size_t first = b * kBucketSize;
+                    uint32_t bucketSize = getBucketSize((uint32_t)b);
+                    if (!rebuildAll)
+                    {
+                        if (std::equal(pWeights + first, pWeights + first + bucketSize, mWeights.begin() + first)) continue;
+                        std::copy(pWeights + first, pWeights + first + bucketSize, mWeights.begin() + first);
+                        isDirty[b] = 1;
+                    }
+                    mBucketSums[b] = buildBucket(mWeights.data() + first, bucketSize, (uint32_t)first, mEntries.data() + first);
+                }
+            }, kMinBucketChunkSize);
+
+            mDirtyBuckets.clear();
+            for (uint32_t b = 0; b < bucketCount; b++) if (isDirty[b]) mDirtyBuckets.push_back(b);
+            if (mDirtyBuckets.empty()) return 0;
+
+            // Bucket table is small, rebuild it every time.
+            std::vector<float> bucketWeights(mBucketSums.begin(), mBucketSums.end());
+            mWeightSum = mpBucketBuilder->build(bucketWeights.data(), bucketWeights.size(), mBucketEntries.data());
+            return (uint32_t)mDirtyBuckets.size();
+        }
+
+        uint32_t getBucketCount() const { return (uint32_t)mBucketEntries.size(); }
+        uint32_t getBucketSize(uint32_t bucketIdx) const { return std::min(kBucketSize, (uint32_t)mWeights.size() - bucketIdx * kBucketSize); }
+        double getWeightSum() const { return mWeightSum; }
+
+        /** Per item entries, threshold is relative to mean weight of its bucket.
+        */
+        const std::vector<HimeAliasTableEntry>& getEntries() const { return mEntries; }
+        const std::vector<HimeAliasTableEntry>& getBucketEntries() const { return mBucketEntries; }
+
+        /** Buckets rebuilt by last update(), in ascending order.
+        */
+        const std::vector<uint32_t>& getDirtyBuckets() const { return mDirtyBuckets; }
+
+        /** Probability of selecting each item, implied by table. Only used for validation.
+        */
+        std::vector<double> computeProbabilities() const
+        {
+            std::vector<double> bucketProbabilities(mBucketEntries.size(), 0.0);
+            for (size_t b = 0; b < mBucketEntries.size(); b++)
+            {
+                bucketProbabilities[b] += mBucketEntries[b].threshold;
+                bucketProbabilities[mBucketEntries[b].alias] += 1.0 - mBucketEntries[b].threshold;
+            }
+
+            std::vector<double> probabilities(mEntries.size(), 0.0);
+            for (size_t i = 0; i < mEntries.size(); i++)
+            {
+                uint32_t b = (uint32_t)(i / kBucketSize);
+                double scale = bucketProbabilities[b] / mBucketEntries.size() / getBucketSize(b);
+                probabilities[i] += mEntries[i].threshold * scale;
+                probabilities[mEntries[i].alias] += (1.0 - mEntries[i].threshold) * scale;
+            }
+            return probabilities;
+        }
+
+    private:
+        HimeIncrementalAliasTable() : mpBucketBuilder(HimeAliasTableBuilder::create()) {}
+
+        /** Sequential Vose's method on one bucket, aliases are offset by first.
+            \return Sum of weights in bucket.
+        */
+        static double buildBucket(const float* pWeights, uint32_t count, uint32_t first, HimeAliasTableEntry* pEntries)
+        {
+            double weightSum = 0.0;
+            for (uint32_t i = 0; i < count; i++) weightSum += std::max(pWeights[i], 0.f);
+            if (!(weightSum > 0.0))
+            {
+                for (uint32_t i = 0; i < count; i++) pEntries[i] = { 1.f, first + i };
+                return 0.0;
+            }
+
+            const double scale = (double)count / weightSum;
+            double scaledWeights[kBucketSize];
+            uint32_t smalls[kBucketSize], larges[kBucketSize];
+            uint32_t smallCount = 0, largeCount = 0;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                scaledWeights[i] = std::max(pWeights[i], 0.f) * scale;
+                if (scaledWeights[i] < 1.0) smalls[smallCount++] = i;
+                else larges[largeCount++] = i;
+            }
+
+            while (smallCount > 0 && largeCount > 0)
+            {
+                uint32_t small = smalls[--smallCount], large = larges[largeCount - 1];
+                pEntries[small] = { (float)scaledWeights[small], first + large };
+                scaledWeights[large] -= 1.0 - scaledWeights[small];
+                if (scaledWeights[large] < 1.0) smalls[smallCount++] = large, largeCount--;
+            }
+            // Leftovers are 1 up to rounding.
+            while (smallCount > 0) { uint32_t i = smalls[--smallCount]; pEntries[i] = { 1.f, first + i }; }
+            while (largeCount > 0) { uint32_t i = larges[--largeCount]; pEntries[i] = { 1.f, first + i }; }
+            return weightSum;
+        }
+
+        HimeAliasTableBuilder::SharedPtr mpBucketBuilder;
+        std::vector<float> mWeights;                      ///< Weights of last update.
+        std::vector<double> mBucketSums;
+        std::vector<HimeAliasTableEntry> mEntries;
+        std::vector<HimeAliasTableEntry> mBucketEntries;
+        std::vector<uint32_t> mDirtyBuckets;
+        double mWeightSum = 0.0;
+    };
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define HIME_CPU_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+/** HIME_TARGET_AVX2 marks functions which use AVX2 intrinsics without compiling the whole project with AVX2.
+    They must only be called when HimeCpuHelpers::hasAVX2() is true. MSVC accepts AVX2 intrinsics anywhere,
+    GCC and Clang need the target attribute (and can't inline such functions into callers without it).
+*/
+#if HIME_CPU_X64 && !defined(_MSC_VER)
+#define HIME_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define HIME_TARGET_AVX2
+#endif
+
+/** HIME_TARGET_AVX2_KERNEL marks the AVX2 entry of a kernel written as a template over its SIMD type (e.g. SimdFloatAVX2).
+    GCC and Clang inline everything it calls (flatten), so the template and SIMD members are compiled for AVX2 inside it.
+*/
+#if HIME_CPU_X64 && !defined(_MSC_VER)
+#define HIME_TARGET_AVX2_KERNEL __attribute__((target("avx2"), flatten))
+#else
+#define HIME_TARGET_AVX2_KERNEL
+#endif
+
+namespace Falcor
+{
+    namespace HimeCpuHelpers
+    {
+        /** Query cpuid and the OS saved register state, use hasAVX2() instead.
+        */
+        inline bool detectAVX2()
+        {
+#if HIME_CPU_X64
+            unsigned int regs[4] = {}; // eax, ebx, ecx, edx
+#if defined(_MSC_VER)
+            __cpuidex((int*)regs, 0, 0);
+#else
+            __cpuid_count(0, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+            if (regs[0] < 7) return false;
+
+#if defined(_MSC_VER)
+            __cpuidex((int*)regs, 1, 0);
+#else
+            __cpuid_count(1, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+            const bool hasOSXSave = (regs[2] & (1u << 27)) != 0;
+            const bool hasAVX = (regs[2] & (1u << 28)) != 0;
+            if (!hasOSXSave || !hasAVX) return false;
+
+            // OS must save xmm and ymm registers on context switch.
+#if defined(_MSC_VER)
+            unsigned long long xcr0 = _xgetbv(0);
+#else
+            unsigned int xcr0Lo = 0, xcr0Hi = 0;
+            __asm__("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+            unsigned long long xcr0 = ((unsigned long long)xcr0Hi << 32) | xcr0Lo;
+#endif
+            if ((xcr0 & 0x6) != 0x6) return false;
+
+#if defined(_MSC_VER)
+            __cpuidex((int*)regs, 7, 0);
+#else
+            __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+            return (regs[1] & (1u << 5)) != 0;
+#else
+            return false;
+#endif
+        }
+
+        /** True if AVX2 can be used on this machine, checked once.
+        */
+        inline bool hasAVX2()
+        {
+            static const bool sHasAVX2 = detectAVX2();
+            return sHasAVX2;
+        }
+    }
+}
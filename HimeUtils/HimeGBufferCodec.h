@@ -0,0 +1,101 @@
+#pragma once
+#include <cmath>
+#include <cstring>
+#include "Falcor.h"
+
+namespace Falcor
+{
+    /** Host version of HimeGBufferCodec.slang, bit identical encoding.
+    */
+    namespace GBufferCodecHelpers
+    {
+        const uint kOctNormalBits = 8;
+        const float kOctNormalScale = 127.f;
+        const uint kHalfExponentOffset = 112 << 23;
+        const uint kMinLinearZBits = 0x0400;
+        const uint kMaxLinearZBits = 0x7bff;
+
+        /** Encoding errors, for surfaces inside encodable range.
+             - Normal: octahedral cells are 1/127 wide, angle between a normal and its decoded normal is below kMaxNormalError radians.
+             - Linear depth: rounding to nearest even, relative error 2^-11 in [kMinLinearZ, kMaxLinearZ], clamped outside.
+             - Reconstructed position: same relative error as linear depth, along the ray.
+        */
+        const float kMaxNormalError = 0.017f; // About 0.97 degree.
+        const float kMaxRelativeLinearZError = 1.f / 2048.f;
+        const float kMinLinearZ = 1.f / 16384.f;
+        const float kMaxLinearZ = 65504.f;
+
+        inline uint encodeNormalOct16(float3 n)
+        {
+            n /= (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+            float2 p(n.x, n.y);
+            if (n.z < 0.f)
+            {
+                p = float2((1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f));
+            }
+            int qx = (int)std::round(clamp(p.x, -1.f, 1.f) * kOctNormalScale);
+            int qy = (int)std::round(clamp(p.y, -1.f, 1.f) * kOctNormalScale);
+            return ((uint)qx & 0xff) | (((uint)qy & 0xff) << kOctNormalBits);
+        }
+
+        inline float3 decodeNormalOct16(uint code)
+        {
+            float3 n;
+            n.x = (float)((int)(code << 24) >> 24) / kOctNormalScale;
+            n.y = (float)((int)(code << 16) >> 24) / kOctNormalScale;
+            n.z = 1.f - std::abs(n.x) - std::abs(n.y);
+            float t = clamp(-n.z, 0.f, 1.f);
+            n.x += n.x >= 0.f ? -t : t;
+            n.y += n.y >= 0.f ? -t : t;
+            return normalize(n);
+        }
+
+        inline uint packLinearZ(float linearZ)
+        {
+            if (!(linearZ > 0.f)) return 0;
+            uint bits;
+            std::memcpy(&bits, &linearZ, sizeof(bits));
+            if (bits < kHalfExponentOffset + (kMinLinearZBits << 13)) return kMinLinearZBits;
+            bits -= kHalfExponentOffset;
+            return std::min((bits + 0xfff + ((bits >> 13) & 1)) >> 13, kMaxLinearZBits);
+        }
+
+        inline float unpackLinearZ(uint h)
+        {
+            if (h == 0) return 0.f;
+            uint bits = (h << 13) + kHalfExponentOffset;
+            float linearZ;
+            std::memcpy(&linearZ, &bits, sizeof(linearZ));
+            return linearZ;
+        }
+
+        inline uint packNormalAndLinearZ(const float3& normal, float linearZ)
+        {
+            uint linearZBits = packLinearZ(linearZ);
+            return linearZBits == 0 ? 0 : encodeNormalOct16(normal) | (linearZBits << 16);
+        }
+
+        inline float4 unpackNormalAndLinearZ(uint packed)
+        {
+            if (packed == 0) return float4(0.f);
+            return float4(decodeNormalOct16(packed & 0xffff), unpackLinearZ(packed >> 16));
+        }
+
+        inline float3 computePixelRayDir(uint2 pixel, uint2 frameDim, const float3& cameraU, const float3& cameraV, const float3& cameraW)
+        {
+            float2 p = (float2(pixel) + 0.5f) / float2(frameDim);
+            float2 ndc = float2(2.f, -2.f) * p + float2(-1.f, 1.f);
+            return ndc.x * cameraU + ndc.y * cameraV + cameraW;
+        }
+
+        inline float computeLinearZ(const float3& posW, const float3& cameraPosW, const float3& cameraForward)
+        {
+            return dot(posW - cameraPosW, cameraForward);
+        }
+
+        inline float3 reconstructPosition(const float3& cameraPosW, const float3& rayDir, const float3& cameraForward, float linearZ)
+        {
+            return cameraPosW + rayDir * (linearZ / dot(rayDir, cameraForward));
+        }
+    }
+}
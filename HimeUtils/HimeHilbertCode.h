@@ -0,0 +1,120 @@
+#pragma once
+#include "Falcor.h"
+#include "HimeMath.h"
+#include "HimeMortonCode.h"
+
+namespace Falcor
+{
+    /** Hilbert curve keys, an alternative of morton codes for ordering points.
+
+        Unlike morton order, two consecutive cells along the hilbert curve are always face neighbors,
+        so ranges of consecutive keys are spatially more compact.
+
+        Implementation follows John Skilling, "Programming the Hilbert curve", AIP Conf. Proc. 707, 2004.
+        Hilbert index is the morton interleave of the "transposed" coordinates, so code width and
+        prefix helpers are shared with morton codes (see MortonCodeTraits).
+    */
+    namespace HilbertCodeHelpers
+    {
+        /** Convert quantized coordinates to transposed hilbert index.
+            \param[in] v Quantized coordinates.
+            \param[in] bitsPerAxis Bits per axis.
+        */
+        inline uint3 axesToTranspose(uint3 v, const uint bitsPerAxis)
+        {
+            uint x[3] = { v.x, v.y, v.z };
+            const uint m = 1u << (bitsPerAxis - 1);
+
+            // Inverse undo.
+            for (uint q = m; q > 1; q >>= 1)
+            {
+                uint p = q - 1;
+                for (int i = 0; i < 3; i++)
+                {
+                    if (x[i] & q) x[0] ^= p; // invert
+                    else
+                    {
+                        uint t = (x[0] ^ x[i]) & p; // exchange
+                        x[0] ^= t;
+                        x[i] ^= t;
+                    }
+                }
+            }
+
+            // Gray encode.
+            x[1] ^= x[0];
+            x[2] ^= x[1];
+            uint t = 0;
+            for (uint q = m; q > 1; q >>= 1)
+            {
+                if (x[2] & q) t ^= q - 1;
+            }
+            for (int i = 0; i < 3; i++) x[i] ^= t;
+
+            return uint3(x[0], x[1], x[2]);
+        }
+
+        /** Inverse of axesToTranspose().
+        */
+        inline uint3 transposeToAxes(uint3 v, const uint bitsPerAxis)
+        {
+            uint x[3] = { v.x, v.y, v.z };
+            const uint n = 2u << (bitsPerAxis - 1);
+
+            // Gray decode.
+            uint t = x[2] >> 1;
+            x[2] ^= x[1];
+            x[1] ^= x[0];
+            x[0] ^= t;
+
+            // Undo excess work.
+            for (uint q = 2; q != n; q <<= 1)
+            {
+                uint p = q - 1;
+                for (int i = 2; i >= 0; i--)
+                {
+                    if (x[i] & q) x[0] ^= p;
+                    else
+                    {
+                        uint t = (x[0] ^ x[i]) & p;
+                        x[0] ^= t;
+                        x[i] ^= t;
+                    }
+                }
+            }
+
+            return uint3(x[0], x[1], x[2]);
+        }
+
+        template<uint BitsPerAxis>
+        MortonCodeHelpers::MortonCode<BitsPerAxis> computeHilbertCodeByQuantPos(const uint3 quantPos)
+        {
+            return MortonCodeTraits<BitsPerAxis>::interleave(axesToTranspose(quantPos, BitsPerAxis));
+        }
+
+        template<uint BitsPerAxis>
+        uint3 computeQuantPosByHilbertCode(const MortonCodeHelpers::MortonCode<BitsPerAxis> hilbertCode)
+        {
+            return transposeToAxes(MortonCodeTraits<BitsPerAxis>::deinterleave(hilbertCode), BitsPerAxis);
+        }
+
+        /** Host version of computeHilbertCodeByPos() in HimeHilbertCode.slang when BitsPerAxis is 10.
+        */
+        template<uint BitsPerAxis>
+        MortonCodeHelpers::MortonCode<BitsPerAxis> computeHilbertCodeByPos(const float3& pos, const AABB& sceneBound)
+        {
+            using Traits = MortonCodeTraits<BitsPerAxis>;
+            float3 normPos = (pos - sceneBound.minPoint) / sceneBound.extent();
+            float3 quantPos = clamp(normPos * float(Traits::kQuantLevels), float3(0.f), float3(float(Traits::kQuantLevels - 1)));
+            return computeHilbertCodeByQuantPos<BitsPerAxis>(uint3(quantPos));
+        }
+
+        template<uint BitsPerAxis>
+        float3 computePosByHilbertCode(const MortonCodeHelpers::MortonCode<BitsPerAxis> hilbertCode, const AABB& sceneBound)
+        {
+            using Traits = MortonCodeTraits<BitsPerAxis>;
+            float3 quantPos = float3(computeQuantPosByHilbertCode<BitsPerAxis>(hilbertCode)) / float(Traits::kQuantLevels);
+            return quantPos * sceneBound.extent() + sceneBound.minPoint;
+        }
+    }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Falcor
+{
+    /** Minimal file helpers for binary caches.
+
+        Only depends on the standard library and the OS, so cache formats built on top of it
+        can be tested on machines without GPU (and without the rest of Falcor).
+    */
+    namespace HimeFileHelpers
+    {
+        /** Bytes of a file, written in order.
+        */
+        using FileParts = std::vector<std::pair<const void*, size_t>>;
+
+        /** Write parts to a temporary file next to path and rename it, so a partially written file is never seen at path.
+            \return False if file can't be written.
+        */
+        inline bool writeFileAtomically(const std::string& path, const FileParts& parts)
+        {
+            std::error_code error;
+            std::filesystem::path filePath(path);
+            if (filePath.has_parent_path()) std::filesystem::create_directories(filePath.parent_path(), error);
+
+            std::string tempPath = path + ".tmp";
+            {
+                std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+                if (!file) return false;
+                for (const auto& [pData, size] : parts) file.write(static_cast<const char*>(pData), (std::streamsize)size);
+                if (!file) return false;
+            }
+
+            std::filesystem::rename(tempPath, path, error);
+            if (error)
+            {
+                std::filesystem::remove(tempPath, error);
+                return false;
+            }
+            return true;
+        }
+    }
+
+    /** Read only memory mapped file.
+    */
+    class HimeMappedFile
+    {
+    public:
+        using UniquePtr = std::unique_ptr<HimeMappedFile>;
+
+        /** Map whole file.
+            \return nullptr if file doesn't exist, is empty or can't be mapped.
+        */
+        static UniquePtr open(const std::string& path)
+        {
+            UniquePtr pFile(new HimeMappedFile());
+#ifdef _WIN32
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) return nullptr;
+            pFile->mFileHandle = file;
+
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return nullptr;
+            pFile->mSize = (size_t)fileSize.QuadPart;
+
+            pFile->mMappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (pFile->mMappingHandle == nullptr) return nullptr;
+            pFile->mpData = static_cast<const uint8_t*>(MapViewOfFile(pFile->mMappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+            pFile->mFile = ::open(path.c_str(), O_RDONLY);
+            if (pFile->mFile < 0) return nullptr;
+
+            struct stat fileStat;
+            if (fstat(pFile->mFile, &fileStat) != 0 || fileStat.st_size == 0) return nullptr;
+            pFile->mSize = (size_t)fileStat.st_size;
+
+            void* pData = mmap(nullptr, pFile->mSize, PROT_READ, MAP_PRIVATE, pFile->mFile, 0);
+            if (pData == MAP_FAILED) return nullptr;
+            pFile->mpData = static_cast<const uint8_t*>(pData);
+#endif
+            if (pFile->mpData == nullptr) return nullptr;
+            return pFile;
+        }
+
+        ~HimeMappedFile()
+        {
+#ifdef _WIN32
+            if (mpData) UnmapViewOfFile(mpData);
+            if (mMappingHandle) CloseHandle(mMappingHandle);
+            if (mFileHandle) CloseHandle(mFileHandle);
+#else
+            if (mpData) munmap(const_cast<uint8_t*>(mpData), mSize);
+            if (mFile >= 0) ::close(mFile);
+#endif
+        }
+
+        HimeMappedFile(const HimeMappedFile&) = delete;
+        HimeMappedFile& operator=(const HimeMappedFile&) = delete;
+
+        const uint8_t* getData() const { return mpData; }
+        size_t getSize() const { return mSize; }
+
+    private:
+        HimeMappedFile() = default;
+
+        const uint8_t* mpData = nullptr;
+        size_t mSize = 0;
+#ifdef _WIN32
+        void* mFileHandle = nullptr;
+        void* mMappingHandle = nullptr;
+#else
+        int mFile = -1;
+#endif
+    };
+}
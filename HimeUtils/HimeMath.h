@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Utils/HostDeviceShared.slangh"
+#include "HimeCpu.h"
+
+// Projects are not compiled with AVX2, AVX2 code is marked HIME_TARGET_AVX2 and dispatched with HimeCpuHelpers::hasAVX2() at runtime.
 
 namespace Falcor
 {
@@ -66,4 +69,166 @@ namespace Falcor
         uint vz = interleave_30bits_uint(v.z);
         return vx * 4 + vy * 2 + vz;
     }
+
+    inline uint deinterleave_63bits_uint(uint64_t x)
+    {
+        x &= 0x1249249249249249;
+        x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3;
+        x = (x ^ (x >> 4)) & 0x100f00f00f00f00f;
+        x = (x ^ (x >> 8)) & 0x001f0000ff0000ff;
+        x = (x ^ (x >> 16)) & 0x001f00000000ffff;
+        x = (x ^ (x >> 32)) & 0x00000000001fffff;
+        return (uint)x;
+    }
+
+    inline uint3 deinterleave_63bits_uint3(uint64_t x)
+    {
+        uint3 v;
+        v.z = deinterleave_63bits_uint(x);
+        v.y = deinterleave_63bits_uint(x >> 1);
+        v.x = deinterleave_63bits_uint(x >> 2);
+        return v;
+    }
+
+    inline uint64_t interleave_63bits_uint(uint64_t x)
+    {
+        x &= 0x00000000001fffff;
+        x = (x ^ (x << 32)) & 0x001f00000000ffff;
+        x = (x ^ (x << 16)) & 0x001f0000ff0000ff;
+        x = (x ^ (x << 8)) & 0x100f00f00f00f00f;
+        x = (x ^ (x << 4)) & 0x10c30c30c30c30c3;
+        x = (x ^ (x << 2)) & 0x1249249249249249;
+        return x;
+    }
+
+    inline uint64_t interleave_63bits_uint3(uint3 v)
+    {
+        uint64_t vx = interleave_63bits_uint(v.x);
+        uint64_t vy = interleave_63bits_uint(v.y);
+        uint64_t vz = interleave_63bits_uint(v.z);
+        return vx * 4 + vy * 2 + vz;
+    }
+
+    /** Morton code width selected at compile time.
+        10 bits per axis gives 30-bit codes stored in uint, 21 bits per axis gives 63-bit codes stored in uint64_t.
+        63-bit codes are host only: LightTreeNode::mortonCode, HimeMortonCode.slang and GPU sorting keys are 32-bit,
+        so GPU passes always use 30-bit codes.
+    */
+    template<uint BitsPerAxis> struct MortonCodeTraits;
+
+    template<> struct MortonCodeTraits<10>
+    {
+        using CodeType = uint;
+        static const uint kBitsPerAxis = 10;
+        static const uint kCodeBits = 30;
+        static const uint kQuantLevels = 1u << kBitsPerAxis;
+        static CodeType interleave(uint3 v) { return interleave_30bits_uint3(v); }
+        static uint3 deinterleave(CodeType code) { return deinterleave_30bits_uint3(code); }
+    };
+
+    template<> struct MortonCodeTraits<21>
+    {
+        using CodeType = uint64_t;
+        static const uint kBitsPerAxis = 21;
+        static const uint kCodeBits = 63;
+        static const uint kQuantLevels = 1u << kBitsPerAxis;
+        static CodeType interleave(uint3 v) { return interleave_63bits_uint3(v); }
+        static uint3 deinterleave(CodeType code) { return deinterleave_63bits_uint3(code); }
+    };
+
+#if HIME_CPU_X64
+    /** 8-wide interleave_30bits_uint.
+    */
+    HIME_TARGET_AVX2 inline __m256i interleave_30bits_uint_avx2(__m256i x)
+    {
+        x = _mm256_and_si256(x, _mm256_set1_epi32(0x000003ff));
+        x = _mm256_and_si256(_mm256_xor_si256(x, _mm256_slli_epi32(x, 16)), _mm256_set1_epi32(0xff0000ff));
+        x = _mm256_and_si256(_mm256_xor_si256(x, _mm256_slli_epi32(x, 8)), _mm256_set1_epi32(0x0300f00f));
+        x = _mm256_and_si256(_mm256_xor_si256(x, _mm256_slli_epi32(x, 4)), _mm256_set1_epi32(0x030c30c3));
+        x = _mm256_and_si256(_mm256_xor_si256(x, _mm256_slli_epi32(x, 2)), _mm256_set1_epi32(0x09249249));
+        return x;
+    }
+
+    /** 8-wide interleave_30bits_uint3, x/y/z are given as separate registers.
+    */
+    HIME_TARGET_AVX2 inline __m256i interleave_30bits_uint3_avx2(__m256i x, __m256i y, __m256i z)
+    {
+        __m256i vx = _mm256_slli_epi32(interleave_30bits_uint_avx2(x), 2);
+        __m256i vy = _mm256_slli_epi32(interleave_30bits_uint_avx2(y), 1);
+        __m256i vz = interleave_30bits_uint_avx2(z);
+        return _mm256_or_si256(_mm256_or_si256(vx, vy), vz);
+    }
+
+    /** 8-wide deinterleave_30bits_uint.
+    */
+    HIME_TARGET_AVX2 inline __m256i deinterleave_30bits_uint_avx2(__m256i x)
+    {
+        x = _mm256_and_si256(x, _mm256_set1_epi32(0x09249249));
+        x = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi32(x, 2)), _mm256_set1_epi32(0x030c30c3));
+        x = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi32(x, 4)), _mm256_set1_epi32(0x0300f00f));
+        x = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi32(x, 8)), _mm256_set1_epi32(0xff0000ff));
+        x = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi32(x, 16)), _mm256_set1_epi32(0x000003ff));
+        return x;
+    }
+
+    /** AVX2 part of interleave_30bits_uint3_batch(), encodes whole groups of 8 points.
+        \return Number of points encoded, the rest is left to scalar code.
+    */
+    HIME_TARGET_AVX2 inline size_t interleave_30bits_uint3_batch_avx2(const uint3* pValues, uint* pCodes, size_t count)
+    {
+        const __m256i kStride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const int* pBase = (const int*)(pValues + i);
+            __m256i vx = _mm256_i32gather_epi32(pBase + 0, kStride, 4);
+            __m256i vy = _mm256_i32gather_epi32(pBase + 1, kStride, 4);
+            __m256i vz = _mm256_i32gather_epi32(pBase + 2, kStride, 4);
+            _mm256_storeu_si256((__m256i*)(pCodes + i), interleave_30bits_uint3_avx2(vx, vy, vz));
+        }
+        return i;
+    }
+
+    /** AVX2 part of deinterleave_30bits_uint3_batch(), decodes whole groups of 8 codes.
+        \return Number of codes decoded, the rest is left to scalar code.
+    */
+    HIME_TARGET_AVX2 inline size_t deinterleave_30bits_uint3_batch_avx2(const uint* pCodes, uint3* pValues, size_t count)
+    {
+        alignas(32) uint vx[8], vy[8], vz[8];
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i code = _mm256_loadu_si256((const __m256i*)(pCodes + i));
+            _mm256_store_si256((__m256i*)vx, deinterleave_30bits_uint_avx2(_mm256_srli_epi32(code, 2)));
+            _mm256_store_si256((__m256i*)vy, deinterleave_30bits_uint_avx2(_mm256_srli_epi32(code, 1)));
+            _mm256_store_si256((__m256i*)vz, deinterleave_30bits_uint_avx2(code));
+            for (int k = 0; k < 8; k++) pValues[i + k] = uint3(vx[k], vy[k], vz[k]);
+        }
+        return i;
+    }
+#endif
+
+    /** Batch version of interleave_30bits_uint3: pCodes[i] = interleave_30bits_uint3(pValues[i]).
+        Uses AVX2 (8 points per step) if the CPU supports it, scalar bit twiddling otherwise. Results are bit identical.
+    */
+    inline void interleave_30bits_uint3_batch(const uint3* pValues, uint* pCodes, size_t count)
+    {
+        size_t i = 0;
+#if HIME_CPU_X64
+        if (HimeCpuHelpers::hasAVX2()) i = interleave_30bits_uint3_batch_avx2(pValues, pCodes, count);
+#endif
+        for (; i < count; i++) pCodes[i] = interleave_30bits_uint3(pValues[i]);
+    }
+
+    /** Batch version of deinterleave_30bits_uint3: pValues[i] = deinterleave_30bits_uint3(pCodes[i]).
+        Uses AVX2 (8 codes per step) if the CPU supports it, scalar bit twiddling otherwise. Results are bit identical.
+    */
+    inline void deinterleave_30bits_uint3_batch(const uint* pCodes, uint3* pValues, size_t count)
+    {
+        size_t i = 0;
+#if HIME_CPU_X64
+        if (HimeCpuHelpers::hasAVX2()) i = deinterleave_30bits_uint3_batch_avx2(pCodes, pValues, count);
+#endif
+        for (; i < count; i++) pValues[i] = deinterleave_30bits_uint3(pCodes[i]);
+    }
 }
@@ -1,11 +1,73 @@
 #pragma once
 #include "Falcor.h"
 #include "HimeMath.h"
+#include "HimeParallel.h"
 
 namespace Falcor
 {
     namespace MortonCodeHelpers
     {
+        /** Host version of computeMortonCodeByPos() in HimeMortonCode.slang.
+        */
+        inline uint computeMortonCodeByPos(const float3& pos, const uint quantLevels, const AABB& sceneBound)
+        {
+            float3 normPos = (pos - sceneBound.minPoint) / sceneBound.extent();
+            float3 quantPos = clamp(normPos * float(quantLevels), float3(0.f), float3(float(quantLevels - 1)));
+            return interleave_30bits_uint3(uint3(quantPos));
+        }
+
+#if HIME_CPU_X64
+        /** AVX2 part of computeMortonCodesByPos(), quantizes and interleaves whole groups of 8 points in [begin, end).
+            Same operation order as computeMortonCodeByPos(), results are bit identical.
+            \return First point not encoded, the rest is left to scalar code.
+        */
+        HIME_TARGET_AVX2 inline size_t computeMortonCodesByPosAVX2(const float3* pPos, size_t begin, size_t end, const uint quantLevels, const AABB& sceneBound, uint* pCodes)
+        {
+            const __m256i kStride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+            const __m256 kZero = _mm256_setzero_ps();
+            const __m256 kQuantLevels = _mm256_set1_ps(float(quantLevels));
+            const __m256 kMaxQuant = _mm256_set1_ps(float(quantLevels - 1));
+            const float3 extent = sceneBound.extent();
+            const __m256 kMin[3] = { _mm256_set1_ps(sceneBound.minPoint.x), _mm256_set1_ps(sceneBound.minPoint.y), _mm256_set1_ps(sceneBound.minPoint.z) };
+            const __m256 kExtent[3] = { _mm256_set1_ps(extent.x), _mm256_set1_ps(extent.y), _mm256_set1_ps(extent.z) };
+
+            size_t i = begin;
+            for (; i + 8 <= end; i += 8)
+            {
+                const float* pBase = (const float*)(pPos + i);
+                __m256i quantPos[3];
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    __m256 p = _mm256_i32gather_ps(pBase + axis, kStride, 4);
+                    __m256 normPos = _mm256_div_ps(_mm256_sub_ps(p, kMin[axis]), kExtent[axis]);
+                    quantPos[axis] = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(normPos, kQuantLevels), kZero), kMaxQuant));
+                }
+                _mm256_storeu_si256((__m256i*)(pCodes + i), interleave_30bits_uint3_avx2(quantPos[0], quantPos[1], quantPos[2]));
+            }
+            return i;
+        }
+#endif
+
+        /** Batch version of computeMortonCodeByPos(), runs across all cores.
+            Quantization and interleaving are done 8 points at a time with AVX2 if the CPU supports it.
+            \param[in] pPos Positions.
+            \param[in] count Number of positions.
+            \param[in] quantLevels Quantization levels per axis (at most 1024).
+            \param[in] sceneBound Cubic scene bound.
+            \param[out] pCodes Morton codes, pCodes[i] is the code of pPos[i].
+        */
+        inline void computeMortonCodesByPos(const float3* pPos, size_t count, const uint quantLevels, const AABB& sceneBound, uint* pCodes)
+        {
+            HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int)
+            {
+                size_t i = begin;
+#if HIME_CPU_X64
+                if (HimeCpuHelpers::hasAVX2()) i = computeMortonCodesByPosAVX2(pPos, begin, end, quantLevels, sceneBound, pCodes);
+#endif
+                for (; i < end; i++) pCodes[i] = computeMortonCodeByPos(pPos[i], quantLevels, sceneBound);
+            });
+        }
+
         inline float3 computePosByMortonCode(const uint mortonCode, const float quantLevels, const AABB& sceneBound)
         {
             float3 quantPos = float3(deinterleave_30bits_uint3(mortonCode)) / quantLevels;
@@ -13,11 +75,35 @@ namespace Falcor
             return pos;
         }
 
+        /** Batch version of computePosByMortonCode(), runs across all cores.
+            \param[in] pCodes Morton codes.
+            \param[in] count Number of codes.
+            \param[in] quantLevels Quantization levels per axis.
+            \param[in] sceneBound Cubic scene bound.
+            \param[out] pPos Positions, pPos[i] is the quantized position of pCodes[i].
+        */
+        inline void computePosByMortonCodes(const uint* pCodes, size_t count, const float quantLevels, const AABB& sceneBound, float3* pPos)
+        {
+            const size_t kBatchSize = 256;
+            const float3 extent = sceneBound.extent();
+            HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int)
+            {
+                uint3 quantPos[kBatchSize];
+                for (size_t batchBegin = begin; batchBegin < end; batchBegin += kBatchSize)
+                {
+                    size_t batchSize = std::min(kBatchSize, end - batchBegin);
+                    deinterleave_30bits_uint3_batch(pCodes + batchBegin, quantPos, batchSize);
+                    for (size_t i = 0; i < batchSize; i++) pPos[batchBegin + i] = float3(quantPos[i]) / quantLevels * extent + sceneBound.minPoint;
+                }
+            });
+        }
+
         inline AABB computeAABBByMortonCode(const uint mortonCode, const uint prefixLength, const float quantLevels, const AABB& sceneBound)
         {
-            uint maskMin = 0xFFFFFFFF << (30 - prefixLength);
+            const uint kCodeBits = MortonCodeTraits<10>::kCodeBits;
+            uint maskMin = 0xFFFFFFFF << (kCodeBits - prefixLength);
             uint mortonCodeMin = mortonCode & (maskMin);
-            uint maskMax = 1 << (30 - prefixLength);
+            uint maskMax = 1 << (kCodeBits - prefixLength);
             uint mortonCodeMax = mortonCode | (maskMax - 1);
 
             float3 minPos = computePosByMortonCode(mortonCodeMin, quantLevels, sceneBound);
@@ -28,9 +114,10 @@ namespace Falcor
 
         inline float3 computePosByMortonCode(const uint mortonCode, const uint prefixLength, const float quantLevels, const AABB& sceneBound)
         {
-            uint maskMin = 0xFFFFFFFF << (30 - prefixLength);
+            const uint kCodeBits = MortonCodeTraits<10>::kCodeBits;
+            uint maskMin = 0xFFFFFFFF << (kCodeBits - prefixLength);
             uint mortonCodeMin = mortonCode & (maskMin);
-            uint maskMax = 1 << (30 - prefixLength);
+            uint maskMax = 1 << (kCodeBits - prefixLength);
             uint mortonCodeMax = mortonCode | (maskMax - 1);
 
             float3 minPos = computePosByMortonCode(mortonCodeMin, quantLevels, sceneBound);
@@ -38,5 +125,50 @@ namespace Falcor
 
             return (minPos + maxPos) * 0.5f;
         }
+
+        /** Morton code helpers with code width selected by bits per axis (see MortonCodeTraits).
+            Quantization levels are always 2^BitsPerAxis.
+        */
+        template<uint BitsPerAxis>
+        using MortonCode = typename MortonCodeTraits<BitsPerAxis>::CodeType;
+
+        template<uint BitsPerAxis>
+        MortonCode<BitsPerAxis> computeMortonCodeByPos(const float3& pos, const AABB& sceneBound)
+        {
+            using Traits = MortonCodeTraits<BitsPerAxis>;
+            float3 normPos = (pos - sceneBound.minPoint) / sceneBound.extent();
+            float3 quantPos = clamp(normPos * float(Traits::kQuantLevels), float3(0.f), float3(float(Traits::kQuantLevels - 1)));
+            return Traits::interleave(uint3(quantPos));
+        }
+
+        template<uint BitsPerAxis>
+        float3 computePosByMortonCode(const MortonCode<BitsPerAxis> mortonCode, const AABB& sceneBound)
+        {
+            using Traits = MortonCodeTraits<BitsPerAxis>;
+            float3 quantPos = float3(Traits::deinterleave(mortonCode)) / float(Traits::kQuantLevels);
+            return quantPos * sceneBound.extent() + sceneBound.minPoint;
+        }
+
+        template<uint BitsPerAxis>
+        AABB computeAABBByMortonCode(const MortonCode<BitsPerAxis> mortonCode, const uint prefixLength, const AABB& sceneBound)
+        {
+            using Traits = MortonCodeTraits<BitsPerAxis>;
+            using CodeType = typename Traits::CodeType;
+            CodeType maskMin = ~CodeType(0) << (Traits::kCodeBits - prefixLength);
+            CodeType maskMax = CodeType(1) << (Traits::kCodeBits - prefixLength);
+
+            float3 minPos = computePosByMortonCode<BitsPerAxis>(mortonCode & maskMin, sceneBound);
+            float3 maxPos = computePosByMortonCode<BitsPerAxis>(mortonCode | (maskMax - 1), sceneBound);
+            return AABB(minPos, maxPos);
+        }
+
+        template<uint BitsPerAxis>
+        bool hasSameMortonCodePrefix(const MortonCode<BitsPerAxis> code1, const MortonCode<BitsPerAxis> code2, const uint prefixLength)
+        {
+            using Traits = MortonCodeTraits<BitsPerAxis>;
+            using CodeType = typename Traits::CodeType;
+            CodeType mask = ~CodeType(0) << (Traits::kCodeBits - prefixLength);
+            return (code1 & mask) == (code2 & mask);
+        }
     }
 }
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Falcor
+{
+    /** Minimal CPU parallel helpers.
+
+        Only depends on the standard library, so host-side algorithms built on top of it
+        can run on machines without GPU (and without the rest of Falcor).
+    */
+    namespace HimeParallelHelpers
+    {
+        /** Number of worker threads used by parallelFor.
+        */
+        inline unsigned int getWorkerCount()
+        {
+            unsigned int count = std::thread::hardware_concurrency();
+            return count == 0 ? 1 : count;
+        }
+
+        /** Number of chunks [begin, end) will be split into.
+            \param[in] count Number of elements.
+            \param[in] minChunkSize Elements below this size will not be split further.
+        */
+        inline unsigned int getChunkCount(size_t count, size_t minChunkSize)
+        {
+            size_t chunkCount = (count + minChunkSize - 1) / std::max<size_t>(minChunkSize, 1);
+            return (unsigned int)std::max<size_t>(1, std::min<size_t>(chunkCount, getWorkerCount()));
+        }
+
+        /** Persistent worker threads shared by all parallelFor calls.
+
+            Threads are created once on first use, a job only wakes them up instead of spawning new threads.
+            The calling thread runs tasks too, so the shared pool creates getWorkerCount() - 1 threads.
+            Jobs are run one at a time, nested jobs (issued from a running task) are run serially on the calling thread.
+        */
+        class ThreadPool
+        {
+        public:
+            static ThreadPool& get()
+            {
+                static ThreadPool sPool(getWorkerCount() - 1);
+                return sPool;
+            }
+
+            /** Create a pool of threadCount threads besides the calling thread, get() should be used except in tests.
+            */
+            explicit ThreadPool(unsigned int threadCount)
+            {
+                mWorkers.reserve(threadCount);
+                for (unsigned int i = 0; i < threadCount; i++) mWorkers.emplace_back([this]() { workerLoop(); });
+            }
+
+            ~ThreadPool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mIsStopping = true;
+                }
+                mWakeCondition.notify_all();
+                for (auto& worker : mWorkers) worker.join();
+            }
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            /** Run task(i) for i in [0, taskCount), returns when all tasks are done.
+            */
+            template<typename Task>
+            void run(unsigned int taskCount, Task& task)
+            {
+                run(taskCount, [](void* pTask, unsigned int taskIdx) { (*(Task*)pTask)(taskIdx); }, &task);
+            }
+
+            void run(unsigned int taskCount, void (*pFunc)(void*, unsigned int), void* pContext)
+            {
+                if (taskCount == 0) return;
+                if (taskCount == 1 || mWorkers.empty() || isInsideTask())
+                {
+                    for (unsigned int i = 0; i < taskCount; i++) pFunc(pContext, i);
+                    return;
+                }
+
+                std::lock_guard<std::mutex> jobLock(mJobMutex);
+                std::unique_lock<std::mutex> lock(mMutex);
+                mpFunc = pFunc;
+                mpContext = pContext;
+                mTaskCount = taskCount;
+                mNextTask = 0;
+                mPendingTaskCount = taskCount;
+                mJobId++;
+                mWakeCondition.notify_all();
+
+                runTasks(lock);
+                mDoneCondition.wait(lock, [this]() { return mPendingTaskCount == 0; });
+            }
+
+        private:
+            static bool& isInsideTask()
+            {
+                static thread_local bool sIsInsideTask = false;
+                return sIsInsideTask;
+            }
+
+            /** Take tasks of current job until none is left, mMutex is held by lock except while running a task.
+            */
+            void runTasks(std::unique_lock<std::mutex>& lock)
+            {
+                while (mNextTask < mTaskCount)
+                {
+                    unsigned int taskIdx = mNextTask++;
+                    auto pFunc = mpFunc;
+                    void* pContext = mpContext;
+
+                    lock.unlock();
+                    isInsideTask() = true;
+                    pFunc(pContext, taskIdx);
+                    isInsideTask() = false;
+                    lock.lock();
+
+                    if (--mPendingTaskCount == 0) mDoneCondition.notify_one();
+                }
+            }
+
+            void workerLoop()
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                uint64_t lastJobId = 0;
+                while (true)
+                {
+                    mWakeCondition.wait(lock, [&]() { return mIsStopping || mJobId != lastJobId; });
+                    if (mIsStopping) return;
+                    lastJobId = mJobId;
+                    runTasks(lock);
+                }
+            }
+
+            std::vector<std::thread> mWorkers;
+            std::mutex mJobMutex;                ///< Serializes jobs issued by different threads.
+            std::mutex mMutex;                   ///< Guards job states below.
+            std::condition_variable mWakeCondition;
+            std::condition_variable mDoneCondition;
+            void (*mpFunc)(void*, unsigned int) = nullptr;
+            void* mpContext = nullptr;
+            unsigned int mTaskCount = 0;
+            unsigned int mNextTask = 0;
+            unsigned int mPendingTaskCount = 0;
+            uint64_t mJobId = 0;
+            bool mIsStopping = false;
+        };
+
+        /** Split [begin, end) into contiguous chunks and run them on the shared ThreadPool.
+            Chunk i always covers the same range for the same input, which makes per-chunk
+            results (histograms, partial sums...) deterministic.
+            \param[in] begin First element.
+            \param[in] end One past the last element.
+            \param[in] func Callable as func(chunkBegin, chunkEnd, chunkIdx).
+            \param[in] minChunkSize Elements below this size will not be split further.
+        */
+        template<typename Func>
+        void parallelFor(size_t begin, size_t end, Func&& func, size_t minChunkSize = 4096)
+        {
+            if (end <= begin) return;
+
+            size_t count = end - begin;
+            unsigned int chunkCount = getChunkCount(count, minChunkSize);
+            if (chunkCount == 1)
+            {
+                func(begin, end, 0u);
+                return;
+            }
+
+            size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+            auto runChunk = [&](unsigned int chunkIdx)
+            {
+                size_t chunkBegin = std::min(end, begin + chunkIdx * chunkSize);
+                size_t chunkEnd = std::min(end, chunkBegin + chunkSize);
+                func(chunkBegin, chunkEnd, chunkIdx);
+            };
+            ThreadPool::get().run(chunkCount, runChunk);
+        }
+    }
+}
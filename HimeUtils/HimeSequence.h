@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "Falcor.h"
+
+namespace Falcor
+{
+    /** Low-discrepancy sequences and blue noise, generated once on first use and shared by all passes.
+        Host tables are header only and only need Falcor math, so CPU reference passes can use them without GPU.
+        HimeSequenceBuffers (HimeSequenceBuffers.h) uploads the same tables for HimeSequence.slang.
+    */
+    namespace HimeSequenceHelpers
+    {
+        const uint kSequenceLength = 8192; ///< Points per table, power of 2 so indices can wrap with a mask.
+        const uint kBlueNoiseSize = 64;    ///< Blue noise tile is kBlueNoiseSize x kBlueNoiseSize.
+
+        /** i-th point of R2 sequence (additive recurrence with plastic number), starting next to (0.5, 0.5).
+            Computed in double so points are accurate for large i, unlike accumulating in float.
+        */
+        inline float2 r2(uint i)
+        {
+            const double a1 = 1.0 / 1.32471795724474602596;
+            const double a2 = a1 * a1;
+            double n = double(i) + 1.0;
+            double x = 0.5 + a1 * n;
+            double y = 0.5 + a2 * n;
+            return float2(float(x - std::floor(x)), float(y - std::floor(y)));
+        }
+
+        /** i-th point of first two dimensions of Sobol sequence. First dimension is van der Corput (base 2 radical inverse),
+            second uses direction numbers of primitive polynomial x + 1. Any 2^k consecutive points starting at a multiple of 2^k
+            are stratified in both dimensions.
+        */
+        inline float2 sobol2D(uint i)
+        {
+            uint32_t x = 0;
+            uint32_t y = 0;
+            uint32_t v = 1u << 31;
+            for (uint32_t bits = i; bits != 0; bits >>= 1)
+            {
+                if (bits & 1) y ^= v;
+                v ^= v >> 1;
+            }
+            for (uint32_t bit = 0; bit < 32; bit++)
+            {
+                if (i & (1u << bit)) x |= 1u << (31 - bit);
+            }
+            return float2(float(x >> 8) * (1.f / 16777216.f), float(y >> 8) * (1.f / 16777216.f));
+        }
+
+        /** First count points of R2 sequence in [0, 1)^2.
+        */
+        inline std::vector<float2> generateR2(uint count)
+        {
+            std::vector<float2> points(count);
+            for (uint i = 0; i < count; i++) points[i] = r2(i);
+            return points;
+        }
+
+        /** R2 points inside disk of radius 0.5, centered at origin. Points outside the disk are rejected, so neighbors in
+            table are still well distributed in the disk.
+        */
+        inline std::vector<float2> generateR2Disk(uint count)
+        {
+            std::vector<float2> points;
+            points.reserve(count);
+            for (uint i = 0; points.size() < count; i++)
+            {
+                float2 p = r2(i) - float2(0.5f);
+                if (p.x * p.x + p.y * p.y <= 0.25f) points.push_back(p);
+            }
+            return points;
+        }
+
+        /** First count points of 2D Sobol sequence in [0, 1)^2.
+        */
+        inline std::vector<float2> generateSobol(uint count)
+        {
+            std::vector<float2> points(count);
+            for (uint i = 0; i < count; i++) points[i] = sobol2D(i);
+            return points;
+        }
+
+        /** Tileable blue noise of size x size values in [0, 1), row major, made by void and cluster (Ulichney 1993).
+
+            Energy of a pixel is the sum of a toroidal Gaussian (sigma 1.5) of all set pixels. The initial pattern sets a tenth
+            of pixels at R2 points and is relaxed by moving the tightest cluster into the largest void until it's stable.
+            Pixels of the initial pattern are ranked by removing tightest clusters, others by filling largest voids, and
+            value of a pixel is its rank. Each step is O(size^2), O(size^4) in total, so it's only run once.
+        */
+        inline std::vector<float> generateBlueNoise(uint size)
+        {
+            const uint count = size * size;
+            const float kSigma = 1.5f;
+
+            std::vector<float> kernel(count);
+            for (uint y = 0; y < size; y++)
+            {
+                for (uint x = 0; x < size; x++)
+                {
+                    float dx = float(std::min(x, size - x));
+                    float dy = float(std::min(y, size - y));
+                    kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.f * kSigma * kSigma));
+                }
+            }
+
+            auto splat = [&](std::vector<float>& energy, uint idx, float sign)
+            {
+                uint px = idx % size, py = idx / size;
+                for (uint y = 0; y < size; y++)
+                {
+                    const float* pKernel = kernel.data() + ((y + size - py) % size) * size;
+                    float* pEnergy = energy.data() + y * size;
+                    for (uint x = 0; x < size; x++) pEnergy[x] += sign * pKernel[(x + size - px) % size];
+                }
+            };
+            // Tightest cluster is the set pixel with max energy, largest void is the unset pixel with min energy.
+            auto findExtreme = [&](const std::vector<float>& energy, const std::vector<uint8_t>& pattern, uint8_t isSet)
+            {
+                uint best = 0;
+                float bestEnergy = isSet ? -FLT_MAX : FLT_MAX;
+                for (uint i = 0; i < count; i++)
+                {
+                    if (pattern[i] != isSet) continue;
+                    if (isSet ? energy[i] > bestEnergy : energy[i] < bestEnergy)
+                    {
+                        best = i;
+                        bestEnergy = energy[i];
+                    }
+                }
+                return best;
+            };
+
+            // Initial pattern.
+            std::vector<uint8_t> pattern(count, 0);
+            std::vector<float> energy(count, 0.f);
+            uint setCount = 0;
+            for (uint i = 0; setCount < std::max(count / 10, 1u) && i < 16 * count; i++)
+            {
+                float2 p = r2(i);
+                uint idx = std::min(uint(p.y * size), size - 1) * size + std::min(uint(p.x * size), size - 1);
+                if (pattern[idx]) continue;
+                pattern[idx] = 1;
+                splat(energy, idx, 1.f);
+                setCount++;
+            }
+            for (uint iter = 0; iter < count; iter++)
+            {
+                uint cluster = findExtreme(energy, pattern, 1);
+                pattern[cluster] = 0;
+                splat(energy, cluster, -1.f);
+                uint hole = findExtreme(energy, pattern, 0);
+                pattern[hole] = 1;
+                splat(energy, hole, 1.f);
+                if (hole == cluster) break;
+            }
+
+            std::vector<float> values(count);
+            auto setRank = [&](uint idx, uint rank) { values[idx] = (float(rank) + 0.5f) / float(count); };
+
+            // Rank initial pattern from its tightest clusters.
+            {
+                std::vector<uint8_t> removePattern = pattern;
+                std::vector<float> removeEnergy = energy;
+                for (uint rank = setCount; rank-- > 0;)
+                {
+                    uint cluster = findExtreme(removeEnergy, removePattern, 1);
+                    removePattern[cluster] = 0;
+                    splat(removeEnergy, cluster, -1.f);
+                    setRank(cluster, rank);
+                }
+            }
+
+            // Rank other pixels by filling largest voids.
+            for (uint rank = setCount; rank < count; rank++)
+            {
+                uint hole = findExtreme(energy, pattern, 0);
+                pattern[hole] = 1;
+                splat(energy, hole, 1.f);
+                setRank(hole, rank);
+            }
+            return values;
+        }
+
+        /** Shared tables of kSequenceLength points, generated on first call. Thread safe.
+        */
+        inline const std::vector<float2>& getR2() { static const std::vector<float2> table = generateR2(kSequenceLength); return table; }
+        inline const std::vector<float2>& getR2Disk() { static const std::vector<float2> table = generateR2Disk(kSequenceLength); return table; }
+        inline const std::vector<float2>& getSobol() { static const std::vector<float2> table = generateSobol(kSequenceLength); return table; }
+        inline const std::vector<float>& getBlueNoise() { static const std::vector<float> table = generateBlueNoise(kBlueNoiseSize); return table; }
+
+        /** Rotation added to samples each time sampleIdx wraps around the tables, so sample i + k * kSequenceLength is not a
+            repeat of sample i. It's the k-th point of R2 sequence (zero for k = 0) in 0.32 fixed point, so host and
+            getSequenceWrapRotation() in HimeSequence.slang give the same bits. Rotation keeps stratification of each wrap.
+        */
+        inline float2 getSequenceWrapRotation(uint sampleIdx)
+        {
+            uint32_t wrapIdx = sampleIdx / kSequenceLength;
+            uint32_t x = wrapIdx * 3242174889u; // 2^32 / plastic number
+            uint32_t y = wrapIdx * 2447445414u; // 2^32 / plastic number^2
+            return float2(float(x >> 8) * (1.f / 16777216.f), float(y >> 8) * (1.f / 16777216.f));
+        }
+
+        /** Host version of getBlueNoise() in HimeSequence.slang.
+        */
+        inline float getBlueNoise(uint2 pixel)
+        {
+            return getBlueNoise()[(pixel.y % kBlueNoiseSize) * kBlueNoiseSize + pixel.x % kBlueNoiseSize];
+        }
+
+        /** Host version of sampleSobol1D() in HimeSequence.slang.
+        */
+        inline float sampleSobol1D(uint2 pixel, uint sampleIdx)
+        {
+            float u = getSobol()[sampleIdx & (kSequenceLength - 1)].x + getBlueNoise(pixel) + getSequenceWrapRotation(sampleIdx).x;
+            return u - std::floor(u);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#include "HimeSequenceBuffers.h"
+
+namespace Falcor
+{
+    namespace
+    {
+        template<typename T>
+        Buffer::SharedPtr createTableBuffer(const std::vector<T>& table, const std::string& name)
+        {
+            Buffer::SharedPtr pBuffer = Buffer::createStructured(sizeof(T), (uint32_t)table.size(), ResourceBindFlags::ShaderResource, Buffer::CpuAccess::None, table.data(), false);
+            pBuffer->setName(name);
+            return pBuffer;
+        }
+    }
+
+    HimeSequenceBuffers::HimeSequenceBuffers()
+    {
+        mpR2Buffer = createTableBuffer(HimeSequenceHelpers::getR2(), "HimeSequenceBuffers::R2");
+        mpR2DiskBuffer = createTableBuffer(HimeSequenceHelpers::getR2Disk(), "HimeSequenceBuffers::R2Disk");
+        mpSobolBuffer = createTableBuffer(HimeSequenceHelpers::getSobol(), "HimeSequenceBuffers::Sobol");
+        mpBlueNoiseBuffer = createTableBuffer(HimeSequenceHelpers::getBlueNoise(), "HimeSequenceBuffers::BlueNoise");
+    }
+
+    HimeSequenceBuffers::SharedPtr HimeSequenceBuffers::get()
+    {
+        // Weak reference, so buffers are not released after the device at exit.
+        static std::weak_ptr<HimeSequenceBuffers> sInstance;
+        SharedPtr pInstance = sInstance.lock();
+        if (pInstance == nullptr)
+        {
+            pInstance = SharedPtr(new HimeSequenceBuffers());
+            sInstance = pInstance;
+        }
+        return pInstance;
+    }
+
+    void HimeSequenceBuffers::setShaderData(ShaderVar var) const
+    {
+        var["gHimeR2Sequence"] = mpR2Buffer;
+        var["gHimeR2DiskSequence"] = mpR2DiskBuffer;
+        var["gHimeSobolSequence"] = mpSobolBuffer;
+        var["gHimeBlueNoise"] = mpBlueNoiseBuffer;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "Falcor.h"
+#include "HimeUtils.h"
+#include "HimeSequence.h"
+
+namespace Falcor
+{
+    /** GPU copies of HimeSequenceHelpers tables, bound to global variables of HimeSequence.slang.
+        Passes share one instance, which is created on first get() and released with the last pass holding it.
+    */
+    class HIME_UTILS_DECL HimeSequenceBuffers
+    {
+    public:
+        using SharedPtr = std::shared_ptr<HimeSequenceBuffers>;
+
+        static SharedPtr get();
+
+        const Buffer::SharedPtr& getR2Buffer() const { return mpR2Buffer; }
+        const Buffer::SharedPtr& getR2DiskBuffer() const { return mpR2DiskBuffer; }
+        const Buffer::SharedPtr& getSobolBuffer() const { return mpSobolBuffer; }
+        const Buffer::SharedPtr& getBlueNoiseBuffer() const { return mpBlueNoiseBuffer; }
+
+        /** Bind all tables.
+            \param[in] var Root variable of a program importing HimeSequence.slang.
+        */
+        void setShaderData(ShaderVar var) const;
+
+    private:
+        HimeSequenceBuffers();
+
+        Buffer::SharedPtr mpR2Buffer;
+        Buffer::SharedPtr mpR2DiskBuffer;
+        Buffer::SharedPtr mpSobolBuffer;
+        Buffer::SharedPtr mpBlueNoiseBuffer;
+    };
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <emmintrin.h>
+#include "HimeMath.h"
+
+namespace Falcor
+{
+    /** Minimal fixed width float vector for host side kernels.
+        SimdFloat<4> uses SSE (always available on x64), SimdFloat<8> uses two SSE halves, and SimdFloatAVX2 is the AVX2
+        version of SimdFloat<8> for kernels dispatched at runtime.
+        Loads and stores require 16-byte (4 lanes) or 32-byte (8 lanes) alignment.
+        Comparisons return lane masks, which are only used by select().
+        loadUnaligned() and storeUnaligned() have no alignment requirement.
+    */
+    template<uint32_t Width>
+    struct SimdFloat;
+
+    template<>
+    struct SimdFloat<4>
+    {
+        __m128 v;
+
+        static SimdFloat load(const float* p) { return { _mm_load_ps(p) }; }
+        static SimdFloat loadUnaligned(const float* p) { return { _mm_loadu_ps(p) }; }
+        static SimdFloat set1(float f) { return { _mm_set1_ps(f) }; }
+        void store(float* p) const { _mm_store_ps(p, v); }
+        void storeUnaligned(float* p) const { _mm_storeu_ps(p, v); }
+
+        friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return { _mm_add_ps(a.v, b.v) }; }
+        friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return { _mm_sub_ps(a.v, b.v) }; }
+        friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return { _mm_mul_ps(a.v, b.v) }; }
+        friend SimdFloat operator/(SimdFloat a, SimdFloat b) { return { _mm_div_ps(a.v, b.v) }; }
+        friend SimdFloat operator>(SimdFloat a, SimdFloat b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+        friend SimdFloat min(SimdFloat a, SimdFloat b) { return { _mm_min_ps(a.v, b.v) }; }
+        friend SimdFloat max(SimdFloat a, SimdFloat b) { return { _mm_max_ps(a.v, b.v) }; }
+        friend SimdFloat sqrt(SimdFloat a) { return { _mm_sqrt_ps(a.v) }; }
+        friend SimdFloat abs(SimdFloat a) { return { _mm_andnot_ps(_mm_set1_ps(-0.f), a.v) }; }
+        friend SimdFloat round(SimdFloat a) { return { _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)) }; } ///< Nearest integer, |a| < 2^31.
+
+        /** 2^n for integer n in [-126, 127].
+        */
+        friend SimdFloat exp2i(SimdFloat n) { return { _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n.v), _mm_set1_epi32(127)), 23)) }; }
+
+        /** mask ? a : b, per lane.
+        */
+        friend SimdFloat select(SimdFloat mask, SimdFloat a, SimdFloat b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+    };
+
+    template<>
+    struct SimdFloat<8>
+    {
+        SimdFloat<4> lo, hi;
+
+        static SimdFloat load(const float* p) { return { SimdFloat<4>::load(p), SimdFloat<4>::load(p + 4) }; }
+        static SimdFloat loadUnaligned(const float* p) { return { SimdFloat<4>::loadUnaligned(p), SimdFloat<4>::loadUnaligned(p + 4) }; }
+        static SimdFloat set1(float f) { return { SimdFloat<4>::set1(f), SimdFloat<4>::set1(f) }; }
+        void store(float* p) const { lo.store(p); hi.store(p + 4); }
+        void storeUnaligned(float* p) const { lo.storeUnaligned(p); hi.storeUnaligned(p + 4); }
+
+        friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return { a.lo + b.lo, a.hi + b.hi }; }
+        friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return { a.lo - b.lo, a.hi - b.hi }; }
+        friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return { a.lo * b.lo, a.hi * b.hi }; }
+        friend SimdFloat operator/(SimdFloat a, SimdFloat b) { return { a.lo / b.lo, a.hi / b.hi }; }
+        friend SimdFloat operator>(SimdFloat a, SimdFloat b) { return { a.lo > b.lo, a.hi > b.hi }; }
+        friend SimdFloat min(SimdFloat a, SimdFloat b) { return { min(a.lo, b.lo), min(a.hi, b.hi) }; }
+        friend SimdFloat max(SimdFloat a, SimdFloat b) { return { max(a.lo, b.lo), max(a.hi, b.hi) }; }
+        friend SimdFloat sqrt(SimdFloat a) { return { sqrt(a.lo), sqrt(a.hi) }; }
+        friend SimdFloat abs(SimdFloat a) { return { abs(a.lo), abs(a.hi) }; }
+        friend SimdFloat round(SimdFloat a) { return { round(a.lo), round(a.hi) }; }
+        friend SimdFloat exp2i(SimdFloat n) { return { exp2i(n.lo), exp2i(n.hi) }; }
+        friend SimdFloat select(SimdFloat mask, SimdFloat a, SimdFloat b) { return { select(mask.lo, a.lo, b.lo), select(mask.hi, a.hi, b.hi) }; }
+    };
+
+#if HIME_CPU_X64
+    /** 8 lanes on AVX registers for kernels dispatched at runtime, same interface as SimdFloat<8>. Members are HIME_TARGET_AVX2,
+        so it's only used after HimeCpuHelpers::hasAVX2() and inside HIME_TARGET_AVX2_KERNEL functions, which inline them.
+    */
+    struct SimdFloatAVX2
+    {
+        __m256 v;
+
+        HIME_TARGET_AVX2 static SimdFloatAVX2 load(const float* p) { return { _mm256_load_ps(p) }; }
+        HIME_TARGET_AVX2 static SimdFloatAVX2 loadUnaligned(const float* p) { return { _mm256_loadu_ps(p) }; }
+        HIME_TARGET_AVX2 static SimdFloatAVX2 set1(float f) { return { _mm256_set1_ps(f) }; }
+        HIME_TARGET_AVX2 void store(float* p) const { _mm256_store_ps(p, v); }
+        HIME_TARGET_AVX2 void storeUnaligned(float* p) const { _mm256_storeu_ps(p, v); }
+
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 operator+(SimdFloatAVX2 a, SimdFloatAVX2 b) { return { _mm256_add_ps(a.v, b.v) }; }
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 operator-(SimdFloatAVX2 a, SimdFloatAVX2 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 operator*(SimdFloatAVX2 a, SimdFloatAVX2 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 operator/(SimdFloatAVX2 a, SimdFloatAVX2 b) { return { _mm256_div_ps(a.v, b.v) }; }
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 operator>(SimdFloatAVX2 a, SimdFloatAVX2 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 min(SimdFloatAVX2 a, SimdFloatAVX2 b) { return { _mm256_min_ps(a.v, b.v) }; }
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 max(SimdFloatAVX2 a, SimdFloatAVX2 b) { return { _mm256_max_ps(a.v, b.v) }; }
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 sqrt(SimdFloatAVX2 a) { return { _mm256_sqrt_ps(a.v) }; }
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 abs(SimdFloatAVX2 a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v) }; }
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 round(SimdFloatAVX2 a) { return { _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) }; }
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 exp2i(SimdFloatAVX2 n) { return { _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127)), 23)) }; }
+        HIME_TARGET_AVX2 friend SimdFloatAVX2 select(SimdFloatAVX2 mask, SimdFloatAVX2 a, SimdFloatAVX2 b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+    };
+#endif
+
+    /** 2^x for x <= 0, Simd is SimdFloat<Width> or SimdFloatAVX2. Cephes exp2f polynomial on [-0.5, 0.5], relative error
+        is below 2.5e-7 (about 4 ulp) for x in [-125, 0], and fastExp2(0) is exactly 1. x above 0 is clamped to 0.
+        x below -125 flushes to 0: results there would be denormal, which exp2i() can't build, and edge-stopping weights
+        that small are 0 to float precision anyway.
+    */
+    template<typename Simd>
+    Simd fastExp2(Simd x)
+    {
+        const Simd kMinExponent = Simd::set1(-125.f);
+        Simd underflow = kMinExponent > x;
+        x = min(max(x, kMinExponent), Simd::set1(0.f));
+        Simd n = round(x);
+        Simd f = x - n;
+        Simd p = Simd::set1(1.535336188319500e-4f);
+        p = p * f + Simd::set1(1.339887440266574e-3f);
+        p = p * f + Simd::set1(9.618437357674640e-3f);
+        p = p * f + Simd::set1(5.550332471162809e-2f);
+        p = p * f + Simd::set1(2.402264791363012e-1f);
+        p = p * f + Simd::set1(6.931472028550421e-1f);
+        return select(underflow, Simd::set1(0.f), (p * f + Simd::set1(1.f)) * exp2i(n));
+    }
+
+    /** e^x for x <= 0, same error as fastExp2() for x >= -86.6, and 0 below.
+    */
+    template<typename Simd>
+    Simd fastExp(Simd x)
+    {
+        return fastExp2(x * Simd::set1(1.44269504f));
+    }
+}
@@ -76,6 +76,38 @@ void HimeBufferHelpers::copyBufferBackToCPU(Buffer::SharedPtr& pBuffer, uint ele
     pBuffer->unmap();
 }
 
+HimeAsyncReadback::HimeAsyncReadback()
+{
+    mpFence = GpuFence::create();
+}
+
+void HimeAsyncReadback::copy(RenderContext* pRenderContext, const Buffer::SharedPtr& pBuffer, uint64_t offset, uint64_t size)
+{
+    if (mpStagingBuffer == nullptr || mpStagingBuffer->getSize() < size)
+    {
+        mpStagingBuffer = Buffer::create(size, ResourceBindFlags::None, Buffer::CpuAccess::Read, nullptr);
+        mpStagingBuffer->setName("HimeAsyncReadback::StagingBuffer");
+    }
+
+    pRenderContext->copyBufferRegion(mpStagingBuffer.get(), 0, pBuffer.get(), offset, size);
+    pRenderContext->flush(false);
+    mFenceValue = mpFence->gpuSignal(pRenderContext->getLowLevelData()->getCommandQueue());
+    mSize = size;
+    mIsPending = true;
+}
+
+bool HimeAsyncReadback::read(void* pCpuData, uint64_t size)
+{
+    if (!isReady()) return false;
+
+    // Staging buffer is CPU readable, so map doesn't wait.
+    void const* pGpuData = mpStagingBuffer->map(Buffer::MapType::Read);
+    memcpy(pCpuData, pGpuData, std::min(size, mSize));
+    mpStagingBuffer->unmap();
+    mIsPending = false;
+    return true;
+}
+
 void MortonCodeHelpers::updateShaderVar(ShaderVar var, uint kQuantLevels, const AABB& sceneBound)
 {
     var["PerFrameMortonCodeCB"]["quantLevels"] = kQuantLevels;
@@ -30,6 +30,40 @@ namespace Falcor
         // [Hime]TODO: templates
     }
 
+    /** Copy a GPU buffer range back to CPU without waiting for GPU.
+        copy() records the copy and submits the command list, read() returns false until GPU has finished it,
+        so results arrive one or more frames late. A new copy() replaces the pending one.
+    */
+    class HIME_UTILS_DECL HimeAsyncReadback
+    {
+    public:
+        using SharedPtr = std::shared_ptr<HimeAsyncReadback>;
+        static SharedPtr create() { return SharedPtr(new HimeAsyncReadback()); }
+
+        void copy(RenderContext* pRenderContext, const Buffer::SharedPtr& pBuffer, uint64_t offset, uint64_t size);
+
+        /** Copy finished data to pCpuData and consume the pending copy.
+            \return False if there is no pending copy or GPU has not finished it.
+        */
+        bool read(void* pCpuData, uint64_t size);
+
+        /** Drop the pending copy, used when its data is out of date.
+        */
+        void discard() { mIsPending = false; }
+
+        bool isPending() const { return mIsPending; } ///< True if a copy is not read yet.
+        bool isReady() const { return mIsPending && mpFence->getGpuValue() >= mFenceValue; } ///< True if read() won't fail.
+
+    private:
+        HimeAsyncReadback();
+
+        Buffer::SharedPtr mpStagingBuffer;
+        GpuFence::SharedPtr mpFence;
+        uint64_t mFenceValue = 0;
+        uint64_t mSize = 0;
+        bool mIsPending = false;
+    };
+
     namespace MortonCodeHelpers
     {
         void HIME_UTILS_DECL updateShaderVar(ShaderVar var, uint kQuantLevels, const AABB& sceneBound);
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "../HimeParallel.h"
+
+namespace Falcor
+{
+    /** Multi-threaded LSD radix sort for key-index pairs on CPU.
+
+        With 32-bit keys, pairs share the layout of HimeBitonicSort's 64-bit mode (uint2(index, key)), so a
+        key-index buffer copied back from GPU can be sorted in place and uploaded again. 64-bit keys are
+        used by 63-bit morton codes. Only the pairs are moved while sorting, payloads are reordered once
+        with gather().
+
+        Header only and standard library only, which means it also works on machines without GPU.
+    */
+    template<typename KeyType>
+    class HimeRadixSorter
+    {
+    public:
+        using SharedPtr = std::shared_ptr<HimeRadixSorter>;
+
+        struct KeyIndexPair
+        {
+            uint32_t index;
+            KeyType key;
+        };
+        static_assert(sizeof(KeyType) != 4 || sizeof(KeyIndexPair) == 8, "KeyIndexPair must match uint2 layout on GPU");
+
+        static const uint32_t kRadixBits = 8;
+        static const uint32_t kBucketCount = 1 << kRadixBits;
+        static const size_t kMinChunkSize = 16384; ///< Below this, a chunk is not worth a thread.
+
+        static constexpr uint32_t kMaxKeyBits = sizeof(KeyType) * 8;
+
+        static SharedPtr create() { return SharedPtr(new HimeRadixSorter()); }
+
+        /** Sort key-index pairs by key, ascending. The sort is stable.
+            \param[in,out] pPairs Pairs to sort.
+            \param[in] count Number of pairs.
+            \param[in] keyBits Number of significant low bits in keys (30 or 63 for morton codes).
+        */
+        void sort(KeyIndexPair* pPairs, size_t count, uint32_t keyBits = kMaxKeyBits)
+        {
+            if (count < 2) return;
+
+            mScratch.resize(count);
+            KeyIndexPair* pSrc = pPairs;
+            KeyIndexPair* pDst = mScratch.data();
+
+            const unsigned int chunkCount = HimeParallelHelpers::getChunkCount(count, kMinChunkSize);
+            mHistograms.resize(chunkCount);
+
+            const uint32_t passCount = (std::min(keyBits, kMaxKeyBits) + kRadixBits - 1) / kRadixBits;
+            for (uint32_t pass = 0; pass < passCount; pass++)
+            {
+                const uint32_t shift = pass * kRadixBits;
+
+                // Per chunk digit histogram.
+                HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int chunkIdx)
+                {
+                    auto& histogram = mHistograms[chunkIdx];
+                    histogram.fill(0);
+                    for (size_t i = begin; i < end; i++) histogram[(pSrc[i].key >> shift) & (kBucketCount - 1)]++;
+                }, kMinChunkSize);
+
+                // Skip this pass if all keys share the same digit.
+                bool isTrivialPass = false;
+                for (uint32_t bucket = 0; bucket < kBucketCount; bucket++)
+                {
+                    size_t bucketCount = 0;
+                    for (unsigned int c = 0; c < chunkCount; c++) bucketCount += mHistograms[c][bucket];
+                    if (bucketCount == 0) continue;
+                    isTrivialPass = bucketCount == count;
+                    break;
+                }
+                if (isTrivialPass) continue;
+
+                // Exclusive prefix sum, bucket major and chunk minor, which keeps the sort stable.
+                size_t offset = 0;
+                for (uint32_t bucket = 0; bucket < kBucketCount; bucket++)
+                {
+                    for (unsigned int c = 0; c < chunkCount; c++)
+                    {
+                        size_t bucketCount = mHistograms[c][bucket];
+                        mHistograms[c][bucket] = offset;
+                        offset += bucketCount;
+                    }
+                }
+
+                // Scatter.
+                HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int chunkIdx)
+                {
+                    auto& offsets = mHistograms[chunkIdx];
+                    for (size_t i = begin; i < end; i++) pDst[offsets[(pSrc[i].key >> shift) & (kBucketCount - 1)]++] = pSrc[i];
+                }, kMinChunkSize);
+
+                std::swap(pSrc, pDst);
+            }
+
+            if (pSrc != pPairs) std::memcpy(pPairs, pSrc, count * sizeof(KeyIndexPair));
+        }
+
+        /** Reorder payloads by sorted pairs: pDst[i] = pSrc[pPairs[i].index].
+        */
+        template<typename T>
+        static void gather(const T* pSrc, const KeyIndexPair* pPairs, size_t count, T* pDst)
+        {
+            HimeParallelHelpers::parallelFor(0, count, [&](size_t begin, size_t end, unsigned int)
+            {
+                for (size_t i = begin; i < end; i++) pDst[i] = pSrc[pPairs[i].index];
+            }, kMinChunkSize);
+        }
+
+    private:
+        HimeRadixSorter() = default;
+
+        std::vector<KeyIndexPair> mScratch;
+        std::vector<std::array<size_t, kBucketCount>> mHistograms;
+    };
+
+    using HimeRadixSort = HimeRadixSorter<uint32_t>;
+    using HimeRadixSort64 = HimeRadixSorter<uint64_t>;
+}
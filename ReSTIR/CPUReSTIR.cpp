@@ -0,0 +1,520 @@
+#include "CPUReSTIR.h"
+#include <atomic>
+#include <chrono>
+#include "../HimeUtils/HimeParallel.h"
+#include "../HimeUtils/HimeGBufferCodec.h"
+#include "ReservoirResampling.slangh"
+
+namespace Falcor
+{
+    namespace
+    {
+        /** Per-pixel random number generator, PCG hash of pixel, frame and pass.
+        */
+        struct RandomState
+        {
+            uint state;
+
+            static uint hash(uint v)
+            {
+                uint state = v * 747796405u + 2891336453u;
+                uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+                return (word >> 22u) ^ word;
+            }
+
+            static RandomState create(uint2 pixel, uint frameCount, uint passIdx)
+            {
+                return { hash(pixel.x + hash(pixel.y + hash(frameCount * 4 + passIdx))) };
+            }
+
+            float next()
+            {
+                state = hash(state);
+                return (state >> 8) * (1.f / 16777216.f);
+            }
+
+            float2 next2D()
+            {
+                float x = next();
+                return float2(x, next());
+            }
+        };
+
+        enum PassIndex : uint
+        {
+            InitialSample = 0,
+            TemporalResample,
+            SpatialResample,
+        };
+
+        float luminance(const float3& rgb) { return dot(rgb, float3(0.2126f, 0.7152f, 0.0722f)); }
+        bool isInside(int2 pixel, uint2 dim) { return pixel.x >= 0 && pixel.y >= 0 && pixel.x < (int)dim.x && pixel.y < (int)dim.y; }
+    }
+
+    void CPUReSTIR::ReservoirBuffer::resize(size_t count)
+    {
+        lightData.assign(count, 0);
+        uvData.assign(count, 0);
+        distanceAge.assign(count, 0);
+        M.assign(count, 0);
+        targetPdf.assign(count, 0.f);
+        weight.assign(count, 0.f);
+    }
+
+    void CPUReSTIR::ReservoirBuffer::store(size_t idx, const ReservoirData& uncompressedReservoir)
+    {
+        const ReservoirData reservoir = isCompact ? CompactReservoir::unpack(CompactReservoir::pack(uncompressedReservoir)) : uncompressedReservoir;
+        int2 clampedSpatialDistance = clamp(reservoir.spatialDistance, int2(-ReservoirData::c_MaxDistance), int2(ReservoirData::c_MaxDistance));
+        int clampedAge = std::min(std::max((int)reservoir.age, 0), (int)ReservoirData::c_MaxAge);
+
+        lightData[idx] = reservoir.lightData;
+        uvData[idx] = reservoir.uvData;
+        distanceAge[idx] =
+              ((clampedSpatialDistance.x & ReservoirData::c_DistanceMask) << ReservoirData::c_DistanceXShift)
+            | ((clampedSpatialDistance.y & ReservoirData::c_DistanceMask) << ReservoirData::c_DistanceYShift)
+            | (clampedAge << ReservoirData::c_AgeShift);
+        M[idx] = reservoir.M;
+        targetPdf[idx] = reservoir.targetPdf;
+        weight[idx] = reservoir.weightSum;
+    }
+
+    ReservoirData CPUReSTIR::ReservoirBuffer::load(size_t idx) const
+    {
+        ReservoirData res;
+        res.lightData = lightData[idx];
+        res.uvData = uvData[idx];
+        res.targetPdf = targetPdf[idx];
+        res.weightSum = weight[idx];
+        res.M = M[idx];
+        // Sign extend the shift values
+        res.spatialDistance.x = int(distanceAge[idx] << (32 - ReservoirData::c_DistanceXShift - ReservoirData::c_DistanceChannelBits)) >> (32 - ReservoirData::c_DistanceChannelBits);
+        res.spatialDistance.y = int(distanceAge[idx] << (32 - ReservoirData::c_DistanceYShift - ReservoirData::c_DistanceChannelBits)) >> (32 - ReservoirData::c_DistanceChannelBits);
+        res.age = distanceAge[idx] >> ReservoirData::c_AgeShift;
+
+        // Discard reservoirs that have Inf/NaN
+        if (std::isinf(res.weightSum) || std::isnan(res.weightSum)) res = createEmptyReservoir();
+        return res;
+    }
+
+    PackedReservoirData CPUReSTIR::ReservoirBuffer::getPacked(size_t idx) const
+    {
+        PackedReservoirData data;
+        data.lightData = lightData[idx];
+        data.uvData = uvData[idx];
+        data.distanceAge = distanceAge[idx];
+        data.M = M[idx];
+        data.targetPdf = targetPdf[idx];
+        data.weight = weight[idx];
+        return data;
+    }
+
+    void CPUReSTIR::setLights(const std::vector<Light>& lights)
+    {
+        mLights = lights;
+        mLightNormals.resize(lights.size());
+        mLightAreas.resize(lights.size());
+
+        std::vector<float> weights(lights.size());
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            float3 n = cross(lights[i].vertices[1] - lights[i].vertices[0], lights[i].vertices[2] - lights[i].vertices[0]);
+            float len = length(n);
+            mLightNormals[i] = len > 0.f ? n / len : float3(0);
+            mLightAreas[i] = 0.5f * len;
+            weights[i] = lights[i].flux;
+        }
+
+        mLightAliasTable.resize(lights.size());
+        double fluxSum = mpAliasTableBuilder->build(weights.data(), weights.size(), mLightAliasTable.data());
+        mInvFluxSum = fluxSum > 0.0 ? (float)(1.0 / fluxSum) : 0.f;
+    }
+
+    bool CPUReSTIR::sampleTriangle(const float3& posW, uint lightIdx, float2 u, LightSample& ls) const
+    {
+        // Uniform point on triangle, same as sample_triangle().
+        float su = std::sqrt(u.x);
+        float2 b = float2(1.f - su, u.y * su);
+        float3 barycentrics = float3(1.f - b.x - b.y, b.x, b.y);
+
+        const Light& light = mLights[lightIdx];
+        ls.posW = light.vertices[0] * barycentrics.x + light.vertices[1] * barycentrics.y + light.vertices[2] * barycentrics.z;
+
+        float3 toLight = ls.posW - posW;
+        float distSqr = std::max(FLT_MIN, dot(toLight, toLight));
+        ls.dir = toLight / std::sqrt(distSqr);
+
+        // Emissive triangles are single sided, pdf is converted to solid angle.
+        float cosTheta = dot(mLightNormals[lightIdx], -ls.dir);
+        if (cosTheta <= 0.f || mLightAreas[lightIdx] == 0.f) return false;
+        ls.pdf = distSqr / (cosTheta * mLightAreas[lightIdx]);
+        ls.Le = light.radiance;
+        return ls.pdf > 0.f;
+    }
+
+    void CPUReSTIR::presampleLights(uint frameCount, uint sampleCount, std::vector<PresampledLight>& lightTiles) const
+    {
+        lightTiles.resize(sampleCount);
+        if (mLights.empty())
+        {
+            std::fill(lightTiles.begin(), lightTiles.end(), PresampledLight());
+            return;
+        }
+
+        const uint lightCount = (uint)mLights.size();
+        HimeParallelHelpers::parallelFor(0, sampleCount, [&](size_t begin, size_t end, unsigned int)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                const uint sampleIdx = (uint)i;
+                uint idx = std::min((uint)(PresampledLight::getRandom(sampleIdx, frameCount, 0) * lightCount), lightCount - 1);
+                uint lightIdx = PresampledLight::getRandom(sampleIdx, frameCount, 1) < mLightAliasTable[idx].threshold ? idx : mLightAliasTable[idx].alias;
+                float trianglePdf = mLights[lightIdx].flux * mInvFluxSum;
+
+                lightTiles[i].lightIndex = lightIdx;
+                lightTiles[i].invPdf = trianglePdf > 0.f ? 1.f / trianglePdf : 0.f;
+            }
+        });
+    }
+
+    template<typename PixelFunc>
+    void CPUReSTIR::forEachTile(uint2 dim, PixelFunc&& pixelFunc) const
+    {
+        const uint2 tileDim = uint2((dim.x + kTileSize - 1) / kTileSize, (dim.y + kTileSize - 1) / kTileSize);
+        const size_t tileCount = (size_t)tileDim.x * tileDim.y;
+        HimeParallelHelpers::parallelFor(0, tileCount, [&](size_t begin, size_t end, unsigned int)
+        {
+            for (size_t tileIdx = begin; tileIdx < end; tileIdx++)
+            {
+                const uint2 tileOrigin = uint2((uint)(tileIdx % tileDim.x) * kTileSize, (uint)(tileIdx / tileDim.x) * kTileSize);
+                const uint2 tileEnd = min(tileOrigin + kTileSize, dim);
+                pixelFunc(tileOrigin, tileEnd);
+            }
+        }, 1);
+    }
+
+    void CPUReSTIR::run(const GBuffer& gBuffer, const Params& params, std::vector<float4>& lightTexture)
+    {
+        const uint2 dim = gBuffer.dim;
+        const size_t pixelCount = (size_t)dim.x * dim.y;
+        lightTexture.assign(pixelCount, float4(0));
+        if (pixelCount == 0) return;
+
+        // History is dropped if resolution changes.
+        if (dim != mPrevDim)
+        {
+            mPrevReservoirs.resize(pixelCount);
+            mPrevNormalAndLinearZ.assign(pixelCount, float4(0));
+            mPrevDim = dim;
+        }
+        if (mCurrReservoirs.size() != pixelCount) mCurrReservoirs.resize(pixelCount);
+        if (mSpatialReservoirs.size() != pixelCount) mSpatialReservoirs.resize(pixelCount);
+        mCurrReservoirs.isCompact = mPrevReservoirs.isCompact = mSpatialReservoirs.isCompact = params.useCompactReservoir;
+        if (params.useHashGrid && mHashGrid.getBucketCount() != params.hashGridBucketCount) mHashGrid.resize(params.hashGridBucketCount);
+        std::atomic<size_t> disocclusionCount{ 0 };
+        std::atomic<size_t> hashGridHitCount{ 0 };
+        std::atomic<size_t> hashGridInsertCount{ 0 };
+        const std::vector<float2>& neighborOffsets = HimeSequenceHelpers::getR2Disk();
+
+        auto isBackground = [&](size_t pixelIdx) { return gBuffer.normals[pixelIdx] == float3(0); };
+        auto computeTargetPdf = [&](const LightSample& ls, size_t pixelIdx)
+        {
+            // Lambertian StandardMaterial::eval().
+            float3 Lr = gBuffer.albedos[pixelIdx] * (std::max(dot(gBuffer.normals[pixelIdx], ls.dir), 0.f) / glm::pi<float>()) * ls.Le;
+            return luminance(Lr) / ls.pdf;
+        };
+        auto measureTime = [](auto&& func)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            func();
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        };
+
+        // PresampleLights.cs.slang
+        const uint lightTileSize = std::max(params.lightTileSize, 1u);
+        const uint lightTileCount = std::max(params.lightTileCount, 1u);
+        mStats.presampleTime = !params.useLightTiles ? 0.0 : measureTime([&]()
+        {
+            presampleLights(params.frameCount, lightTileCount * lightTileSize, mLightTiles);
+        });
+
+        // GenerateInitialSample.cs.slang
+        mStats.initialSampleTime = measureTime([&]()
+        {
+            forEachTile(dim, [&](uint2 tileOrigin, uint2 tileEnd)
+            {
+                for (uint y = tileOrigin.y; y < tileEnd.y; y++)
+                {
+                    for (uint x = tileOrigin.x; x < tileEnd.x; x++)
+                    {
+                        const size_t pixelIdx = (size_t)y * dim.x + x;
+                        ReservoirData state = createEmptyReservoir();
+                        if (isBackground(pixelIdx) || mLights.empty())
+                        {
+                            mCurrReservoirs.store(pixelIdx, state);
+                            continue;
+                        }
+
+                        RandomState rng = RandomState::create(uint2(x, y), params.frameCount, InitialSample);
+                        const float3 posW = gBuffer.positions[pixelIdx];
+                        const PresampledLight* pLightTile = params.useLightTiles
+                            ? &mLightTiles[(size_t)PresampledLight::getTileIndex(uint2(x, y) / kTileSize, params.frameCount, lightTileCount) * lightTileSize]
+                            : nullptr;
+                        LightSample selectedSample = {};
+                        for (uint i = 0; i < params.initialCandidateCount; i++)
+                        {
+                            uint lightIdx;
+                            float invSourcePdf;
+                            if (pLightTile)
+                            {
+                                const PresampledLight& presampled = pLightTile[std::min((uint)(rng.next() * lightTileSize), lightTileSize - 1)];
+                                lightIdx = presampled.lightIndex;
+                                invSourcePdf = presampled.invPdf;
+                                if (!(invSourcePdf > 0.f)) continue;
+                            }
+                            else
+                            {
+                                float2 u = rng.next2D();
+                                uint idx = std::min((uint)(u.x * mLights.size()), (uint)mLights.size() - 1);
+                                lightIdx = u.y < mLightAliasTable[idx].threshold ? idx : mLightAliasTable[idx].alias;
+                                float trianglePdf = mLights[lightIdx].flux * mInvFluxSum;
+                                if (!(trianglePdf > 0.f)) continue;
+                                invSourcePdf = 1.f / trianglePdf;
+                            }
+
+                            LightSample ls;
+                            float2 uv = rng.next2D();
+                            if (!sampleTriangle(posW, lightIdx, uv, ls)) continue;
+
+                            float targetPdf = computeTargetPdf(ls, pixelIdx);
+                            if (streamSample(state, lightIdx, uv, rng.next(), targetPdf, invSourcePdf)) selectedSample = ls;
+                        }
+
+                        finalizeResampling(state, 1.f, (float)state.M);
+                        state.M = 1;
+
+                        if (params.visibilityFunc && state.isValid() && !params.visibilityFunc(posW, selectedSample.posW))
+                        {
+                            state.spatialDistance = int2(0);
+                            state.age = 0;
+                            state.lightData = 0;
+                            state.weightSum = 0;
+                        }
+                        mCurrReservoirs.store(pixelIdx, state);
+                    }
+                }
+            });
+        });
+
+        // TemporalResample.cs.slang, boiling filter works on a tile instead of a thread group.
+        mStats.temporalResampleTime = !params.enableTemporalResampling ? 0.0 : measureTime([&]()
+        {
+            forEachTile(dim, [&](uint2 tileOrigin, uint2 tileEnd)
+            {
+                float tileWeightSum = 0.f;
+                uint tileWeightCount = 0;
+                size_t tileDisocclusionCount = 0;
+                size_t tileHitCount = 0;
+                for (uint y = tileOrigin.y; y < tileEnd.y; y++)
+                {
+                    for (uint x = tileOrigin.x; x < tileEnd.x; x++)
+                    {
+                        const size_t pixelIdx = (size_t)y * dim.x + x;
+                        ReservoirData state = createEmptyReservoir();
+                        if (!isBackground(pixelIdx))
+                        {
+                            RandomState rng = RandomState::create(uint2(x, y), params.frameCount, TemporalResample);
+                            const ReservoirData currReservoir = mCurrReservoirs.load(pixelIdx);
+                            int historyLimit = std::min((int)ReservoirData::c_MaxM, (int)(params.maxHistoryLength * currReservoir.M));
+                            combineReservoirs(state, currReservoir, 0.5f, currReservoir.targetPdf);
+
+                            // Backproject this pixel to last frame
+                            int2 prevPos = int2(float2(x, y) + gBuffer.motionVectors[pixelIdx] * float2(dim) + float2(0.5f));
+                            float4 prevNormalAndLinearZ = isInside(prevPos, dim) ? mPrevNormalAndLinearZ[(size_t)prevPos.y * dim.x + prevPos.x] : float4(0);
+
+                            bool foundNeighbor = false;
+                            const float radius = 4;
+                            int2 spatialOffset = int2(0);
+                            int2 temporalIdx = int2(0);
+                            for (uint i = 0; i < params.temporalNeighborCandidateCount; i++)
+                            {
+                                int2 offset = int2(0);
+                                if (i > 0) offset = int2((rng.next2D() - 0.5f) * radius);
+
+                                int2 temporalNeighborIdx = prevPos + offset;
+                                if (!isInside(temporalNeighborIdx, dim)) continue;
+
+                                float4 neighborNormalAndLinearZ = mPrevNormalAndLinearZ[(size_t)temporalNeighborIdx.y * dim.x + temporalNeighborIdx.x];
+                                if (!isValidNeighbor(float3(prevNormalAndLinearZ), float3(neighborNormalAndLinearZ), prevNormalAndLinearZ.w, neighborNormalAndLinearZ.w,
+                                    params.temporalNormalThreshold, params.temporalDepthThreshold)) continue;
+
+                                spatialOffset = offset;
+                                temporalIdx = temporalNeighborIdx;
+                                foundNeighbor = true;
+                                break;
+                            }
+
+                            bool hasPrevReservoir = foundNeighbor;
+                            ReservoirData prevReservoir;
+                            if (foundNeighbor)
+                            {
+                                prevReservoir = mPrevReservoirs.load((size_t)temporalIdx.y * dim.x + temporalIdx.x);
+                                prevReservoir.spatialDistance += spatialOffset;
+                            }
+                            else
+                            {
+                                // Disocclusion, reuse reservoir cached at this surface if hash grid is enabled.
+                                tileDisocclusionCount++;
+                                if (params.useHashGrid)
+                                {
+                                    uint4 key = ReservoirHashGrid::computeKey(gBuffer.positions[pixelIdx], gBuffer.normals[pixelIdx], gBuffer.cameraPosW, params.hashGridCellSize);
+                                    hasPrevReservoir = mHashGrid.lookup(key, params.frameCount, params.hashGridMaxAge, prevReservoir);
+                                    tileHitCount += hasPrevReservoir ? 1 : 0;
+                                }
+                            }
+
+                            if (hasPrevReservoir)
+                            {
+                                prevReservoir.M = std::min((int)prevReservoir.M, historyLimit);
+                                prevReservoir.age += 1;
+
+                                float weightAtCurrent = 0;
+                                LightSample ls;
+                                if (prevReservoir.isValid() && prevReservoir.getLightIndex() < mLights.size()
+                                    && sampleTriangle(gBuffer.positions[pixelIdx], prevReservoir.getLightIndex(), prevReservoir.getSampleUV(), ls))
+                                {
+                                    weightAtCurrent = computeTargetPdf(ls, pixelIdx);
+                                }
+                                combineReservoirs(state, prevReservoir, rng.next(), weightAtCurrent);
+                            }
+
+                            finalizeResampling(state, 1.f, (float)state.M);
+                            if (state.weightSum > 0.f)
+                            {
+                                tileWeightSum += state.weightSum;
+                                tileWeightCount++;
+                            }
+                        }
+                        mCurrReservoirs.store(pixelIdx, state);
+                    }
+                }
+
+                disocclusionCount += tileDisocclusionCount;
+                hashGridHitCount += tileHitCount;
+                if (!params.enableBoilingFilter || tileWeightCount == 0) return;
+
+                float boilingFilterMultiplier = 10.f / std::min(std::max(params.boilingFilterStrength, 1e-6f), 1.f) - 9.f;
+                float averageNonzeroWeight = tileWeightSum / tileWeightCount;
+                for (uint y = tileOrigin.y; y < tileEnd.y; y++)
+                {
+                    for (uint x = tileOrigin.x; x < tileEnd.x; x++)
+                    {
+                        const size_t pixelIdx = (size_t)y * dim.x + x;
+                        if (mCurrReservoirs.weight[pixelIdx] > averageNonzeroWeight * boilingFilterMultiplier) mCurrReservoirs.store(pixelIdx, createEmptyReservoir());
+                    }
+                }
+            });
+        });
+
+        // ComputeNormalAndLinearZ.cs.slang, current frame's normal and linear z are used by spatial resample and next frame.
+        for (size_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++)
+        {
+            float4 normalAndLinearZ = float4(gBuffer.normals[pixelIdx], gBuffer.linearZ[pixelIdx]);
+            if (params.useCompactGBuffer)
+            {
+                normalAndLinearZ = GBufferCodecHelpers::unpackNormalAndLinearZ(GBufferCodecHelpers::packNormalAndLinearZ(float3(normalAndLinearZ), normalAndLinearZ.w));
+            }
+            mPrevNormalAndLinearZ[pixelIdx] = normalAndLinearZ;
+        }
+
+        // SpatialResample.cs.slang
+        mStats.spatialResampleTime = !params.enableSpatialResampling ? 0.0 : measureTime([&]()
+        {
+            forEachTile(dim, [&](uint2 tileOrigin, uint2 tileEnd)
+            {
+                size_t tileInsertCount = 0;
+                for (uint y = tileOrigin.y; y < tileEnd.y; y++)
+                {
+                    for (uint x = tileOrigin.x; x < tileEnd.x; x++)
+                    {
+                        const size_t pixelIdx = (size_t)y * dim.x + x;
+                        const ReservoirData centerReservoir = mCurrReservoirs.load(pixelIdx);
+                        if (isBackground(pixelIdx))
+                        {
+                            mSpatialReservoirs.store(pixelIdx, centerReservoir);
+                            continue;
+                        }
+
+                        RandomState rng = RandomState::create(uint2(x, y), params.frameCount, SpatialResample);
+                        ReservoirData state = createEmptyReservoir();
+                        combineReservoirs(state, centerReservoir, 0.5f, centerReservoir.targetPdf);
+
+                        uint startIdx = (uint)(HimeSequenceHelpers::sampleSobol1D(uint2(x, y), params.frameCount) * (kNeighborOffsetCount - 1));
+                        uint numSpatialSamples = params.spatialSampleCount;
+                        if (centerReservoir.M < params.maxHistoryLength) numSpatialSamples = std::max(params.disocclusionBoostSampleCount, numSpatialSamples);
+                        numSpatialSamples = std::min(numSpatialSamples, 32u);
+
+                        const float4 centerNormalAndLinearZ = mPrevNormalAndLinearZ[pixelIdx];
+                        for (uint i = 0; i < numSpatialSamples; i++)
+                        {
+                            uint sampleIdx = (startIdx + i) & (kNeighborOffsetCount - 1);
+                            int2 spatialOffset = int2(neighborOffsets[sampleIdx] * params.spatialSampleRadius);
+                            int2 neighborIdx = int2(x, y) + spatialOffset;
+                            if (!isInside(neighborIdx, dim)) continue;
+
+                            const size_t neighborPixelIdx = (size_t)neighborIdx.y * dim.x + neighborIdx.x;
+                            const float4 neighborNormalAndLinearZ = mPrevNormalAndLinearZ[neighborPixelIdx];
+                            if (!isValidNeighbor(float3(centerNormalAndLinearZ), float3(neighborNormalAndLinearZ), centerNormalAndLinearZ.w, neighborNormalAndLinearZ.w,
+                                params.spatialNormalThreshold, params.spatialDepthThreshold)) continue;
+
+                            ReservoirData neighborReservoir = mCurrReservoirs.load(neighborPixelIdx);
+                            neighborReservoir.spatialDistance += spatialOffset;
+
+                            LightSample ls;
+                            if (neighborReservoir.isValid() && neighborReservoir.getLightIndex() < mLights.size()
+                                && sampleTriangle(gBuffer.positions[pixelIdx], neighborReservoir.getLightIndex(), neighborReservoir.getSampleUV(), ls))
+                            {
+                                combineReservoirs(state, neighborReservoir, rng.next(), computeTargetPdf(ls, pixelIdx));
+                            }
+                        }
+
+                        finalizeResampling(state, 1.f, (float)state.M);
+                        mSpatialReservoirs.store(pixelIdx, state);
+
+                        if (params.useHashGrid && state.isValid() && ReservoirHashGrid::isInsertPixel(uint2(x, y), params.frameCount))
+                        {
+                            uint4 key = ReservoirHashGrid::computeKey(gBuffer.positions[pixelIdx], gBuffer.normals[pixelIdx], gBuffer.cameraPosW, params.hashGridCellSize);
+                            tileInsertCount += mHashGrid.insert(key, params.frameCount, params.hashGridMaxAge, state, params.useCompactReservoir) ? 1 : 0;
+                        }
+                    }
+                }
+                hashGridInsertCount += tileInsertCount;
+            });
+            std::swap(mCurrReservoirs, mSpatialReservoirs);
+        });
+
+        // GenerateLightTexture.cs.slang
+        mStats.lightTextureTime = measureTime([&]()
+        {
+            forEachTile(dim, [&](uint2 tileOrigin, uint2 tileEnd)
+            {
+                for (uint y = tileOrigin.y; y < tileEnd.y; y++)
+                {
+                    for (uint x = tileOrigin.x; x < tileEnd.x; x++)
+                    {
+                        const size_t pixelIdx = (size_t)y * dim.x + x;
+                        ReservoirData reservoir = mCurrReservoirs.load(pixelIdx);
+                        float2 lightUV = reservoir.getSampleUV();
+                        lightTexture[pixelIdx] = float4((float)reservoir.getLightIndex(), 1.f / reservoir.getInvPdf(), lightUV.x, lightUV.y);
+                    }
+                }
+            });
+        });
+
+        mStats.disocclusionCount = disocclusionCount;
+        mStats.hashGridHitCount = hashGridHitCount;
+        mStats.hashGridInsertCount = hashGridInsertCount;
+
+        // Current reservoirs are previous reservoirs of next frame.
+        std::swap(mCurrReservoirs, mPrevReservoirs);
+    }
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <functional>
+#include "Falcor.h"
+#include "../HimeUtils/HimeAliasTable.h"
+#include "../HimeUtils/HimeSequence.h"
+#include "CompactReservoir.h"
+#include "ReservoirHashGrid.h"
+#include "LightTileData.slang"
+
+namespace Falcor
+{
+    /** Host version of ReSTIR::updateEmissiveTriangleTexture().
+
+        Runs initial candidates, temporal resample, spatial resample and light texture generation on a G-buffer, with the
+        same math as GenerateInitialSample.cs.slang, TemporalResample.cs.slang, SpatialResample.cs.slang and
+        GenerateLightTexture.cs.slang. Pixels are processed in tiles of kTileSize x kTileSize (same as a thread group) on
+        all cores, and each pass is finished before next one starts. Reservoirs are stored as SoA of PackedReservoirData
+        fields, so they can be compared with or uploaded to gReservoirBuffer.
+
+        Differences with GPU passes:
+         - Materials are Lambertian with per-pixel albedo, and emission is constant per triangle (average radiance).
+         - Visibility is only tested if Params::visibilityFunc is set, e.g. by a CPU ray tracer on GPU-less nodes.
+         - Spatial resample writes to another buffer instead of resampling in place, so results don't depend on thread count.
+         - Random numbers come from a per-pixel generator seeded by pass, so passes are not correlated.
+    */
+    class CPUReSTIR
+    {
+    public:
+        using SharedPtr = std::shared_ptr<CPUReSTIR>;
+
+        static const uint kTileSize = 16;              ///< CHUNK_SIZE in shaders.
+        static const uint kNeighborOffsetCount = HimeSequenceHelpers::kSequenceLength; ///< Same as ReSTIR, power of 2.
+
+        /** Emissive triangle, same as LightCollection::MeshLightTriangle without texture.
+        */
+        struct Light
+        {
+            float3 vertices[3];
+            float3 radiance; ///< Average radiance, emitted on front face.
+            float flux;      ///< Weight of light selection.
+        };
+
+        /** Per-pixel inputs. Pixels with zero normal are background and skipped.
+        */
+        struct GBuffer
+        {
+            uint2 dim = uint2(0);
+            const float3* positions = nullptr;
+            const float3* normals = nullptr;
+            const float3* albedos = nullptr;
+            const float* linearZ = nullptr;
+            const float2* motionVectors = nullptr; ///< Screen space, same as gMotionVector. Optional if temporal resample is disabled.
+            float3 cameraPosW = float3(0);         ///< Hash grid cell size grows with distance to camera.
+        };
+
+        struct Params
+        {
+            uint initialCandidateCount = 32;
+
+            bool enableTemporalResampling = true;
+            bool enableBoilingFilter = true;
+            uint maxHistoryLength = 5;
+            uint temporalNeighborCandidateCount = 4;
+            float boilingFilterStrength = 0.2f;
+            float temporalNormalThreshold = 0.5f;
+            float temporalDepthThreshold = 0.1f;
+
+            bool enableSpatialResampling = true;
+            uint spatialSampleCount = 1;
+            float spatialSampleRadius = 32;
+            uint disocclusionBoostSampleCount = 8;
+            float spatialNormalThreshold = 0.5f;
+            float spatialDepthThreshold = 0.1f;
+
+            uint frameCount = 0; ///< Seed of random numbers.
+            bool useCompactReservoir = false; ///< Round trip stored reservoirs through CompactReservoirData, same as USE_COMPACT_RESERVOIR.
+            bool useCompactGBuffer = false;   ///< Round trip normal and linear z through HimeGBufferCodec.h, same as USE_COMPACT_GBUFFER.
+
+            bool useHashGrid = false;          ///< Same as USE_RESERVOIR_HASH_GRID, requires spatial resample to fill the grid.
+            uint hashGridBucketCount = 1 << 15;
+            float hashGridCellSize = 0.02f;    ///< Relative to distance to camera.
+            uint hashGridMaxAge = 4;
+
+            bool useLightTiles = false;        ///< Same as USE_LIGHT_TILES, a tile of kTileSize x kTileSize pixels draws candidates from one light tile.
+            uint lightTileCount = 128;
+            uint lightTileSize = 1024;
+
+            /** Returns true if segment between shading point and light sample is unoccluded. All samples are visible if not set.
+            */
+            std::function<bool(const float3& posW, const float3& lightPosW)> visibilityFunc;
+        };
+
+        /** Time of each pass in last run(), in ms, and hash grid counters.
+        */
+        struct Stats
+        {
+            double presampleTime = 0.0; ///< Light tiles, 0 if they are not used.
+            double initialSampleTime = 0.0;
+            double temporalResampleTime = 0.0;
+            double spatialResampleTime = 0.0;
+            double lightTextureTime = 0.0;
+
+            size_t disocclusionCount = 0;   ///< Pixels without valid temporal neighbor, which look up the hash grid.
+            size_t hashGridHitCount = 0;
+            size_t hashGridInsertCount = 0; ///< Successful inserts, including inserts to cells already written in this frame.
+        };
+
+        /** SoA storage of PackedReservoirData, one element per pixel.
+        */
+        struct ReservoirBuffer
+        {
+            std::vector<uint> lightData;
+            std::vector<uint> uvData;
+            std::vector<uint> distanceAge;
+            std::vector<uint> M;
+            std::vector<float> targetPdf;
+            std::vector<float> weight;
+            bool isCompact = false; ///< Quantize reservoirs to CompactReservoirData precision when they are stored.
+
+            void resize(size_t count);
+            size_t size() const { return lightData.size(); }
+
+            void store(size_t idx, const ReservoirData& reservoir);  ///< Same as storeReservoir().
+            ReservoirData load(size_t idx) const;                    ///< Same as loadReservoir().
+            PackedReservoirData getPacked(size_t idx) const;
+        };
+
+        static SharedPtr create() { return SharedPtr(new CPUReSTIR()); }
+
+        /** Set emissive triangles and build light alias table. Reservoirs of previous frame are kept, light indices must be stable.
+        */
+        void setLights(const std::vector<Light>& lights);
+
+        /** Run all passes on a frame, and keep reservoirs and normal/linear z for temporal resample of next frame.
+            \param[in] gBuffer Per-pixel inputs of current frame.
+            \param[in] params ReSTIR parameters.
+            \param[out] lightTexture Same as gLightTexture, float4(lightIdx, pdf, uv) of each pixel.
+        */
+        void run(const GBuffer& gBuffer, const Params& params, std::vector<float4>& lightTexture);
+
+        /** Same as PresampleLights.cs.slang, draw sampleCount lights with pdf proportional to flux.
+            Light selection uses the flat alias table instead of bucketed table, with the same distribution.
+        */
+        void presampleLights(uint frameCount, uint sampleCount, std::vector<PresampledLight>& lightTiles) const;
+
+        /** Reservoirs of last run().
+        */
+        const ReservoirBuffer& getReservoirs() const { return mPrevReservoirs; }
+        const Stats& getStats() const { return mStats; }
+        const ReservoirHashGrid& getHashGrid() const { return mHashGrid; }
+
+    private:
+        CPUReSTIR() = default;
+
+        struct LightSample
+        {
+            float3 posW;
+            float3 dir;
+            float3 Le;
+            float pdf; ///< Solid angle pdf.
+        };
+
+        bool sampleTriangle(const float3& posW, uint lightIdx, float2 u, LightSample& ls) const;
+
+        template<typename PixelFunc>
+        void forEachTile(uint2 dim, PixelFunc&& pixelFunc) const;
+
+        std::vector<Light> mLights;
+        std::vector<float3> mLightNormals;
+        std::vector<float> mLightAreas;
+        std::vector<HimeAliasTableEntry> mLightAliasTable;
+        float mInvFluxSum = 0.f;
+        HimeAliasTableBuilder::SharedPtr mpAliasTableBuilder = HimeAliasTableBuilder::create();
+
+        ReservoirBuffer mCurrReservoirs;
+        ReservoirBuffer mPrevReservoirs;
+        ReservoirBuffer mSpatialReservoirs;
+        std::vector<float4> mPrevNormalAndLinearZ;
+        ReservoirHashGrid mHashGrid;
+        std::vector<PresampledLight> mLightTiles;
+        uint2 mPrevDim = uint2(0);
+        Stats mStats;
+    };
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Falcor.h"
+
+using namespace Falcor;
+
+#include "ReservoirData.slang"
+
+static_assert(sizeof(CompactReservoirData) == 16, "CompactReservoirData must be 16 bytes");
+
+namespace Falcor
+{
+    /** Host version of 16-byte reservoir encoding (packCompactReservoir() and unpackCompactReservoir() in ReSTIRHelpers.slang).
+        Header only, so round trips can be validated without GPU.
+    */
+    namespace CompactReservoir
+    {
+        /** Host version of packUnsignedHalf().
+        */
+        inline uint packUnsignedHalf(float x)
+        {
+            if (!(x > 0.f)) return 0;
+            uint bits;
+            std::memcpy(&bits, &x, sizeof(bits));
+            if (bits < CompactReservoirData::c_HalfExponentOffset) return 0;
+            bits -= CompactReservoirData::c_HalfExponentOffset;
+            return std::min((bits + 0xfff + ((bits >> 13) & 1)) >> 13, (uint)CompactReservoirData::c_MaxHalfBits);
+        }
+
+        /** Host version of unpackUnsignedHalf().
+        */
+        inline float unpackUnsignedHalf(uint h)
+        {
+            if (h == 0) return 0.f;
+            uint bits = (h << 13) + CompactReservoirData::c_HalfExponentOffset;
+            float x;
+            std::memcpy(&x, &bits, sizeof(x));
+            return x;
+        }
+
+        /** Max error of a round trip, for values inside encodable range.
+             - UV: ReservoirData::uvData loses its lowest bit, each 16-bit fixed point coordinate moves by at most one step.
+             - targetPdf and weight: rounding to nearest even, relative error 2^-11 in [kMinHalf, kMaxHalf]. Values above
+               are clamped to kMaxHalf, values below may be flushed to 0.
+             - M, age and spatial distance are exact up to c_MMask, c_MaxAge and c_MaxDistance, and clamped above.
+        */
+        const int kMaxUVError = 1;
+        const float kMaxRelativeHalfError = 1.f / 2048.f;
+        const float kMinHalf = 1.f / 1073741824.f;                 // 2^-30, smallest exponent of encoded values is 2^-31
+        const float kMaxHalf = 8589934592.f * (1.f - 1.f / 2048.f); // 2^33 - 2^22, largest encodable value
+
+        /** Host version of packCompactReservoir().
+        */
+        inline CompactReservoirData pack(const ReservoirData& reservoir)
+        {
+            CompactReservoirData data;
+            if (std::isinf(reservoir.weightSum) || std::isnan(reservoir.weightSum)) return data;
+
+            int2 clampedSpatialDistance = clamp(reservoir.spatialDistance, int2(-CompactReservoirData::c_MaxDistance), int2((int)CompactReservoirData::c_MaxDistance));
+            uint clampedAge = std::min(reservoir.age, (uint)CompactReservoirData::c_MaxAge);
+            uint clampedM = std::min(reservoir.M, (uint)CompactReservoirData::c_MMask);
+
+            data.lightData = reservoir.lightData;
+            data.uvData = ((reservoir.uvData & 0xffff) >> 1) | ((reservoir.uvData >> 17) << CompactReservoirData::c_UVBits);
+            data.pdfWeight = packUnsignedHalf(reservoir.targetPdf) | (packUnsignedHalf(reservoir.weightSum) << 16);
+            data.MDistanceAge = clampedM
+                | (clampedAge << CompactReservoirData::c_AgeShift)
+                | ((clampedSpatialDistance.x & CompactReservoirData::c_DistanceMask) << CompactReservoirData::c_DistanceXShift)
+                | ((clampedSpatialDistance.y & CompactReservoirData::c_DistanceMask) << CompactReservoirData::c_DistanceYShift);
+            return data;
+        }
+
+        /** Host version of unpackCompactReservoir().
+        */
+        inline ReservoirData unpack(const CompactReservoirData& data)
+        {
+            uint u = data.uvData & CompactReservoirData::c_UVMask;
+            uint v = (data.uvData >> CompactReservoirData::c_UVBits) & CompactReservoirData::c_UVMask;
+
+            ReservoirData res;
+            res.lightData = data.lightData;
+            res.uvData = ((u << 1) | (u >> 14)) | (((v << 1) | (v >> 14)) << 16);
+            res.targetPdf = unpackUnsignedHalf(data.pdfWeight & 0xffff);
+            res.weightSum = unpackUnsignedHalf(data.pdfWeight >> 16);
+            res.M = data.MDistanceAge & CompactReservoirData::c_MMask;
+            // Sign extend the shift values
+            res.spatialDistance.x = int(data.MDistanceAge << (32 - CompactReservoirData::c_DistanceXShift - CompactReservoirData::c_DistanceChannelBits)) >> (32 - CompactReservoirData::c_DistanceChannelBits);
+            res.spatialDistance.y = int(data.MDistanceAge << (32 - CompactReservoirData::c_DistanceYShift - CompactReservoirData::c_DistanceChannelBits)) >> (32 - CompactReservoirData::c_DistanceChannelBits);
+            res.age = (data.MDistanceAge >> CompactReservoirData::c_AgeShift) & CompactReservoirData::c_MaxAge;
+            return res;
+        }
+    }
+}
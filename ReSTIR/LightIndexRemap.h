@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Falcor
+{
+    /** Map light indices of previous frame to current frame, so that temporal resampling keeps reusing reservoirs
+        after light collection is rebuilt. Lights are matched by stable keys instead of their indices.
+        Header only, so it can be validated without GPU.
+    */
+    namespace LightIndexRemap
+    {
+        const uint32_t kInvalidIndex = 0xFFFFFFFF;
+
+        /** Key of each emissive triangle: mesh instance ID in high bits, triangle index inside mesh light in low bits.
+            Mesh lights may be reordered when light collection is rebuilt, but their instance IDs are kept.
+            \param[in] instanceIDs Mesh instance ID of each triangle, triangles of a mesh light are consecutive.
+        */
+        inline std::vector<uint64_t> computeKeys(const std::vector<uint32_t>& instanceIDs)
+        {
+            std::vector<uint64_t> keys(instanceIDs.size());
+            uint32_t localIdx = 0;
+            for (size_t i = 0; i < instanceIDs.size(); i++)
+            {
+                localIdx = (i > 0 && instanceIDs[i] == instanceIDs[i - 1]) ? localIdx + 1 : 0;
+                keys[i] = ((uint64_t)instanceIDs[i] << 32) | localIdx;
+            }
+            return keys;
+        }
+
+        /** Compute remap from previous light indices to current ones.
+            \return remap[prevIdx] is current index of the light, or kInvalidIndex if it's gone. Empty if keys are unchanged.
+        */
+        inline std::vector<uint32_t> compute(const std::vector<uint64_t>& prevKeys, const std::vector<uint64_t>& currKeys)
+        {
+            if (prevKeys == currKeys) return {};
+
+            std::unordered_map<uint64_t, uint32_t> currIndices;
+            currIndices.reserve(currKeys.size());
+            for (size_t i = 0; i < currKeys.size(); i++) currIndices.emplace(currKeys[i], (uint32_t)i);
+
+            std::vector<uint32_t> remap(prevKeys.size(), kInvalidIndex);
+            for (size_t i = 0; i < prevKeys.size(); i++)
+            {
+                auto it = currIndices.find(prevKeys[i]);
+                if (it != currIndices.end()) remap[i] = it->second;
+            }
+            return remap;
+        }
+    }
+}
@@ -27,7 +27,8 @@
  **************************************************************************/
 #include "ReSTIR.h"
 #include "../HimeUtils/HimeUtils.h"
-#include "ReservoirData.slang"
+#include "LightIndexRemap.h"
+#include "ReservoirHashGrid.h"
 
 namespace
 {
@@ -58,6 +59,7 @@ namespace
 
     // Compute passes.
     const HimeComputePassDesc kComputeNormalAndLinearZPass = { "RenderPasses/Hime/ReSTIR/ComputeNormalAndLinearZ.cs.slang" , "computeNormalAndLinearZ" };
+    const HimeComputePassDesc kPresampleLightsPass         = { "RenderPasses/Hime/ReSTIR/PresampleLights.cs.slang"         , "presampleLights"         };
     const HimeComputePassDesc kGenerateInitialSamplePass   = { "RenderPasses/Hime/ReSTIR/GenerateInitialSample.cs.slang"   , "generateInitialSample"   };
     const HimeComputePassDesc kTemporalResamplePass        = { "RenderPasses/Hime/ReSTIR/TemporalResample.cs.slang"        , "temporalResample"        };
     const HimeComputePassDesc kSpatialResamplePass         = { "RenderPasses/Hime/ReSTIR/SpatialResample.cs.slang"         , "spatialResample"         };
@@ -66,6 +68,9 @@ namespace
     // Compute shader settings.
     const uint kGroupSize = 512;
     const uint kChunkSize = 16;
+
+    // Reservoir hash grid, 256K slots.
+    const uint kHashGridBucketCount = 1 << 15;
 }
 
 // Don't remove this. it's required for hot-reload to function properly
@@ -94,8 +99,10 @@ RenderPassReflection ReSTIR::reflect(const CompileData& compile_data)
 
     for (const auto& internalChannel : kInternalChannels)
     {
+        // Packed normal and linear z, see HimeGBufferCodec.slang.
+        bool isCompact = mParams.useCompactGBuffer && internalChannel.name == kInternalChannels[PrevNormalAndLinearZ].name;
         reflector.addInternal(internalChannel.name, internalChannel.desc)
-            .format(internalChannel.format)
+            .format(isCompact ? ResourceFormat::R32Uint : internalChannel.format)
             .bindFlags(ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
     }
 
@@ -105,17 +112,51 @@ RenderPassReflection ReSTIR::reflect(const CompileData& compile_data)
 void ReSTIR::setScene(RenderContext* pRenderContext, const std::shared_ptr<Scene>& pScene)
 {
     HimePathTracer::setScene(pRenderContext, pScene);
-    mpEmissivePowerSampler = nullptr;
+    mLightAliasTable.needsRebuild = true;
+    mLightAliasTable.pTable = nullptr;
+    mLightAliasTable.lightKeys.clear();
+    mHashGrid.needsClear = true;
 }
 
 void ReSTIR::renderUI(Gui::Widgets& widget)
 {
     auto group = widget.group("ReSTIR", true);
 
+    if (group.checkbox("Compact reservoirs", mParams.useCompactReservoir))
+    {
+        // Reservoir layout changes, history is dropped.
+        mpGenerateInitialSamplePass = nullptr;
+        mpTemporalResamplePass = nullptr;
+        mpSpatialResamplePass = nullptr;
+        mpGenerateLightTexturePass = nullptr;
+        mpCurrReservoirBuffer = nullptr;
+        mpPrevReservoirBuffer = nullptr;
+        mHashGrid.pReservoirBuffer = nullptr;
+        mHashGrid.needsClear = true;
+    }
+
+    if (group.checkbox("Compact normal and depth", mParams.useCompactGBuffer))
+    {
+        // Format of PrevNormalAndLinearZ changes, render graph reallocates it.
+        mpComputeNormalAndLinearZPass = nullptr;
+        mpTemporalResamplePass = nullptr;
+        mpSpatialResamplePass = nullptr;
+        mPassChangedCB();
+    }
+
     {
         auto initialCandidatePassUI = group.group("Generate initial sample", true);
         initialCandidatePassUI.checkbox("Disable initial visibility", mParams.ignoreInitialVisibility);
         initialCandidatePassUI.var("Initial candidates count", mParams.initialCandidateCount, 1u, 1024u, 1u);
+        if (initialCandidatePassUI.checkbox("Presample light tiles", mParams.useLightTiles))
+        {
+            mpGenerateInitialSamplePass = nullptr;
+        }
+        if (mParams.useLightTiles)
+        {
+            initialCandidatePassUI.var("Light tile count", mParams.lightTileCount, 1u, 1024u, 1u);
+            initialCandidatePassUI.var("Light tile size", mParams.lightTileSize, 64u, 8192u, 64u);
+        }
     }
 
     {
@@ -149,28 +190,46 @@ void ReSTIR::renderUI(Gui::Widgets& widget)
         }
     }
 
+    {
+        auto hashGridUI = group.group("Reservoir hash grid", true);
+        if (hashGridUI.checkbox("Enable hash grid", mParams.useHashGrid))
+        {
+            mpTemporalResamplePass = nullptr;
+            mpSpatialResamplePass = nullptr;
+            mHashGrid.needsClear = true;
+        }
+        if (mParams.useHashGrid)
+        {
+            hashGridUI.var("Hash grid cell size", mParams.hashGridCellSize, 0.001f, 0.2f, 0.001f);
+            hashGridUI.var("Hash grid max age", mParams.hashGridMaxAge, 1u, 64u, 1u);
+        }
+    }
+
     {
         auto lightIndexPassUI = group.group("Generate light index", true);
         // Seems that ray tracing shaders will be re-compiled automatically in HimePathTracer::execute(), prepareVar().
         lightIndexPassUI.checkbox("Disable final visibility", mTracerParams.ignoreShadowRayVisibility);
     }
 
+    {
+        auto debugUI = group.group("Debug", true);
+        debugUI.text("Light alias table: " + std::to_string(mLightAliasTable.lightCount) + " lights, " + std::to_string(mLightAliasTable.rebuiltBucketCount)
+            + " buckets rebuilt in " + std::to_string(mLightAliasTable.buildTime) + " ms");
+    }
+
     HimePathTracer::renderUI(widget);
 }
 
 bool ReSTIR::updateLights(RenderContext* pRenderContext)
 {
     bool lightingChanged = PathTracer::updateLights(pRenderContext);
+    mLightAliasTable.remapLightIndex = false;
 
-    // Update EmissivePowerSampler here to achieve better performance.
-    if (mpScene && mpEmissivePowerSampler == nullptr)
+    // Light alias table replaces EmissivePowerSampler, which sorts all lights on one thread.
+    if (mpScene && (mLightAliasTable.needsRebuild || is_set(mpScene->getUpdates(), Scene::UpdateFlags::LightCollectionChanged)))
     {
-        mpEmissivePowerSampler = EmissivePowerSampler::create(pRenderContext, mpScene);
-    }
-
-    if (mpEmissivePowerSampler)
-    {
-        lightingChanged |= mpEmissivePowerSampler->update(pRenderContext);
+        updateLightAliasTable(pRenderContext);
+        lightingChanged = true;
     }
     return lightingChanged;
 }
@@ -179,6 +238,7 @@ void ReSTIR::updateEmissiveTriangleTexture(RenderContext* pRenderContext, const
 {
     PROFILE("ReSTIR");
     prepareResource(pRenderContext, renderData);
+    presampleLights(pRenderContext);
     generateInitialSample(pRenderContext, renderData);
     temporalResample(pRenderContext, renderData);
     computeNormalAndLinear(pRenderContext, renderData);
@@ -222,6 +282,7 @@ void ReSTIR::computeNormalAndLinear(RenderContext* pRenderContext, const RenderD
         defines.add(getValidResourceDefines(mInputChannels, renderData)); // We need `loadShadingData`, which uses input channels
         defines.add("USE_VBUFFER", mSharedParams.useVBuffer ? "1" : "0");
         defines.add("GBUFFER_ADJUST_SHADING_NORMALS", mGBufferAdjustShadingNormals ? "1" : "0");
+        defines.add("USE_COMPACT_GBUFFER", mParams.useCompactGBuffer ? "1" : "0");
         kComputeNormalAndLinearZPass.createComputePass(mpComputeNormalAndLinearZPass, defines, kGroupSize, kChunkSize);
     }
 
@@ -236,28 +297,51 @@ void ReSTIR::computeNormalAndLinear(RenderContext* pRenderContext, const RenderD
 
 void ReSTIR::prepareResource(RenderContext* pRenderContext, const RenderData& renderData)
 {
-    // Precompute neighbor "random" offset buffer.
+    // Neighbor offsets never change, tables are uploaded once and shared with other passes.
+    if (mpSequenceBuffers == nullptr) mpSequenceBuffers = HimeSequenceBuffers::get();
+
+    if (mParams.useHashGrid)
     {
-        std::vector<float2> neighborOffsets(mParams.neighborOffsetCount);
-        const float phi2 = 1.0f / 1.3247179572447f;
-        uint32_t num = 0;
-        float u = 0.5f;
-        float v = 0.5f;
-        while (num < neighborOffsets.size()) {
-            u += phi2;
-            v += phi2 * phi2;
-            if (u >= 1.0f) u -= 1.0f;
-            if (v >= 1.0f) v -= 1.0f;
-
-            float rSq = (u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f);
-            if (rSq > 0.25f) continue;
-
-            neighborOffsets[num++] = float2(u - 0.5f, v - 0.5f);
+        const uint slotCount = kHashGridBucketCount * ReservoirHashGrid::kBucketSize;
+        HimeBufferHelpers::createOrResizeBuffer(mHashGrid.pKeyBuffer, sizeof(uint), slotCount, "ReSTIR::HashGridKeyBuffer");
+        HimeBufferHelpers::createOrResizeBuffer(mHashGrid.pStampBuffer, sizeof(uint), slotCount, "ReSTIR::HashGridStampBuffer");
+        HimeBufferHelpers::createOrResizeBuffer(mHashGrid.pReservoirBuffer, getReservoirSize(), slotCount, "ReSTIR::HashGridReservoirBuffer");
+        if (mHashGrid.needsClear)
+        {
+            mHashGrid.needsClear = false;
+            pRenderContext->clearUAV(mHashGrid.pKeyBuffer->getUAV().get(), uint4(0));
+            pRenderContext->clearUAV(mHashGrid.pStampBuffer->getUAV().get(), uint4(0));
         }
-        HimeBufferHelpers::createAndCopyBuffer(mpNeighborOffsetBuffer, sizeof(float2), (uint)neighborOffsets.size(), neighborOffsets.data(), "ReSTIR::NeighborOffsetBuffer");
     }
 }
 
+void ReSTIR::presampleLights(RenderContext* pRenderContext)
+{
+    if (!mParams.useLightTiles) return;
+
+    PROFILE("Presample lights");
+    if (mpPresampleLightsPass == nullptr)
+    {
+        Program::DefineList defines = mpScene->getSceneDefines();
+        kPresampleLightsPass.createComputePass(mpPresampleLightsPass, defines, kGroupSize, kChunkSize);
+    }
+
+    const uint sampleCount = mParams.lightTileCount * mParams.lightTileSize;
+    HimeBufferHelpers::createOrResizeBuffer(mpLightTileBuffer, sizeof(PresampledLight), sampleCount, "ReSTIR::LightTileBuffer");
+
+    mpPresampleLightsPass.getRootVar()["gScene"] = mpScene->getParameterBlock();
+    mpPresampleLightsPass.getRootVar()["PerFrameCB"]["sampleCount"] = sampleCount;
+    mpPresampleLightsPass.getRootVar()["PerFrameCB"]["frameCount"] = mSharedParams.frameCount;
+    mpPresampleLightsPass.getRootVar()["PerFrameCB"]["lightCount"] = mLightAliasTable.lightCount;
+    mpPresampleLightsPass.getRootVar()["PerFrameCB"]["invFluxSum"] = mLightAliasTable.invFluxSum;
+    mpPresampleLightsPass.getRootVar()["PerFrameCB"]["bucketCount"] = mLightAliasTable.pTable->getBucketCount();
+    mpPresampleLightsPass.getRootVar()["PerFrameCB"]["bucketSize"] = HimeIncrementalAliasTable::kBucketSize;
+    mpPresampleLightsPass.getRootVar()["gLightAliasTable"] = mLightAliasTable.pBuffer;
+    mpPresampleLightsPass.getRootVar()["gLightAliasTableBuckets"] = mLightAliasTable.pBucketBuffer;
+    mpPresampleLightsPass.getRootVar()["gLightTiles"] = mpLightTileBuffer;
+    mpPresampleLightsPass->execute(pRenderContext, uint3(sampleCount, 1, 1));
+}
+
 void ReSTIR::generateInitialSample(RenderContext* pRenderContext, const RenderData& renderData)
 {
     PROFILE("Generate initial sample");
@@ -270,21 +354,34 @@ void ReSTIR::generateInitialSample(RenderContext* pRenderContext, const RenderDa
         defines.add("USE_VBUFFER", mSharedParams.useVBuffer ? "1" : "0");
         defines.add("GBUFFER_ADJUST_SHADING_NORMALS", mGBufferAdjustShadingNormals ? "1" : "0");
         defines.add("CHUNK_SIZE", std::to_string(kChunkSize));
+        defines.add("USE_COMPACT_RESERVOIR", mParams.useCompactReservoir ? "1" : "0");
+        defines.add("USE_LIGHT_TILES", mParams.useLightTiles ? "1" : "0");
 
         kGenerateInitialSamplePass.createComputePass(mpGenerateInitialSamplePass, defines, kGroupSize, kChunkSize, "6_5");
     }
 
-    HimeBufferHelpers::createOrResizeBuffer(mpCurrReservoirBuffer, sizeof(PackedReservoirData), mSharedParams.frameDim.x * mSharedParams.frameDim.y, "ReSTIR::CurrReservoirBuffer");
-    HimeBufferHelpers::createOrResizeBuffer(mpPrevReservoirBuffer, sizeof(PackedReservoirData), mSharedParams.frameDim.x * mSharedParams.frameDim.y, "ReSTIR::PrevReservoirBuffer");
+    HimeBufferHelpers::createOrResizeBuffer(mpCurrReservoirBuffer, getReservoirSize(), mSharedParams.frameDim.x * mSharedParams.frameDim.y, "ReSTIR::CurrReservoirBuffer");
+    HimeBufferHelpers::createOrResizeBuffer(mpPrevReservoirBuffer, getReservoirSize(), mSharedParams.frameDim.x * mSharedParams.frameDim.y, "ReSTIR::PrevReservoirBuffer");
 
     bindGBuffers(mpGenerateInitialSamplePass, renderData);
 
     mpScene->setRaytracingShaderData(pRenderContext, mpGenerateInitialSamplePass.getRootVar());
-    mpEmissivePowerSampler->setShaderData(mpGenerateInitialSamplePass.getRootVar()["PerFrameCB"]["emissivePowerSampler"]);
+    mpGenerateInitialSamplePass.getRootVar()["PerFrameCB"]["lightCount"] = mLightAliasTable.lightCount;
+    mpGenerateInitialSamplePass.getRootVar()["PerFrameCB"]["invFluxSum"] = mLightAliasTable.invFluxSum;
+    mpGenerateInitialSamplePass.getRootVar()["PerFrameCB"]["bucketCount"] = mLightAliasTable.pTable->getBucketCount();
+    mpGenerateInitialSamplePass.getRootVar()["PerFrameCB"]["bucketSize"] = HimeIncrementalAliasTable::kBucketSize;
+    mpGenerateInitialSamplePass.getRootVar()["gLightAliasTable"] = mLightAliasTable.pBuffer;
+    mpGenerateInitialSamplePass.getRootVar()["gLightAliasTableBuckets"] = mLightAliasTable.pBucketBuffer;
     mpGenerateInitialSamplePass.getRootVar()["PerFrameCB"]["dispatchDim"] = mSharedParams.frameDim;
     mpGenerateInitialSamplePass.getRootVar()["PerFrameCB"]["frameCount"] = mSharedParams.frameCount;
     mpGenerateInitialSamplePass.getRootVar()["PerFrameCB"]["candidateCount"] = mParams.initialCandidateCount;
     mpGenerateInitialSamplePass.getRootVar()["PerFrameCB"]["ignoreVisibility"] = mParams.ignoreInitialVisibility;
+    if (mParams.useLightTiles)
+    {
+        mpGenerateInitialSamplePass.getRootVar()["PerFrameCB"]["lightTileCount"] = mParams.lightTileCount;
+        mpGenerateInitialSamplePass.getRootVar()["PerFrameCB"]["lightTileSize"] = mParams.lightTileSize;
+        mpGenerateInitialSamplePass.getRootVar()["gLightTiles"] = mpLightTileBuffer;
+    }
     mpGenerateInitialSamplePass.getRootVar()["gReservoirBuffer"] = mpCurrReservoirBuffer;
     mpGenerateInitialSamplePass->execute(pRenderContext, uint3(mSharedParams.frameDim, 1));
 }
@@ -305,6 +402,9 @@ void ReSTIR::temporalResample(RenderContext* pRenderContext, const RenderData& r
         defines.add("USE_VBUFFER", mSharedParams.useVBuffer ? "1" : "0");
         defines.add("GBUFFER_ADJUST_SHADING_NORMALS", mGBufferAdjustShadingNormals ? "1" : "0");
         defines.add("ENABLE_BOILING_FILTER", mParams.enableBoilingFilter ? "1" : "0");
+        defines.add("USE_COMPACT_RESERVOIR", mParams.useCompactReservoir ? "1" : "0");
+        defines.add("USE_COMPACT_GBUFFER", mParams.useCompactGBuffer ? "1" : "0");
+        defines.add("USE_RESERVOIR_HASH_GRID", mParams.useHashGrid ? "1" : "0");
         kTemporalResamplePass.createComputePass(mpTemporalResamplePass, defines, kGroupSize, kChunkSize);
     }
 
@@ -318,9 +418,13 @@ void ReSTIR::temporalResample(RenderContext* pRenderContext, const RenderData& r
     mpTemporalResamplePass.getRootVar()["PerFrameCB"]["boilingFilterStrength"] = mParams.boilingFilterStrength;
     mpTemporalResamplePass.getRootVar()["PerFrameCB"]["normalThreshold"] = mParams.temporalNormalThreshold;
     mpTemporalResamplePass.getRootVar()["PerFrameCB"]["depthThreshold"] = mParams.temporalDepthThreshold;
+    mpTemporalResamplePass.getRootVar()["PerFrameCB"]["remapLightIndex"] = mLightAliasTable.remapLightIndex;
+    mpTemporalResamplePass.getRootVar()["PerFrameCB"]["remapCount"] = mLightAliasTable.remapCount;
+    mpTemporalResamplePass.getRootVar()["gLightIndexRemap"] = mLightAliasTable.pRemapBuffer;
     mpTemporalResamplePass.getRootVar()["gScene"] = mpScene->getParameterBlock();
     mpTemporalResamplePass.getRootVar()["gPrevReservoirBuffer"] = mpPrevReservoirBuffer;
     mpTemporalResamplePass.getRootVar()["gCurrReservoirBuffer"] = mpCurrReservoirBuffer;
+    bindHashGrid(mpTemporalResamplePass);
     mpTemporalResamplePass->execute(pRenderContext, uint3(mSharedParams.frameDim, 1));
 }
 
@@ -337,6 +441,9 @@ void ReSTIR::spatialResample(RenderContext* pRenderContext, const RenderData& re
         defines.add(mpSampleGenerator->getDefines()); // We need `SampleGenerator`
         defines.add("USE_VBUFFER", mSharedParams.useVBuffer ? "1" : "0");
         defines.add("GBUFFER_ADJUST_SHADING_NORMALS", mGBufferAdjustShadingNormals ? "1" : "0");
+        defines.add("USE_COMPACT_RESERVOIR", mParams.useCompactReservoir ? "1" : "0");
+        defines.add("USE_COMPACT_GBUFFER", mParams.useCompactGBuffer ? "1" : "0");
+        defines.add("USE_RESERVOIR_HASH_GRID", mParams.useHashGrid ? "1" : "0");
         kSpatialResamplePass.createComputePass(mpSpatialResamplePass, defines, kGroupSize, kChunkSize);
     }
 
@@ -354,7 +461,8 @@ void ReSTIR::spatialResample(RenderContext* pRenderContext, const RenderData& re
     mpSpatialResamplePass.getRootVar()["PerFrameCB"]["depthThreshold"] = mParams.spatialDepthThreshold;
     mpSpatialResamplePass.getRootVar()["gScene"] = mpScene->getParameterBlock();
     mpSpatialResamplePass.getRootVar()["gReservoirBuffer"] = mpCurrReservoirBuffer;
-    mpSpatialResamplePass.getRootVar()["gNeighborOffsetBuffer"] = mpNeighborOffsetBuffer;
+    mpSequenceBuffers->setShaderData(mpSpatialResamplePass.getRootVar());
+    bindHashGrid(mpSpatialResamplePass);
     mpSpatialResamplePass->execute(pRenderContext, uint3(mSharedParams.frameDim, 1));
 }
 
@@ -362,7 +470,12 @@ void ReSTIR::generateLightTexture(RenderContext* pRenderContext, const RenderDat
 {
     PROFILE("Generate light texture");
 
-    kGenerateLightTexturePass.createComputePassIfNecessary(mpGenerateLightTexturePass, kGroupSize, kChunkSize);
+    if (mpGenerateLightTexturePass == nullptr)
+    {
+        Program::DefineList defines;
+        defines.add("USE_COMPACT_RESERVOIR", mParams.useCompactReservoir ? "1" : "0");
+        kGenerateLightTexturePass.createComputePass(mpGenerateLightTexturePass, defines, kGroupSize, kChunkSize);
+    }
 
     Texture::SharedPtr pTexture = getEmissiveTriangleTexture(renderData);
 
@@ -379,3 +492,90 @@ void ReSTIR::prepareNextFrame(RenderContext* pRenderContext, const RenderData& r
     // Use current reservoir buffer in current frame as previous reservoir buffer in next frame.
     std::swap(mpCurrReservoirBuffer, mpPrevReservoirBuffer);
 }
+
+void ReSTIR::bindHashGrid(ComputePass::SharedPtr& pPass)
+{
+    if (!mParams.useHashGrid) return;
+
+    pPass.getRootVar()["HashGridCB"]["hashGridBucketCount"] = kHashGridBucketCount;
+    pPass.getRootVar()["HashGridCB"]["hashGridCellSize"] = mParams.hashGridCellSize;
+    pPass.getRootVar()["HashGridCB"]["hashGridMaxAge"] = mParams.hashGridMaxAge;
+    pPass.getRootVar()["gHashGridKeys"] = mHashGrid.pKeyBuffer;
+    pPass.getRootVar()["gHashGridStamps"] = mHashGrid.pStampBuffer;
+    pPass.getRootVar()["gHashGridReservoirs"] = mHashGrid.pReservoirBuffer;
+}
+
+void ReSTIR::updateLightAliasTable(RenderContext* pRenderContext)
+{
+    PROFILE("Update light alias table");
+    mLightAliasTable.needsRebuild = false;
+
+    auto pLightCollection = mpScene->getLightCollection(pRenderContext);
+    const auto& triangles = pLightCollection->getMeshLightTriangles();
+    mLightAliasTable.lightCount = (uint)triangles.size();
+
+    // Same weights as EmissivePowerSampler, so initial samples keep their distribution.
+    const auto& meshLights = pLightCollection->getMeshLights();
+    std::vector<float> weights(triangles.size());
+    std::vector<uint32_t> instanceIDs(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i++)
+    {
+        weights[i] = triangles[i].flux;
+        instanceIDs[i] = meshLights[triangles[i].lightIdx].instanceID;
+    }
+    updateLightIndexRemap(LightIndexRemap::computeKeys(instanceIDs));
+
+    // Only buckets with changed flux are rebuilt and uploaded.
+    if (mLightAliasTable.pTable == nullptr) mLightAliasTable.pTable = HimeIncrementalAliasTable::create();
+    auto start = std::chrono::high_resolution_clock::now();
+    mLightAliasTable.rebuiltBucketCount = mLightAliasTable.pTable->update(weights.data(), weights.size());
+    mLightAliasTable.buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    const auto& pTable = mLightAliasTable.pTable;
+    mLightAliasTable.invFluxSum = pTable->getWeightSum() > 0.0 ? (float)(1.0 / pTable->getWeightSum()) : 0.f;
+    if (mLightAliasTable.rebuiltBucketCount == 0 && mLightAliasTable.pBuffer) return;
+
+    // Keep at least one entry, shader never reads it when there is no light.
+    const auto& entries = pTable->getEntries();
+    const auto& bucketEntries = pTable->getBucketEntries();
+    HimeAliasTableEntry emptyEntry;
+    HimeBufferHelpers::createAndCopyBuffer(mLightAliasTable.pBucketBuffer, sizeof(HimeAliasTableEntry), std::max(1u, pTable->getBucketCount()),
+        bucketEntries.empty() ? &emptyEntry : bucketEntries.data(), "ReSTIR::LightAliasTableBucketBuffer");
+    if (mLightAliasTable.pBuffer == nullptr || mLightAliasTable.rebuiltBucketCount == pTable->getBucketCount())
+    {
+        HimeBufferHelpers::createAndCopyBuffer(mLightAliasTable.pBuffer, sizeof(HimeAliasTableEntry), std::max(1u, mLightAliasTable.lightCount),
+            entries.empty() ? &emptyEntry : entries.data(), "ReSTIR::LightAliasTableBuffer");
+        return;
+    }
+
+    // Upload runs of consecutive dirty buckets.
+    const auto& dirtyBuckets = pTable->getDirtyBuckets();
+    for (size_t i = 0; i < dirtyBuckets.size();)
+    {
+        size_t j = i + 1;
+        while (j < dirtyBuckets.size() && dirtyBuckets[j] == dirtyBuckets[j - 1] + 1) j++;
+        uint first = dirtyBuckets[i] * HimeIncrementalAliasTable::kBucketSize;
+        uint last = std::min(mLightAliasTable.lightCount, (dirtyBuckets[j - 1] + 1) * HimeIncrementalAliasTable::kBucketSize);
+        mLightAliasTable.pBuffer->setBlob(&entries[first], first * sizeof(HimeAliasTableEntry), (last - first) * sizeof(HimeAliasTableEntry));
+        i = j;
+    }
+}
+
+void ReSTIR::updateLightIndexRemap(const std::vector<uint64_t>& lightKeys)
+{
+    // No history after scene is changed, and nothing to remap if lights are kept.
+    if (!mLightAliasTable.lightKeys.empty())
+    {
+        std::vector<uint32_t> remap = LightIndexRemap::compute(mLightAliasTable.lightKeys, lightKeys);
+        if (!remap.empty())
+        {
+            HimeBufferHelpers::createAndCopyBuffer(mLightAliasTable.pRemapBuffer, sizeof(uint32_t), (uint)remap.size(), remap.data(), "ReSTIR::LightIndexRemapBuffer");
+            mLightAliasTable.remapCount = (uint)remap.size();
+            mLightAliasTable.remapLightIndex = true;
+
+            // Cached reservoirs may be older than previous frame, hash grid is cleared instead of remapped.
+            mHashGrid.needsClear = true;
+        }
+    }
+    mLightAliasTable.lightKeys = lightKeys;
+}
@@ -27,6 +27,10 @@
  **************************************************************************/
 #pragma once
 #include "../HimeTracer/HimePathTracer/HimePathTracer.h"
+#include "../HimeUtils/HimeAliasTable.h"
+#include "../HimeUtils/HimeSequenceBuffers.h"
+#include "ReservoirData.slang"
+#include "LightTileData.slang"
 
 using namespace Falcor;
 
@@ -53,16 +57,28 @@ private:
     void computeNormalAndLinear(RenderContext* pRenderContext, const RenderData& renderData);
 
     void prepareResource(RenderContext* pRenderContext, const RenderData& renderData);
+    void presampleLights(RenderContext* pRenderContext);
     void generateInitialSample(RenderContext* pRenderContext, const RenderData& renderData);
     void temporalResample(RenderContext* pRenderContext, const RenderData& renderData);
     void spatialResample(RenderContext* pRenderContext, const RenderData& renderData);
     void generateLightTexture(RenderContext* pRenderContext, const RenderData& renderData);
     void prepareNextFrame(RenderContext* pRenderContext, const RenderData& renderData);
+    void bindHashGrid(ComputePass::SharedPtr& pPass);
+
+    void updateLightAliasTable(RenderContext* pRenderContext);
+    void updateLightIndexRemap(const std::vector<uint64_t>& lightKeys);
+
+    /** Size of an element of reservoir buffers, PackedReservoirData or CompactReservoirData.
+    */
+    uint getReservoirSize() const { return mParams.useCompactReservoir ? sizeof(CompactReservoirData) : sizeof(PackedReservoirData); }
 
     struct
     {
         bool ignoreInitialVisibility = false;
         uint initialCandidateCount = 32;
+        bool useLightTiles = false; // Draw initial candidates of a thread group from one tile of presampled lights.
+        uint lightTileCount = 128;
+        uint lightTileSize = 1024;
 
         bool enableTemporalResampling = true;
         bool enableBoilingFilter = true;
@@ -80,16 +96,50 @@ private:
         float spatialNormalThreshold = 0.5f;
         float spatialDepthThreshold = 0.1f;
 
-        const uint neighborOffsetCount = 8192;
+        const uint neighborOffsetCount = HimeSequenceHelpers::kSequenceLength;
+
+        bool useCompactReservoir = false; // Store reservoirs in 16 bytes (CompactReservoirData) instead of 24 bytes.
+        bool useCompactGBuffer = false; // Store previous normal and linear z in 4 bytes (HimeGBufferCodec) instead of 16 bytes.
+
+        bool useHashGrid = false; // Reuse reservoirs of world-space hash grid at disocclusions, filled by spatial resample.
+        float hashGridCellSize = 0.02f; // Relative to distance to camera.
+        uint hashGridMaxAge = 4;
     } mParams;
 
     Buffer::SharedPtr mpCurrReservoirBuffer;
     Buffer::SharedPtr mpPrevReservoirBuffer;
+    Buffer::SharedPtr mpLightTileBuffer;
+
+    struct
+    {
+        Buffer::SharedPtr pKeyBuffer;
+        Buffer::SharedPtr pStampBuffer;
+        Buffer::SharedPtr pReservoirBuffer;
+        bool needsClear = true;
+    } mHashGrid;
+
+    HimeSequenceBuffers::SharedPtr mpSequenceBuffers; ///< Neighbor offsets and blue noise, shared with other passes.
+
+    struct
+    {
+        HimeIncrementalAliasTable::SharedPtr pTable;
+        Buffer::SharedPtr pBuffer;
+        Buffer::SharedPtr pBucketBuffer;
+        uint lightCount = 0;
+        float invFluxSum = 0.f; // Light i is selected with pdf flux(i) * invFluxSum.
+        bool needsRebuild = true;
+        uint rebuiltBucketCount = 0;
+        double buildTime = 0.0; // ms
 
-    Buffer::SharedPtr mpNeighborOffsetBuffer;
+        // Light indices of previous frame's reservoirs are remapped in the frame after lights are rebuilt.
+        std::vector<uint64_t> lightKeys;
+        Buffer::SharedPtr pRemapBuffer;
+        uint remapCount = 0;
+        bool remapLightIndex = false;
+    } mLightAliasTable;
 
-    EmissivePowerSampler::SharedPtr mpEmissivePowerSampler;
     ComputePass::SharedPtr mpComputeNormalAndLinearZPass;
+    ComputePass::SharedPtr mpPresampleLightsPass;
     ComputePass::SharedPtr mpGenerateInitialSamplePass;
     ComputePass::SharedPtr mpTemporalResamplePass;
     ComputePass::SharedPtr mpSpatialResamplePass;
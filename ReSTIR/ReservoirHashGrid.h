@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+#include "CompactReservoir.h"
+
+namespace Falcor
+{
+    /** Host version of ReservoirHashGrid.slang, same keys, hashes, insert, lookup and eviction.
+        Header only, used by CPUReSTIR and by HimeTests (ReservoirHashGridTests.cpp, ReservoirHashGridBenchmarks.cpp).
+
+        insert() is thread safe, and lookup() must not run at the same time as insert(), same as on GPU.
+    */
+    class ReservoirHashGrid
+    {
+    public:
+        static const uint kBucketSize = 8;   ///< Slots per bucket, same as kReservoirHashGridBucketSize.
+        static const uint kInsertStride = 4; ///< One pixel per kInsertStride x kInsertStride block inserts per frame.
+
+        /** Create empty grid.
+            \param[in] bucketCount Number of buckets, power of 2.
+        */
+        void resize(uint bucketCount)
+        {
+            mBucketCount = bucketCount;
+            mKeys = std::vector<std::atomic<uint>>((size_t)bucketCount * kBucketSize);
+            mStamps = std::vector<std::atomic<uint>>((size_t)bucketCount * kBucketSize);
+            mReservoirs.assign((size_t)bucketCount * kBucketSize, ReservoirData());
+            clear();
+        }
+
+        void clear()
+        {
+            for (auto& key : mKeys) key.store(0, std::memory_order_relaxed);
+            for (auto& stamp : mStamps) stamp.store(0, std::memory_order_relaxed);
+        }
+
+        uint getBucketCount() const { return mBucketCount; }
+        uint getSlotCount() const { return mBucketCount * kBucketSize; }
+
+        /** Number of slots written in last maxAge frames.
+        */
+        uint getOccupiedSlotCount(uint frameCount, uint maxAge) const
+        {
+            uint count = 0;
+            for (size_t i = 0; i < mKeys.size(); i++)
+            {
+                if (mKeys[i].load(std::memory_order_relaxed) != 0 && frameCount + 1 - mStamps[i].load(std::memory_order_relaxed) <= maxAge) count++;
+            }
+            return count;
+        }
+
+        /** Same as computeHashGridKey().
+        */
+        static uint4 computeKey(const float3& posW, const float3& normal, const float3& cameraPosW, float cellSizeScale)
+        {
+            float cellSize = std::max(cellSizeScale * length(posW - cameraPosW), 1e-6f);
+            uint exponent = (asUint(cellSize) >> 23) & 0xff;
+            float quantizedCellSize = asFloat(exponent << 23);
+            int3 cell = int3(glm::floor(posW / quantizedCellSize));
+
+            float3 absNormal = glm::abs(normal);
+            uint axis = absNormal.x >= absNormal.y && absNormal.x >= absNormal.z ? 0 : (absNormal.y >= absNormal.z ? 1 : 2);
+            uint normalBin = axis * 2 + (normal[axis] < 0.f ? 1 : 0);
+
+            return uint4((uint)cell.x, (uint)cell.y, (uint)cell.z, exponent | (normalBin << 8));
+        }
+
+        /** Same as getHashGridBucket().
+        */
+        uint getBucket(const uint4& key) const
+        {
+            return hashPcg(key.x ^ hashPcg(key.y ^ hashPcg(key.z ^ hashPcg(key.w)))) & (mBucketCount - 1);
+        }
+
+        /** Same as getHashGridChecksum().
+        */
+        static uint getChecksum(const uint4& key)
+        {
+            return std::max(hashJenkins(key.x ^ hashJenkins(key.y ^ hashJenkins(key.z ^ hashJenkins(key.w)))), 1u);
+        }
+
+        /** Same as isHashGridInsertPixel().
+        */
+        static bool isInsertPixel(uint2 pixel, uint frameCount)
+        {
+            return pixel.x % kInsertStride == frameCount % kInsertStride && pixel.y % kInsertStride == (frameCount / kInsertStride) % kInsertStride;
+        }
+
+        /** Same as insertReservoirHashGrid().
+            \param[in] isCompact Quantize reservoir to CompactReservoirData, same as USE_COMPACT_RESERVOIR.
+        */
+        bool insert(const uint4& key, uint frameCount, uint maxAge, const ReservoirData& reservoir, bool isCompact)
+        {
+            const uint checksum = getChecksum(key);
+            const size_t baseSlot = (size_t)getBucket(key) * kBucketSize;
+            const uint stamp = frameCount + 1;
+
+            for (size_t slot = baseSlot; slot < baseSlot + kBucketSize; slot++)
+            {
+                uint prevChecksum = 0;
+                if (!mKeys[slot].compare_exchange_strong(prevChecksum, checksum) && prevChecksum != checksum) continue;
+
+                if (mStamps[slot].exchange(stamp) != stamp) write(slot, reservoir, isCompact);
+                return true;
+            }
+
+            // Bucket is full, evict oldest stale slot.
+            size_t oldestSlot = baseSlot;
+            uint oldestStamp = stamp;
+            for (size_t slot = baseSlot; slot < baseSlot + kBucketSize; slot++)
+            {
+                uint slotStamp = mStamps[slot].load();
+                if (stamp - slotStamp > stamp - oldestStamp)
+                {
+                    oldestStamp = slotStamp;
+                    oldestSlot = slot;
+                }
+            }
+            if (stamp - oldestStamp <= maxAge) return false;
+            if (!mStamps[oldestSlot].compare_exchange_strong(oldestStamp, stamp)) return false;
+
+            mKeys[oldestSlot].store(checksum);
+            write(oldestSlot, reservoir, isCompact);
+            return true;
+        }
+
+        /** Same as lookupReservoirHashGrid().
+        */
+        bool lookup(const uint4& key, uint frameCount, uint maxAge, ReservoirData& reservoir) const
+        {
+            const uint checksum = getChecksum(key);
+            const size_t baseSlot = (size_t)getBucket(key) * kBucketSize;
+
+            for (size_t slot = baseSlot; slot < baseSlot + kBucketSize; slot++)
+            {
+                uint slotChecksum = mKeys[slot].load(std::memory_order_relaxed);
+                if (slotChecksum == 0) return false;
+                if (slotChecksum != checksum) continue;
+                if (frameCount + 1 - mStamps[slot].load(std::memory_order_relaxed) > maxAge) return false;
+
+                reservoir = mReservoirs[slot];
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        static uint asUint(float f) { uint u; std::memcpy(&u, &f, sizeof(u)); return u; }
+        static float asFloat(uint u) { float f; std::memcpy(&f, &u, sizeof(f)); return f; }
+
+        static uint hashPcg(uint v)
+        {
+            uint state = v * 747796405u + 2891336453u;
+            uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+            return (word >> 22u) ^ word;
+        }
+
+        static uint hashJenkins(uint a)
+        {
+            a = (a + 0x7ed55d16) + (a << 12);
+            a = (a ^ 0xc761c23c) ^ (a >> 19);
+            a = (a + 0x165667b1) + (a << 5);
+            a = (a + 0xd3a2646c) ^ (a << 9);
+            a = (a + 0xfd7046c5) + (a << 3);
+            a = (a ^ 0xb55a4f09) ^ (a >> 16);
+            return a;
+        }
+
+        /** Same as writeHashGridReservoir(), spatial distance and age of the inserting pixel are reset.
+        */
+        void write(size_t slot, const ReservoirData& reservoir, bool isCompact)
+        {
+            ReservoirData& r = mReservoirs[slot];
+            r = reservoir;
+            r.spatialDistance = int2(0);
+            r.age = 0;
+            if (isCompact) r = CompactReservoir::unpack(CompactReservoir::pack(r));
+        }
+
+        uint mBucketCount = 0;
+        std::vector<std::atomic<uint>> mKeys;
+        std::vector<std::atomic<uint>> mStamps;
+        std::vector<ReservoirData> mReservoirs;
+    };
+}
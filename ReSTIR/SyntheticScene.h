@@ -0,0 +1,80 @@
+#pragma once
+#include <random>
+#include "CPUReSTIR.h"
+
+namespace Falcor
+{
+    /** Synthetic surface G-buffer for CPU ReSTIR: height field across scene bound, camera above it, every 16th pixel is background.
+    */
+    struct SyntheticGBuffer
+    {
+        std::vector<float3> positions;
+        std::vector<float3> normals;
+        std::vector<float3> albedos;
+        std::vector<float> linearZ;
+        std::vector<float2> motionVectors; // Zero, set by caller.
+        CPUReSTIR::GBuffer gBuffer;
+
+        SyntheticGBuffer(uint2 dim)
+        {
+            const size_t pixelCount = (size_t)dim.x * dim.y;
+            positions.resize(pixelCount);
+            normals.resize(pixelCount);
+            albedos.assign(pixelCount, float3(0.5f));
+            linearZ.resize(pixelCount);
+            motionVectors.assign(pixelCount, float2(0.f));
+
+            gBuffer.dim = dim;
+            gBuffer.positions = positions.data();
+            gBuffer.normals = normals.data();
+            gBuffer.albedos = albedos.data();
+            gBuffer.linearZ = linearZ.data();
+            gBuffer.motionVectors = motionVectors.data();
+        }
+
+        /** Fill surface moved left by shift pixels, so pixel x shows what pixel x + 1 showed at shift - 1 (motion vector 1 / dim.x).
+        */
+        void update(const AABB& sceneBound, uint shift)
+        {
+            const float3 extent = sceneBound.extent();
+            const uint2 dim = gBuffer.dim;
+            const float kFrequency = 4.f * glm::pi<float>();
+            for (size_t i = 0; i < positions.size(); i++)
+            {
+                // Height h(u, v) = 0.5 + 0.1 * sin(4 pi u) * cos(4 pi v) in scene bound.
+                float u = ((float)(i % dim.x + shift) + 0.5f) / dim.x;
+                float v = ((float)(i / dim.x) + 0.5f) / dim.y;
+                float h = 0.5f + 0.1f * std::sin(kFrequency * u) * std::cos(kFrequency * v);
+                float dhdu = 0.1f * kFrequency * std::cos(kFrequency * u) * std::cos(kFrequency * v);
+                float dhdv = -0.1f * kFrequency * std::sin(kFrequency * u) * std::sin(kFrequency * v);
+                positions[i] = sceneBound.minPoint + float3(u, h, v) * extent;
+                normals[i] = i % 16 == 0 ? float3(0) : normalize(float3(-dhdu * extent.y / extent.x, 1.f, -dhdv * extent.y / extent.z));
+                linearZ[i] = (1.f - h) * extent.y;
+            }
+            // Camera is as far above the surface as its width, so pixel footprint is close to a 60 degree perspective camera.
+            gBuffer.cameraPosW = sceneBound.minPoint + float3(0.5f, 1.f, 0.5f) * extent + float3(0.f, std::max(extent.x, extent.z), 0.f);
+        }
+    };
+
+    /** Synthetic downward facing lights at the top of bound, above the height field of SyntheticGBuffer.
+        Fluxes are lognormal and a tenth of lights are not emissive.
+    */
+    inline std::vector<CPUReSTIR::Light> createSyntheticLights(const AABB& bound, size_t count, uint seed)
+    {
+        std::vector<CPUReSTIR::Light> lights(count);
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> position(0.f, 1.f);
+        std::lognormal_distribution<float> flux(0.f, 2.f);
+        const float kArea = 0.005f;
+        for (auto& light : lights)
+        {
+            float3 c = bound.minPoint + float3(position(rng), 1.f, position(rng)) * bound.extent();
+            light.vertices[0] = c;
+            light.vertices[1] = c + float3(0.1f, 0.f, 0.f);
+            light.vertices[2] = c + float3(0.f, 0.f, 0.1f);
+            light.flux = rng() % 10 == 0 ? 0.f : flux(rng);
+            light.radiance = float3(light.flux / (kArea * glm::pi<float>()));
+        }
+        return lights;
+    }
+}
@@ -0,0 +1,436 @@
+#include "CPULightcuts.h"
+#include "../HimeUtils/HimeParallel.h"
+#include "../HimeUtils/HimeSimd.h"
+
+namespace Falcor
+{
+    namespace
+    {
+        using SimdType = SimdFloat<8>;
+        const uint kLaneCount = 8;
+
+        /** A node bound to evaluate at a shading point.
+        */
+        struct BoundQuery
+        {
+            uint nodeId;
+            uint pointIdx;
+        };
+
+        /** Bound terms shared by computeError() and firstChildWeight() in FindLightcuts.cs.slang.
+        */
+        struct BoundTerms
+        {
+            float dlen2; ///< Squared distance to closest point, not bounded.
+            float geom;  ///< computeGeomTermBound().
+            float l2Max; ///< Squared distance to farthest point.
+        };
+
+        /** Evaluate bound terms of queries, kLaneCount queries at a time.
+            Operations are in the same order as scalar host helpers, so results are bit identical.
+        */
+        void evaluateBounds(const LightTreeNode* pNodes, const std::vector<BoundQuery>& queries, const float3* positions, const float3* normals, std::vector<BoundTerms>& terms)
+        {
+            terms.resize(queries.size());
+
+            alignas(32) float boundMin[3][kLaneCount];
+            alignas(32) float boundMax[3][kLaneCount];
+            alignas(32) float pos[3][kLaneCount];
+            alignas(32) float nrm[3][kLaneCount];
+            alignas(32) float dlen2Lanes[kLaneCount];
+            alignas(32) float geomLanes[kLaneCount];
+            alignas(32) float l2MaxLanes[kLaneCount];
+
+            for (size_t base = 0; base < queries.size(); base += kLaneCount)
+            {
+                const size_t laneCount = std::min<size_t>(kLaneCount, queries.size() - base);
+
+                // Gather, unused lanes repeat the first query.
+                for (size_t lane = 0; lane < kLaneCount; lane++)
+                {
+                    const BoundQuery& query = queries[base + (lane < laneCount ? lane : 0)];
+                    const LightTreeNode& node = pNodes[query.nodeId];
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        boundMin[axis][lane] = node.aabbMinPoint[axis];
+                        boundMax[axis][lane] = node.aabbMaxPoint[axis];
+                        pos[axis][lane] = positions[query.pointIdx][axis];
+                        nrm[axis][lane] = normals[query.pointIdx][axis];
+                    }
+                }
+
+                const SimdType zero = SimdType::set1(0.f);
+                SimdType d[3], n[3];
+                SimdType dlen2 = zero, dDotN = zero, nrmMax = zero, l2Max = zero;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    SimdType p = SimdType::load(pos[axis]);
+                    SimdType bMin = SimdType::load(boundMin[axis]);
+                    SimdType bMax = SimdType::load(boundMax[axis]);
+                    n[axis] = SimdType::load(nrm[axis]);
+
+                    d[axis] = min(max(p, bMin), bMax) - p;
+                    dlen2 = dlen2 + d[axis] * d[axis];
+                    dDotN = dDotN + d[axis] * n[axis];
+
+                    SimdType dirP = n[axis] * p;
+                    nrmMax = nrmMax + max(n[axis] * bMin - dirP, n[axis] * bMax - dirP);
+
+                    SimdType farthest = max(abs(bMin - p), abs(bMax - p));
+                    l2Max = l2Max + farthest * farthest;
+                }
+
+                SimdType tng2 = zero;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    SimdType tng = d[axis] - dDotN * n[axis];
+                    tng2 = tng2 + tng * tng;
+                }
+                SimdType geom = select(nrmMax > zero, nrmMax / sqrt(tng2 + nrmMax * nrmMax), zero);
+
+                dlen2.store(dlen2Lanes);
+                geom.store(geomLanes);
+                l2Max.store(l2MaxLanes);
+                for (size_t lane = 0; lane < laneCount; lane++) terms[base + lane] = { dlen2Lanes[lane], geomLanes[lane], l2MaxLanes[lane] };
+            }
+        }
+
+        float normalizedWeights(float l2_0, float l2_1, float intensGeom0, float intensGeom1)
+        {
+            float ww0 = l2_1 * intensGeom0;
+            float ww1 = l2_0 * intensGeom1;
+            return ww0 / (ww0 + ww1);
+        }
+
+        /** Same as firstChildWeight() in FindLightcuts.cs.slang, with bound terms evaluated already.
+        */
+        bool firstChildWeight(const LightTreeNode& c0, const LightTreeNode& c1, const BoundTerms& t0, const BoundTerms& t1, float& prob0)
+        {
+            float c0_intensity = length(c0.intensity);
+            float c1_intensity = length(c1.intensity);
+
+            if (c0_intensity == 0)
+            {
+                if (c1_intensity == 0) return false;
+                prob0 = 0;
+                return true;
+            }
+            else if (c1_intensity == 0)
+            {
+                prob0 = 1;
+                return true;
+            }
+
+            if (t0.geom + t1.geom == 0) return false;
+
+            if (t0.geom == 0)
+            {
+                prob0 = 0;
+                return true;
+            }
+            else if (t1.geom == 0)
+            {
+                prob0 = 1;
+                return true;
+            }
+
+            float intensGeom0 = c0_intensity * t0.geom;
+            float intensGeom1 = c1_intensity * t1.geom;
+            float w_max0 = t0.dlen2 == 0 && t1.dlen2 == 0 ? intensGeom0 / (intensGeom0 + intensGeom1) : normalizedWeights(t0.dlen2, t1.dlen2, intensGeom0, intensGeom1);
+            float w_min0 = normalizedWeights(t0.l2Max, t1.l2Max, intensGeom0, intensGeom1);
+            prob0 = 0.5f * (w_max0 + w_min0);
+            return true;
+        }
+
+        /** Cut node being expanded in current step.
+        */
+        struct Expansion
+        {
+            uint pointIdx;
+            uint2 children;
+        };
+
+        struct Traversal
+        {
+            uint pointIdx;
+            uint sampleIdx;
+            uint cutNode;
+            uint nodeId;
+            float r;
+            float nodeProb;
+            bool isDeadBranch;
+        };
+
+        /** Per thread buffers, reused across tiles.
+        */
+        struct TileScratch
+        {
+            std::vector<uint> pixelIndices;
+            std::vector<float3> positions;
+            std::vector<float3> normals;
+            std::vector<LightcutHeap> heaps;
+            std::vector<uint> heapIndices;    ///< Heap of each point, cut tile index if cuts are shared by tiles.
+            std::vector<float3> tilePositions;
+            std::vector<float3> tileNormals;
+            std::vector<uint> activePoints;
+            std::vector<Expansion> expansions;
+            std::vector<Traversal> traversals;
+            std::vector<uint> activeTraversals;
+            std::vector<BoundQuery> queries;
+            std::vector<BoundTerms> terms;
+        };
+
+        /** Same as findCut() in FindLightcuts.cs.slang, for all points of a tile in lockstep.
+        */
+        void findCuts(const LightTreeHelpers::LightTreeView& lightTree, const CPULightcuts::Params& params, TileScratch& scratch)
+        {
+            const uint pointCount = (uint)scratch.positions.size();
+            const uint cutSize = std::min(params.cutSize, kMaxLightcutSize);
+
+            float SR2 = params.errorLimit * params.sceneLightBoundRadius;
+            SR2 *= SR2;
+
+            scratch.heaps.resize(pointCount);
+            scratch.heapIndices.resize(pointCount);
+            scratch.activePoints.clear();
+            for (uint i = 0; i < pointCount; i++)
+            {
+                scratch.heapIndices[i] = i;
+                scratch.heaps[i].reset(cutSize);
+                scratch.heaps[i].push(0, 1e27f);
+                if (cutSize > 1) scratch.activePoints.push_back(i);
+            }
+
+            while (!scratch.activePoints.empty())
+            {
+                scratch.expansions.clear();
+                scratch.queries.clear();
+
+                size_t activeCount = 0;
+                for (uint pointIdx : scratch.activePoints)
+                {
+                    uint nodeId = scratch.heaps[pointIdx].top().nodeId;
+                    if (lightTree.isLeaf(nodeId)) continue;
+
+                    uint2 children = lightTree.getChildren(nodeId);
+                    scratch.expansions.push_back({ pointIdx, children });
+                    scratch.queries.push_back({ children.x, pointIdx });
+                    scratch.queries.push_back({ children.y, pointIdx });
+                    scratch.activePoints[activeCount++] = pointIdx;
+                }
+                scratch.activePoints.resize(activeCount);
+
+                evaluateBounds(lightTree.pNodes, scratch.queries, scratch.positions.data(), scratch.normals.data(), scratch.terms);
+
+                // Replace as two children, same as computeError().
+                activeCount = 0;
+                for (size_t i = 0; i < scratch.expansions.size(); i++)
+                {
+                    const Expansion& expansion = scratch.expansions[i];
+                    LightcutHeap& heap = scratch.heaps[expansion.pointIdx];
+
+                    auto computeError = [&](uint nodeId, const BoundTerms& terms)
+                    {
+                        float dlen2 = terms.dlen2;
+                        if (dlen2 < SR2) dlen2 = SR2; // bound the distance
+                        float atten = 1.f / dlen2;
+                        atten *= terms.geom;
+                        return atten * length(lightTree.pNodes[nodeId].intensity);
+                    };
+
+                    heap.replaceTop(expansion.children.x, computeError(expansion.children.x, scratch.terms[2 * i]));
+                    if (!lightTree.pNodes[expansion.children.y].isBogus())
+                    {
+                        heap.push(expansion.children.y, computeError(expansion.children.y, scratch.terms[2 * i + 1]));
+                    }
+                    if (heap.size < cutSize) scratch.activePoints[activeCount++] = expansion.pointIdx;
+                }
+                scratch.activePoints.resize(activeCount);
+            }
+        }
+
+        /** Same as findTileCut() in FindLightcuts.cs.slang, one cut per cut tile, heapIndices are cut tile indices already.
+        */
+        void findTileCuts(const LightTreeHelpers::LightTreeView& lightTree, const CPULightcuts::Params& params, TileScratch& scratch)
+        {
+            const uint cutTilesPerRow = CPULightcuts::kTileSize / params.cutTileSize;
+            scratch.heaps.resize(cutTilesPerRow * cutTilesPerRow);
+            for (uint cutTileIdx = 0; cutTileIdx < (uint)scratch.heaps.size(); cutTileIdx++)
+            {
+                scratch.tilePositions.clear();
+                scratch.tileNormals.clear();
+                for (size_t i = 0; i < scratch.positions.size(); i++)
+                {
+                    if (scratch.heapIndices[i] != cutTileIdx) continue;
+                    scratch.tilePositions.push_back(scratch.positions[i]);
+                    scratch.tileNormals.push_back(scratch.normals[i]);
+                }
+                if (scratch.tilePositions.empty()) continue;
+
+                auto bound = LightTreeHelpers::ShadingPointBound::create(scratch.tilePositions.data(), scratch.tileNormals.data(), scratch.tilePositions.size());
+                LightTreeHelpers::findCut(lightTree, bound, params.cutSize, params.errorLimit, params.sceneLightBoundRadius, scratch.heaps[cutTileIdx]);
+            }
+        }
+
+        /** Same as traverseLightTree() in FindLightcuts.cs.slang, for all samples of a tile in lockstep.
+        */
+        void traverseLightTrees(const LightTreeHelpers::LightTreeView& lightTree, TileScratch& scratch)
+        {
+            scratch.activeTraversals.clear();
+            for (uint i = 0; i < (uint)scratch.traversals.size(); i++)
+            {
+                if (!lightTree.isLeaf(scratch.traversals[i].nodeId)) scratch.activeTraversals.push_back(i);
+            }
+
+            while (!scratch.activeTraversals.empty())
+            {
+                scratch.queries.clear();
+                for (uint traversalIdx : scratch.activeTraversals)
+                {
+                    const Traversal& traversal = scratch.traversals[traversalIdx];
+                    uint2 children = lightTree.getChildren(traversal.nodeId);
+                    scratch.queries.push_back({ children.x, traversal.pointIdx });
+                    scratch.queries.push_back({ children.y, traversal.pointIdx });
+                }
+
+                evaluateBounds(lightTree.pNodes, scratch.queries, scratch.positions.data(), scratch.normals.data(), scratch.terms);
+
+                size_t activeCount = 0;
+                for (size_t i = 0; i < scratch.activeTraversals.size(); i++)
+                {
+                    Traversal& traversal = scratch.traversals[scratch.activeTraversals[i]];
+                    uint lChildId = scratch.queries[2 * i].nodeId;
+                    uint rChildId = scratch.queries[2 * i + 1].nodeId;
+
+                    float prob0;
+                    if (!firstChildWeight(lightTree.pNodes[lChildId], lightTree.pNodes[rChildId], scratch.terms[2 * i], scratch.terms[2 * i + 1], prob0))
+                    {
+                        traversal.isDeadBranch = true;
+                        continue;
+                    }
+
+                    if (traversal.r < prob0)
+                    {
+                        traversal.nodeId = lChildId;
+                        traversal.r /= prob0;
+                        traversal.nodeProb *= prob0;
+                    }
+                    else
+                    {
+                        traversal.nodeId = rChildId;
+                        traversal.r = (traversal.r - prob0) / (1 - prob0);
+                        traversal.nodeProb *= (1 - prob0);
+                    }
+                    if (!lightTree.isLeaf(traversal.nodeId)) scratch.activeTraversals[activeCount++] = scratch.activeTraversals[i];
+                }
+                scratch.activeTraversals.resize(activeCount);
+            }
+        }
+    }
+
+    CPULightcuts::RandomState CPULightcuts::RandomState::create(uint2 pixel, uint frameCount)
+    {
+        // PCG hash of pixel and frame.
+        auto hash = [](uint v)
+        {
+            uint state = v * 747796405u + 2891336453u;
+            uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+            return (word >> 22u) ^ word;
+        };
+        return { hash(pixel.x + hash(pixel.y + hash(frameCount))) };
+    }
+
+    float CPULightcuts::RandomState::next()
+    {
+        state = state * 747796405u + 2891336453u;
+        uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        word = (word >> 22u) ^ word;
+        return (word >> 8) * (1.f / 16777216.f);
+    }
+
+    void CPULightcuts::run(const LightTreeHelpers::LightTreeView& lightTree, const float3* positions, const float3* normals, uint2 dim, const Params& params, std::vector<LightSample>& samples)
+    {
+        const size_t pixelCount = (size_t)dim.x * dim.y;
+        samples.assign(pixelCount * params.lightSampleCount, LightSample());
+        if (lightTree.nodeCount == 0 || pixelCount == 0 || params.lightSampleCount == 0 || params.cutSize < params.lightSampleCount) return;
+
+        if (params.cutTileSize == 0 || kTileSize % params.cutTileSize != 0) return;
+
+        const uint2 tileDim = uint2((dim.x + kTileSize - 1) / kTileSize, (dim.y + kTileSize - 1) / kTileSize);
+        const size_t tileCount = (size_t)tileDim.x * tileDim.y;
+
+        std::vector<TileScratch> scratches(HimeParallelHelpers::getChunkCount(tileCount, 1));
+        HimeParallelHelpers::parallelFor(0, tileCount, [&](size_t begin, size_t end, unsigned int chunkIdx)
+        {
+            TileScratch& scratch = scratches[chunkIdx];
+            for (size_t tileIdx = begin; tileIdx < end; tileIdx++)
+            {
+                const uint2 tileOrigin = uint2((uint)(tileIdx % tileDim.x) * kTileSize, (uint)(tileIdx / tileDim.x) * kTileSize);
+
+                // Shading points of tile, background pixels are skipped.
+                scratch.pixelIndices.clear();
+                scratch.positions.clear();
+                scratch.normals.clear();
+                scratch.heapIndices.clear();
+                for (uint y = tileOrigin.y; y < std::min(tileOrigin.y + kTileSize, dim.y); y++)
+                {
+                    for (uint x = tileOrigin.x; x < std::min(tileOrigin.x + kTileSize, dim.x); x++)
+                    {
+                        size_t pixelIdx = (size_t)y * dim.x + x;
+                        if (normals[pixelIdx] == float3(0)) continue;
+                        scratch.pixelIndices.push_back((uint)pixelIdx);
+                        scratch.positions.push_back(positions[pixelIdx]);
+                        scratch.normals.push_back(normals[pixelIdx]);
+                        scratch.heapIndices.push_back((y - tileOrigin.y) / params.cutTileSize * (kTileSize / params.cutTileSize) + (x - tileOrigin.x) / params.cutTileSize);
+                    }
+                }
+                if (scratch.pixelIndices.empty()) continue;
+
+                if (params.cutTileSize > 1) findTileCuts(lightTree, params, scratch);
+                else findCuts(lightTree, params, scratch);
+
+                // One random number per light sample, same as findLight().
+                scratch.traversals.clear();
+                for (uint pointIdx = 0; pointIdx < (uint)scratch.pixelIndices.size(); pointIdx++)
+                {
+                    uint pixelIdx = scratch.pixelIndices[pointIdx];
+                    LightcutHeap& heap = scratch.heaps[scratch.heapIndices[pointIdx]];
+                    RandomState rng = RandomState::create(uint2(pixelIdx % dim.x, pixelIdx / dim.x), params.frameCount);
+                    for (uint i = 0; i < params.lightSampleCount; i++)
+                    {
+                        float r = rng.next();
+                        if (params.cutSize == params.lightSampleCount)
+                        {
+                            // One light sample per cut node, unused cut nodes are root.
+                            uint cutNode = i < heap.size ? heap.nodes[i].nodeId : 0;
+                            scratch.traversals.push_back({ pointIdx, i, cutNode, cutNode, r, 1.f, false });
+                            continue;
+                        }
+
+                        LightcutSelection selection = heap.selectNode(r);
+                        if (selection.heapIdx == heap.size)
+                        {
+                            LightSample& sample = samples[(size_t)i * pixelCount + pixelIdx];
+                            sample.lightIdx = 0;
+                            sample.pdf = 1e27f;
+                            sample.cutNode = 0;
+                            continue;
+                        }
+                        uint cutNode = heap.nodes[selection.heapIdx].nodeId;
+                        scratch.traversals.push_back({ pointIdx, i, cutNode, cutNode, selection.r, selection.prob * params.lightSampleCount, false });
+                    }
+                }
+
+                traverseLightTrees(lightTree, scratch);
+
+                for (const Traversal& traversal : scratch.traversals)
+                {
+                    LightSample& sample = samples[(size_t)traversal.sampleIdx * pixelCount + scratch.pixelIndices[traversal.pointIdx]];
+                    sample.lightIdx = traversal.isDeadBranch ? 0 : lightTree.pNodes[traversal.nodeId].lightIdx;
+                    sample.pdf = traversal.isDeadBranch ? 1e27f : traversal.nodeProb;
+                    sample.cutNode = traversal.cutNode;
+                }
+            }
+        }, 1);
+    }
+}
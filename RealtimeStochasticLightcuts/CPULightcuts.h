@@ -0,0 +1,73 @@
+#pragma once
+#include "LightTreeHelpers.h"
+
+namespace Falcor
+{
+    /** Host version of FindLightcuts.cs.slang.
+
+        Finds a cut and samples one light under each cut node for every pixel of a G-buffer, with the same output as
+        gLightIndex. Pixels are processed in tiles on all cores. Within a tile, pixels advance in lockstep, and children
+        visited by all pixels of a step are evaluated together, so bound math (closest distance, geometry term bound,
+        farthest distance) runs on SIMD lanes. Results are bit identical with LightTreeHelpers::findCut() and
+        LightTreeHelpers::traverseLightTree().
+
+        With Params::cutTileSize larger than 1, one cut is found per cutTileSize x cutTileSize pixels against their bound
+        (see LightTreeHelpers::ShadingPointBound), and each pixel only traverses below the shared cut nodes.
+
+        Random numbers come from a per-pixel generator (see RandomState), so results don't depend on thread count.
+    */
+    class CPULightcuts
+    {
+    public:
+        using SharedPtr = std::shared_ptr<CPULightcuts>;
+
+        static const uint kTileSize = 8;
+
+        struct Params
+        {
+            uint cutSize = 1;                 ///< CUT_SIZE in shader, at least lightSampleCount and at most kMaxLightcutSize.
+            uint lightSampleCount = 1;        ///< NUM_LIGHT_SAMPLES in shader.
+            uint cutTileSize = 1;             ///< LIGHTCUT_TILE_SIZE in shader, pixels of a tile share one cut. Divides kTileSize.
+            float errorLimit = 0.001f;
+            float sceneLightBoundRadius = 1.f;
+            uint frameCount = 0;              ///< Seed of random numbers.
+        };
+
+        /** Same as gLightIndex, float4(lightIdx, pdf, cutNode, 0).
+            With leaves of multiple triangles, lightIdx is the leaf index, see LightTreeHelpers::sampleLeafTriangle().
+            Dead samples (no light under the cut node can contribute) have pdf 1e27 and lightIdx 0.
+        */
+        struct LightSample
+        {
+            uint lightIdx = 0;
+            float pdf = 0.f;
+            uint cutNode = kInvalidLightTreeNode; ///< kInvalidLightTreeNode for background pixels.
+            uint padding = 0;
+        };
+
+        /** Per-pixel random number generator.
+        */
+        struct RandomState
+        {
+            uint state;
+
+            static RandomState create(uint2 pixel, uint frameCount);
+            float next(); ///< Uniform float in [0, 1).
+        };
+
+        static SharedPtr create() { return SharedPtr(new CPULightcuts()); }
+
+        /** Find lightcuts of a G-buffer.
+            \param[in] lightTree Light tree to traverse.
+            \param[in] positions World positions, width * height.
+            \param[in] normals Shading normals, width * height. Pixels with zero normal are background and skipped.
+            \param[in] dim G-buffer width and height.
+            \param[in] params Lightcut parameters.
+            \param[out] samples Light samples, lightSampleCount slices of width * height, same layout as gLightIndex.
+        */
+        void run(const LightTreeHelpers::LightTreeView& lightTree, const float3* positions, const float3* normals, uint2 dim, const Params& params, std::vector<LightSample>& samples);
+
+    private:
+        CPULightcuts() = default;
+    };
+}
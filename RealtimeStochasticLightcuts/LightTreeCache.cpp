@@ -0,0 +1,221 @@
+#include "LightTreeCache.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+namespace Falcor
+{
+    namespace LightTreeCache
+    {
+        namespace
+        {
+            const char kMagic[8] = { 'H', 'I', 'M', 'E', 'L', 'T', 'C', '\0' };
+            const char kFileExtension[] = ".lighttree";
+
+            const uint64_t kPrime0 = 0x9E3779B185EBCA87ull;
+            const uint64_t kPrime1 = 0xC2B2AE3D27D4EB4Full;
+
+            inline uint64_t rotl(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+            inline uint64_t mixWord(uint64_t hash, uint64_t word)
+            {
+                return rotl(hash ^ (word * kPrime1), 31) * kPrime0;
+            }
+
+            // Lanes of EmissiveFingerprint::hashWords().
+            const uint32_t kMurmurC1 = 0xCC9E2D51u;
+            const uint32_t kMurmurC2 = 0x1B873593u;
+            const uint32_t kMurmurN = 0xE6546B64u;
+            const uint32_t kLanePrime = 0x9E3779B1u;
+
+            inline uint32_t rotl32(uint32_t v, int r) { return (v << r) | (v >> (32 - r)); }
+
+            inline uint64_t finalizeLanes(const uint32_t lanes[8], size_t count)
+            {
+                uint64_t hash = mixWord(0x9E3779B97F4A7C15ull, count);
+                for (uint32_t l = 0; l < 8; l += 2) hash = mixWord(hash, lanes[l] | ((uint64_t)lanes[l + 1] << 32));
+                return hash;
+            }
+        }
+
+        void Hasher::add(const void* pData, size_t size)
+        {
+            const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+            mSize += size;
+
+            for (; size >= 8; pBytes += 8, size -= 8)
+            {
+                uint64_t word;
+                memcpy(&word, pBytes, 8);
+                mHash = mixWord(mHash, word);
+            }
+            if (size > 0)
+            {
+                uint64_t word = 0;
+                memcpy(&word, pBytes, size);
+                mHash = mixWord(mHash, word);
+            }
+        }
+
+        uint64_t Hasher::get() const
+        {
+            // Final avalanche, so hashes of similar streams differ in all bits.
+            uint64_t hash = mixWord(mHash, mSize);
+            hash ^= hash >> 33;
+            hash *= kPrime1;
+            hash ^= hash >> 29;
+            return hash;
+        }
+
+        uint64_t EmissiveFingerprint::hashWords(const uint32_t* pWords, size_t count)
+        {
+#if HIME_CPU_X64
+            if (HimeCpuHelpers::hasAVX2()) return hashWordsAVX2(pWords, count);
+#endif
+            return hashWordsScalar(pWords, count);
+        }
+
+        uint64_t EmissiveFingerprint::hashWordsScalar(const uint32_t* pWords, size_t count)
+        {
+            // Murmur3 body on 8 lanes, lane l consumes words l, l + 8, l + 16...
+            uint32_t lanes[8];
+            for (uint32_t l = 0; l < 8; l++) lanes[l] = l * kLanePrime;
+            for (size_t i = 0; i < count; i += 8)
+            {
+                for (uint32_t l = 0; l < 8; l++)
+                {
+                    uint32_t k = pWords[i + l] * kMurmurC1;
+                    k = rotl32(k, 15) * kMurmurC2;
+                    lanes[l] = rotl32(lanes[l] ^ k, 13) * 5 + kMurmurN;
+                }
+            }
+            return finalizeLanes(lanes, count);
+        }
+
+#if HIME_CPU_X64
+        HIME_TARGET_AVX2 uint64_t EmissiveFingerprint::hashWordsAVX2(const uint32_t* pWords, size_t count)
+        {
+            // Same lanes as hashWordsScalar(), one lane per 32-bit element.
+            __m256i h = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)kLanePrime));
+            const __m256i c1 = _mm256_set1_epi32((int)kMurmurC1);
+            const __m256i c2 = _mm256_set1_epi32((int)kMurmurC2);
+            const __m256i five = _mm256_set1_epi32(5);
+            const __m256i n = _mm256_set1_epi32((int)kMurmurN);
+            for (size_t i = 0; i < count; i += 8)
+            {
+                __m256i k = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(pWords + i)), c1);
+                k = _mm256_or_si256(_mm256_slli_epi32(k, 15), _mm256_srli_epi32(k, 17));
+                k = _mm256_mullo_epi32(k, c2);
+                h = _mm256_xor_si256(h, k);
+                h = _mm256_or_si256(_mm256_slli_epi32(h, 13), _mm256_srli_epi32(h, 19));
+                h = _mm256_add_epi32(_mm256_mullo_epi32(h, five), n);
+            }
+            uint32_t lanes[8];
+            _mm256_storeu_si256((__m256i*)lanes, h);
+            return finalizeLanes(lanes, count);
+        }
+#endif
+
+        std::vector<uint32_t> EmissiveFingerprint::findDirtyChunks(size_t triangleCount, const std::vector<TriangleRange>& dirtyRanges)
+        {
+            const size_t chunkCount = (triangleCount + kChunkTriangleCount - 1) / kChunkTriangleCount;
+            std::vector<uint32_t> dirtyChunks;
+            mIsResized = triangleCount != mTriangleCount || chunkCount != mChunkHashes.size();
+            if (mIsResized)
+            {
+                mTriangleCount = triangleCount;
+                mChunkHashes.assign(chunkCount, 0);
+                dirtyChunks.resize(chunkCount);
+                for (size_t i = 0; i < chunkCount; i++) dirtyChunks[i] = (uint32_t)i;
+                return dirtyChunks;
+            }
+
+            std::vector<uint8_t> isDirty(chunkCount, 0);
+            for (const auto& [begin, end] : dirtyRanges)
+            {
+                const size_t clampedEnd = std::min(end, triangleCount);
+                if (begin >= clampedEnd) continue;
+                for (size_t i = begin / kChunkTriangleCount; i <= (clampedEnd - 1) / kChunkTriangleCount; i++) isDirty[i] = 1;
+            }
+            for (size_t i = 0; i < chunkCount; i++)
+            {
+                if (isDirty[i]) dirtyChunks.push_back((uint32_t)i);
+            }
+            return dirtyChunks;
+        }
+
+        uint64_t EmissiveFingerprint::combine(const std::vector<uint32_t>& dirtyChunks, const std::vector<uint64_t>& chunkHashes)
+        {
+            mHashedChunkCount = (uint32_t)dirtyChunks.size();
+            mChangedChunkCount = mIsResized ? (uint32_t)mChunkHashes.size() : 0;
+            for (size_t i = 0; i < dirtyChunks.size(); i++)
+            {
+                uint64_t& chunkHash = mChunkHashes[dirtyChunks[i]];
+                if (!mIsResized && chunkHash != chunkHashes[i]) mChangedChunkCount++;
+                chunkHash = chunkHashes[i];
+            }
+
+            Hasher hasher;
+            hasher.add(mChunkHashes.data(), mChunkHashes.size() * sizeof(uint64_t));
+            mHash = hasher.get();
+            return mHash;
+        }
+
+        bool Key::operator==(const Key& other) const
+        {
+            return emissiveHash == other.emissiveHash && quantLevels == other.quantLevels && leafOrder == other.leafOrder && isBottomUp == other.isBottomUp
+                && isLBVH == other.isLBVH && leafTriangleCount == other.leafTriangleCount && lightCount == other.lightCount && nodeCount == other.nodeCount && boundMin == other.boundMin && boundMax == other.boundMax;
+        }
+
+        uint64_t Key::hash() const
+        {
+            Hasher hasher;
+            hasher.add(emissiveHash);
+            hasher.add(quantLevels);
+            hasher.add(leafOrder);
+            hasher.add(isBottomUp);
+            hasher.add(isLBVH);
+            hasher.add(leafTriangleCount);
+            hasher.add(lightCount);
+            hasher.add(nodeCount);
+            hasher.add(boundMin);
+            hasher.add(boundMax);
+            return hasher.get();
+        }
+
+        std::string getFilePath(const std::string& directory, const Key& key)
+        {
+            char name[17];
+            snprintf(name, sizeof(name), "%016llx", (unsigned long long)key.hash());
+            return (std::filesystem::path(directory) / (std::string(name) + kFileExtension)).string();
+        }
+
+        bool save(const std::string& directory, const Key& key, const LightTreeNode* nodes)
+        {
+            Header header = {};
+            memcpy(header.magic, kMagic, sizeof(kMagic));
+            header.version = kVersion;
+            header.nodeSize = (uint32_t)sizeof(LightTreeNode);
+            header.key = key;
+
+            return HimeFileHelpers::writeFileAtomically(getFilePath(directory, key), { { &header, sizeof(Header) }, { nodes, (size_t)key.nodeCount * sizeof(LightTreeNode) } });
+        }
+
+        MappedLightTree::SharedPtr MappedLightTree::open(const std::string& directory, const Key& key)
+        {
+            SharedPtr pMapped = SharedPtr(new MappedLightTree());
+            pMapped->mpFile = HimeMappedFile::open(getFilePath(directory, key));
+            if (pMapped->mpFile == nullptr || pMapped->mpFile->getSize() < sizeof(Header)) return nullptr;
+
+            // Reject files of other versions, layouts or keys (hash collision of file name).
+            const Header& header = pMapped->getHeader();
+            if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) return nullptr;
+            if (header.version != kVersion || header.nodeSize != sizeof(LightTreeNode)) return nullptr;
+            if (header.key != key) return nullptr;
+            if (pMapped->mpFile->getSize() != sizeof(Header) + (size_t)key.nodeCount * sizeof(LightTreeNode)) return nullptr;
+
+            return pMapped;
+        }
+    }
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include "Falcor.h"
+#include "LightTreeData.slangh"
+#include "../HimeUtils/HimeMath.h"
+#include "../HimeUtils/HimeParallel.h"
+#include "../HimeUtils/HimeMappedFile.h"
+
+namespace Falcor
+{
+    /** On-disk cache of built light trees.
+
+        A cache file stores a header and the LightTreeNode array of a complete light tree. Files are named by the hash of
+        their key (emissive triangle data and build parameters), and are memory mapped when loaded, so nodes can be uploaded
+        from the mapped view directly. Files with a different version, node size or key are ignored.
+    */
+    namespace LightTreeCache
+    {
+        const uint32_t kVersion = 3;
+
+        /** 64-bit hash of a byte stream, 8 bytes are consumed at a time.
+        */
+        class Hasher
+        {
+        public:
+            void add(const void* pData, size_t size);
+
+            template<typename T>
+            void add(const T& value)
+            {
+                static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be hashed");
+                add(&value, sizeof(T));
+            }
+
+            uint64_t get() const;
+
+        private:
+            uint64_t mHash = 0x9E3779B97F4A7C15ull;
+            uint64_t mSize = 0;
+        };
+
+        /** Fingerprint of emissive triangles, used to detect frames where no light changed.
+
+            Triangles are packed into kWordsPerTriangle 32-bit words and hashed in chunks of kChunkTriangleCount triangles
+            on all cores. Within a chunk, words are mixed on 8 independent 32-bit lanes (one AVX2 register if the CPU supports
+            it, scalar lanes otherwise, same result). Chunk hashes of last update are kept, so only chunks overlapping changed
+            triangles are packed and hashed again, and the number of changed chunks is known.
+        */
+        class EmissiveFingerprint
+        {
+        public:
+            static const size_t kChunkTriangleCount = 1024;
+            static const uint32_t kWordsPerTriangle = 16;
+
+            /** Triangle range [begin, end).
+            */
+            using TriangleRange = std::pair<size_t, size_t>;
+
+            /** Hash triangles of changed ranges again, and keep chunk hashes of other triangles from last update.
+                All triangles are hashed if triangle count changed since last update.
+                \param[in] triangleCount Number of triangles.
+                \param[in] dirtyRanges Triangle ranges changed since last update, in any order.
+                \param[in] packTriangle Callable as packTriangle(triangleIdx, pWords), writes kWordsPerTriangle words.
+                \return Fingerprint of all triangles.
+            */
+            template<typename PackTriangle>
+            uint64_t update(size_t triangleCount, const std::vector<TriangleRange>& dirtyRanges, PackTriangle&& packTriangle)
+            {
+                const std::vector<uint32_t> dirtyChunks = findDirtyChunks(triangleCount, dirtyRanges);
+                std::vector<uint64_t> chunkHashes(dirtyChunks.size());
+                HimeParallelHelpers::parallelFor(0, dirtyChunks.size(), [&](size_t begin, size_t end, unsigned int)
+                {
+                    std::vector<uint32_t> words(kChunkTriangleCount * kWordsPerTriangle);
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        const size_t first = dirtyChunks[i] * kChunkTriangleCount;
+                        const size_t count = std::min(kChunkTriangleCount, triangleCount - first);
+                        for (size_t t = 0; t < count; t++) packTriangle(first + t, words.data() + t * kWordsPerTriangle);
+                        chunkHashes[i] = hashWords(words.data(), count * kWordsPerTriangle);
+                    }
+                }, 16);
+                return combine(dirtyChunks, chunkHashes);
+            }
+
+            /** Hash all triangles.
+            */
+            template<typename PackTriangle>
+            uint64_t update(size_t triangleCount, PackTriangle&& packTriangle)
+            {
+                return update(triangleCount, { TriangleRange(0, triangleCount) }, std::forward<PackTriangle>(packTriangle));
+            }
+
+            /** Hash of words, count is a multiple of 8. Uses AVX2 if the CPU supports it.
+            */
+            static uint64_t hashWords(const uint32_t* pWords, size_t count);
+
+            /** Scalar path of hashWords(), same result as the AVX2 path.
+            */
+            static uint64_t hashWordsScalar(const uint32_t* pWords, size_t count);
+
+#if HIME_CPU_X64
+            /** AVX2 path of hashWords(), only call it if HimeCpuHelpers::hasAVX2() is true.
+            */
+            HIME_TARGET_AVX2 static uint64_t hashWordsAVX2(const uint32_t* pWords, size_t count);
+#endif
+
+            uint64_t get() const { return mHash; }
+            uint32_t getChangedChunkCount() const { return mChangedChunkCount; } ///< Chunks changed in last update, all chunks if triangle count changed.
+            uint32_t getHashedChunkCount() const { return mHashedChunkCount; }   ///< Chunks packed and hashed in last update.
+            uint32_t getChunkCount() const { return (uint32_t)mChunkHashes.size(); }
+
+        private:
+            /** Sorted chunks overlapping dirty ranges, all chunks if triangle count changed.
+            */
+            std::vector<uint32_t> findDirtyChunks(size_t triangleCount, const std::vector<TriangleRange>& dirtyRanges);
+            uint64_t combine(const std::vector<uint32_t>& dirtyChunks, const std::vector<uint64_t>& chunkHashes);
+
+            std::vector<uint64_t> mChunkHashes;
+            size_t mTriangleCount = 0;
+            bool mIsResized = true;
+            uint64_t mHash = 0;
+            uint32_t mChangedChunkCount = 0;
+            uint32_t mHashedChunkCount = 0;
+        };
+
+        /** Everything a built light tree depends on.
+        */
+        struct Key
+        {
+            uint64_t emissiveHash = 0; ///< Hash of emissive triangle data, see EmissiveFingerprint.
+            uint32_t quantLevels = 0;  ///< Morton code quantization levels per axis.
+            uint32_t leafOrder = 0;    ///< LightTreeHelpers::LeafOrder.
+            uint32_t isBottomUp = 0;   ///< 1 if internal nodes are built by constructLightTreeBottomUp().
+            uint32_t isLBVH = 0;       ///< 1 if light tree is a LBVH, never saved to cache file.
+            uint32_t leafTriangleCount = 1; ///< Max triangles per leaf, only 1 is saved to cache file.
+            uint32_t lightCount = 0;
+            uint32_t nodeCount = 0;
+            float3 boundMin = float3(0);
+            float3 boundMax = float3(0);
+
+            bool operator==(const Key& other) const;
+            bool operator!=(const Key& other) const { return !(*this == other); }
+
+            /** Hash of all fields, used as file name.
+            */
+            uint64_t hash() const;
+        };
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t nodeSize;
+            Key key;
+        };
+
+        /** Cache file path of a key in a directory.
+        */
+        std::string getFilePath(const std::string& directory, const Key& key);
+
+        /** Write light tree to cache file. File is written to a temporary file first and renamed,
+            so a partially written file is never loaded.
+            \param[in] nodes Light tree nodes, nodeCount of key.
+            \return False if file can't be written.
+        */
+        bool save(const std::string& directory, const Key& key, const LightTreeNode* nodes);
+
+        /** Memory mapped cache file.
+        */
+        class MappedLightTree
+        {
+        public:
+            using SharedPtr = std::shared_ptr<MappedLightTree>;
+
+            /** Map cache file of a key.
+                \return nullptr if file doesn't exist or doesn't match key.
+            */
+            static SharedPtr open(const std::string& directory, const Key& key);
+
+            const Header& getHeader() const { return *reinterpret_cast<const Header*>(mpFile->getData()); }
+            const LightTreeNode* getNodes() const { return reinterpret_cast<const LightTreeNode*>(mpFile->getData() + sizeof(Header)); }
+            uint32_t getNodeCount() const { return getHeader().key.nodeCount; }
+
+        private:
+            MappedLightTree() = default;
+
+            HimeMappedFile::UniquePtr mpFile;
+        };
+    }
+}
@@ -0,0 +1,725 @@
+#include "LightTreeHelpers.h"
+#include "../HimeUtils/HimeMortonCode.h"
+#include "../HimeUtils/HimeHilbertCode.h"
+#include "../HimeUtils/RadixSort/RadixSort.h"
+
+namespace Falcor
+{
+    namespace LightTreeHelpers
+    {
+        LightTreeLayout computeLayout(uint lightCount)
+        {
+            LightTreeLayout layout;
+            layout.lightCount = lightCount;
+            layout.leafCount = nextPow2(lightCount);
+            layout.levelCount = uintLog2(layout.leafCount) + 1;
+            layout.nodeCount = CompleteBinaryTreeHelpers::getAllNodeCount(layout.levelCount - 1);
+            return layout;
+        }
+
+        LightTreeNode createBogusLeaf(uint nodeIdx)
+        {
+            LightTreeNode node;
+            node.id = nodeIdx;
+            node.lightIdx = 0;
+            node.mortonCode = 0xFFFFFFFF;
+            node.intensity = float3(0);
+            node.aabbMinPoint = float3(100000000.f);
+            node.aabbMaxPoint = float3(100000000.f);
+            node.paddingAndDebug = float4(0);
+            return node;
+        }
+
+        uint computeLeafSortKey(const LightTreeNode& leaf, LeafOrder order, const AABB& sceneBound)
+        {
+            float3 center = (leaf.aabbMinPoint + leaf.aabbMaxPoint) * 0.5f;
+            switch (order)
+            {
+            case LeafOrder::Hilbert:
+                return HilbertCodeHelpers::computeHilbertCodeByPos<kMortonCodeBitsPerAxis>(center, sceneBound);
+            case LeafOrder::Morton:
+            default:
+                return MortonCodeHelpers::computeMortonCodeByPos(center, LightTreeMortonCode::kQuantLevels, sceneBound);
+            }
+        }
+
+        void sortLeaves(std::vector<LightTreeNode>& leaves, LeafOrder order, const AABB& sceneBound)
+        {
+            std::vector<HimeRadixSort::KeyIndexPair> keyIndexPairs(leaves.size());
+            HimeParallelHelpers::parallelFor(0, leaves.size(), [&](size_t begin, size_t end, unsigned int)
+            {
+                for (size_t i = begin; i < end; i++) keyIndexPairs[i] = { (uint32_t)i, computeLeafSortKey(leaves[i], order, sceneBound) };
+            });
+
+            HimeRadixSort::create()->sort(keyIndexPairs.data(), keyIndexPairs.size(), LightTreeMortonCode::kCodeBits);
+
+            std::vector<LightTreeNode> sortedLeaves(leaves.size());
+            HimeRadixSort::gather(leaves.data(), keyIndexPairs.data(), leaves.size(), sortedLeaves.data());
+            leaves.swap(sortedLeaves);
+        }
+
+        ClusteredLeaves clusterLeaves(const std::vector<LightTreeNode>& sortedLeaves, uint trianglesPerLeaf, const AABB& sceneBound)
+        {
+            ClusteredLeaves clusters;
+            clusters.trianglesPerLeaf = std::max(trianglesPerLeaf, 1u);
+            const uint triangleCount = (uint)sortedLeaves.size();
+            const uint leafCount = (triangleCount + clusters.trianglesPerLeaf - 1) / clusters.trianglesPerLeaf;
+            clusters.leaves.resize(leafCount);
+            clusters.triangles.resize(triangleCount);
+            clusters.triangleCdf.resize(triangleCount);
+
+            HimeParallelHelpers::parallelFor(0, leafCount, [&](size_t begin, size_t end, unsigned int)
+            {
+                for (size_t leafIdx = begin; leafIdx < end; leafIdx++)
+                {
+                    const uint first = (uint)leafIdx * clusters.trianglesPerLeaf;
+                    const uint count = clusters.getTriangleCount((uint)leafIdx);
+
+                    LightTreeNode node = sortedLeaves[first];
+                    float intensitySum = length(node.intensity);
+                    for (uint t = 1; t < count; t++)
+                    {
+                        const LightTreeNode& triangle = sortedLeaves[first + t];
+                        node.intensity += triangle.intensity;
+                        node.aabbMinPoint = min(node.aabbMinPoint, triangle.aabbMinPoint);
+                        node.aabbMaxPoint = max(node.aabbMaxPoint, triangle.aabbMaxPoint);
+                        intensitySum += length(triangle.intensity);
+                    }
+                    node.lightIdx = (uint)leafIdx;
+                    node.mortonCode = MortonCodeHelpers::computeMortonCodeByPos((node.aabbMinPoint + node.aabbMaxPoint) * 0.5f, LightTreeMortonCode::kQuantLevels, sceneBound);
+                    node.paddingAndDebug = float4(float(first), float(first + count), 0, 0);
+                    clusters.leaves[leafIdx] = node;
+
+                    // uniform if no triangle emits, last triangle takes rounding error of cdf, cdf is clamped so rounding never makes it exceed 1 early
+                    float cdf = 0;
+                    for (uint t = 0; t < count; t++)
+                    {
+                        cdf += intensitySum > 0 ? length(sortedLeaves[first + t].intensity) / intensitySum : 1.f / count;
+                        clusters.triangles[first + t] = sortedLeaves[first + t].lightIdx;
+                        clusters.triangleCdf[first + t] = t + 1 == count ? 1.f : std::min(cdf, 1.f);
+                    }
+                }
+            }, 1024);
+            return clusters;
+        }
+
+        uint sampleLeafTriangle(const ClusteredLeaves& clusters, uint leafIdx, float& r, float& nodeProb)
+        {
+            const uint first = leafIdx * clusters.trianglesPerLeaf;
+            const uint count = clusters.getTriangleCount(leafIdx);
+            float prevCdf = 0;
+            for (uint t = 0; t < count; t++)
+            {
+                float cdf = clusters.triangleCdf[first + t];
+                if (r < cdf || t + 1 == count)
+                {
+                    float prob = cdf - prevCdf;
+                    float rescaled = prob > 0 ? (r - prevCdf) / prob : 0.f;
+                    r = rescaled < 0 ? 0 : (rescaled < 0.99999994f ? rescaled : 0.99999994f);
+                    nodeProb *= prob;
+                    return clusters.triangles[first + t];
+                }
+                prevCdf = cdf;
+            }
+            return clusters.triangles[first];
+        }
+
+        LightTreeNode mergeNodes(uint nodeIdx, const LightTreeNode& left, const LightTreeNode& right, const AABB& sceneBound)
+        {
+            LightTreeNode node = left;
+            node.id = nodeIdx;
+            if (!right.isBogus())
+            {
+                node.intensity += right.intensity;
+                node.aabbMinPoint = min(right.aabbMinPoint, node.aabbMinPoint);
+                node.aabbMaxPoint = max(right.aabbMaxPoint, node.aabbMaxPoint);
+                node.mortonCode = MortonCodeHelpers::computeMortonCodeByPos((node.aabbMinPoint + node.aabbMaxPoint) * 0.5f, LightTreeMortonCode::kQuantLevels, sceneBound);
+            }
+            node.paddingAndDebug = float4(float(CompleteBinaryTreeHelpers::getLeftChild(nodeIdx)), float(CompleteBinaryTreeHelpers::getRightChild(nodeIdx) + 1), 0, 0);
+            return node;
+        }
+
+        std::vector<LightTreeNode> buildLightTree(const std::vector<LightTreeNode>& sortedLeaves, const AABB& sceneBound)
+        {
+            LightTreeLayout layout = computeLayout((uint)sortedLeaves.size());
+            std::vector<LightTreeNode> lightTree(layout.nodeCount);
+
+            const uint leafOffset = CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(layout.levelCount - 1);
+            for (uint i = 0; i < layout.leafCount; i++)
+            {
+                lightTree[leafOffset + i] = i < layout.lightCount ? sortedLeaves[i] : createBogusLeaf(leafOffset + i);
+            }
+
+            if (layout.levelCount < 2) return lightTree;
+
+            auto mergeLevelRange = [&](int level, size_t begin, size_t end)
+            {
+                const size_t levelStart = CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(level);
+                for (size_t nodeIdx = levelStart + begin; nodeIdx < levelStart + end; nodeIdx++)
+                {
+                    const LightTreeNode& left = lightTree[CompleteBinaryTreeHelpers::getLeftChild((int)nodeIdx)];
+                    const LightTreeNode& right = lightTree[CompleteBinaryTreeHelpers::getRightChild((int)nodeIdx)];
+                    lightTree[nodeIdx] = mergeNodes((uint)nodeIdx, left, right, sceneBound);
+                }
+            };
+
+            // Subtrees rooted at splitLevel are independent, one chunk of them is built by one thread from leaves up.
+            const int leafLevel = (int)layout.levelCount - 1;
+            const int splitLevel = std::min(leafLevel - 1, (int)uintLog2(nextPow2(HimeParallelHelpers::getWorkerCount())));
+            const size_t subtreeCount = CompleteBinaryTreeHelpers::getCurrentLevelNodeCount(splitLevel);
+            const size_t minChunkSize = (4096 * subtreeCount + layout.leafCount - 1) / layout.leafCount; // at least 4096 leaves per thread
+            HimeParallelHelpers::parallelFor(0, subtreeCount, [&](size_t begin, size_t end, unsigned int)
+            {
+                for (int level = leafLevel - 1; level >= splitLevel; level--)
+                {
+                    const int shift = level - splitLevel;
+                    mergeLevelRange(level, begin << shift, end << shift);
+                }
+            }, minChunkSize);
+
+            for (int level = splitLevel - 1; level >= 0; level--)
+            {
+                mergeLevelRange(level, 0, CompleteBinaryTreeHelpers::getCurrentLevelNodeCount(level));
+            }
+
+            return lightTree;
+        }
+
+        std::vector<ConstructionBatch> computeConstructionBatches(uint levelCount)
+        {
+            const int kMaxWorkLoad = 2048;
+
+            std::vector<ConstructionBatch> batches;
+            for (int srcLevel = (int)levelCount - 1; srcLevel > 0;)
+            {
+                int workLoad = 0;
+
+                int dstLevelStart = srcLevel - 1;
+                while (dstLevelStart >= 0)
+                {
+                    workLoad += CompleteBinaryTreeHelpers::getCurrentLevelNodeCount(dstLevelStart);
+                    dstLevelStart--;
+                    if (workLoad > kMaxWorkLoad) break;
+                }
+                dstLevelStart++;
+
+                batches.push_back({ srcLevel, dstLevelStart, srcLevel - 1, workLoad });
+                srcLevel = dstLevelStart;
+            }
+            return batches;
+        }
+
+        std::vector<LightTreeNode> buildLightTreeByLevelBatches(const std::vector<LightTreeNode>& sortedLeaves, const AABB& sceneBound)
+        {
+            LightTreeLayout layout = computeLayout((uint)sortedLeaves.size());
+            std::vector<LightTreeNode> lightTree(layout.nodeCount);
+
+            const uint leafOffset = CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(layout.levelCount - 1);
+            for (uint i = 0; i < layout.leafCount; i++)
+            {
+                lightTree[leafOffset + i] = i < layout.lightCount ? sortedLeaves[i] : createBogusLeaf(leafOffset + i);
+            }
+
+            // Batches must run in order, nodes of a batch are independent.
+            for (const ConstructionBatch& batch : computeConstructionBatches(layout.levelCount))
+            {
+                const int dstStart = CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(batch.dstLevelStart);
+                HimeParallelHelpers::parallelFor(0, batch.workLoad, [&](size_t begin, size_t end, unsigned int)
+                {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        int nodeIdx = dstStart + (int)i;
+                        int nodeLevel = uintLog2(nodeIdx + 1);
+                        int startNodeId = CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(batch.srcLevel) + ((nodeIdx - CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(nodeLevel)) << (batch.srcLevel - nodeLevel));
+                        int endNodeId = startNodeId + (1 << (batch.srcLevel - nodeLevel));
+
+                        LightTreeNode node = lightTree[startNodeId];
+                        node.id = nodeIdx;
+                        for (int nodeId = startNodeId + 1; nodeId < endNodeId; nodeId++)
+                        {
+                            const LightTreeNode& srcNode = lightTree[nodeId];
+                            if (srcNode.isBogus()) continue;
+                            node.intensity += srcNode.intensity;
+                            node.aabbMinPoint = min(srcNode.aabbMinPoint, node.aabbMinPoint);
+                            node.aabbMaxPoint = max(srcNode.aabbMaxPoint, node.aabbMaxPoint);
+                            node.mortonCode = MortonCodeHelpers::computeMortonCodeByPos((node.aabbMinPoint + node.aabbMaxPoint) * 0.5f, LightTreeMortonCode::kQuantLevels, sceneBound);
+                        }
+                        node.paddingAndDebug = float4((float)startNodeId, (float)endNodeId, 0.f, 0.f);
+                        lightTree[nodeIdx] = node;
+                    }
+                }, 256);
+            }
+            return lightTree;
+        }
+
+        std::vector<uint> refitLightTree(std::vector<LightTreeNode>& lightTree, const std::vector<uint>& dirtyNodes, const AABB& sceneBound)
+        {
+            std::vector<uint> modifiedNodes;
+            std::vector<uint> levelNodes = dirtyNodes;
+            std::sort(levelNodes.begin(), levelNodes.end());
+            levelNodes.erase(std::unique(levelNodes.begin(), levelNodes.end()), levelNodes.end());
+
+            // Dirty leaves are all on the last level, so ancestors are refitted level by level.
+            while (!levelNodes.empty())
+            {
+                modifiedNodes.insert(modifiedNodes.end(), levelNodes.begin(), levelNodes.end());
+                if (levelNodes[0] == 0) break;
+
+                std::vector<uint> parentNodes;
+                parentNodes.reserve(levelNodes.size());
+                for (uint nodeIdx : levelNodes)
+                {
+                    uint parentIdx = (nodeIdx - 1) / 2;
+                    if (parentNodes.empty() || parentNodes.back() != parentIdx) parentNodes.push_back(parentIdx);
+                }
+
+                for (uint parentIdx : parentNodes)
+                {
+                    const LightTreeNode& left = lightTree[CompleteBinaryTreeHelpers::getLeftChild(parentIdx)];
+                    const LightTreeNode& right = lightTree[CompleteBinaryTreeHelpers::getRightChild(parentIdx)];
+                    lightTree[parentIdx] = mergeNodes(parentIdx, left, right, sceneBound);
+                }
+
+                levelNodes.swap(parentNodes);
+            }
+
+            std::sort(modifiedNodes.begin(), modifiedNodes.end());
+            return modifiedNodes;
+        }
+
+        int updateLeafOrderFlags(const std::vector<LightTreeNode>& lightTree, const std::vector<uint>& dirtyNodes, LeafOrder order, const AABB& sceneBound, std::vector<uint>& orderFlags)
+        {
+            const uint levelCount = uintLog2((uint)lightTree.size() + 1);
+            const uint leafStart = CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(levelCount - 1);
+            const uint leafCount = CompleteBinaryTreeHelpers::getCurrentLevelNodeCount(levelCount - 1);
+
+            int violationDelta = 0;
+            auto updateFlag = [&](uint leafIdx)
+            {
+                if (leafIdx + 1 >= leafCount || lightTree[leafStart + leafIdx + 1].isBogus()) return;
+                uint isViolated = computeLeafSortKey(lightTree[leafStart + leafIdx], order, sceneBound) > computeLeafSortKey(lightTree[leafStart + leafIdx + 1], order, sceneBound) ? 1 : 0;
+                if (orderFlags[leafIdx] != isViolated) violationDelta += isViolated ? 1 : -1;
+                orderFlags[leafIdx] = isViolated;
+            };
+
+            for (uint nodeIdx : dirtyNodes)
+            {
+                uint leafIdx = nodeIdx - leafStart;
+                if (leafIdx > 0) updateFlag(leafIdx - 1);
+                updateFlag(leafIdx);
+            }
+            return violationDelta;
+        }
+
+        LBVH buildLBVH(const std::vector<LightTreeNode>& sortedLeaves, LeafOrder order, const AABB& sceneBound)
+        {
+            LBVH lbvh;
+            const int leafCount = (int)sortedLeaves.size();
+            if (leafCount == 0) return lbvh;
+
+            const int internalCount = leafCount - 1;
+            lbvh.nodes.resize(2 * leafCount - 1);
+            lbvh.children.assign(2 * leafCount - 1, uint2(kInvalidLightTreeNode));
+
+            std::vector<uint> keys(leafCount);
+            for (int i = 0; i < leafCount; i++)
+            {
+                keys[i] = computeLeafSortKey(sortedLeaves[i], order, sceneBound);
+                lbvh.nodes[internalCount + i] = sortedLeaves[i];
+                lbvh.nodes[internalCount + i].id = internalCount + i;
+            }
+
+            // Length of common prefix of key i and key j, index is appended to keys to split same keys.
+            auto countLeadingZeros = [](uint v) { uint n = 0; for (uint bit = 0x80000000; bit != 0 && (v & bit) == 0; bit >>= 1) n++; return n; };
+            auto delta = [&](int i, int j) -> int
+            {
+                if (j < 0 || j >= leafCount) return -1;
+                if (keys[i] == keys[j]) return 32 + (int)countLeadingZeros((uint)(i ^ j));
+                return (int)countLeadingZeros(keys[i] ^ keys[j]);
+            };
+
+            // Each internal node finds its range and split independently.
+            std::vector<uint> parents(lbvh.nodes.size(), kInvalidLightTreeNode);
+            HimeParallelHelpers::parallelFor(0, internalCount, [&](size_t begin, size_t end, unsigned int)
+            {
+                for (int i = (int)begin; i < (int)end; i++)
+                {
+                    int d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+
+                    // Upper bound of range length, then exact range end by binary search.
+                    int deltaMin = delta(i, i - d);
+                    int lengthMax = 2;
+                    while (delta(i, i + lengthMax * d) > deltaMin) lengthMax *= 2;
+                    int length = 0;
+                    for (int t = lengthMax / 2; t >= 1; t /= 2)
+                    {
+                        if (delta(i, i + (length + t) * d) > deltaMin) length += t;
+                    }
+                    int j = i + length * d;
+
+                    // Split position.
+                    int deltaNode = delta(i, j);
+                    int split = 0;
+                    for (int divisor = 2; ; divisor *= 2)
+                    {
+                        int t = (length + divisor - 1) / divisor;
+                        if (delta(i, i + (split + t) * d) > deltaNode) split += t;
+                        if (t == 1) break;
+                    }
+                    int gamma = i + split * d + std::min(d, 0);
+
+                    uint left = std::min(i, j) == gamma ? internalCount + gamma : gamma;
+                    uint right = std::max(i, j) == gamma + 1 ? internalCount + gamma + 1 : gamma + 1;
+                    lbvh.children[i] = uint2(left, right);
+                    parents[left] = i;
+                    parents[right] = i;
+                }
+            });
+
+            // Merge bounds bottom up, children of a node are always merged before the node itself.
+            std::vector<uint> stack = { 0 };
+            std::vector<uint> postOrder;
+            postOrder.reserve(internalCount);
+            while (!stack.empty())
+            {
+                uint nodeIdx = stack.back();
+                stack.pop_back();
+                if (lbvh.children[nodeIdx].x == kInvalidLightTreeNode) continue;
+                postOrder.push_back(nodeIdx);
+                stack.push_back(lbvh.children[nodeIdx].x);
+                stack.push_back(lbvh.children[nodeIdx].y);
+            }
+            for (auto it = postOrder.rbegin(); it != postOrder.rend(); it++)
+            {
+                uint2 children = lbvh.children[*it];
+                LightTreeNode node = mergeNodes(*it, lbvh.nodes[children.x], lbvh.nodes[children.y], sceneBound);
+                node.paddingAndDebug = float4(float(children.x), float(children.y), 0, 0);
+                lbvh.nodes[*it] = node;
+            }
+
+            return lbvh;
+        }
+
+        LightTreeView LightTreeView::create(const std::vector<LightTreeNode>& lightTree)
+        {
+            LightTreeView view;
+            view.pNodes = lightTree.data();
+            view.nodeCount = (uint)lightTree.size();
+            view.leafStartIdx = CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(uintLog2(view.nodeCount + 1) - 1);
+            return view;
+        }
+
+        LightTreeView LightTreeView::create(const LBVH& lbvh)
+        {
+            LightTreeView view;
+            view.pNodes = lbvh.nodes.data();
+            view.pChildren = lbvh.children.data();
+            view.nodeCount = (uint)lbvh.nodes.size();
+            return view;
+        }
+
+        namespace
+        {
+            float computeMaxDistAlong(const float3& p, const float3& dir, const float3& boundMin, const float3& boundMax)
+            {
+                float3 dir_p = dir * p;
+                float3 mx0 = dir * boundMin - dir_p;
+                float3 mx1 = dir * boundMax - dir_p;
+                return std::max(mx0[0], mx1[0]) + std::max(mx0[1], mx1[1]) + std::max(mx0[2], mx1[2]);
+            }
+
+            float computeGeomTermBound(const float3& p, const float3& N, const float3& boundMin, const float3& boundMax)
+            {
+                float nrm_max = computeMaxDistAlong(p, N, boundMin, boundMax);
+                if (nrm_max <= 0) return 0.0f;
+                float3 d = min(max(p, boundMin), boundMax) - p;
+                float3 tng = d - dot(d, N) * N;
+                float hyp2 = dot(tng, tng) + nrm_max * nrm_max;
+                return nrm_max / std::sqrt(hyp2);
+            }
+
+            float computeSquaredDistanceToClosestPoint(const float3& p, const float3& boundMin, const float3& boundMax)
+            {
+                float3 d = min(max(p, boundMin), boundMax) - p;
+                return dot(d, d);
+            }
+
+            float computeSquaredDistanceToFarthestPoint(const float3& p, const float3& boundMin, const float3& boundMax)
+            {
+                float3 d = max(abs(boundMin - p), abs(boundMax - p));
+                return dot(d, d);
+            }
+
+            float normalizedWeights(float l2_0, float l2_1, float intensGeom0, float intensGeom1)
+            {
+                float ww0 = l2_1 * intensGeom0;
+                float ww1 = l2_0 * intensGeom1;
+                return ww0 / (ww0 + ww1);
+            }
+        }
+
+        float computeNodeError(const LightTreeNode& node, const float3& posW, const float3& normal, float errorLimit, float sceneLightBoundRadius)
+        {
+            float3 d = min(max(posW, node.aabbMinPoint), node.aabbMaxPoint) - posW;
+            float dlen2 = dot(d, d);
+            float SR2 = errorLimit * sceneLightBoundRadius;
+            SR2 *= SR2;
+            if (dlen2 < SR2) dlen2 = SR2; // bound the distance
+
+            float atten = 1.f / dlen2;
+            atten *= computeGeomTermBound(posW, normal, node.aabbMinPoint, node.aabbMaxPoint);
+            return atten * length(node.intensity);
+        }
+
+        void findCut(const LightTreeView& lightTree, const float3& posW, const float3& normal, uint cutSize, float errorLimit, float sceneLightBoundRadius, LightcutHeap& heap)
+        {
+            cutSize = std::min(cutSize, kMaxLightcutSize);
+
+            heap.reset(cutSize);
+            heap.push(0, 1e27f);
+            while (heap.size < cutSize)
+            {
+                uint nodeId = heap.top().nodeId;
+                if (lightTree.isLeaf(nodeId)) break;
+
+                // Replace as two children.
+                uint2 children = lightTree.getChildren(nodeId);
+                heap.replaceTop(children.x, computeNodeError(lightTree.pNodes[children.x], posW, normal, errorLimit, sceneLightBoundRadius));
+                if (lightTree.pNodes[children.y].isBogus()) continue;
+                heap.push(children.y, computeNodeError(lightTree.pNodes[children.y], posW, normal, errorLimit, sceneLightBoundRadius));
+            }
+        }
+
+        std::vector<uint> findCut(const LightTreeView& lightTree, const float3& posW, const float3& normal, uint cutSize, float errorLimit, float sceneLightBoundRadius)
+        {
+            LightcutHeap heap;
+            findCut(lightTree, posW, normal, cutSize, errorLimit, sceneLightBoundRadius, heap);
+
+            std::vector<uint> cut(heap.size);
+            for (uint i = 0; i < heap.size; i++) cut[i] = heap.nodes[i].nodeId;
+            return cut;
+        }
+
+        std::vector<uint> findCutByLinearScan(const LightTreeView& lightTree, const float3& posW, const float3& normal, uint cutSize, float errorLimit, float sceneLightBoundRadius)
+        {
+            struct HeapNode
+            {
+                uint nodeId;
+                float error;
+            };
+
+            std::vector<HeapNode> heap = { { 0, 1e27f } };
+            while (heap.size() < cutSize)
+            {
+                // Find max node.
+                size_t maxIdx = 0;
+                for (size_t i = 1; i < heap.size(); i++)
+                {
+                    if (heap[i].error > heap[maxIdx].error) maxIdx = i;
+                }
+
+                uint nodeId = heap[maxIdx].nodeId;
+                if (lightTree.isLeaf(nodeId)) break;
+
+                // Replace as two children.
+                uint2 children = lightTree.getChildren(nodeId);
+                heap[maxIdx] = { children.x, computeNodeError(lightTree.pNodes[children.x], posW, normal, errorLimit, sceneLightBoundRadius) };
+                if (lightTree.pNodes[children.y].isBogus()) continue;
+                heap.push_back({ children.y, computeNodeError(lightTree.pNodes[children.y], posW, normal, errorLimit, sceneLightBoundRadius) });
+            }
+
+            std::vector<uint> cut(heap.size());
+            for (size_t i = 0; i < heap.size(); i++) cut[i] = heap[i].nodeId;
+            return cut;
+        }
+
+        ShadingPointBound ShadingPointBound::create(const float3* positions, const float3* normals, size_t count)
+        {
+            ShadingPointBound bound;
+            bound.boundMin = positions[0];
+            bound.boundMax = positions[0];
+            float3 normalSum = float3(0);
+            for (size_t i = 0; i < count; i++)
+            {
+                bound.boundMin = min(bound.boundMin, positions[i]);
+                bound.boundMax = max(bound.boundMax, positions[i]);
+                normalSum += normals[i];
+            }
+
+            // Cone around average normal, degenerate to all directions if normals cancel out.
+            float normalSumLength = length(normalSum);
+            if (!(normalSumLength > 1e-4f)) return bound;
+            bound.normalAxis = normalSum / normalSumLength;
+            bound.normalCosAngle = 1.f;
+            for (size_t i = 0; i < count; i++) bound.normalCosAngle = std::min(bound.normalCosAngle, dot(bound.normalAxis, normals[i]));
+            return bound;
+        }
+
+        namespace
+        {
+            float computeGeomTermBound(const ShadingPointBound& bound, const float3& boundMin, const float3& boundMax)
+            {
+                if (bound.normalCosAngle <= -1.f) return 1.f;
+
+                // Cone of directions from bounding sphere of shading points to bounding sphere of node.
+                float3 d = (boundMin + boundMax) * 0.5f - (bound.boundMin + bound.boundMax) * 0.5f;
+                float dist = length(d);
+                float radius = 0.5f * (length(boundMax - boundMin) + length(bound.boundMax - bound.boundMin));
+                if (dist <= radius) return 1.f;
+
+                float cosTheta = std::max(-1.f, std::min(1.f, dot(bound.normalAxis, d) / dist));
+                float angle = std::acos(cosTheta) - std::acos(bound.normalCosAngle) - std::asin(radius / dist);
+                if (angle <= 0.f) return 1.f;
+                if (angle >= 1.5707964f) return 0.f;
+                return std::cos(angle);
+            }
+
+            float computeSquaredDistanceBetweenBounds(const float3& boundMin0, const float3& boundMax0, const float3& boundMin1, const float3& boundMax1)
+            {
+                float3 d = max(max(boundMin0 - boundMax1, boundMin1 - boundMax0), float3(0));
+                return dot(d, d);
+            }
+        }
+
+        float computeNodeError(const LightTreeNode& node, const ShadingPointBound& bound, float errorLimit, float sceneLightBoundRadius)
+        {
+            float dlen2 = computeSquaredDistanceBetweenBounds(bound.boundMin, bound.boundMax, node.aabbMinPoint, node.aabbMaxPoint);
+            float SR2 = errorLimit * sceneLightBoundRadius;
+            SR2 *= SR2;
+            if (dlen2 < SR2) dlen2 = SR2; // bound the distance
+
+            float atten = 1.f / dlen2;
+            atten *= computeGeomTermBound(bound, node.aabbMinPoint, node.aabbMaxPoint);
+            return atten * length(node.intensity);
+        }
+
+        void findCut(const LightTreeView& lightTree, const ShadingPointBound& bound, uint cutSize, float errorLimit, float sceneLightBoundRadius, LightcutHeap& heap)
+        {
+            cutSize = std::min(cutSize, kMaxLightcutSize);
+
+            heap.reset(cutSize);
+            heap.push(0, 1e27f);
+            while (heap.size < cutSize)
+            {
+                uint nodeId = heap.top().nodeId;
+                if (lightTree.isLeaf(nodeId)) break;
+
+                // Replace as two children.
+                uint2 children = lightTree.getChildren(nodeId);
+                heap.replaceTop(children.x, computeNodeError(lightTree.pNodes[children.x], bound, errorLimit, sceneLightBoundRadius));
+                if (lightTree.pNodes[children.y].isBogus()) continue;
+                heap.push(children.y, computeNodeError(lightTree.pNodes[children.y], bound, errorLimit, sceneLightBoundRadius));
+            }
+        }
+
+        bool firstChildWeight(const LightTreeNode& c0, const LightTreeNode& c1, const float3& p, const float3& N, float& prob0)
+        {
+            float c0_intensity = length(c0.intensity);
+            float c1_intensity = length(c1.intensity);
+
+            if (c0_intensity == 0)
+            {
+                if (c1_intensity == 0) return false;
+                prob0 = 0;
+                return true;
+            }
+            else if (c1_intensity == 0)
+            {
+                prob0 = 1;
+                return true;
+            }
+
+            float geom0 = computeGeomTermBound(p, N, c0.aabbMinPoint, c0.aabbMaxPoint);
+            float geom1 = computeGeomTermBound(p, N, c1.aabbMinPoint, c1.aabbMaxPoint);
+
+            if (geom0 + geom1 == 0) return false;
+
+            if (geom0 == 0)
+            {
+                prob0 = 0;
+                return true;
+            }
+            else if (geom1 == 0)
+            {
+                prob0 = 1;
+                return true;
+            }
+
+            float intensGeom0 = c0_intensity * geom0;
+            float intensGeom1 = c1_intensity * geom1;
+
+            float l2_min0 = computeSquaredDistanceToClosestPoint(p, c0.aabbMinPoint, c0.aabbMaxPoint);
+            float l2_min1 = computeSquaredDistanceToClosestPoint(p, c1.aabbMinPoint, c1.aabbMaxPoint);
+            float l2_max0 = computeSquaredDistanceToFarthestPoint(p, c0.aabbMinPoint, c0.aabbMaxPoint);
+            float l2_max1 = computeSquaredDistanceToFarthestPoint(p, c1.aabbMinPoint, c1.aabbMaxPoint);
+            float w_max0 = l2_min0 == 0 && l2_min1 == 0 ? intensGeom0 / (intensGeom0 + intensGeom1) : normalizedWeights(l2_min0, l2_min1, intensGeom0, intensGeom1);
+            float w_min0 = normalizedWeights(l2_max0, l2_max1, intensGeom0, intensGeom1);
+            prob0 = 0.5f * (w_max0 + w_min0);
+
+            return true;
+        }
+
+        bool traverseLightTree(const LightTreeView& lightTree, const float3& posW, const float3& normal, uint& nodeId, float& r, float& nodeProb)
+        {
+            while (!lightTree.isLeaf(nodeId))
+            {
+                uint2 children = lightTree.getChildren(nodeId);
+                float prob0;
+                if (!firstChildWeight(lightTree.pNodes[children.x], lightTree.pNodes[children.y], posW, normal, prob0)) return true;
+
+                if (r < prob0)
+                {
+                    nodeId = children.x;
+                    r /= prob0;
+                    nodeProb *= prob0;
+                }
+                else
+                {
+                    nodeId = children.y;
+                    r = (r - prob0) / (1 - prob0);
+                    nodeProb *= (1 - prob0);
+                }
+            }
+            return false;
+        }
+
+        std::vector<uint> computeNodeLightCounts(const LightTreeView& lightTree)
+        {
+            std::vector<uint> lightCounts(lightTree.nodeCount, 0);
+            std::vector<std::pair<uint, bool>> stack = { { 0, false } };
+            while (!stack.empty())
+            {
+                auto [nodeIdx, isVisited] = stack.back();
+                stack.pop_back();
+                if (lightTree.isLeaf(nodeIdx))
+                {
+                    lightCounts[nodeIdx] = lightTree.pNodes[nodeIdx].isBogus() ? 0 : 1;
+                    continue;
+                }
+
+                uint2 children = lightTree.getChildren(nodeIdx);
+                if (isVisited)
+                {
+                    lightCounts[nodeIdx] = lightCounts[children.x] + lightCounts[children.y];
+                    continue;
+                }
+                stack.push_back({ nodeIdx, true });
+                stack.push_back({ children.x, false });
+                stack.push_back({ children.y, false });
+            }
+            return lightCounts;
+        }
+
+        double computeSurfaceAreaSum(const std::vector<LightTreeNode>& lightTree)
+        {
+            double areaSum = 0.0;
+            for (const auto& node : lightTree)
+            {
+                if (node.isBogus()) continue;
+                float3 extent = node.aabbMaxPoint - node.aabbMinPoint;
+                areaSum += 2.0 * ((double)extent.x * extent.y + (double)extent.y * extent.z + (double)extent.z * extent.x);
+            }
+            return areaSum;
+        }
+    }
+}
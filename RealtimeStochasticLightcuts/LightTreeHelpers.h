@@ -0,0 +1,241 @@
+#pragma once
+#include "Falcor.h"
+#include "LightTreeData.slangh"
+#include "LightcutHeap.slangh"
+#include "../HimeUtils/HimeMath.h"
+
+namespace Falcor
+{
+    /** Host side version of light tree construction.
+
+        Mirrors generateLightTreeLeaves / sortTreeLeaves / constructLightTree, so light trees copied back
+        from GPU can be inspected and compared on CPU.
+    */
+    namespace LightTreeHelpers
+    {
+        // Light tree on GPU stores 30-bit codes, so only 10 bits per axis are supported by the passes.
+        const uint kMortonCodeBitsPerAxis = 10;
+        using LightTreeMortonCode = MortonCodeTraits<kMortonCodeBitsPerAxis>;
+
+        /** Space filling curve used to order light tree leaves.
+        */
+        enum class LeafOrder : uint32_t
+        {
+            Morton = 0,
+            Hilbert = 1,
+        };
+
+        struct LightTreeLayout
+        {
+            uint lightCount = 0;
+            uint leafCount = 0;
+            uint levelCount = 0;
+            uint nodeCount = 0;
+        };
+
+        /** Same layout as generateLightTreeLeaves(), leaves are padded with bogus leaves.
+        */
+        LightTreeLayout computeLayout(uint lightCount);
+
+        LightTreeNode createBogusLeaf(uint nodeIdx);
+
+        /** Sorting key of a leaf, morton code or hilbert code of its aabb center.
+        */
+        uint computeLeafSortKey(const LightTreeNode& leaf, LeafOrder order, const AABB& sceneBound);
+
+        /** Sort leaves by key, ascending.
+        */
+        void sortLeaves(std::vector<LightTreeNode>& leaves, LeafOrder order, const AABB& sceneBound);
+
+        /** Leaves of up to trianglesPerLeaf consecutive sorted triangles, same as ClusterLightTreeLeaves.cs.slang.
+            Triangles of leaf i are [i * trianglesPerLeaf, min((i + 1) * trianglesPerLeaf, triangle count)).
+        */
+        struct ClusteredLeaves
+        {
+            uint trianglesPerLeaf = 1;
+            std::vector<LightTreeNode> leaves; ///< Merged leaves, lightIdx is leaf index.
+            std::vector<uint> triangles;       ///< Light index of each sorted triangle.
+            std::vector<float> triangleCdf;    ///< CDF of triangle intensity within its leaf, last triangle of a leaf is 1.
+
+            uint getTriangleCount(uint leafIdx) const { return std::min(trianglesPerLeaf, (uint)triangles.size() - leafIdx * trianglesPerLeaf); }
+        };
+
+        /** Merge runs of trianglesPerLeaf sorted leaves into one leaf each.
+            \param[in] sortedLeaves Leaves of single triangles sorted by key of leaf order.
+            \param[in] trianglesPerLeaf Max triangles per leaf, at least 1.
+            \param[in] sceneBound Cubic scene bound.
+        */
+        ClusteredLeaves clusterLeaves(const std::vector<LightTreeNode>& sortedLeaves, uint trianglesPerLeaf, const AABB& sceneBound);
+
+        /** Host version of sampleLeafTriangle() in FindLightcuts.cs.slang.
+            \param[in,out] r Random number in [0, 1), rescaled to [0, 1) on return.
+            \param[in,out] nodeProb Probability of leaf, multiplied by probability of sampled triangle.
+            \return Light index of sampled triangle.
+        */
+        uint sampleLeafTriangle(const ClusteredLeaves& clusters, uint leafIdx, float& r, float& nodeProb);
+
+        /** Build light tree from sorted leaves.
+            Each internal node is merged from its two children (mergeNodes()), which is the summation order of
+            constructLightTreeBottomUp() in ConstructLightTree.cs.slang. Bounds only go through min/max, so they match the
+            GPU light tree exactly. Intensities and morton codes go through float arithmetic the shader compiler may fuse or
+            reorder, so they are only expected to match up to rounding. Level batch construction sums all descendants on its
+            source level one by one instead, see buildLightTreeByLevelBatches(). Debug data stores the child range [leftChild, rightChild + 1).
+            Each worker thread builds a range of subtrees from leaves up, and only the few levels above them are built
+            after threads join, instead of joining threads once per level.
+            \param[in] sortedLeaves Sorted leaves, bogus leaves are excluded.
+            \param[in] sceneBound Cubic scene bound.
+            \return Light tree nodes, nodeCount of computeLayout().
+        */
+        std::vector<LightTreeNode> buildLightTree(const std::vector<LightTreeNode>& sortedLeaves, const AABB& sceneBound);
+
+        /** Dispatch of constructLightTree() in ConstructLightTree.cs.slang, nodes of levels [dstLevelStart, dstLevelEnd] merge all nodes below them in srcLevel.
+        */
+        struct ConstructionBatch
+        {
+            int srcLevel;
+            int dstLevelStart;
+            int dstLevelEnd;
+            int workLoad;
+        };
+
+        /** Split level batch construction into dispatches from leaf level up, each one writes a few levels of at most about 2048 nodes.
+        */
+        std::vector<ConstructionBatch> computeConstructionBatches(uint levelCount);
+
+        /** Host version of level batch construction (constructLightTree() in ConstructLightTree.cs.slang).
+            Each internal node sums all nodes below it in the source level of its batch, so intensities differ from
+            buildLightTree() by rounding. Bounds, morton codes, light indices and node ids are the same. Debug data stores
+            the source node range [start, end).
+            \param[in] sortedLeaves Sorted leaves, bogus leaves are excluded.
+            \param[in] sceneBound Cubic scene bound.
+            \return Light tree nodes, nodeCount of computeLayout().
+        */
+        std::vector<LightTreeNode> buildLightTreeByLevelBatches(const std::vector<LightTreeNode>& sortedLeaves, const AABB& sceneBound);
+
+        /** Merge two children into their parent node.
+        */
+        LightTreeNode mergeNodes(uint nodeIdx, const LightTreeNode& left, const LightTreeNode& right, const AABB& sceneBound);
+
+        /** Refit ancestors of modified leaves in place.
+            Each ancestor is merged from its children again, so the result is bit identical with
+            buildLightTree() on the modified leaves, as long as leaf order is not changed.
+            \param[in,out] lightTree Light tree to refit, leaves are already modified.
+            \param[in] dirtyNodes Node indices of modified leaves.
+            \param[in] sceneBound Cubic scene bound.
+            \return Node indices of modified leaves and all refitted ancestors, sorted ascending.
+        */
+        std::vector<uint> refitLightTree(std::vector<LightTreeNode>& lightTree, const std::vector<uint>& dirtyNodes, const AABB& sceneBound);
+
+        /** Update out of order flags of leaf pairs next to modified leaves, same as refitLightTree() in ConstructLightTree.cs.slang.
+            Flag i is set if sorting key of leaf i is larger than leaf i + 1. Light tree is still valid with such leaves, but its bounds get looser.
+            \param[in] lightTree Light tree, leaves are already modified.
+            \param[in] dirtyNodes Node indices of modified leaves.
+            \param[in,out] orderFlags One flag per light, all cleared after a rebuild.
+            \return Change of out of order pair count. A pair only counts when its flag changes, so leaves modified in many refits are not counted again.
+        */
+        int updateLeafOrderFlags(const std::vector<LightTreeNode>& lightTree, const std::vector<uint>& dirtyNodes, LeafOrder order, const AABB& sceneBound, std::vector<uint>& orderFlags);
+
+        /** Light tree with explicit child links, built by buildLBVH().
+            Node 0 is root. Nodes [0, lightCount - 1) are internal nodes, nodes [lightCount - 1, 2 * lightCount - 1) are sorted leaves.
+        */
+        struct LBVH
+        {
+            std::vector<LightTreeNode> nodes;
+            std::vector<uint2> children; ///< Left and right child of each node, kInvalidLightTreeNode for leaves.
+        };
+
+        /** Build LBVH (Karras, "Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d Trees", HPG 2012)
+            from sorted leaves. No bogus leaves are needed, so node count is 2 * lightCount - 1.
+            Leaves with same key are split by their index. Host version of buildLBVHHierarchy() and buildLBVHBounds() in ConstructLightTree.cs.slang.
+            \param[in] sortedLeaves Leaves sorted by key of leaf order.
+            \param[in] order Leaf order used to sort leaves.
+            \param[in] sceneBound Cubic scene bound.
+        */
+        LBVH buildLBVH(const std::vector<LightTreeNode>& sortedLeaves, LeafOrder order, const AABB& sceneBound);
+
+        /** Read only view of a light tree, complete binary tree (implicit child links) or LBVH.
+        */
+        struct LightTreeView
+        {
+            const LightTreeNode* pNodes = nullptr;
+            const uint2* pChildren = nullptr; ///< Explicit child links, nullptr for complete binary tree.
+            uint nodeCount = 0;
+            uint leafStartIdx = 0;            ///< Complete binary tree only.
+
+            static LightTreeView create(const std::vector<LightTreeNode>& lightTree);
+            static LightTreeView create(const LBVH& lbvh);
+
+            bool isLeaf(uint nodeIdx) const { return pChildren ? pChildren[nodeIdx].x == kInvalidLightTreeNode : nodeIdx >= leafStartIdx; }
+            uint2 getChildren(uint nodeIdx) const
+            {
+                return pChildren ? pChildren[nodeIdx] : uint2(CompleteBinaryTreeHelpers::getLeftChild(nodeIdx), CompleteBinaryTreeHelpers::getRightChild(nodeIdx));
+            }
+        };
+
+        /** Host version of computeError() in FindLightcuts.cs.slang.
+        */
+        float computeNodeError(const LightTreeNode& node, const float3& posW, const float3& normal, float errorLimit, float sceneLightBoundRadius);
+
+        /** Host version of findCut() in FindLightcuts.cs.slang.
+            \param[in] cutSize Cut size, at most kMaxLightcutSize.
+            \param[out] heap Cut nodes with their errors, in heap order.
+        */
+        void findCut(const LightTreeView& lightTree, const float3& posW, const float3& normal, uint cutSize, float errorLimit, float sceneLightBoundRadius, LightcutHeap& heap);
+
+        /** Same as above.
+            \return Node indices of the cut in heap order, at most cutSize nodes.
+        */
+        std::vector<uint> findCut(const LightTreeView& lightTree, const float3& posW, const float3& normal, uint cutSize, float errorLimit, float sceneLightBoundRadius);
+
+        /** Find cut by scanning all cut nodes for the max error on every split, which is what findCut() did before LightcutHeap.
+            O(cutSize^2), only kept as baseline of cut selection benchmark.
+        */
+        std::vector<uint> findCutByLinearScan(const LightTreeView& lightTree, const float3& posW, const float3& normal, uint cutSize, float errorLimit, float sceneLightBoundRadius);
+
+        /** Bound of shading points sharing one cut (a screen tile), aabb of positions and cone of normals.
+        */
+        struct ShadingPointBound
+        {
+            float3 boundMin = float3(0);
+            float3 boundMax = float3(0);
+            float3 normalAxis = float3(0, 0, 1);
+            float normalCosAngle = -1.f; ///< Cosine of half angle of normal cone, -1 if normals can be in any direction.
+
+            /** Same as computeShadingPointBound() in FindLightcuts.cs.slang.
+                \param[in] count Number of shading points, at least 1.
+            */
+            static ShadingPointBound create(const float3* positions, const float3* normals, size_t count);
+        };
+
+        /** Host version of computeTileError() in FindLightcuts.cs.slang.
+            Distance and geometry term are bounded over all shading points in bound.
+        */
+        float computeNodeError(const LightTreeNode& node, const ShadingPointBound& bound, float errorLimit, float sceneLightBoundRadius);
+
+        /** Host version of findTileCut() in FindLightcuts.cs.slang, one cut shared by all shading points in bound.
+            Light samples still traverse below cut nodes with their own position and normal.
+        */
+        void findCut(const LightTreeView& lightTree, const ShadingPointBound& bound, uint cutSize, float errorLimit, float sceneLightBoundRadius, LightcutHeap& heap);
+
+        /** Host version of firstChildWeight() in FindLightcuts.cs.slang.
+            \return False if both children can not contribute.
+        */
+        bool firstChildWeight(const LightTreeNode& child0, const LightTreeNode& child1, const float3& posW, const float3& normal, float& prob0);
+
+        /** Host version of traverseLightTree() in FindLightcuts.cs.slang, samples a leaf under nodeId.
+            \param[in,out] nodeId Cut node, sampled leaf on return.
+            \param[in,out] r Random number in [0, 1), rescaled at each level.
+            \param[in,out] nodeProb Probability of sampled leaf.
+            \return True if traversal stopped at a dead branch.
+        */
+        bool traverseLightTree(const LightTreeView& lightTree, const float3& posW, const float3& normal, uint& nodeId, float& r, float& nodeProb);
+
+        /** Number of lights under each node.
+        */
+        std::vector<uint> computeNodeLightCounts(const LightTreeView& lightTree);
+
+        /** Sum of aabb surface area of all non-bogus nodes. Leaves are points, so this is the sum of internal nodes.
+        */
+        double computeSurfaceAreaSum(const std::vector<LightTreeNode>& lightTree);
+    }
+}
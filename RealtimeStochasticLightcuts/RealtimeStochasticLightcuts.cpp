@@ -27,22 +27,50 @@
  **************************************************************************/
 #include "RealtimeStochasticLightcuts.h"
 #include "../HimeUtils/HimeMath.h"
+#include "../HimeUtils/HimeMortonCode.h"
 #include "../HimeUtils/HimeUtils.h"
 
 namespace
 {
     const char kDesc[] = "Implementation of I3D2020 paper: Realtime Stochastic Lightcuts";
+    const char kLightTreeCacheDirectory[] = "LightTreeCache";
 
     // Compute passes.
     const HimeComputePassDesc kGenerateLightTreeLeavesPass = { "RenderPasses/Hime/RealtimeStochasticLightcuts/GenerateLightTreeLeaves.cs.slang", "generateLightTreeLeaves" };
     const HimeComputePassDesc kReorderLightTreeLeavesPass  = { "RenderPasses/Hime/RealtimeStochasticLightcuts/ReorderLightTreeLeaves.cs.slang" , "reorderLightTreeLeaves"  };
+    const HimeComputePassDesc kClusterLightTreeLeavesPass  = { "RenderPasses/Hime/RealtimeStochasticLightcuts/ClusterLightTreeLeaves.cs.slang" , "clusterLightTreeLeaves"  };
     const HimeComputePassDesc kConstructLightTreePass      = { "RenderPasses/Hime/RealtimeStochasticLightcuts/ConstructLightTree.cs.slang"     , "constructLightTree"      };
+    const HimeComputePassDesc kConstructLightTreeBottomUpPass = { "RenderPasses/Hime/RealtimeStochasticLightcuts/ConstructLightTree.cs.slang"  , "constructLightTreeBottomUp" };
+    const HimeComputePassDesc kBuildLBVHHierarchyPass      = { "RenderPasses/Hime/RealtimeStochasticLightcuts/ConstructLightTree.cs.slang"     , "buildLBVHHierarchy"      };
+    const HimeComputePassDesc kBuildLBVHBoundsPass         = { "RenderPasses/Hime/RealtimeStochasticLightcuts/ConstructLightTree.cs.slang"     , "buildLBVHBounds"         };
+    const HimeComputePassDesc kInitLightTreeRefitPass      = { "RenderPasses/Hime/RealtimeStochasticLightcuts/ConstructLightTree.cs.slang"     , "initLightTreeRefit"      };
+    const HimeComputePassDesc kWriteDirtyLeavesPass        = { "RenderPasses/Hime/RealtimeStochasticLightcuts/ConstructLightTree.cs.slang"     , "writeDirtyLeaves"        };
+    const HimeComputePassDesc kRefitLightTreePass          = { "RenderPasses/Hime/RealtimeStochasticLightcuts/ConstructLightTree.cs.slang"     , "refitLightTree"          };
+    const HimeComputePassDesc kPackLightTreePass           = { "RenderPasses/Hime/RealtimeStochasticLightcuts/PackLightTree.cs.slang"          , "packLightTree"           };
     const HimeComputePassDesc kFindLightcutsPass           = { "RenderPasses/Hime/RealtimeStochasticLightcuts/FindLightCuts.cs.slang"          , "findLightcuts"           };
 
     // Compute shader settings.
-    const uint kQuantLevels = 1024; // [Hime]TODO: make as variable
+    using LightTreeMortonCode = LightTreeHelpers::LightTreeMortonCode;
+    const uint kQuantLevels = LightTreeMortonCode::kQuantLevels;
+    const uint kMortonCodeBits = LightTreeMortonCode::kCodeBits;
+    static_assert(kMortonCodeBits <= 32, "LightTreeNode::mortonCode and GPU sorting keys are 32-bit, 63-bit morton codes are host only");
     const uint kGroupSize = 512;
     const uint kChunkSize = 16;
+    const uint kMaxLeafTriangleCount = 16;
+
+    const Gui::DropdownList kLeafOrderList =
+    {
+        { (uint)LightTreeHelpers::LeafOrder::Morton, "Morton" },
+        { (uint)LightTreeHelpers::LeafOrder::Hilbert, "Hilbert" },
+    };
+
+    // Pixels of a tile share one cut, tile size must divide kChunkSize and CPULightcuts::kTileSize.
+    const Gui::DropdownList kLightcutTileList =
+    {
+        { 1, "Per pixel" },
+        { 4, "4x4" },
+        { 8, "8x8" },
+    };
 }
 
 // Don't remove this. it's required for hot-reload to function properly
@@ -71,26 +99,91 @@ void RealtimeStochasticLightcuts::renderUI(Gui::Widgets& widget)
     {
         auto constructLightTreeUI = group.group("Construct light tree", true);
         constructLightTreeUI.checkbox("Use CPU sorter", mLightTree.useCPUSorter, false);
+        uint leafOrder = (uint)mLightTree.leafOrder;
+        if (constructLightTreeUI.dropdown("Leaf order", kLeafOrderList, leafOrder))
+        {
+            mLightTree.leafOrder = (LightTreeHelpers::LeafOrder)leafOrder;
+            mpGenerateLightTreeLeavesPass = nullptr; // sorting key is selected by define
+            mpRefitLightTreePass = nullptr;
+            mLightTree.isRefitValid = false;
+        }
+        if (constructLightTreeUI.checkbox("Use LBVH", mLightTree.useLBVH))
+        {
+            mpFindLightcutsPass = nullptr; // child links are selected by define
+            mLightTree.isRefitValid = false;
+        }
+        if (!mLightTree.useLBVH && constructLightTreeUI.checkbox("Bottom-up construction", mLightTree.useBottomUpConstruction))
+        {
+            mLightTree.cacheKey = {};
+            mLightTree.isRefitValid = false;
+        }
+        if (!mLightTree.useLBVH && constructLightTreeUI.var("Triangles per leaf", mLightTree.leafTriangleCount, 1u, kMaxLeafTriangleCount, 1u))
+        {
+            mpFindLightcutsPass = nullptr; // triangle selection in leaves is selected by define
+            mLightTree.cacheKey = {};
+            mLightTree.isRefitValid = false;
+        }
+        constructLightTreeUI.checkbox("Skip static light tree rebuild", mLightTree.skipStaticRebuild);
+        if (mLightTree.skipStaticRebuild || mLightTree.useCache)
+        {
+            constructLightTreeUI.text("Light tree builds: " + std::to_string(mLightTree.rebuildCount) + ", skipped: " + std::to_string(mLightTree.skippedRebuildCount)
+                + ", hashed / changed fingerprint chunks: " + std::to_string(mLightTree.emissiveFingerprint.getHashedChunkCount()) + " / " + std::to_string(mLightTree.emissiveFingerprint.getChangedChunkCount())
+                + " of " + std::to_string(mLightTree.emissiveFingerprint.getChunkCount()));
+        }
+        // Cache and refit store leaves of single triangles.
+        if (!mLightTree.useLBVH && !useLeafClusters() && constructLightTreeUI.checkbox("Use light tree cache", mLightTree.useCache))
+        {
+            mLightTree.cacheKey = {};
+        }
+        if (!mLightTree.useLBVH && !useLeafClusters() && constructLightTreeUI.checkbox("Refit dynamic lights", mLightTree.useRefit))
+        {
+            mpGenerateLightTreeLeavesPass = nullptr; // dirty leaf tracking is selected by define
+            mLightTree.cacheKey = {}; // refit forces bottom-up construction
+            mLightTree.isRefitValid = false;
+        }
+        if (isRefitEnabled())
+        {
+            constructLightTreeUI.var("Rebuild threshold", mLightTree.refitThreshold, 0.f, 1.f, 0.001f);
+            constructLightTreeUI.text("Dirty leaves: " + std::to_string(mLightTree.dirtyLeafCount) + ", out of order leaf pairs: " + std::to_string(mLightTree.orderViolationCount));
+        }
     }
 
     {
         auto lightcutsUI = group.group("Find lightcuts", true);
-        if (lightcutsUI.var("Cut size", mTracerParams.lightsPerPixel, 1u, mTracerParams.kMaxLightsPerPixel, 1u))
+        if (lightcutsUI.checkbox("Compact light tree", mLightTree.useCompactLightTree))
         {
-            // It's better to bind lightSamplesPerVertex to lightsPerPixel.
-            mSharedParams.lightSamplesPerVertex = mTracerParams.lightsPerPixel;
-            recreateVars();
-            mTracerParams.isLightsPerPixelChanged = true;
+            mpFindLightcutsPass = nullptr;
+            if (!mLightTree.useCompactLightTree) mLightTree.PackedGPUBuffer = nullptr;
+        }
+        if (mLightTree.useCompactLightTree && mLightTree.PackedGPUBuffer)
+        {
+            // Construction, refit and cache still use the full tree, so the packed tree is extra memory.
+            lightcutsUI.text("Light tree memory: " + std::to_string(mLightTree.GPUBuffer->getSize() >> 10) + " KB full + " + std::to_string(mLightTree.PackedGPUBuffer->getSize() >> 10)
+                + " KB compact, traversal reads compact only.");
+        }
+        if (lightcutsUI.var("Cut size", mLightTree.cutSize, 1u, kMaxLightcutSize, 1u)) mpFindLightcutsPass = nullptr;
+        if (lightcutsUI.dropdown("Lightcut tile", kLightcutTileList, mLightTree.lightcutTileSize)) mpFindLightcutsPass = nullptr;
+        if (lightcutsUI.checkbox("Low discrepancy samples", mLightTree.useLowDiscrepancySamples)) mpFindLightcutsPass = nullptr;
+        if (getCutSize() > mTracerParams.lightsPerPixel)
+        {
+            lightcutsUI.text("Cut size is larger than shadow rays, each shadow ray selects a cut node by its error.");
         }
     }
 
     {
         auto rtUI = group.group("Ray tracing", true);
-        rtUI.var("Shadowrays per pixel", mTracerParams.lightsPerPixel, 1u, mTracerParams.kMaxLightsPerPixel, 1u);
+        if (rtUI.var("Shadowrays per pixel", mTracerParams.lightsPerPixel, 1u, mTracerParams.kMaxLightsPerPixel, 1u))
+        {
+            // It's better to bind lightSamplesPerVertex to lightsPerPixel.
+            mSharedParams.lightSamplesPerVertex = mTracerParams.lightsPerPixel;
+            recreateVars();
+            mTracerParams.isLightsPerPixelChanged = true;
+        }
     }
 
     {
         auto debugUI = group.group("Debug", true);
+        if (debugUI.button("Report morton code collisions")) reportMortonCodeCollisions();
         debugUI.checkbox("Visualize light tree", mTracerParams.enableDebugTexture, false);
         if (mTracerParams.enableDebugTexture)
         {
@@ -111,17 +204,58 @@ void RealtimeStochasticLightcuts::renderUI(Gui::Widgets& widget)
     HimePathTracer::renderUI(widget);
 }
 
+void RealtimeStochasticLightcuts::setScene(RenderContext* pRenderContext, const Scene::SharedPtr& pScene)
+{
+    HimePathTracer::setScene(pRenderContext, pScene);
+    mLightTree.isFingerprintValid = false;
+    mLightTree.builtKey = {};
+    mLightTree.cacheKey = {};
+}
+
 void RealtimeStochasticLightcuts::updateEmissiveTriangleTexture(RenderContext* pRenderContext, const RenderData& renderData)
 {
     PROFILE("Realtime Stochastic Lightcuts");
-    generateLightTreeLeaves(pRenderContext);
-    sortTreeLeaves(pRenderContext);
-    constructLightTree(pRenderContext);
+
+    // Cache stores complete binary trees of single triangle leaves.
+    const bool useCache = mLightTree.useCache && !mLightTree.useLBVH && !useLeafClusters();
+    LightTreeCache::Key key;
+    if (useCache || mLightTree.skipStaticRebuild) key = computeLightTreeCacheKey(pRenderContext);
+
+    bool isLightTreeValid = false;
+    if (useCache) isLightTreeValid = loadLightTreeCache(pRenderContext, key);
+    else if (mLightTree.skipStaticRebuild) isLightTreeValid = key.lightCount > 0 && key == mLightTree.builtKey;
+    mLightTree.builtKey = key;
+
+    if (isLightTreeValid)
+    {
+        mLightTree.skippedRebuildCount++;
+    }
+    else
+    {
+        mLightTree.rebuildCount++;
+        generateLightTreeLeaves(pRenderContext);
+        if (mLightTree.useLBVH)
+        {
+            buildLBVH(pRenderContext);
+            mLightTree.cacheKey = {}; // light tree buffer is overwritten by LBVH
+        }
+        else if (!isRefitEnabled() || !refitLightTree(pRenderContext))
+        {
+            sortTreeLeaves(pRenderContext);
+            constructLightTree(pRenderContext);
+            if (isRefitEnabled()) initLightTreeRefit(pRenderContext);
+            if (useLeafClusters()) mLightTree.cacheKey = {}; // light tree buffer is overwritten by clustered leaves
+        }
+    }
+    if (mLightTree.useCompactLightTree) packLightTree(pRenderContext);
     findLightcuts(pRenderContext, renderData);
 }
 
 void RealtimeStochasticLightcuts::updateDebugTexture(RenderContext* renderContext, const RenderData& renderData)
 {
+    // Light tree levels are only defined in complete binary tree.
+    if (mLightTree.useLBVH) return;
+
     // Copy buffer to cpu
     Buffer::SharedPtr pLightTreeBuffer = mLightTree.GPUBuffer;
     std::vector<LightTreeNode> lightTree(pLightTreeBuffer->getElementCount());
@@ -169,6 +303,7 @@ RealtimeStochasticLightcuts::RealtimeStochasticLightcuts(const Dictionary& dict)
     mDebugParams.visualizeLevelRange = uint2(0, 0);
 
     mpLightTreeLeavesSorter = HimeBitonicSort::create(true); // we are using key index, which is uint2 = 64bit
+    mpLightTreeLeavesCPUSorter = HimeRadixSort::create();
     mpShapeVisualizer = ShapeVisualizer::create();
 }
 
@@ -181,72 +316,125 @@ void RealtimeStochasticLightcuts::generateLightTreeLeaves(RenderContext* pRender
     if (mpGenerateLightTreeLeavesPass == nullptr)
     {
         Program::DefineList defines = mpScene->getSceneDefines();
+        defines.add("USE_HILBERT_ORDER", mLightTree.leafOrder == LightTreeHelpers::LeafOrder::Hilbert ? "1" : "0");
+        defines.add("TRACK_DIRTY_LEAVES", mLightTree.useRefit ? "1" : "0");
         kGenerateLightTreeLeavesPass.createComputePass(mpGenerateLightTreeLeavesPass, defines, kGroupSize, kChunkSize);
     }
 
-    mLightTree.lightCount = mpScene->getLightCollection(pRenderContext)->getTotalLightCount();
-    mLightTree.leafCount = nextPow2(mLightTree.lightCount);
-    mLightTree.bogusLightCount = mLightTree.leafCount - mLightTree.lightCount;
-    mLightTree.levelCount = uintLog2(mLightTree.leafCount) + 1;
-    mLightTree.nodeCount = CompleteBinaryTreeHelpers::getAllNodeCount(mLightTree.levelCount - 1);
+    uint lightCount = mpScene->getLightCollection(pRenderContext)->getTotalLightCount();
+    AABB sceneBound = sceneBoundHelper();
+    if (lightCount != mLightTree.lightCount || sceneBound.minPoint != mLightTree.refitSceneBound.minPoint || sceneBound.maxPoint != mLightTree.refitSceneBound.maxPoint)
+    {
+        mLightTree.isRefitValid = false;
+    }
+
+    mLightTree.lightCount = lightCount;
+    mLightTree.clusterCount = useLeafClusters() ? (lightCount + mLightTree.leafTriangleCount - 1) / mLightTree.leafTriangleCount : lightCount;
+    if (mLightTree.useLBVH)
+    {
+        // No bogus leaves, levelCount is only used by the complete binary tree.
+        mLightTree.leafCount = mLightTree.lightCount;
+        mLightTree.bogusLightCount = 0;
+        mLightTree.levelCount = uintLog2(nextPow2(mLightTree.lightCount)) + 1;
+        mLightTree.nodeCount = std::max(2 * mLightTree.lightCount, 1u) - 1;
+    }
+    else
+    {
+        mLightTree.leafCount = nextPow2(mLightTree.clusterCount);
+        mLightTree.bogusLightCount = mLightTree.leafCount - mLightTree.clusterCount;
+        mLightTree.levelCount = uintLog2(mLightTree.leafCount) + 1;
+        mLightTree.nodeCount = CompleteBinaryTreeHelpers::getAllNodeCount(mLightTree.levelCount - 1);
+    }
 
-    HimeBufferHelpers::createOrExtendBuffer(mLightTree.GPUBuffer, sizeof(LightTreeNode), mLightTree.nodeCount, "Lightcuts::LightTreeBuffer");
+    HimeBufferHelpers::createOrResizeBuffer(mLightTree.GPUBuffer, sizeof(LightTreeNode), mLightTree.nodeCount, "Lightcuts::LightTreeBuffer");
     HimeBufferHelpers::createOrExtendBuffer(mLightTree.SortingHelperBuffer, sizeof(LightTreeNode), mLightTree.lightCount, "Lightcuts::SortingHelperBuffer");
     HimeBufferHelpers::createOrExtendBuffer(mLightTree.SortingKeyIndexBuffer, sizeof(uint2), mLightTree.lightCount, "Lightcuts::SortingKeyIndexBuffer");
 
-    MortonCodeHelpers::updateShaderVar(mpGenerateLightTreeLeavesPass.getRootVar(), kQuantLevels, sceneBoundHelper());
+    if (mLightTree.useRefit)
+    {
+        mLightTree.maxDirtyLeafCount = std::max(1u, (uint)(mLightTree.lightCount * mLightTree.refitThreshold));
+        HimeBufferHelpers::createOrExtendBuffer(mLightTree.DirtyLeavesBuffer, sizeof(LightTreeNode), mLightTree.maxDirtyLeafCount, "Lightcuts::DirtyLeavesBuffer");
+        HimeBufferHelpers::createOrExtendBuffer(mLightTree.DirtyLeafCounterBuffer, sizeof(uint), 2, "Lightcuts::DirtyLeafCounterBuffer");
+        uint dirtyLeafCount = 0; // out of order leaf pair count is kept until next rebuild
+        mLightTree.DirtyLeafCounterBuffer->setBlob(&dirtyLeafCount, 0, sizeof(uint));
+        mpGenerateLightTreeLeavesPass.getRootVar()["gDirtyLeaves"] = mLightTree.DirtyLeavesBuffer;
+        mpGenerateLightTreeLeavesPass.getRootVar()["gDirtyLeafCounter"] = mLightTree.DirtyLeafCounterBuffer;
+    }
+
+    MortonCodeHelpers::updateShaderVar(mpGenerateLightTreeLeavesPass.getRootVar(), kQuantLevels, sceneBound);
     mpGenerateLightTreeLeavesPass.getRootVar()["gScene"] = mpScene->getParameterBlock();
     mpGenerateLightTreeLeavesPass.getRootVar()["PerFrameCB"]["lightCount"] = mLightTree.lightCount;
     mpGenerateLightTreeLeavesPass.getRootVar()["PerFrameCB"]["levelCount"] = mLightTree.levelCount;
+    // Leaves of multiple triangles are written by clusterLightTreeLeaves after sorting, LBVH leaves by buildLBVH.
+    mpGenerateLightTreeLeavesPass.getRootVar()["PerFrameCB"]["writeLightTree"] = !(mLightTree.useRefit && mLightTree.isRefitValid) && !useLeafClusters() && !mLightTree.useLBVH;
+    mpGenerateLightTreeLeavesPass.getRootVar()["PerFrameCB"]["maxDirtyLeafCount"] = mLightTree.maxDirtyLeafCount;
     mpGenerateLightTreeLeavesPass.getRootVar()["gLightTree"] = mLightTree.GPUBuffer;
     mpGenerateLightTreeLeavesPass.getRootVar()["gSortingHelper"] = mLightTree.SortingHelperBuffer;
     mpGenerateLightTreeLeavesPass.getRootVar()["gSortingKeyIndex"] = mLightTree.SortingKeyIndexBuffer;
 
-    mpGenerateLightTreeLeavesPass->execute(pRenderContext, mLightTree.leafCount, 1, 1);
+    mpGenerateLightTreeLeavesPass->execute(pRenderContext, std::max(mLightTree.leafCount, mLightTree.lightCount), 1, 1);
 }
 
-void RealtimeStochasticLightcuts::sortTreeLeaves(RenderContext* pRenderContext)
+void RealtimeStochasticLightcuts::sortLightTreeKeys(RenderContext* pRenderContext)
 {
-    PROFILE("Sort Light Tree Leaves");
-    auto& lightTreeCPUBuffer = mLightTree.CPUBuffer;
-    auto& lightTreeGPUBuffer = mLightTree.GPUBuffer;
-
     if (mLightTree.useCPUSorter)
     {
         PROFILE("CPU Sort Light Tree Leaves");
-        // Copy buffer to cpu, sort and copy back to gpu
-        uint32_t leafStartIdx = CompleteBinaryTreeHelpers::getCurrentLevelNodeStartIdx(mLightTree.levelCount - 1);
-        size_t bufferSize = sizeof(LightTreeNode) * mLightTree.lightCount;
-
-        lightTreeCPUBuffer.resize(mLightTree.lightCount);
-        LightTreeNode* pTree = (LightTreeNode*)lightTreeGPUBuffer->map(Buffer::MapType::Read);
-        memcpy(lightTreeCPUBuffer.data(), &(pTree[leafStartIdx]), bufferSize);
-        lightTreeGPUBuffer->unmap();
+        // Only key-index pairs are copied back and sorted, leaves are still reordered on GPU.
+        auto& keyIndexPairs = mLightTree.CPUSortingKeyIndex;
+        keyIndexPairs.resize(mLightTree.lightCount);
+        HimeBufferHelpers::copyBufferBackToCPU(mLightTree.SortingKeyIndexBuffer, sizeof(HimeRadixSort::KeyIndexPair), mLightTree.lightCount, keyIndexPairs.data());
 
-        std::sort(lightTreeCPUBuffer.begin(), lightTreeCPUBuffer.end(), [](const LightTreeNode& a, const LightTreeNode& b) { return a.mortonCode < b.mortonCode; });
+        mpLightTreeLeavesCPUSorter->sort(keyIndexPairs.data(), keyIndexPairs.size(), kMortonCodeBits);
 
-        uint32_t leafOffsetInByte = leafStartIdx * sizeof(LightTreeNode);
-        lightTreeGPUBuffer->setBlob(lightTreeCPUBuffer.data(), leafOffsetInByte, bufferSize);
+        mLightTree.SortingKeyIndexBuffer->setBlob(keyIndexPairs.data(), 0, keyIndexPairs.size() * sizeof(HimeRadixSort::KeyIndexPair));
     }
     else
     {
-        {
-            PROFILE("GPU Sort Light Tree Leaves");
+        PROFILE("GPU Sort Light Tree Leaves");
+        mpLightTreeLeavesSorter->sort(pRenderContext, mLightTree.SortingKeyIndexBuffer, mLightTree.lightCount);
+    }
+}
 
-            mpLightTreeLeavesSorter->sort(pRenderContext, mLightTree.SortingKeyIndexBuffer, mLightTree.lightCount);
-        }
+void RealtimeStochasticLightcuts::sortTreeLeaves(RenderContext* pRenderContext)
+{
+    PROFILE("Sort Light Tree Leaves");
+
+    sortLightTreeKeys(pRenderContext);
+
+    if (useLeafClusters())
+    {
+        PROFILE("Cluster Light Tree Leaves");
+        kClusterLightTreeLeavesPass.createComputePassIfNecessary(mpClusterLightTreeLeavesPass, kGroupSize, kChunkSize, false);
+
+        HimeBufferHelpers::createOrExtendBuffer(mLightTree.LeafTrianglesBuffer, sizeof(uint), mLightTree.lightCount, "Lightcuts::LeafTrianglesBuffer");
+        HimeBufferHelpers::createOrExtendBuffer(mLightTree.LeafTriangleCdfBuffer, sizeof(float), mLightTree.lightCount, "Lightcuts::LeafTriangleCdfBuffer");
+
+        MortonCodeHelpers::updateShaderVar(mpClusterLightTreeLeavesPass.getRootVar(), kQuantLevels, sceneBoundHelper());
+        mpClusterLightTreeLeavesPass.getRootVar()["PerFrameCB"]["lightCount"] = mLightTree.lightCount;
+        mpClusterLightTreeLeavesPass.getRootVar()["PerFrameCB"]["clusterCount"] = mLightTree.clusterCount;
+        mpClusterLightTreeLeavesPass.getRootVar()["PerFrameCB"]["levelCount"] = mLightTree.levelCount;
+        mpClusterLightTreeLeavesPass.getRootVar()["PerFrameCB"]["trianglesPerLeaf"] = mLightTree.leafTriangleCount;
+        mpClusterLightTreeLeavesPass.getRootVar()["gLightTree"] = mLightTree.GPUBuffer;
+        mpClusterLightTreeLeavesPass.getRootVar()["gSortingHelper"] = mLightTree.SortingHelperBuffer;
+        mpClusterLightTreeLeavesPass.getRootVar()["gSortingKeyIndex"] = mLightTree.SortingKeyIndexBuffer;
+        mpClusterLightTreeLeavesPass.getRootVar()["gLeafTriangles"] = mLightTree.LeafTrianglesBuffer;
+        mpClusterLightTreeLeavesPass.getRootVar()["gLeafTriangleCdf"] = mLightTree.LeafTriangleCdfBuffer;
+
+        mpClusterLightTreeLeavesPass->execute(pRenderContext, uint3(mLightTree.leafCount, 1, 1));
+    }
+    else
+    {
         PROFILE("Reorder Light Tree Leaves");
-        {
-            kReorderLightTreeLeavesPass.createComputePassIfNecessary(mpReorderLightTreeLeavesPass, kGroupSize, kChunkSize, false);
+        kReorderLightTreeLeavesPass.createComputePassIfNecessary(mpReorderLightTreeLeavesPass, kGroupSize, kChunkSize, false);
 
-            mpReorderLightTreeLeavesPass.getRootVar()["PerFrameCB"]["lightCount"] = mLightTree.lightCount;
-            mpReorderLightTreeLeavesPass.getRootVar()["PerFrameCB"]["levelCount"] = mLightTree.levelCount;
-            mpReorderLightTreeLeavesPass.getRootVar()["gLightTree"] = mLightTree.GPUBuffer;
-            mpReorderLightTreeLeavesPass.getRootVar()["gSortingHelper"] = mLightTree.SortingHelperBuffer;
-            mpReorderLightTreeLeavesPass.getRootVar()["gSortingKeyIndex"] = mLightTree.SortingKeyIndexBuffer;
+        mpReorderLightTreeLeavesPass.getRootVar()["PerFrameCB"]["lightCount"] = mLightTree.lightCount;
+        mpReorderLightTreeLeavesPass.getRootVar()["PerFrameCB"]["levelCount"] = mLightTree.levelCount;
+        mpReorderLightTreeLeavesPass.getRootVar()["gLightTree"] = mLightTree.GPUBuffer;
+        mpReorderLightTreeLeavesPass.getRootVar()["gSortingHelper"] = mLightTree.SortingHelperBuffer;
+        mpReorderLightTreeLeavesPass.getRootVar()["gSortingKeyIndex"] = mLightTree.SortingKeyIndexBuffer;
 
-            mpReorderLightTreeLeavesPass->execute(pRenderContext, uint3(mLightTree.lightCount, 1, 1));
-        }
+        mpReorderLightTreeLeavesPass->execute(pRenderContext, uint3(mLightTree.lightCount, 1, 1));
     }
 }
 
@@ -254,24 +442,35 @@ void RealtimeStochasticLightcuts::constructLightTree(RenderContext* pRenderConte
 {
     PROFILE("Construct Light Tree");
 
-    // create light tree construction program
-    const int kMaxWorkLoad = 2048;
+    if (mLightTree.levelCount < 2) return;
+
+    if (useBottomUpConstruction())
+    {
+        const uint internalNodeCount = mLightTree.leafCount - 1;
+        HimeBufferHelpers::createOrExtendBuffer(mLightTree.ReadyCounterBuffer, sizeof(uint), internalNodeCount, "Lightcuts::ReadyCounterBuffer");
+        pRenderContext->clearUAV(mLightTree.ReadyCounterBuffer->getUAV().get(), uint4(0));
+
+        // One thread per parent of two leaves.
+        const uint workLoad = CompleteBinaryTreeHelpers::getCurrentLevelNodeCount(mLightTree.levelCount - 2);
+        kConstructLightTreeBottomUpPass.createComputePassIfNecessary(mpConstructLightTreeBottomUpPass, kGroupSize, kChunkSize, false);
+        MortonCodeHelpers::updateShaderVar(mpConstructLightTreeBottomUpPass.getRootVar(), kQuantLevels, sceneBoundHelper());
+        mpConstructLightTreeBottomUpPass.getRootVar()["PerFrameCB"]["workLoad"] = workLoad;
+        mpConstructLightTreeBottomUpPass.getRootVar()["PerFrameCB"]["srcLevel"] = mLightTree.levelCount - 1;
+        mpConstructLightTreeBottomUpPass.getRootVar()["gCoherentLightTree"] = mLightTree.GPUBuffer;
+        mpConstructLightTreeBottomUpPass.getRootVar()["gReadyCounters"] = mLightTree.ReadyCounterBuffer;
+        mpConstructLightTreeBottomUpPass->execute(pRenderContext, workLoad, 1, 1);
+        return;
+    }
 
+    // create light tree construction program
     kConstructLightTreePass.createComputePassIfNecessary(mpConstructLightTreePass, kGroupSize, kChunkSize, false);
 
-    for (int srcLevel = mLightTree.levelCount - 1; srcLevel > 0;)
+    for (const LightTreeHelpers::ConstructionBatch& batch : LightTreeHelpers::computeConstructionBatches(mLightTree.levelCount))
     {
-        int workLoad = 0;
-
-        int dstLevelStart = srcLevel - 1;
-        while(dstLevelStart >= 0)
-        {
-            workLoad += CompleteBinaryTreeHelpers::getCurrentLevelNodeCount(dstLevelStart);
-            dstLevelStart--;
-            if (workLoad > kMaxWorkLoad) break;
-        }
-        dstLevelStart++;
-        int dstLevelEnd = srcLevel - 1;
+        const int srcLevel = batch.srcLevel;
+        const int dstLevelStart = batch.dstLevelStart;
+        const int dstLevelEnd = batch.dstLevelEnd;
+        const int workLoad = batch.workLoad;
 
         {
             PROFILE("Construct Light Tree Level " + std::to_string(dstLevelStart) + "-" + std::to_string(dstLevelEnd));
@@ -283,9 +482,266 @@ void RealtimeStochasticLightcuts::constructLightTree(RenderContext* pRenderConte
             mpConstructLightTreePass.getRootVar()["gLightTree"] = mLightTree.GPUBuffer;
             mpConstructLightTreePass->execute(pRenderContext, workLoad, 1, 1);
         }
+    }
+}
+
+void RealtimeStochasticLightcuts::buildLBVH(RenderContext* pRenderContext)
+{
+    PROFILE("Build LBVH");
+
+    if (mLightTree.lightCount == 0) return;
+    sortLightTreeKeys(pRenderContext);
+
+    const uint internalNodeCount = mLightTree.lightCount - 1;
+    HimeBufferHelpers::createOrExtendBuffer(mLightTree.ChildrenBuffer, sizeof(uint2), mLightTree.nodeCount, "Lightcuts::LightTreeChildrenBuffer");
+    HimeBufferHelpers::createOrExtendBuffer(mLightTree.ParentsBuffer, sizeof(uint), mLightTree.nodeCount, "Lightcuts::LightTreeParentsBuffer");
+    HimeBufferHelpers::createOrExtendBuffer(mLightTree.ReadyCounterBuffer, sizeof(uint), std::max(internalNodeCount, 1u), "Lightcuts::ReadyCounterBuffer");
+    pRenderContext->clearUAV(mLightTree.ReadyCounterBuffer->getUAV().get(), uint4(0));
+
+    // One thread per sorted leaf, and per internal node of the same index.
+    kBuildLBVHHierarchyPass.createComputePassIfNecessary(mpBuildLBVHHierarchyPass, kGroupSize, kChunkSize, false);
+    mpBuildLBVHHierarchyPass.getRootVar()["PerFrameCB"]["workLoad"] = mLightTree.lightCount;
+    mpBuildLBVHHierarchyPass.getRootVar()["gSortingHelper"] = mLightTree.SortingHelperBuffer;
+    mpBuildLBVHHierarchyPass.getRootVar()["gSortingKeyIndex"] = mLightTree.SortingKeyIndexBuffer;
+    mpBuildLBVHHierarchyPass.getRootVar()["gCoherentLightTree"] = mLightTree.GPUBuffer;
+    mpBuildLBVHHierarchyPass.getRootVar()["gLightTreeChildren"] = mLightTree.ChildrenBuffer;
+    mpBuildLBVHHierarchyPass.getRootVar()["gLightTreeParents"] = mLightTree.ParentsBuffer;
+    mpBuildLBVHHierarchyPass->execute(pRenderContext, mLightTree.lightCount, 1, 1);
+
+    if (internalNodeCount == 0) return;
+
+    kBuildLBVHBoundsPass.createComputePassIfNecessary(mpBuildLBVHBoundsPass, kGroupSize, kChunkSize, false);
+    MortonCodeHelpers::updateShaderVar(mpBuildLBVHBoundsPass.getRootVar(), kQuantLevels, sceneBoundHelper());
+    mpBuildLBVHBoundsPass.getRootVar()["PerFrameCB"]["workLoad"] = mLightTree.lightCount;
+    mpBuildLBVHBoundsPass.getRootVar()["gCoherentLightTree"] = mLightTree.GPUBuffer;
+    mpBuildLBVHBoundsPass.getRootVar()["gLightTreeChildren"] = mLightTree.ChildrenBuffer;
+    mpBuildLBVHBoundsPass.getRootVar()["gLightTreeParents"] = mLightTree.ParentsBuffer;
+    mpBuildLBVHBoundsPass.getRootVar()["gReadyCounters"] = mLightTree.ReadyCounterBuffer;
+    mpBuildLBVHBoundsPass->execute(pRenderContext, mLightTree.lightCount, 1, 1);
+}
+
+void RealtimeStochasticLightcuts::packLightTree(RenderContext* pRenderContext)
+{
+    PROFILE("Pack Light Tree");
+
+    kPackLightTreePass.createComputePassIfNecessary(mpPackLightTreePass, kGroupSize, kChunkSize, false);
+    HimeBufferHelpers::createOrExtendBuffer(mLightTree.PackedGPUBuffer, sizeof(PackedLightTreeNode), mLightTree.nodeCount, "Lightcuts::PackedLightTreeBuffer");
+
+    AABB sceneBound = sceneBoundHelper();
+    mpPackLightTreePass.getRootVar()["PerFrameCB"]["nodeCount"] = mLightTree.nodeCount;
+    mpPackLightTreePass.getRootVar()["PerFrameCB"]["boundMin"] = sceneBound.minPoint;
+    mpPackLightTreePass.getRootVar()["PerFrameCB"]["boundExtent"] = sceneBound.extent();
+    mpPackLightTreePass.getRootVar()["gLightTree"] = mLightTree.GPUBuffer;
+    mpPackLightTreePass.getRootVar()["gPackedLightTree"] = mLightTree.PackedGPUBuffer;
+    mpPackLightTreePass->execute(pRenderContext, mLightTree.nodeCount, 1, 1);
+}
+
+bool RealtimeStochasticLightcuts::refitLightTree(RenderContext* pRenderContext)
+{
+    PROFILE("Refit Light Tree");
 
-        srcLevel = dstLevelStart;
+    if (!mLightTree.isRefitValid) return false;
+
+    // Counters of an earlier frame. Dirty leaves beyond maxDirtyLeafCount were dropped in that frame, so light tree is stale.
+    uint counters[2];
+    if (mLightTree.pRefitCounterReadback->read(counters, sizeof(counters)))
+    {
+        mLightTree.dirtyLeafCount = counters[0];
+        mLightTree.orderViolationCount = counters[1];
+        if (counters[0] > mLightTree.maxDirtyLeafCount || counters[1] > mLightTree.maxDirtyLeafCount) return false;
+    }
+
+    // Leaves keep their sorted positions, so light tree gets looser when lights move across leaf order.
+    // Dirty leaf count is only known on GPU, so each pass runs maxDirtyLeafCount threads and exits early.
+    const uint leafLevel = mLightTree.levelCount - 1;
+    kWriteDirtyLeavesPass.createComputePassIfNecessary(mpWriteDirtyLeavesPass, kGroupSize, kChunkSize, false);
+    mpWriteDirtyLeavesPass.getRootVar()["PerFrameCB"]["workLoad"] = mLightTree.maxDirtyLeafCount;
+    mpWriteDirtyLeavesPass.getRootVar()["gLightTree"] = mLightTree.GPUBuffer;
+    mpWriteDirtyLeavesPass.getRootVar()["gDirtyLeaves"] = mLightTree.DirtyLeavesBuffer;
+    mpWriteDirtyLeavesPass.getRootVar()["gDirtyLeafCounter"] = mLightTree.DirtyLeafCounterBuffer;
+    mpWriteDirtyLeavesPass.getRootVar()["gLeafNodeIndices"] = mLightTree.LeafNodeIndicesBuffer;
+    mpWriteDirtyLeavesPass->execute(pRenderContext, mLightTree.maxDirtyLeafCount, 1, 1);
+
+    if (mpRefitLightTreePass == nullptr)
+    {
+        Program::DefineList defines;
+        defines.add("USE_HILBERT_ORDER", mLightTree.leafOrder == LightTreeHelpers::LeafOrder::Hilbert ? "1" : "0");
+        kRefitLightTreePass.createComputePass(mpRefitLightTreePass, defines, kGroupSize, kChunkSize);
+    }
+    MortonCodeHelpers::updateShaderVar(mpRefitLightTreePass.getRootVar(), kQuantLevels, sceneBoundHelper());
+    mpRefitLightTreePass.getRootVar()["PerFrameCB"]["workLoad"] = mLightTree.maxDirtyLeafCount;
+    mpRefitLightTreePass.getRootVar()["PerFrameCB"]["srcLevel"] = leafLevel;
+    mpRefitLightTreePass.getRootVar()["gLightTree"] = mLightTree.GPUBuffer;
+    mpRefitLightTreePass.getRootVar()["gDirtyLeaves"] = mLightTree.DirtyLeavesBuffer;
+    mpRefitLightTreePass.getRootVar()["gDirtyLeafCounter"] = mLightTree.DirtyLeafCounterBuffer;
+    mpRefitLightTreePass.getRootVar()["gLeafNodeIndices"] = mLightTree.LeafNodeIndicesBuffer;
+    mpRefitLightTreePass.getRootVar()["gLeafOrderFlags"] = mLightTree.LeafOrderFlagsBuffer;
+    for (int dstLevel = (int)leafLevel - 1; dstLevel >= 0; dstLevel--)
+    {
+        mpRefitLightTreePass.getRootVar()["PerFrameCB"]["dstLevelStart"] = dstLevel;
+        mpRefitLightTreePass->execute(pRenderContext, mLightTree.maxDirtyLeafCount, 1, 1);
+    }
+
+    mLightTree.pRefitCounterReadback->copy(pRenderContext, mLightTree.DirtyLeafCounterBuffer, 0, sizeof(counters));
+    return true;
+}
+
+void RealtimeStochasticLightcuts::initLightTreeRefit(RenderContext* pRenderContext)
+{
+    PROFILE("Init Light Tree Refit");
+
+    HimeBufferHelpers::createOrExtendBuffer(mLightTree.LeafNodeIndicesBuffer, sizeof(uint), mLightTree.lightCount, "Lightcuts::LeafNodeIndicesBuffer");
+    HimeBufferHelpers::createOrExtendBuffer(mLightTree.LeafOrderFlagsBuffer, sizeof(uint), mLightTree.lightCount, "Lightcuts::LeafOrderFlagsBuffer");
+
+    kInitLightTreeRefitPass.createComputePassIfNecessary(mpInitLightTreeRefitPass, kGroupSize, kChunkSize, false);
+    mpInitLightTreeRefitPass.getRootVar()["PerFrameCB"]["workLoad"] = mLightTree.lightCount;
+    mpInitLightTreeRefitPass.getRootVar()["PerFrameCB"]["srcLevel"] = mLightTree.levelCount - 1;
+    mpInitLightTreeRefitPass.getRootVar()["gLightTree"] = mLightTree.GPUBuffer;
+    mpInitLightTreeRefitPass.getRootVar()["gLeafNodeIndices"] = mLightTree.LeafNodeIndicesBuffer;
+    mpInitLightTreeRefitPass.getRootVar()["gLeafOrderFlags"] = mLightTree.LeafOrderFlagsBuffer;
+    mpInitLightTreeRefitPass->execute(pRenderContext, mLightTree.lightCount, 1, 1);
+
+    // Counters read back before this rebuild belong to the old light tree.
+    const uint counters[2] = { 0, 0 };
+    mLightTree.DirtyLeafCounterBuffer->setBlob(counters, 0, sizeof(counters));
+    if (mLightTree.pRefitCounterReadback == nullptr) mLightTree.pRefitCounterReadback = HimeAsyncReadback::create();
+    mLightTree.pRefitCounterReadback->discard();
+
+    mLightTree.refitSceneBound = sceneBoundHelper();
+    mLightTree.dirtyLeafCount = 0;
+    mLightTree.orderViolationCount = 0;
+    mLightTree.isRefitValid = true;
+}
+
+std::vector<LightTreeCache::EmissiveFingerprint::TriangleRange> RealtimeStochasticLightcuts::findDirtyEmissiveTriangles(const std::vector<MeshLightData>& meshLights, size_t triangleCount)
+{
+    // Triangles of a mesh light only move with its instance, other emissive data only changes with materials or mesh lights.
+    const auto& globalMatrices = mpScene->getAnimationController()->getGlobalMatrices();
+    const bool isAllDirty = !mLightTree.isFingerprintValid || is_set(mpScene->getUpdates(), Scene::UpdateFlags::MaterialsChanged)
+        || meshLights.size() != mLightTree.emissiveInstanceMatrices.size();
+    mLightTree.emissiveInstanceMatrices.resize(meshLights.size());
+
+    std::vector<LightTreeCache::EmissiveFingerprint::TriangleRange> dirtyRanges;
+    if (isAllDirty) dirtyRanges.emplace_back(0, triangleCount);
+    for (size_t i = 0; i < meshLights.size(); i++)
+    {
+        const MeshLightData& meshLight = meshLights[i];
+        const glm::mat4& matrix = globalMatrices[mpScene->getMeshInstance(meshLight.instanceID).globalMatrixID];
+        if (!isAllDirty && matrix == mLightTree.emissiveInstanceMatrices[i]) continue;
+        if (!isAllDirty) dirtyRanges.emplace_back(meshLight.triangleOffset, meshLight.triangleOffset + meshLight.triangleCount);
+        mLightTree.emissiveInstanceMatrices[i] = matrix;
     }
+    return dirtyRanges;
+}
+
+LightTreeCache::Key RealtimeStochasticLightcuts::computeLightTreeCacheKey(RenderContext* pRenderContext)
+{
+    PROFILE("Hash Emissive Triangles");
+
+    auto pLightCollection = mpScene->getLightCollection(pRenderContext);
+    AABB sceneBound = sceneBoundHelper();
+
+    // Leaves are generated from triangle centers, area and emissive at center uv.
+    // Light collection only changes with scene updates, so fingerprint of last frame is reused otherwise.
+    const auto& triangles = pLightCollection->getMeshLightTriangles();
+    const bool isEmissiveChanged = !mLightTree.isFingerprintValid || is_set(mpScene->getUpdates(), Scene::UpdateFlags::LightCollectionChanged);
+    LightTreeCache::Key key;
+    if (!isEmissiveChanged)
+    {
+        key.emissiveHash = mLightTree.emissiveFingerprint.get();
+    }
+    else
+    {
+        static_assert(LightTreeCache::EmissiveFingerprint::kWordsPerTriangle == 16, "Triangle is packed into 16 words");
+        key.emissiveHash = mLightTree.emissiveFingerprint.update(triangles.size(), findDirtyEmissiveTriangles(pLightCollection->getMeshLights(), triangles.size()), [&](size_t triangleIdx, uint32_t* pWords)
+        {
+            const auto& triangle = triangles[triangleIdx];
+            float2 uv = (triangle.vtx[0].uv + triangle.vtx[1].uv + triangle.vtx[2].uv) / 3.f;
+            memcpy(pWords + 0, &triangle.vtx[0].pos, sizeof(float3));
+            memcpy(pWords + 3, &triangle.vtx[1].pos, sizeof(float3));
+            memcpy(pWords + 6, &triangle.vtx[2].pos, sizeof(float3));
+            memcpy(pWords + 9, &uv, sizeof(float2));
+            memcpy(pWords + 11, &triangle.averageRadiance, sizeof(float3));
+            memcpy(pWords + 14, &triangle.area, sizeof(float));
+            pWords[15] = triangle.lightIdx;
+        });
+    }
+    mLightTree.isFingerprintValid = true;
+    key.quantLevels = kQuantLevels;
+    key.leafOrder = (uint32_t)mLightTree.leafOrder;
+    key.isBottomUp = useBottomUpConstruction() ? 1 : 0;
+    key.isLBVH = mLightTree.useLBVH ? 1 : 0;
+    key.leafTriangleCount = useLeafClusters() ? mLightTree.leafTriangleCount : 1;
+    key.lightCount = pLightCollection->getTotalLightCount();
+    key.nodeCount = LightTreeHelpers::computeLayout(key.lightCount).nodeCount;
+    key.boundMin = sceneBound.minPoint;
+    key.boundMax = sceneBound.maxPoint;
+    return key;
+}
+
+bool RealtimeStochasticLightcuts::loadLightTreeCache(RenderContext* pRenderContext, const LightTreeCache::Key& key)
+{
+    PROFILE("Load Light Tree Cache");
+
+    if (key.lightCount == 0) return false;
+
+    if (key == mLightTree.cacheKey)
+    {
+        // Light tree on GPU is still valid, lights are static since it's built.
+        if (!mLightTree.isCacheSaved) saveLightTreeCache(pRenderContext);
+        return true;
+    }
+
+    // Light tree built in this frame is saved in later frames, if lights are still the same.
+    mLightTree.cacheKey = key;
+    mLightTree.isCacheSaved = false;
+    if (mLightTree.pCacheReadback) mLightTree.pCacheReadback->discard();
+
+    std::string directory = getExecutableDirectory() + "/" + kLightTreeCacheDirectory;
+    LightTreeCache::MappedLightTree::SharedPtr pMappedLightTree = LightTreeCache::MappedLightTree::open(directory, key);
+    if (pMappedLightTree == nullptr) return false;
+
+    LightTreeHelpers::LightTreeLayout layout = LightTreeHelpers::computeLayout(key.lightCount);
+    mLightTree.lightCount = layout.lightCount;
+    mLightTree.clusterCount = layout.lightCount;
+    mLightTree.leafCount = layout.leafCount;
+    mLightTree.bogusLightCount = layout.leafCount - layout.lightCount;
+    mLightTree.levelCount = layout.levelCount;
+    mLightTree.nodeCount = layout.nodeCount;
+
+    // Nodes are uploaded from mapped file directly.
+    HimeBufferHelpers::createOrResizeBuffer(mLightTree.GPUBuffer, sizeof(LightTreeNode), mLightTree.nodeCount, "Lightcuts::LightTreeBuffer");
+    mLightTree.GPUBuffer->setBlob(pMappedLightTree->getNodes(), 0, mLightTree.nodeCount * sizeof(LightTreeNode));
+
+    mLightTree.isCacheSaved = true;
+    mLightTree.isRefitValid = false; // leaves of last frame are not generated
+    logInfo("Lightcuts: light tree of " + std::to_string(mLightTree.lightCount) + " lights is loaded from cache.");
+    return true;
+}
+
+void RealtimeStochasticLightcuts::saveLightTreeCache(RenderContext* pRenderContext)
+{
+    PROFILE("Save Light Tree Cache");
+
+    // Light tree is unchanged while the copy is in flight, otherwise cacheKey changes and the copy is discarded.
+    const uint64_t size = (uint64_t)mLightTree.cacheKey.nodeCount * sizeof(LightTreeNode);
+    if (mLightTree.pCacheReadback == nullptr) mLightTree.pCacheReadback = HimeAsyncReadback::create();
+    if (!mLightTree.pCacheReadback->isPending())
+    {
+        mLightTree.pCacheReadback->copy(pRenderContext, mLightTree.GPUBuffer, 0, size);
+        return;
+    }
+    if (!mLightTree.pCacheReadback->isReady()) return;
+
+    std::vector<LightTreeNode> lightTree(mLightTree.cacheKey.nodeCount);
+    mLightTree.pCacheReadback->read(lightTree.data(), size);
+
+    std::string directory = getExecutableDirectory() + "/" + kLightTreeCacheDirectory;
+    if (!LightTreeCache::save(directory, mLightTree.cacheKey, lightTree.data()))
+    {
+        logWarning("Lightcuts: failed to write light tree cache to " + directory + ".");
+    }
+    mLightTree.isCacheSaved = true; // don't retry every frame
 }
 
 void RealtimeStochasticLightcuts::findLightcuts(RenderContext* pRenderContext, const RenderData& renderData)
@@ -300,8 +756,14 @@ void RealtimeStochasticLightcuts::findLightcuts(RenderContext* pRenderContext, c
         defines.add(getValidResourceDefines(mInputChannels, renderData)); // We need `loadShadingData`, which uses input channels
         defines.add(mpSampleGenerator->getDefines()); // We need `SampleGenerator`
         defines.add("NUM_LIGHT_SAMPLES", std::to_string(mTracerParams.lightsPerPixel));
+        defines.add("CUT_SIZE", std::to_string(getCutSize()));
+        defines.add("LIGHTCUT_TILE_SIZE", std::to_string(mLightTree.lightcutTileSize));
         defines.add("USE_VBUFFER", mSharedParams.useVBuffer ? "1" : "0");
         defines.add("GBUFFER_ADJUST_SHADING_NORMALS", mGBufferAdjustShadingNormals ? "1" : "0");
+        defines.add("USE_COMPACT_LIGHT_TREE", mLightTree.useCompactLightTree ? "1" : "0");
+        defines.add("USE_LBVH", mLightTree.useLBVH ? "1" : "0");
+        defines.add("LEAF_TRIANGLE_COUNT", std::to_string(useLeafClusters() ? mLightTree.leafTriangleCount : 1u));
+        defines.add("USE_LOW_DISCREPANCY_SAMPLES", mLightTree.useLowDiscrepancySamples ? "1" : "0");
         kFindLightcutsPass.createComputePass(mpFindLightcutsPass, defines, kGroupSize, kChunkSize);
 
         mTracerParams.isLightsPerPixelChanged = false;
@@ -326,14 +788,58 @@ void RealtimeStochasticLightcuts::findLightcuts(RenderContext* pRenderContext, c
     mpFindLightcutsPass.getRootVar()["PerFrameCB"]["dispatchDim"] = mSharedParams.frameDim;
     mpFindLightcutsPass.getRootVar()["PerFrameCB"]["frameCount"] = mSharedParams.frameCount;
     mpFindLightcutsPass.getRootVar()["PerFrameCB"]["levelCount"] = mLightTree.levelCount;
+    mpFindLightcutsPass.getRootVar()["PerFrameCB"]["triangleCount"] = mLightTree.lightCount;
     mpFindLightcutsPass.getRootVar()["PerFrameCB"]["errorLimit"] = mLightTree.errorLimit;
     mpFindLightcutsPass.getRootVar()["PerFrameCB"]["sceneLightBoundRadius"] = sceneBound.radius();
-    mpFindLightcutsPass.getRootVar()["gLightTree"] = mLightTree.GPUBuffer;
+    mpFindLightcutsPass.getRootVar()["PerFrameCB"]["lightTreeBoundMin"] = sceneBound.minPoint;
+    mpFindLightcutsPass.getRootVar()["PerFrameCB"]["lightTreeBoundExtent"] = sceneBound.extent();
+    if (mLightTree.useCompactLightTree) mpFindLightcutsPass.getRootVar()["gPackedLightTree"] = mLightTree.PackedGPUBuffer;
+    else mpFindLightcutsPass.getRootVar()["gLightTree"] = mLightTree.GPUBuffer;
+    if (mLightTree.useLBVH) mpFindLightcutsPass.getRootVar()["gLightTreeChildren"] = mLightTree.ChildrenBuffer;
+    if (useLeafClusters())
+    {
+        mpFindLightcutsPass.getRootVar()["gLeafTriangles"] = mLightTree.LeafTrianglesBuffer;
+        mpFindLightcutsPass.getRootVar()["gLeafTriangleCdf"] = mLightTree.LeafTriangleCdfBuffer;
+    }
+    if (mLightTree.useLowDiscrepancySamples)
+    {
+        if (mpSequenceBuffers == nullptr) mpSequenceBuffers = HimeSequenceBuffers::get();
+        mpSequenceBuffers->setShaderData(mpFindLightcutsPass.getRootVar());
+    }
     mpFindLightcutsPass.getRootVar()["gLightIndex"] = pLightIndexTexture;
 
     mpFindLightcutsPass->execute(pRenderContext, uint3(mSharedParams.frameDim, 1));
 }
 
+void RealtimeStochasticLightcuts::reportMortonCodeCollisions()
+{
+    if (mLightTree.lightCount == 0) return;
+
+    // Unsorted leaves, aabb center is triangle center.
+    std::vector<LightTreeNode> leaves(mLightTree.lightCount);
+    HimeBufferHelpers::copyBufferBackToCPU(mLightTree.SortingHelperBuffer, sizeof(LightTreeNode), mLightTree.lightCount, leaves.data());
+    AABB sceneBound = sceneBoundHelper();
+
+    // Number of lights which can not be separated from another light by morton code.
+    auto countCollisions = [&](auto bitsPerAxis)
+    {
+        constexpr uint kBitsPerAxis = decltype(bitsPerAxis)::value;
+        std::vector<MortonCodeHelpers::MortonCode<kBitsPerAxis>> codes(leaves.size());
+        for (size_t i = 0; i < leaves.size(); i++)
+        {
+            float3 center = (leaves[i].aabbMinPoint + leaves[i].aabbMaxPoint) * 0.5f;
+            codes[i] = MortonCodeHelpers::computeMortonCodeByPos<kBitsPerAxis>(center, sceneBound);
+        }
+        std::sort(codes.begin(), codes.end());
+        return (uint)(codes.end() - std::unique(codes.begin(), codes.end()));
+    };
+
+    uint collisions30 = countCollisions(std::integral_constant<uint, 10>());
+    uint collisions63 = countCollisions(std::integral_constant<uint, 21>());
+    logInfo("Lightcuts: " + std::to_string(mLightTree.lightCount) + " lights, " + std::to_string(collisions30) + " collide with 30-bit morton code, "
+        + std::to_string(collisions63) + " collide with 63-bit morton code.");
+}
+
 AABB RealtimeStochasticLightcuts::sceneBoundHelper() const
 {
     const auto& sceneBound = mpScene->getSceneBounds();
@@ -27,8 +27,12 @@
  **************************************************************************/
 #pragma once
 #include "../HimeUtils/BitonicSort/BitonicSort.h"
+#include "../HimeUtils/RadixSort/RadixSort.h"
+#include "../HimeUtils/HimeSequenceBuffers.h"
 #include "../HimeTracer/HimePathTracer/HimePathTracer.h"
 #include "LightTreeData.slangh"
+#include "LightTreeHelpers.h"
+#include "LightTreeCache.h"
 #include "../HimeUtils/Shape/VisualizeShape.h"
 
 using namespace Falcor;
@@ -46,6 +50,7 @@ public:
 
     virtual std::string getDesc() override;
     void renderUI(Gui::Widgets& widget) override;
+    virtual void setScene(RenderContext* pRenderContext, const Scene::SharedPtr& pScene) override;
 
 protected:
     virtual void updateEmissiveTriangleTexture(RenderContext* pRenderContext, const RenderData& renderData) override;
@@ -57,8 +62,67 @@ private:
     void generateLightTreeLeaves(RenderContext* pRenderContext);
     void sortTreeLeaves(RenderContext* pRenderContext);
     void constructLightTree(RenderContext* pRenderContext);
+    void packLightTree(RenderContext* pRenderContext);
+
+    /** Sort key-index pairs of generated leaves, used by sortTreeLeaves() and buildLBVH().
+    */
+    void sortLightTreeKeys(RenderContext* pRenderContext);
+
+    /** Build LBVH on GPU from sorted keys (Karras 2012), replaces sortTreeLeaves() and constructLightTree().
+    */
+    void buildLBVH(RenderContext* pRenderContext);
+
+    /** Refit ancestors of leaves changed since last frame on GPU, one dispatch per level.
+        Dirty leaf and out of order leaf counts are read back asynchronously, so a rebuild is triggered one or more frames late.
+        \return False if light tree needs to be rebuilt.
+    */
+    bool refitLightTree(RenderContext* pRenderContext);
+
+    /** Find leaf node of each light and clear refit counters after light tree is rebuilt.
+    */
+    void initLightTreeRefit(RenderContext* pRenderContext);
+
+    /** Fingerprint emissive triangles, and hash it with build parameters of light tree.
+        Triangles are only hashed again when scene reports changed emissive triangles, and only those of moved mesh lights.
+    */
+    LightTreeCache::Key computeLightTreeCacheKey(RenderContext* pRenderContext);
+
+    /** Triangle ranges of mesh lights whose instance matrix changed since last fingerprint update, all triangles if
+        materials or mesh lights changed.
+    */
+    std::vector<LightTreeCache::EmissiveFingerprint::TriangleRange> findDirtyEmissiveTriangles(const std::vector<MeshLightData>& meshLights, size_t triangleCount);
+
+    /** Reuse light tree on GPU if emissive triangles are unchanged, or upload it from cache file.
+        Light tree built in the same frame is saved to cache file once it's read back, if it's still unchanged.
+        \return False if light tree needs to be built.
+    */
+    bool loadLightTreeCache(RenderContext* pRenderContext, const LightTreeCache::Key& key);
+
+    /** Copy light tree back without waiting for GPU, and write cache file in a later frame when the copy is finished.
+    */
+    void saveLightTreeCache(RenderContext* pRenderContext);
     void findLightcuts(RenderContext* pRenderContext, const RenderData& renderData);
 
+    /** Log how many lights share morton codes with 30-bit and 63-bit codes.
+    */
+    void reportMortonCodeCollisions();
+
+    /** Leaves hold up to leafTriangleCount triangles, only supported by complete binary tree.
+    */
+    bool useLeafClusters() const { return mLightTree.leafTriangleCount > 1 && !mLightTree.useLBVH; }
+
+    /** Refit stores leaves of single triangles in complete binary tree.
+    */
+    bool isRefitEnabled() const { return mLightTree.useRefit && !mLightTree.useLBVH && !useLeafClusters(); }
+
+    /** Refit merges nodes pairwise, so light tree is also rebuilt bottom-up to keep the same summation order.
+    */
+    bool useBottomUpConstruction() const { return mLightTree.useBottomUpConstruction || isRefitEnabled(); }
+
+    /** Cut size used by FindLightcuts, at least shadow rays per pixel.
+    */
+    uint getCutSize() const { return std::max(mLightTree.cutSize, mTracerParams.lightsPerPixel); }
+
     /** This function returns a cubic bounding box.
     */
     AABB sceneBoundHelper() const;
@@ -67,27 +131,81 @@ private:
     {
         // Light tree params.
         bool useCPUSorter = false;
+        LightTreeHelpers::LeafOrder leafOrder = LightTreeHelpers::LeafOrder::Morton;
+        bool useRefit = false;
+        float refitThreshold = 0.01f; ///< Rebuild when dirty leaves or out of order leaves exceed this ratio of lights.
+        bool useCompactLightTree = false; ///< Traverse PackedLightTreeNode instead of LightTreeNode, packed tree is extra memory next to the full tree.
+        bool useLBVH = false;             ///< Use LBVH with explicit child links instead of complete binary tree with bogus leaves.
+        bool useCache = false;            ///< Reuse light tree while emissive triangles are unchanged, and persist it to disk.
+        bool skipStaticRebuild = false;   ///< Skip leaf generation and light tree construction while light fingerprint and build parameters are unchanged.
+        bool useBottomUpConstruction = false; ///< Build internal nodes in one dispatch, each node only reads its two children.
         float errorLimit = 0.001f; // [Hime]TODO: make as gui
+        uint cutSize = 1;                 ///< At most kMaxLightcutSize, each shadow ray samples a cut node when it's larger than shadow rays.
+        uint lightcutTileSize = 1;        ///< Pixels of a tile share one cut found against their bound, 1 for a cut per pixel.
+        uint leafTriangleCount = 1;       ///< Max Morton adjacent triangles merged in one leaf, 1 for a leaf per triangle.
+        bool useLowDiscrepancySamples = false; ///< Select lights with blue noise rotated van der Corput numbers (HimeSequence) instead of SampleGenerator.
 
         // Light tree infos.
         uint lightCount = 0;
-        uint leafCount = 0;
+        uint clusterCount = 0;           ///< Non-bogus leaves, lightCount unless leaves hold multiple triangles.
+        uint leafCount = 0;              ///< Leaves including bogus leaves, lightCount for LBVH.
         uint bogusLightCount = 0;
         uint levelCount = 0;
         uint nodeCount = 0;
 
+        // Light tree refit states.
+        bool isRefitValid = false;       ///< False if leaf node indices are out of date.
+        AABB refitSceneBound;            ///< Scene bound when light tree is rebuilt, rebuild if it's changed.
+        uint maxDirtyLeafCount = 0;
+        uint dirtyLeafCount = 0;         ///< Leaves changed in last read back frame.
+        uint orderViolationCount = 0;    ///< Out of order leaf pairs since last rebuild, as of last read back frame.
+
+        // Light tree rebuild states.
+        LightTreeCache::EmissiveFingerprint emissiveFingerprint;
+        bool isFingerprintValid = false; ///< False if emissive triangles of scene are not hashed yet.
+        std::vector<glm::mat4> emissiveInstanceMatrices; ///< Instance matrix of each mesh light at last fingerprint update.
+        LightTreeCache::Key builtKey;    ///< Key of light tree in GPU buffers, empty if it's not fingerprinted.
+        uint64_t rebuildCount = 0;
+        uint64_t skippedRebuildCount = 0; ///< Frames light tree is reused or loaded from cache instead of built.
+
+        // Light tree cache states.
+        LightTreeCache::Key cacheKey;    ///< Key of light tree in GPUBuffer.
+        bool isCacheSaved = true;        ///< False if light tree of cacheKey is not in cache file yet.
+        HimeAsyncReadback::SharedPtr pCacheReadback; ///< Reads GPUBuffer back for cache file without waiting for GPU.
+
         // Light tree buffers.
-        std::vector<LightTreeNode> CPUBuffer;    ///< CPU buffer stores light tree.
+        std::vector<HimeRadixSort::KeyIndexPair> CPUSortingKeyIndex; ///< CPU copy of SortingKeyIndexBuffer, used by CPU sorter.
         Buffer::SharedPtr GPUBuffer;             ///< GPU buffer stores light tree.
         Buffer::SharedPtr SortingHelperBuffer;   ///< GPU buffer stores unsorted leaves.
         Buffer::SharedPtr SortingKeyIndexBuffer; ///< GPU buffer stores key(value) and index(leaf index in buffer).
+        Buffer::SharedPtr ChildrenBuffer;        ///< GPU buffer stores child links of LBVH.
+        Buffer::SharedPtr ParentsBuffer;         ///< GPU buffer stores parent links of LBVH, used by construction.
+        Buffer::SharedPtr PackedGPUBuffer;       ///< GPU buffer stores compact light tree, used by traversal. Released when compact light tree is off.
+        Buffer::SharedPtr DirtyLeavesBuffer;     ///< GPU buffer stores leaves changed since last frame, used by refit.
+        Buffer::SharedPtr DirtyLeafCounterBuffer; ///< GPU buffer stores dirty leaf count of this frame and out of order leaf pair count since last rebuild.
+        Buffer::SharedPtr LeafNodeIndicesBuffer; ///< GPU buffer stores leaf node index of each light, used by refit.
+        Buffer::SharedPtr LeafOrderFlagsBuffer;  ///< GPU buffer stores out of order flag of each leaf and its next leaf, used by refit.
+        HimeAsyncReadback::SharedPtr pRefitCounterReadback; ///< Reads DirtyLeafCounterBuffer back without waiting for GPU.
+        Buffer::SharedPtr ReadyCounterBuffer;    ///< GPU buffer stores arrived children of internal nodes, used by bottom-up construction.
+        Buffer::SharedPtr LeafTrianglesBuffer;   ///< GPU buffer stores light index of sorted triangles, used by leaves of multiple triangles.
+        Buffer::SharedPtr LeafTriangleCdfBuffer; ///< GPU buffer stores cdf of triangles within their leaf.
     } mLightTree;
 
     ComputePass::SharedPtr mpGenerateLightTreeLeavesPass;
     HimeBitonicSort::SharedPtr mpLightTreeLeavesSorter;
+    HimeRadixSort::SharedPtr mpLightTreeLeavesCPUSorter;
     ComputePass::SharedPtr mpReorderLightTreeLeavesPass;
+    ComputePass::SharedPtr mpClusterLightTreeLeavesPass;
     ComputePass::SharedPtr mpConstructLightTreePass;
+    ComputePass::SharedPtr mpConstructLightTreeBottomUpPass;
+    ComputePass::SharedPtr mpBuildLBVHHierarchyPass;
+    ComputePass::SharedPtr mpBuildLBVHBoundsPass;
+    ComputePass::SharedPtr mpInitLightTreeRefitPass;
+    ComputePass::SharedPtr mpWriteDirtyLeavesPass;
+    ComputePass::SharedPtr mpRefitLightTreePass;
+    ComputePass::SharedPtr mpPackLightTreePass;
     ComputePass::SharedPtr mpFindLightcutsPass;
+    HimeSequenceBuffers::SharedPtr mpSequenceBuffers;
 
     struct
     {
@@ -0,0 +1,310 @@
+#pragma once
+#include "LightTreeHelpers.h"
+#include "../HimeUtils/HimeSimd.h"
+
+namespace Falcor
+{
+    /** Wide node of a light tree collapsed from a binary light tree.
+        Data of all children is stored in the node (structure of arrays), so all children are evaluated in one SIMD step.
+        Unused lanes have zero intensity.
+    */
+    template<uint Width>
+    struct WideLightTreeNode
+    {
+        static const uint kLeafFlag = 0x80000000;
+
+        alignas(32) float boundMin[3][Width];
+        alignas(32) float boundMax[3][Width];
+        alignas(32) float intensity[Width]; ///< Length of child intensity, which is what error and weights use.
+        uint children[Width];               ///< Wide node index of internal child, kLeafFlag | lightIdx of leaf child, kInvalidLightTreeNode of unused lane.
+        uint nodeIds[Width];                ///< Binary light tree node index of each child.
+        uint childCount;
+
+        bool isLeaf(uint lane) const { return (children[lane] & kLeafFlag) != 0; }
+    };
+
+    /** Light tree with 4 or 8 children per node, collapsed from a binary light tree.
+        Wide node 0 holds children of binary root.
+    */
+    template<uint Width>
+    class WideLightTree
+    {
+    public:
+        static_assert(Width == 4 || Width == 8, "WideLightTree only supports 4 or 8 children");
+
+        using Node = WideLightTreeNode<Width>;
+        using SimdType = SimdFloat<Width>;
+
+        /** Per lane terms of a shading point.
+        */
+        struct ChildTerms
+        {
+            alignas(32) float error[Width];       ///< Same as computeError() in FindLightcuts.cs.slang.
+            alignas(32) float intensGeom[Width];  ///< Intensity times geometry term bound.
+            alignas(32) float invL2Min[Width];    ///< 1 / squared distance to closest point, distance is bounded as in computeError().
+            alignas(32) float invL2Max[Width];    ///< 1 / squared distance to farthest point.
+        };
+
+        /** Collapse binary light tree. Each binary node is expanded by its children until a wide node is full,
+            children with larger surface area are expanded first.
+        */
+        void build(const LightTreeHelpers::LightTreeView& lightTree)
+        {
+            mNodes.clear();
+            mLightCount = 0;
+
+            struct PendingNode
+            {
+                uint wideNodeIdx;
+                uint binaryNodeIdx;
+            };
+            std::vector<PendingNode> pendingNodes = { { allocateNode(), 0 } };
+
+            while (!pendingNodes.empty())
+            {
+                PendingNode pendingNode = pendingNodes.back();
+                pendingNodes.pop_back();
+
+                // Binary nodes collapsed into this wide node.
+                std::vector<uint> lanes;
+                if (lightTree.isLeaf(pendingNode.binaryNodeIdx)) lanes.push_back(pendingNode.binaryNodeIdx);
+                else expandNode(lightTree, pendingNode.binaryNodeIdx, lanes);
+
+                while (lanes.size() < Width)
+                {
+                    int expandLane = -1;
+                    float maxArea = -1.f;
+                    for (size_t i = 0; i < lanes.size(); i++)
+                    {
+                        if (lightTree.isLeaf(lanes[i])) continue;
+                        float area = computeSurfaceArea(lightTree.pNodes[lanes[i]]);
+                        if (area > maxArea)
+                        {
+                            maxArea = area;
+                            expandLane = (int)i;
+                        }
+                    }
+                    if (expandLane < 0) break;
+
+                    std::vector<uint> children;
+                    expandNode(lightTree, lanes[expandLane], children);
+                    if (lanes.size() - 1 + children.size() > Width) break;
+                    lanes.erase(lanes.begin() + expandLane);
+                    lanes.insert(lanes.begin() + expandLane, children.begin(), children.end());
+                }
+
+                for (uint lane = 0; lane < (uint)lanes.size(); lane++)
+                {
+                    const LightTreeNode& binaryNode = lightTree.pNodes[lanes[lane]];
+                    uint child = kInvalidLightTreeNode;
+                    if (lightTree.isLeaf(lanes[lane]))
+                    {
+                        child = Node::kLeafFlag | binaryNode.lightIdx;
+                        mLightCount++;
+                    }
+                    else
+                    {
+                        child = allocateNode();
+                        pendingNodes.push_back({ child, lanes[lane] });
+                    }
+
+                    Node& node = mNodes[pendingNode.wideNodeIdx];
+                    node.children[lane] = child;
+                    node.nodeIds[lane] = lanes[lane];
+                    node.intensity[lane] = length(binaryNode.intensity);
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        node.boundMin[axis][lane] = binaryNode.aabbMinPoint[axis];
+                        node.boundMax[axis][lane] = binaryNode.aabbMaxPoint[axis];
+                    }
+                }
+                mNodes[pendingNode.wideNodeIdx].childCount = (uint)lanes.size();
+            }
+        }
+
+        /** Evaluate error and weight terms of all children of a node in one SIMD step.
+        */
+        static void evaluateChildren(const Node& node, const float3& posW, const float3& normal, float minDistance2, ChildTerms& terms)
+        {
+            const SimdType zero = SimdType::set1(0.f);
+
+            SimdType dlen2 = zero, nrmMax = zero, dDotN = zero, l2Max = zero;
+            SimdType d[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                SimdType p = SimdType::set1(posW[axis]);
+                SimdType n = SimdType::set1(normal[axis]);
+                SimdType boundMin = SimdType::load(node.boundMin[axis]);
+                SimdType boundMax = SimdType::load(node.boundMax[axis]);
+
+                // Closest point, farthest point and max distance along normal.
+                d[axis] = min(max(p, boundMin), boundMax) - p;
+                dlen2 = dlen2 + d[axis] * d[axis];
+                dDotN = dDotN + d[axis] * n;
+                nrmMax = nrmMax + max(n * boundMin - n * p, n * boundMax - n * p);
+                SimdType farthest = max(abs(boundMin - p), abs(boundMax - p));
+                l2Max = l2Max + farthest * farthest;
+            }
+
+            // Geometry term bound, see computeGeomTermBound() in FindLightcuts.cs.slang.
+            SimdType tng2 = zero;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                SimdType tng = d[axis] - dDotN * SimdType::set1(normal[axis]);
+                tng2 = tng2 + tng * tng;
+            }
+            SimdType isFacing = nrmMax > zero;
+            SimdType geom = select(isFacing, nrmMax / sqrt(tng2 + nrmMax * nrmMax), zero);
+
+            SimdType intensity = SimdType::load(node.intensity);
+            SimdType bound2 = SimdType::set1(minDistance2);
+            SimdType intensGeom = intensity * geom;
+            SimdType isValid = intensGeom > zero;
+            (intensGeom / max(dlen2, bound2)).store(terms.error);
+            intensGeom.store(terms.intensGeom);
+            select(isValid, SimdType::set1(1.f) / max(dlen2, bound2), zero).store(terms.invL2Min);
+            select(isValid, SimdType::set1(1.f) / max(l2Max, bound2), zero).store(terms.invL2Max);
+        }
+
+        /** Child selection probabilities, generalization of firstChildWeight() in FindLightcuts.cs.slang to N children:
+            average of weights normalized with closest and farthest distances.
+            \return False if no child can contribute.
+        */
+        static bool computeChildProbs(const Node& node, const ChildTerms& terms, float probs[Width])
+        {
+            float sumMin = 0.f, sumMax = 0.f;
+            for (uint lane = 0; lane < node.childCount; lane++)
+            {
+                sumMin += terms.intensGeom[lane] * terms.invL2Min[lane];
+                sumMax += terms.intensGeom[lane] * terms.invL2Max[lane];
+            }
+            if (!(sumMin > 0.f) || !(sumMax > 0.f)) return false;
+
+            for (uint lane = 0; lane < Width; lane++)
+            {
+                probs[lane] = lane < node.childCount ? 0.5f * (terms.intensGeom[lane] * terms.invL2Min[lane] / sumMin + terms.intensGeom[lane] * terms.invL2Max[lane] / sumMax) : 0.f;
+            }
+            return true;
+        }
+
+        struct CutNode
+        {
+            uint child;  ///< Same encoding as WideLightTreeNode::children, wide node index or kLeafFlag | lightIdx.
+            uint nodeId; ///< Binary light tree node index.
+            float error;
+        };
+
+        /** Find a cut of at most cutSize nodes. A node is expanded only if all its children fit in the cut.
+        */
+        std::vector<CutNode> findCut(const float3& posW, const float3& normal, uint cutSize, float minDistance2) const
+        {
+            if (mNodes.empty()) return {};
+            std::vector<CutNode> cut = { { 0, 0, 1e27f } };
+
+            ChildTerms terms;
+            while (true)
+            {
+                int maxIdx = -1;
+                float maxError = -1e10f;
+                for (size_t i = 0; i < cut.size(); i++)
+                {
+                    if (cut[i].error > maxError)
+                    {
+                        maxIdx = (int)i;
+                        maxError = cut[i].error;
+                    }
+                }
+                if (maxIdx < 0 || (cut[maxIdx].child & Node::kLeafFlag)) break;
+
+                const Node& node = mNodes[cut[maxIdx].child];
+                if (cut.size() - 1 + node.childCount > cutSize) break;
+
+                evaluateChildren(node, posW, normal, minDistance2, terms);
+                cut.erase(cut.begin() + maxIdx);
+                for (uint lane = 0; lane < node.childCount; lane++) cut.push_back({ node.children[lane], node.nodeIds[lane], terms.error[lane] });
+            }
+            return cut;
+        }
+
+        /** Sample a light under a cut node.
+            \param[in] cutNode Cut node from findCut().
+            \param[in,out] r Random number in [0, 1), rescaled at each level.
+            \param[out] lightIdx Sampled light.
+            \param[out] prob Probability of sampled light in the cut node.
+            \param[out] depth Number of wide nodes visited.
+            \return False if traversal stopped at a dead branch.
+        */
+        bool sampleLight(const CutNode& cutNode, const float3& posW, const float3& normal, float minDistance2, float& r, uint& lightIdx, float& prob, uint& depth) const
+        {
+            uint child = cutNode.child;
+            prob = 1.f;
+            depth = 0;
+
+            ChildTerms terms;
+            float probs[Width];
+            while ((child & Node::kLeafFlag) == 0)
+            {
+                const Node& node = mNodes[child];
+                depth++;
+                evaluateChildren(node, posW, normal, minDistance2, terms);
+                if (!computeChildProbs(node, terms, probs)) return false;
+
+                uint lane = 0;
+                uint lastValidLane = 0;
+                float cdf = 0.f;
+                for (; lane < node.childCount; lane++)
+                {
+                    if (!(probs[lane] > 0.f)) continue;
+                    lastValidLane = lane;
+                    if (r < cdf + probs[lane]) break;
+                    cdf += probs[lane];
+                }
+                if (lane == node.childCount)
+                {
+                    // Rounding error of cdf.
+                    lane = lastValidLane;
+                    cdf -= probs[lane];
+                }
+
+                r = std::min((r - cdf) / probs[lane], 0.99999994f);
+                prob *= probs[lane];
+                child = node.children[lane];
+            }
+
+            lightIdx = child & ~Node::kLeafFlag;
+            return true;
+        }
+
+        const std::vector<Node>& getNodes() const { return mNodes; }
+        uint getLightCount() const { return mLightCount; }
+
+    private:
+        uint allocateNode()
+        {
+            Node node = {};
+            for (uint lane = 0; lane < Width; lane++)
+            {
+                node.children[lane] = kInvalidLightTreeNode;
+                node.nodeIds[lane] = kInvalidLightTreeNode;
+            }
+            mNodes.push_back(node);
+            return (uint)mNodes.size() - 1;
+        }
+
+        static void expandNode(const LightTreeHelpers::LightTreeView& lightTree, uint nodeIdx, std::vector<uint>& children)
+        {
+            uint2 childIds = lightTree.getChildren(nodeIdx);
+            if (!lightTree.pNodes[childIds.x].isBogus()) children.push_back(childIds.x);
+            if (!lightTree.pNodes[childIds.y].isBogus()) children.push_back(childIds.y);
+        }
+
+        static float computeSurfaceArea(const LightTreeNode& node)
+        {
+            float3 extent = node.aabbMaxPoint - node.aabbMinPoint;
+            return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+        }
+
+        std::vector<Node> mNodes;
+        uint mLightCount = 0;
+    };
+}